@@ -29,7 +29,9 @@
 // ============================================================================
 // SonarSurface - displays sonar data in a fan display
 
-SonarSurface::SonarSurface()
+SonarSurface::SonarSurface() :
+    m_gridText(0, true),        // Grid labels only change with the range or projection
+    m_measureText(80)           // Measurement label is rewritten in place on every move
 {
     m_textureId    = 0;           // The image texture id
     m_nBrgs        = 0;
@@ -52,6 +54,7 @@ SonarSurface::SonarSurface()
 
     m_pRgbData     = nullptr;
     m_useRgb       = false;
+    m_pRgbPalette  = nullptr;
 
     m_disconnected = true;
 
@@ -63,10 +66,16 @@ SonarSurface::SonarSurface()
     m_measureEnable = false;
 
     m_wasInsideFan = false;
+    m_crossCursor = false;
 
     m_showGrid = true;
     m_showDetections = false;
 
+    // Detection overlay styles, drawn in the order they are added
+    m_detGlowStyle  = m_detectionOverlay.AddStyle(QColor(200, 0, 0), 5.0f);
+    m_detBoxStyle   = m_detectionOverlay.AddStyle(QColor(255, 0, 0), 2.0f);
+    m_detCrossStyle = m_detectionOverlay.AddStyle(QColor(255, 200, 0), 1.5f);
+
 }
 
 SonarSurface::~SonarSurface()
@@ -85,6 +94,8 @@ SonarSurface::~SonarSurface()
 
     if (m_pRgbData)
         delete m_pRgbData;
+
+    RmglReleaseText(m_gridText);
 }
 
 // ----------------------------------------------------------------------------
@@ -183,7 +194,7 @@ void SonarSurface::InitTextures()
     UpdateImg(nRngs, nBrgs, pData);
 
     // Put a simple test image into the sonar display
-    m_pRgbData = (uchar*) malloc (nBrgs * nRngs * 3);
+    m_pRgbData = (uchar*) realloc (m_pRgbData, nBrgs * nRngs * 3);
     pPtr = m_pRgbData;
 
     for (int j = 0; j < nRngs; j++)
@@ -455,6 +466,9 @@ void SonarSurface::CalcGrid()
 
     // How many arcs to render
     m_nArcs = a + 1;
+
+    // Labels are sized in pixels so follow the projection
+    BuildDetectionOverlay();
 }
 
 // ----------------------------------------------------------------------------
@@ -595,6 +609,9 @@ void SonarSurface::UpdateImg(int nRngs, int nBrgs, uchar* pData)
         memcpy(m_pData, pData, nRngs * nBrgs);
     }
 
+    if (m_pRgbPalette)
+        ColouriseImg();
+
     m_newImgData = true;
 }
 
@@ -614,9 +631,42 @@ void SonarSurface::UpdateImg16(int nRngs, int nBrgs, quint16* pData)
     for (int i = 0; i < nRngs * nBrgs; i++)
         *pDest++ = (uchar)((*pSrc++ & 0xff00) >> 8);
 
+    // The CPU palette can use the full 16 bits
+    if (m_pRgbPalette)
+    {
+        m_pRgbData = (uchar*) realloc (m_pRgbData, nRngs * nBrgs * 3);
+        m_pRgbPalette->Colourise16(pData, nRngs * nBrgs, m_pRgbData, pixRgb);
+    }
+
     m_newImgData = true;
 }
 
+// ----------------------------------------------------------------------------
+// Colour the current image through the CPU palette into the RGB image
+void SonarSurface::ColouriseImg()
+{
+    if (!m_pRgbPalette || !m_pData || !m_nRngs || !m_nBrgs)
+        return;
+
+    m_pRgbData = (uchar*) realloc (m_pRgbData, m_nRngs * m_nBrgs * 3);
+    m_pRgbPalette->Colourise8(m_pData, m_nRngs * m_nBrgs, m_pRgbData, pixRgb);
+}
+
+// ----------------------------------------------------------------------------
+// Render through a CPU palette (RGB image) or, with nullptr, through the GPU
+// palette selected by m_palIndex. The palette is not owned
+void SonarSurface::SetRgbPalette(RmPalette* pPalette)
+{
+    m_pRgbPalette = pPalette;
+    m_useRgb      = (pPalette != nullptr);
+
+    ColouriseImg();
+
+    m_newImgData = true;
+
+    emit Update();
+}
+
 bool SonarSurface::AreClockwise(QPoint ct, float radius, float angle, QPoint pt)
 {
     float x = (ct.x() + radius) * cos(angle);
@@ -714,7 +764,8 @@ void SonarSurface::mouseMoveEvent(QMouseEvent* pEvent)
     QPoint pos = pEvent->pos();
 
     // Determine if the cursor is inside the fan display
-    bool insideFan = IsInsideFan(pos) && (!m_disconnected);
+    bool inFan = IsInsideFan(pos);
+    bool insideFan = inFan && (!m_disconnected);
 
     // Check to see if the mouse has moved in or out of the fan display
     if (insideFan && !m_wasInsideFan) {
@@ -728,12 +779,16 @@ void SonarSurface::mouseMoveEvent(QMouseEvent* pEvent)
     m_wasInsideFan = insideFan;
 
 
-    if ((m_measureEnable) && (IsInsideFan(pos)))
-        this->SetCursor(Qt::CrossCursor);
-    else
-        this->SetCursor(Qt::ArrowCursor);
+    // Only touch the cursor when it actually changes
+    bool crossCursor = m_measureEnable && inFan;
+
+    if (crossCursor != m_crossCursor)
+    {
+        m_crossCursor = crossCursor;
+        this->SetCursor(crossCursor ? Qt::CrossCursor : Qt::ArrowCursor);
+    }
 
-    if ((m_measureEnable) && ((m_measuring) && (IsInsideFan(pos))))
+    if ((m_measureEnable) && ((m_measuring) && (inFan)))
     {
 
         //QPoint pos = pEvent->pos();
@@ -768,14 +823,17 @@ void SonarSurface::mouseMoveEvent(QMouseEvent* pEvent)
         m_measureEndX = x;
         m_measureEndY = y;
 
+        // Rewrite the label in place (the buffer keeps its storage)
+        QString text = "Dist: " + QString::number(dist, 3, 2) + "m, Angle: " + QString::number(angle, 3, 1) + ", X: " + QString::number(x, 3, 2) + ", Y: " + QString::number(y, 3, 2);
+
         m_measureText.ClearBuffer();
         if (m_headDown)
         {
-            RmglAddText(m_measureText, m_measureEndX, m_measureEndY, 0.0, "Dist: " + QString::number(dist, 3, 2) + "m, Angle: " + QString::number(angle, 3, 1) + ", X: " + QString::number(x, 3, 2) + ", Y: " + QString::number(y, 3, 2), taFlipY);
+            RmglAddText(m_measureText, m_measureEndX, m_measureEndY, 0.0, text, taFlipY);
         }
         else
         {
-            RmglAddText(m_measureText, m_measureEndX, m_measureEndY, 0.0, "Dist: " + QString::number(dist, 3, 2) + "m, Angle: " + QString::number(angle, 3, 1) + ", X: " + QString::number(x, 3, 2) + ", Y: " + QString::number(y, 3, 2));
+            RmglAddText(m_measureText, m_measureEndX, m_measureEndY, 0.0, text);
         }
 
         emit Update();
@@ -855,21 +913,20 @@ void SonarSurface::ToggleGridLines() {
     m_showGrid = !m_showGrid;
 }
 
-// YOLO Detection Methods
+// ----------------------------------------------------------------------------
+// Store the latest detections and rebuild their overlay
 void SonarSurface::SetDetections(const QList<DetectedObject>& detections)
 {
     m_detections = detections;
+
+    BuildDetectionOverlay();
 }
 
-void SonarSurface::RenderDetections()
+// ----------------------------------------------------------------------------
+// Build the boxes, crosses and confidence labels for the current detections
+void SonarSurface::BuildDetectionOverlay()
 {
-    if (m_detections.isEmpty()) {
-        return;
-    }
-
-    glDisable(GL_DEPTH_TEST);
-
-    int aPosition = glGetAttribLocation(m_pgmSolid, "aPosition");
+    m_detectionOverlay.ClearBuffer();
 
     for (const auto& obj : m_detections) {
         float halfW = (obj.meterWidth * m_detectionWidthScale) / 2.0f;
@@ -878,44 +935,27 @@ void SonarSurface::RenderDetections()
         float x = static_cast<float>(obj.meterPos.x());
         float y = static_cast<float>(obj.meterPos.y());
 
-        float vertices[] = {
-            x - halfW, y - halfH,
-            x + halfW, y - halfH,
-            x + halfW, y + halfH,
-            x - halfW, y + halfH
-        };
-
-        // 1. Dış glow - koyu mavi
-        RmglSetColour(QColor(200, 0, 0));
-        RmglSetPgm(pgmSolid);  // Rengi shader'a gönder
-        glLineWidth(5.0f);
-        glVertexAttribPointer(aPosition, 2, GL_FLOAT, GL_FALSE, 0, vertices);
-        glEnableVertexAttribArray(aPosition);
-        glDrawArrays(GL_LINE_LOOP, 0, 4);
-
-        // 2. Ana çerçeve - parlak cyan
-        RmglSetColour(QColor(255, 0, 0));
-        RmglSetPgm(pgmSolid);  // Rengi shader'a gönder
-        glLineWidth(2.0f);
-        glVertexAttribPointer(aPosition, 2, GL_FLOAT, GL_FALSE, 0, vertices);
-        glDrawArrays(GL_LINE_LOOP, 0, 4);
-
-        // 3. Merkez artı
-        RmglSetColour(QColor(255, 200, 0));
-        RmglSetPgm(pgmSolid);  // Rengi shader'a gönder
-        glLineWidth(1.5f);
-
-        float crossSize = qMin(halfW, halfH) * 0.3f;
-        float crossVerts[] = {
-            x - crossSize, y,
-            x + crossSize, y,
-            x, y - crossSize,
-            x, y + crossSize
-        };
-        glVertexAttribPointer(aPosition, 2, GL_FLOAT, GL_FALSE, 0, crossVerts);
-        glDrawArrays(GL_LINES, 0, 4);
+        m_detectionOverlay.AddBox(m_detGlowStyle, x - halfW, y - halfH, x + halfW, y + halfH);
+        m_detectionOverlay.AddBox(m_detBoxStyle, x - halfW, y - halfH, x + halfW, y + halfH);
+        m_detectionOverlay.AddCross(m_detCrossStyle, x, y, qMin(halfW, halfH) * 0.3f);
+
+        // Confidence above the top left corner of the box
+        QString label = QString::number(qRound(obj.confidence * 100.0f)) + "%";
+
+        if (m_headDown)
+            RmglAddText(m_detectionOverlay.m_labels, x - halfW, y - halfH, 0.0, label, taLeft | taTop | taFlipY);
+        else
+            RmglAddText(m_detectionOverlay.m_labels, x - halfW, y + halfH, 0.0, label, taLeft | taBottom);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Draw the detection overlay
+void SonarSurface::RenderDetections()
+{
+    if (m_detections.isEmpty()) {
+        return;
     }
 
-    glDisableVertexAttribArray(aPosition);
-    glLineWidth(1.0f);
+    RmglRenderOverlayBuffer(m_detectionOverlay);
 }
@@ -20,6 +20,7 @@
 #pragma once
 
 #include "../RmGl/RmGlSurface.h"
+#include "../RmUtil/RmPalette.h"
 #include <QPointF>
 #include <QList>
 
@@ -63,10 +64,13 @@ public:
     void RenderMeasureLine();
     void RenderBranding();
     void RenderDetections();
+    void BuildDetectionOverlay();
     void CalcGrid();
     void Recalculate();
     void AddDataToImg();
     void AddRgbDataToImg();
+    void ColouriseImg();
+    void SetRgbPalette(RmPalette* pPalette);
 
     bool AreClockwise(QPoint ct, float radius, float angle, QPoint pt);
     bool IsInsideSector(QPoint pt, QPoint ct, float radius, float angle1, float angle2);
@@ -109,6 +113,7 @@ public:
     uchar*   m_pData;        // The last data for this image
     uchar*   m_pRgbData;     // The RGB data to use for this image
     bool     m_useRgb;       // Use an RGB image rather than the luminance
+    RmPalette* m_pRgbPalette; // CPU palette feeding the RGB image (nullptr = GPU palette)
 
     int      m_width;
     int      m_height;
@@ -127,12 +132,19 @@ public:
     float m_detectionHeightScale = 5.0f;
 
     bool     m_wasInsideFan;
+    bool     m_crossCursor;  // The cross (measure) cursor is currently shown
 
     bool		m_showGrid;
 
     // YOLO detections
     QList<DetectedObject> m_detections;
 
+    // Batched overlay the detections are drawn from
+    RmGlOverlayBuffer m_detectionOverlay;
+    int      m_detGlowStyle;     // Outer glow of the detection box
+    int      m_detBoxStyle;      // Detection box
+    int      m_detCrossStyle;    // Centre cross
+
     // Text buffer to draw grid information into
     RmGlTextBuffer m_gridText;
 
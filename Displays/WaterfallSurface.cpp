@@ -0,0 +1,395 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "WaterfallSurface.h"
+
+#include <QtMath>
+
+#include "../RmUtil/RmUtil.h"
+
+
+// ============================================================================
+// WaterfallSurface - displays a beam or sector as a scrolling time history
+
+WaterfallSurface::WaterfallSurface(int nHistory, int nBins) :
+    m_gridText(0, true)         // Labels only change with the range, source or size
+{
+    m_textureId    = 0;
+    m_pgmWaterfall = 0;
+    m_nHistory     = qMax(nHistory, 2);
+    m_nBins        = qMax(nBins, 2);
+    m_head         = 0;
+    m_nPings       = 0;
+    m_nPending     = 0;
+    m_newTexture   = true;
+
+    m_pRows        = (uchar*) calloc (m_nHistory * m_nBins, 1);
+    m_pBinRows     = (int*) malloc (m_nBins * sizeof(int));
+    m_nRngs        = 0;
+
+    // Default to the strongest return across the whole fan
+    m_source       = wfSectorMax;
+    m_left         = -180.0f;
+    m_right        = 180.0f;
+    m_beam0        = 0;
+    m_beam1        = 0;
+    m_nBrgs        = 0;
+    m_brg0         = 0;
+    m_newSector    = true;
+
+    m_range        = 0.0;
+    m_mkr          = 1.0f;
+    m_dwGridText   = true;
+    m_newGrid      = true;
+
+    rmgl2dProjection(0.0f, 1.0f, 0.0f, m_nHistory, none);
+}
+
+WaterfallSurface::~WaterfallSurface()
+{
+    if (m_pRows)
+        free(m_pRows);
+
+    if (m_pBinRows)
+        free(m_pBinRows);
+
+    RmglReleaseText(m_gridText);
+}
+
+// ----------------------------------------------------------------------------
+// Initialise the OpenGL environment
+void WaterfallSurface::OnCreate()
+{
+    RmGlSurface::OnCreate();
+
+    m_pgmWaterfall = RmglBuildProgram(":/RmGl/Shaders/texture.vsh", ":/RmGl/Shaders/waterfall.fsh");
+
+    glGenTextures(1, &m_textureId);
+
+    m_newTexture = true;
+    m_newGrid    = true;
+}
+
+// ----------------------------------------------------------------------------
+// Range across, ping history up (newest at the top)
+void WaterfallSurface::OnResize(int w, int h)
+{
+    m_width  = w;
+    m_height = h;
+
+    rmgl2dProjection(0.0f, m_range > 0.0 ? m_range : 1.0, 0.0f, m_nHistory, none);
+
+    m_newGrid = true;
+}
+
+// ----------------------------------------------------------------------------
+// Render the scene
+void WaterfallSurface::Render()
+{
+    glClearColor(m_clearColour.redF(), m_clearColour.greenF(), m_clearColour.blueF(), m_clearColour.alphaF());
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+
+    if (m_range <= 0.0)
+        return;
+
+    if (m_newGrid)
+        CalcGrid();
+
+    RenderImg();
+    RenderGrid();
+}
+
+// ----------------------------------------------------------------------------
+// Select the beam or sector the rows are built from (degrees). The history is
+// kept, new rows are built from the new selection
+void WaterfallSurface::SetSource(eWaterfallSource source, float left, float right)
+{
+    m_source    = source;
+    m_left      = qMin(left, right);
+    m_right     = qMax(left, right);
+    m_newSector = true;
+    m_newGrid   = true;
+}
+
+// ----------------------------------------------------------------------------
+// Drop all the history, the texture is reloaded on the next render
+void WaterfallSurface::ClearHistory()
+{
+    if (m_pRows)
+        memset(m_pRows, 0, m_nHistory * m_nBins);
+
+    m_head       = 0;
+    m_nPings     = 0;
+    m_nPending   = 0;
+    m_newTexture = true;
+}
+
+// ----------------------------------------------------------------------------
+// Resolve the source selection into a run of beams using the bearing table
+// (hundredths of a degree, ascending)
+void WaterfallSurface::CalcSector(int nBrgs, short* pBrgs)
+{
+    m_nBrgs     = nBrgs;
+    m_brg0      = pBrgs ? pBrgs[0] : 0;
+    m_newSector = false;
+
+    m_beam0 = 0;
+    m_beam1 = nBrgs - 1;
+
+    if (!pBrgs)
+        return;
+
+    float centre = (m_left + m_right) * 50.0f;
+    int   nearest = 0;
+
+    for (int b = 1; b < nBrgs; b++)
+    {
+        if (qAbs(pBrgs[b] - centre) < qAbs(pBrgs[nearest] - centre))
+            nearest = b;
+    }
+
+    if (m_source == wfBeam)
+    {
+        m_beam0 = m_beam1 = nearest;
+        return;
+    }
+
+    m_beam0 = -1;
+
+    for (int b = 0; b < nBrgs; b++)
+    {
+        if (pBrgs[b] >= m_left * 100.0f && pBrgs[b] <= m_right * 100.0f)
+        {
+            if (m_beam0 < 0)
+                m_beam0 = b;
+
+            m_beam1 = b;
+        }
+    }
+
+    // A sector narrower than the beam spacing falls back to the nearest beam
+    if (m_beam0 < 0)
+        m_beam0 = m_beam1 = nearest;
+}
+
+// ----------------------------------------------------------------------------
+// Reduce a ping (nRngs lines of nBrgs beams) to one row and write it over the
+// oldest row in the ring. Only this row is sent to the texture on the next render
+void WaterfallSurface::AddPing(double range, int nRngs, int nBrgs, short* pBrgs, uchar* pData)
+{
+    if (!pData || !m_pRows || !m_pBinRows || nRngs < 1 || nBrgs < 1 || range <= 0.0)
+        return;
+
+    // The bins are fixed fractions of the range so a new range restarts the history
+    if (range != m_range)
+    {
+        m_range = range;
+        ClearHistory();
+
+        rmgl2dProjection(0.0f, m_range, 0.0f, m_nHistory, none);
+        m_newGrid = true;
+    }
+
+    if (nRngs != m_nRngs)
+    {
+        m_nRngs = nRngs;
+
+        for (int k = 0; k < m_nBins; k++)
+            m_pBinRows[k] = qMin(nRngs - 1, (int)((k + 0.5) * nRngs / m_nBins));
+    }
+
+    if (m_newSector || nBrgs != m_nBrgs || (pBrgs && pBrgs[0] != m_brg0))
+        CalcSector(nBrgs, pBrgs);
+
+    uchar* pRow   = &m_pRows[m_head * m_nBins];
+    int    nBeams = m_beam1 - m_beam0 + 1;
+
+    for (int k = 0; k < m_nBins; k++)
+    {
+        const uchar* pSrc = &pData[m_pBinRows[k] * nBrgs + m_beam0];
+
+        switch (m_source)
+        {
+        case wfBeam:
+            pRow[k] = *pSrc;
+            break;
+
+        case wfSectorMax:
+        {
+            uchar max = 0;
+
+            for (int b = 0; b < nBeams; b++)
+                max = qMax(max, pSrc[b]);
+
+            pRow[k] = max;
+            break;
+        }
+
+        case wfSectorMean:
+        {
+            unsigned sum = 0;
+
+            for (int b = 0; b < nBeams; b++)
+                sum += pSrc[b];
+
+            pRow[k] = (uchar)(sum / nBeams);
+            break;
+        }
+        }
+    }
+
+    m_head = (m_head + 1) % m_nHistory;
+
+    if (m_nPings < m_nHistory)
+        m_nPings++;
+
+    if (m_nPending < m_nHistory)
+        m_nPending++;
+}
+
+// ----------------------------------------------------------------------------
+// Bring the texture up to date - normally a single row, at most two runs when
+// the pending rows wrap round the end of the ring
+void WaterfallSurface::UploadRows()
+{
+    glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+    if (m_newTexture)
+    {
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S,     GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T,     GL_CLAMP_TO_EDGE);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+        glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+
+        glTexImage2D(GL_TEXTURE_2D, 0, GL_ALPHA, m_nBins, m_nHistory, 0, GL_ALPHA, GL_UNSIGNED_BYTE, m_pRows);
+
+        m_newTexture = false;
+        m_nPending   = 0;
+        return;
+    }
+
+    if (m_nPending < 1)
+        return;
+
+    int start = (m_head - m_nPending + m_nHistory) % m_nHistory;
+    int nRun  = qMin(m_nPending, m_nHistory - start);
+
+    glTexSubImage2D(GL_TEXTURE_2D, 0, 0, start, m_nBins, nRun, GL_ALPHA, GL_UNSIGNED_BYTE, &m_pRows[start * m_nBins]);
+
+    if (nRun < m_nPending)
+        glTexSubImage2D(GL_TEXTURE_2D, 0, 0, 0, m_nBins, m_nPending - nRun, GL_ALPHA, GL_UNSIGNED_BYTE, m_pRows);
+
+    m_nPending = 0;
+}
+
+// ----------------------------------------------------------------------------
+// Draw the filled part of the history through the palette
+void WaterfallSurface::RenderImg()
+{
+    if (!m_pgmWaterfall || !m_textureId || m_nPings < 1)
+        return;
+
+    glActiveTexture(GL_TEXTURE0);
+    glBindTexture(GL_TEXTURE_2D, m_textureId);
+
+    UploadRows();
+
+    m_pgmId = m_pgmWaterfall;
+    glUseProgram(m_pgmId);
+    glUniform1i(glGetUniformLocation(m_pgmId, "uTexUnit"), 0);
+    glUniform1i(glGetUniformLocation(m_pgmId, "uPalUnit"), 1);
+    glUniform1f(glGetUniformLocation(m_pgmId, "uPalIndex"), ((float)m_palIndex + 0.5f) / (float)m_nPalettes);
+    glUniform1f(glGetUniformLocation(m_pgmId, "uHead"), (float)m_head / (float)m_nHistory);
+    glUniformMatrix4fv(glGetUniformLocation(m_pgmId, "uMatrix"), 1, false, m_projection.data());
+    glUniform1f(glGetUniformLocation(m_pgmId, "uOriginX"), m_originX);
+    glUniform1f(glGetUniformLocation(m_pgmId, "uOriginY"), m_originY);
+
+    glActiveTexture(GL_TEXTURE1);
+    glBindTexture(GL_TEXTURE_2D, m_palTexId);
+    glActiveTexture(GL_TEXTURE0);
+
+    // The newest ping is at the top, the quad only covers the rows written so far
+    float y0 = (float)(m_nHistory - m_nPings);
+    float t0 = y0 / (float)m_nHistory;
+    float r  = (float)m_range;
+
+    float vbo[16] =
+    {
+        0.0f, y0,                0.0f, t0,
+        r,    y0,                1.0f, t0,
+        0.0f, (float)m_nHistory, 0.0f, 1.0f,
+        r,    (float)m_nHistory, 1.0f, 1.0f
+    };
+
+    int aPosition = glGetAttribLocation(m_pgmId, "aPosition");
+    glVertexAttribPointer(aPosition, 2, GL_FLOAT, false, 4 * sizeof(float), vbo);
+    glEnableVertexAttribArray(aPosition);
+
+    int aTexCoord = glGetAttribLocation(m_pgmId, "aTexCoords");
+    glVertexAttribPointer(aTexCoord, 2, GL_FLOAT, false, 4 * sizeof(float), &vbo[2]);
+    glEnableVertexAttribArray(aTexCoord);
+
+    glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+}
+
+// ----------------------------------------------------------------------------
+// Lay out the range labels and the source description
+void WaterfallSurface::CalcGrid()
+{
+    m_newGrid = false;
+
+    m_gridText.ClearBuffer();
+
+    if (m_range <= 0.0)
+        return;
+
+    m_mkr = (float) RmUtil::NearestMkr(m_range / 5.0);
+
+    if (!m_dwGridText)
+        return;
+
+    for (float rng = m_mkr; rng < m_range; rng += m_mkr)
+        RmglAddText(m_gridText, rng, 0.0f, 0.0f, QString::number(rng, 'g', 3) + "m", taHCentre | taBottom);
+
+    QString source;
+
+    switch (m_source)
+    {
+    case wfBeam:       source = "Beam " + QString::number((m_left + m_right) / 2.0f, 'f', 1) + " deg"; break;
+    case wfSectorMax:  source = "Max "  + QString::number(m_left, 'f', 1) + " to " + QString::number(m_right, 'f', 1) + " deg"; break;
+    case wfSectorMean: source = "Mean " + QString::number(m_left, 'f', 1) + " to " + QString::number(m_right, 'f', 1) + " deg"; break;
+    }
+
+    RmglAddText(m_gridText, 0.0f, (float)m_nHistory, 0.0f, " " + source, taLeft | taTop);
+}
+
+// ----------------------------------------------------------------------------
+// Draw the range grid lines and the labels
+void WaterfallSurface::RenderGrid()
+{
+    if (m_mkr <= 0.0f)
+        return;
+
+    glDisable(GL_DEPTH_TEST);
+
+    for (float rng = m_mkr; rng < m_range; rng += m_mkr)
+        RmglRenderLine(rng, 0.0f, rng, (float)m_nHistory, Qt::gray);
+
+    RmglRenderText(m_gridText);
+}
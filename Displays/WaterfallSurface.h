@@ -0,0 +1,91 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#pragma once
+
+#include "../RmGl/RmGlSurface.h"
+
+// Where each waterfall row is taken from in the ping
+enum eWaterfallSource : int
+{
+    wfBeam,          // The single beam nearest the sector centre
+    wfSectorMax,     // Strongest return across the sector at each range
+    wfSectorMean     // Mean return across the sector at each range
+};
+
+// ----------------------------------------------------------------------------
+// WaterfallSurface - displays intensity versus range for a beam or sector as a
+// scrolling time history. The last m_nHistory pings are kept in a ring texture,
+// each ping replaces a single row and the shader handles the wrap so scrolling
+// costs the same however much history is kept
+
+class WaterfallSurface : public RmGlSurface
+{
+    Q_OBJECT
+
+public:
+    explicit WaterfallSurface(int nHistory = 512, int nBins = 512);
+    ~WaterfallSurface();
+
+    // Overrides
+    void Render()                                 Q_DECL_OVERRIDE;
+    void OnCreate()                               Q_DECL_OVERRIDE;
+    void OnResize(int w, int h)                   Q_DECL_OVERRIDE;
+
+    // Methods
+    void AddPing(double range, int nRngs, int nBrgs, short* pBrgs, uchar* pData);
+    void SetSource(eWaterfallSource source, float left, float right);
+    void ClearHistory();
+
+    void RenderImg();
+    void RenderGrid();
+    void UploadRows();
+    void CalcGrid();
+    void CalcSector(int nBrgs, short* pBrgs);
+
+    // Data
+    unsigned m_textureId;        // Ring texture (m_nBins x m_nHistory)
+    int      m_pgmWaterfall;     // Palette lookup with the ring wrap
+    int      m_nHistory;         // Number of pings kept
+    int      m_nBins;            // Number of range bins in a row
+    int      m_head;             // Row the next ping is written to (the oldest row)
+    int      m_nPings;           // Number of rows holding data (up to m_nHistory)
+    int      m_nPending;         // Rows written since the last texture upload
+    bool     m_newTexture;       // The whole texture needs to be (re)loaded
+
+    uchar*   m_pRows;            // CPU copy of the ring
+    int*     m_pBinRows;         // Source range line for each bin
+    int      m_nRngs;            // Range lines the bin table was built for
+
+    eWaterfallSource m_source;   // How a row is built
+    float    m_left;             // Sector left (degrees)
+    float    m_right;            // Sector right (degrees)
+    int      m_beam0;            // First beam in the sector
+    int      m_beam1;            // Last beam in the sector (inclusive)
+    int      m_nBrgs;            // Beams the sector was resolved for
+    short    m_brg0;             // First bearing the sector was resolved for
+    bool     m_newSector;        // The sector needs to be resolved against the beams
+
+    double   m_range;            // Range of the rows in the history
+    float    m_mkr;              // Range grid spacing
+    bool     m_dwGridText;       // Draw the range labels
+    bool     m_newGrid;          // The labels need to be laid out again
+
+    RmGlTextBuffer m_gridText;   // Range and source labels
+};
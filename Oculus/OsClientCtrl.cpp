@@ -187,6 +187,159 @@ void OsBufferEntry::ProcessRaw(char* pData)
 }
 
 
+// ----------------------------------------------------------------------------
+// Get the image dimensions and range of the last processed record (the caller
+// should hold the entry lock)
+void OsBufferEntry::GetImageInfo(int& nBeams, int& nRanges, double& range)
+{
+  if (m_simple)
+  {
+    if (m_version == 2)
+    {
+      nBeams  = m_rfm2.nBeams;
+      nRanges = m_rfm2.nRanges;
+      range   = nRanges * m_rfm2.rangeResolution;
+    }
+    else
+    {
+      nBeams  = m_rfm.nBeams;
+      nRanges = m_rfm.nRanges;
+      range   = nRanges * m_rfm.rangeResolution;
+    }
+  }
+  else
+  {
+    nBeams  = m_rff.ping.nBeams;
+    nRanges = m_rff.ping_params.nRangeLinesBfm;
+    range   = m_rff.ping.range;
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Image size and beam count of the ping an entry holds
+static void FrameSizes(const OsBufferEntry& entry, quint32& imageSize, int& nBeams)
+{
+  if (entry.m_simple)
+  {
+    imageSize = (entry.m_version == 2) ? entry.m_rfm2.imageSize : entry.m_rfm.imageSize;
+    nBeams    = (entry.m_version == 2) ? entry.m_rfm2.nBeams : entry.m_rfm.nBeams;
+  }
+  else
+  {
+    imageSize = entry.m_rff.ping_params.imageSize;
+    nBeams    = entry.m_rff.ping.nBeams;
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Size of the decoded image and bearing table (the caller should hold the
+// entry lock)
+quint32 OsBufferEntry::FrameBytes()
+{
+  quint32 imageSize;
+  int     nBeams;
+
+  FrameSizes(*this, imageSize, nBeams);
+
+  return imageSize + nBeams * sizeof(short);
+}
+
+// ----------------------------------------------------------------------------
+// Copy the decoded ping (messages, image and bearings) of another entry. The
+// raw record isn't copied, so the one held is dropped as it isn't this ping's
+bool OsBufferEntry::CopyFrame(OsBufferEntry& src)
+{
+  QMutexLocker lock(&src.m_mutex);
+
+  if (!src.m_pImage || !src.m_pBrgs)
+    return false;
+
+  quint32 imageSize;
+  int     nBeams;
+
+  FrameSizes(src, imageSize, nBeams);
+
+  m_mutex.lock();
+
+  m_rfm     = src.m_rfm;
+  m_rff     = src.m_rff;
+  m_rfm2    = src.m_rfm2;
+  m_version = src.m_version;
+  m_simple  = src.m_simple;
+  m_rawSize = 0;
+
+  m_pImage = (uchar*) realloc(m_pImage, qMax(imageSize, 1u));
+  m_pBrgs  = (short*) realloc(m_pBrgs, qMax(nBeams, 1) * sizeof(short));
+
+  bool ok = m_pImage && m_pBrgs;
+
+  if (ok)
+  {
+    memcpy(m_pImage, src.m_pImage, imageSize);
+    memcpy(m_pBrgs, src.m_pBrgs, nBeams * sizeof(short));
+  }
+
+  m_mutex.unlock();
+
+  return ok;
+}
+
+// ----------------------------------------------------------------------------
+// Find the image in a raw simple ping result so the log codec can predict
+// along the range lines. Returns false for anything else
+bool OsBufferEntry::CodecLayout(const quint8* pRaw, quint32 size, RmCodecLayout& layout)
+{
+  if (!pRaw || size < sizeof(OculusMessageHeader))
+    return false;
+
+  OculusMessageHeader head;
+  memcpy(&head, pRaw, sizeof(OculusMessageHeader));
+
+  if (head.msgId != messageSimplePingResult)
+    return false;
+
+  quint32 imageOffset, imageSize, nRanges;
+  DataSizeType dataSize;
+
+  if (head.msgVersion == 2)
+  {
+    if (size < sizeof(OculusSimplePingResult2))
+      return false;
+
+    OculusSimplePingResult2 rfm;
+    memcpy(&rfm, pRaw, sizeof(OculusSimplePingResult2));
+
+    imageOffset = rfm.imageOffset;
+    imageSize   = rfm.imageSize;
+    nRanges     = rfm.nRanges;
+    dataSize    = rfm.dataSize;
+  }
+  else
+  {
+    if (size < sizeof(OculusSimplePingResult))
+      return false;
+
+    OculusSimplePingResult rfm;
+    memcpy(&rfm, pRaw, sizeof(OculusSimplePingResult));
+
+    imageOffset = rfm.imageOffset;
+    imageSize   = rfm.imageSize;
+    nRanges     = rfm.nRanges;
+    dataSize    = rfm.dataSize;
+  }
+
+  if (nRanges == 0 || (quint64) imageOffset + imageSize > size || imageSize % nRanges)
+    return false;
+
+  layout.offset      = imageOffset;
+  layout.lineBytes   = imageSize / nRanges;
+  layout.lines       = nRanges;
+  layout.sampleBytes = (dataSize == dataSize16Bit) ? 2 : (dataSize == dataSize32Bit) ? 4 : 1;
+
+  return true;
+}
+
+
 // ============================================================================
 // OsReadThread - a worker thread used to read OS rfm data from the network
 OsReadThread::OsReadThread()
@@ -31,6 +31,7 @@
 #include "../Oculus/Oculus.h"
 #include "../Oculus/DataWrapper.h"
 #include "../Oculus/OssDataWrapper.h"
+#include "../RmUtil/RmCodec.h"
 
 class QTcpSocket;
 
@@ -57,6 +58,10 @@ public:
   // Methods
   void AddRawToEntry(char* pData, quint64 nData);
   void ProcessRaw(char* pData);
+  void GetImageInfo(int& nBeams, int& nRanges, double& range);
+  bool CopyFrame(OsBufferEntry& src);
+  quint32 FrameBytes();
+  static bool CodecLayout(const quint8* pRaw, quint32 size, RmCodecLayout& layout);
 
   // Data
   OculusSimplePingResult  m_rfm;         // The fixed length return fire message
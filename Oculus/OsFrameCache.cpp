@@ -0,0 +1,302 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "OsFrameCache.h"
+
+// ============================================================================
+// OsCacheWorker - runs the cache's fill loop
+
+OsCacheWorker::OsCacheWorker(OsFrameCache* pCache)
+{
+  m_pCache = pCache;
+}
+
+// ----------------------------------------------------------------------------
+void OsCacheWorker::run()
+{
+  m_pCache->FillLoop();
+}
+
+// ============================================================================
+// OsFrameCache - LRU cache of decoded replay frames
+
+OsFrameCache::OsFrameCache() :
+  m_worker(this)
+{
+  m_nHits     = 0;
+  m_nMisses   = 0;
+  m_nEntries  = 0;
+  m_playhead  = -1;
+  m_direction = 1;
+  m_fillAhead = true;
+  m_frameKb   = 0;
+  m_stop      = false;
+  m_open      = false;
+
+  m_frames.setMaxCost(FRAME_CACHE_MB * 1024);
+}
+
+OsFrameCache::~OsFrameCache()
+{
+  Close();
+}
+
+// ----------------------------------------------------------------------------
+// Start caching the frames of a session. Anything cached is thrown away
+void OsFrameCache::Open(const QVector<RmSessionEntry>& entries, const QStringList& files)
+{
+  Close();
+
+  m_source.SetSession(entries, files);
+
+  m_nEntries = entries.size();
+  m_playhead = -1;
+  m_nHits    = 0;
+  m_nMisses  = 0;
+  m_frameKb  = 0;
+  m_stop     = false;
+  m_open     = true;
+
+  m_worker.start(QThread::LowPriority);
+}
+
+// ----------------------------------------------------------------------------
+// Stop the worker and drop the cached frames
+void OsFrameCache::Close()
+{
+  if (!m_open)
+    return;
+
+  m_mutex.lock();
+  m_stop = true;
+  m_wake.wakeAll();
+  m_mutex.unlock();
+
+  m_worker.wait();
+
+  m_source.Close();
+
+  QMutexLocker lock(&m_mutex);
+
+  m_frames.clear();
+  m_bad.clear();
+
+  m_open = false;
+}
+
+// ----------------------------------------------------------------------------
+// Memory the cached frames may use
+void OsFrameCache::SetBudget(int megabytes)
+{
+  QMutexLocker lock(&m_mutex);
+
+  m_frames.setMaxCost(qMax(megabytes, 1) * 1024);
+}
+
+// ----------------------------------------------------------------------------
+// The frame now on display and which way play is going. Without fillAhead
+// only the frames behind the playhead are filled (the replay engine is
+// supplying the ones ahead)
+void OsFrameCache::SetPlayhead(int entry, int direction, bool fillAhead)
+{
+  QMutexLocker lock(&m_mutex);
+
+  m_playhead  = entry;
+  m_direction = (direction < 0) ? -1 : 1;
+  m_fillAhead = fillAhead;
+
+  m_wake.wakeOne();
+}
+
+// ----------------------------------------------------------------------------
+// Copy a cached frame out. False (a miss) if it isn't in the cache
+bool OsFrameCache::Fetch(int entry, OsBufferEntry& dst, double* pTime)
+{
+  QMutexLocker lock(&m_mutex);
+
+  OsCachedFrame* pFrame = m_frames.object(entry);
+
+  if (!pFrame || !dst.CopyFrame(pFrame->entry))
+  {
+    m_nMisses++;
+    return false;
+  }
+
+  m_nHits++;
+  *pTime = pFrame->time;
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Cache a frame decoded elsewhere, before anything draws on it
+void OsFrameCache::Insert(int entry, OsBufferEntry& src, double time)
+{
+  QMutexLocker lock(&m_mutex);
+
+  if (!m_open)
+    return;
+
+  OsCachedFrame* pFrame = new OsCachedFrame;
+
+  if (!pFrame->entry.CopyFrame(src))
+  {
+    delete pFrame;
+    return;
+  }
+
+  pFrame->time = time;
+
+  Add(entry, pFrame);
+}
+
+// ----------------------------------------------------------------------------
+// Frames in the cache
+int OsFrameCache::Count()
+{
+  QMutexLocker lock(&m_mutex);
+
+  return m_frames.count();
+}
+
+// ----------------------------------------------------------------------------
+// Memory held by the cached frames
+quint64 OsFrameCache::Bytes()
+{
+  QMutexLocker lock(&m_mutex);
+
+  return (quint64) m_frames.totalCost() * 1024;
+}
+
+// ----------------------------------------------------------------------------
+// Fraction of fetches found in the cache
+double OsFrameCache::HitRate()
+{
+  QMutexLocker lock(&m_mutex);
+
+  quint64 total = m_nHits + m_nMisses;
+
+  return total ? (double) m_nHits / total : 0.0;
+}
+
+// ----------------------------------------------------------------------------
+// (WORKER THREAD) Decode the frames around the playhead, nearest first
+void OsFrameCache::FillLoop()
+{
+  OsBufferEntry raw;
+
+  for (;;)
+  {
+    int entry;
+
+    m_mutex.lock();
+
+    while (!m_stop && (entry = NextToFill()) < 0)
+      m_wake.wait(&m_mutex);
+
+    bool stop = m_stop;
+
+    m_mutex.unlock();
+
+    if (stop)
+      return;
+
+    OsCachedFrame* pFrame = new OsCachedFrame;
+    unsigned short version;
+
+    bool ok = m_source.Read(entry, raw, &pFrame->time, &version);
+
+    if (ok)
+    {
+      pFrame->entry.ProcessRaw((char*) raw.m_pRaw);
+      ok = pFrame->entry.m_pImage != nullptr;
+    }
+
+    m_mutex.lock();
+
+    if (ok)
+      Add(entry, pFrame);
+    else
+    {
+      m_bad.insert(entry);
+      delete pFrame;
+    }
+
+    m_mutex.unlock();
+  }
+}
+
+// ----------------------------------------------------------------------------
+// (LOCKED) The nearest frame to the playhead that isn't cached, -1 when the
+// window is full. The window is as wide as the budget allows for frames of
+// the last size seen, and reaches four times further ahead than behind
+int OsFrameCache::NextToFill()
+{
+  if (!m_open || m_playhead < 0)
+    return -1;
+
+  int radius = FRAME_CACHE_RADIUS;
+
+  if (m_frameKb > 0)
+    radius = qBound(1, m_frames.maxCost() / (m_frameKb * 2), FRAME_CACHE_RADIUS);
+
+  int behind = radius / 4;
+
+  for (int d = 0; d <= radius; d++)
+  {
+    int ahead = m_playhead + d * m_direction;
+
+    if ((d == 0 || m_fillAhead) && Wanted(ahead))
+      return ahead;
+
+    int back = m_playhead - d * m_direction;
+
+    if (d > 0 && d <= behind && Wanted(back))
+      return back;
+  }
+
+  return -1;
+}
+
+// ----------------------------------------------------------------------------
+// (LOCKED) Is the entry still to be cached
+bool OsFrameCache::Wanted(int entry)
+{
+  return entry >= 0 && entry < m_nEntries && !m_frames.contains(entry) && !m_bad.contains(entry);
+}
+
+// ----------------------------------------------------------------------------
+// (LOCKED) Put a frame in the cache, which takes it over. The least recently
+// used frames go to make room
+void OsFrameCache::Add(int entry, OsCachedFrame* pFrame)
+{
+  if (m_frames.contains(entry))
+  {
+    delete pFrame;
+    return;
+  }
+
+  int kb = qMax(1, (int)((pFrame->entry.FrameBytes() + sizeof(OsCachedFrame)) / 1024));
+
+  m_frameKb = kb;
+
+  // A frame bigger than the whole budget is deleted straight away
+  if (!m_frames.insert(entry, pFrame, kb))
+    m_bad.insert(entry);
+}
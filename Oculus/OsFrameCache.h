@@ -0,0 +1,107 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#pragma once
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QCache>
+#include <QSet>
+
+#include "OsReplayEngine.h"
+
+#define FRAME_CACHE_MB      256     // Default memory budget
+#define FRAME_CACHE_RADIUS  256     // Most frames filled either side of the playhead
+
+class OsFrameCache;
+
+// ----------------------------------------------------------------------------
+// A decoded frame held by the cache
+struct OsCachedFrame
+{
+  OsBufferEntry entry;        // Decoded ping (no raw record)
+  double        time;         // Record time
+};
+
+// ----------------------------------------------------------------------------
+// OsCacheWorker - the thread filling the cache around the playhead
+class OsCacheWorker : public QThread
+{
+  Q_OBJECT
+
+public:
+  OsCacheWorker(OsFrameCache* pCache);
+
+  void run() Q_DECL_OVERRIDE;
+
+  OsFrameCache* m_pCache;     // The cache being filled
+};
+
+// ----------------------------------------------------------------------------
+// OsFrameCache - decoded frames of the replay session kept in least recently
+// used order within a memory budget. A worker decodes the frames around the
+// playhead, more of them in the direction of play, so stepping, scrubbing and
+// reverse play find them ready; frames shown by the forward replay engine are
+// added as they go past. A frame found in the cache is copied out without any
+// file access
+
+class OsFrameCache
+{
+public:
+  OsFrameCache();
+  ~OsFrameCache();
+
+  // Methods
+  void    Open(const QVector<RmSessionEntry>& entries, const QStringList& files);
+  void    Close();
+  void    SetBudget(int megabytes);
+  void    SetPlayhead(int entry, int direction, bool fillAhead);
+  bool    Fetch(int entry, OsBufferEntry& dst, double* pTime);
+  void    Insert(int entry, OsBufferEntry& src, double time);
+  int     Count();
+  quint64 Bytes();
+  double  HitRate();
+
+  void FillLoop();
+
+  // Statistics
+  quint64 m_nHits;            // Fetches found in the cache
+  quint64 m_nMisses;          // Fetches that had to go to the file
+
+protected:
+  int  NextToFill();
+  bool Wanted(int entry);
+  void Add(int entry, OsCachedFrame* pFrame);
+
+  OsCacheWorker               m_worker;
+  OsSessionReader             m_source;     // Used by the worker only
+  QCache<int, OsCachedFrame>  m_frames;     // Cost in KB
+  QSet<int>                   m_bad;        // Entries that couldn't be read
+
+  QMutex         m_mutex;       // Protects everything below and m_frames
+  QWaitCondition m_wake;        // The playhead has moved
+  int            m_nEntries;    // Entries in the session
+  int            m_playhead;    // Entry on display
+  int            m_direction;   // 1 forward, -1 reverse
+  bool           m_fillAhead;   // Also decode ahead of the playhead
+  int            m_frameKb;     // Size of the last frame cached
+  bool           m_stop;        // Worker to finish
+  bool           m_open;        // A session is open
+};
@@ -0,0 +1,432 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "OsReplayEngine.h"
+
+#include "../RmUtil/RmLogger.h"
+#include "../RmUtil/RmCodec.h"
+
+// ============================================================================
+// OsSessionReader - reads the records of a session
+
+OsSessionReader::OsSessionReader()
+{
+  m_segment    = -1;
+  m_pMap       = nullptr;
+  m_fileSize   = 0;
+  m_pBuffer    = nullptr;
+  m_bufferSize = 0;
+}
+
+OsSessionReader::~OsSessionReader()
+{
+  Close();
+
+  if (m_pBuffer)
+    free(m_pBuffer);
+}
+
+// ----------------------------------------------------------------------------
+// The session to read. The entries are shared with the caller, not copied
+void OsSessionReader::SetSession(const QVector<RmSessionEntry>& entries, const QStringList& files)
+{
+  Close();
+
+  m_entries = entries;
+  m_files   = files;
+}
+
+// ----------------------------------------------------------------------------
+// Let go of the file being read
+void OsSessionReader::Close()
+{
+  MapSegment(-1);
+}
+
+// ----------------------------------------------------------------------------
+int OsSessionReader::Count()
+{
+  return m_entries.size();
+}
+
+// ----------------------------------------------------------------------------
+// Copy a record out of its file into the entry's raw buffer, decompressing it
+// on the way. Nothing is decoded
+bool OsSessionReader::Read(int entry, OsBufferEntry& dst, double* pTime, unsigned short* pVersion)
+{
+  if (entry < 0 || entry >= m_entries.size())
+    return false;
+
+  const RmSessionEntry& at = m_entries.at(entry);
+
+  if (!MapSegment(at.segment))
+    return false;
+
+  if (at.offset > m_fileSize || m_fileSize - at.offset < sizeof(RmLogItem))
+    return false;
+
+  RmLogItem      item;
+  quint64        pos = at.offset + sizeof(RmLogItem);
+  const quint8*  pPayload;
+
+  if (m_pMap)
+    memcpy(&item, m_pMap + at.offset, sizeof(RmLogItem));
+  else if (!m_file.seek(at.offset) || m_file.read((char*) &item, sizeof(RmLogItem)) != sizeof(RmLogItem))
+    return false;
+
+  if (item.itemHeader != RmLogger::s_itemHeader || item.sizeHeader != sizeof(RmLogItem))
+    return false;
+
+  if (item.payloadSize > m_fileSize - pos)
+    return false;
+
+  unsigned size = item.compression ? item.originalSize : item.payloadSize;
+
+  *pTime    = item.time;
+  *pVersion = item.version;
+
+  // Grow the entry's raw buffer if this record is bigger than the last
+  if (size > dst.m_rawSize || !dst.m_pRaw)
+  {
+    quint8* pRaw = (quint8*) realloc(dst.m_pRaw, qMax(size, 1u));
+
+    if (!pRaw)
+      return false;
+
+    dst.m_pRaw = pRaw;
+  }
+
+  dst.m_rawSize = size;
+
+  if (m_pMap)
+    pPayload = m_pMap + pos;
+  else
+  {
+    quint8* pDst = dst.m_pRaw;
+
+    if (item.compression)
+    {
+      if (item.payloadSize > m_bufferSize)
+      {
+        quint8* pBuffer = (quint8*) realloc(m_pBuffer, item.payloadSize);
+
+        if (!pBuffer)
+          return false;
+
+        m_pBuffer    = pBuffer;
+        m_bufferSize = item.payloadSize;
+      }
+
+      pDst = m_pBuffer;
+    }
+
+    if (m_file.read((char*) pDst, item.payloadSize) != item.payloadSize)
+      return false;
+
+    pPayload = pDst;
+  }
+
+  if (item.compression)
+    return RmCodec::Decompress(item.compression, pPayload, item.payloadSize, dst.m_pRaw, size);
+
+  if (pPayload != dst.m_pRaw)
+    memcpy(dst.m_pRaw, pPayload, size);
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Make the segment the one being read, mapping it where possible. -1 just
+// closes the current one
+bool OsSessionReader::MapSegment(int segment)
+{
+  if (segment == m_segment && m_file.isOpen())
+    return true;
+
+  if (m_pMap)
+    m_file.unmap(m_pMap);
+
+  m_pMap    = nullptr;
+  m_segment = -1;
+  m_file.close();
+
+  if (segment < 0 || segment >= m_files.size())
+    return false;
+
+  m_file.setFileName(m_files.at(segment));
+
+  if (!m_file.open(QIODevice::ReadOnly))
+    return false;
+
+  m_segment  = segment;
+  m_fileSize = m_file.size();
+  m_pMap     = m_file.map(0, m_fileSize);
+
+  return true;
+}
+
+// ============================================================================
+// OsReplayWorker - runs the reader or the decoder loop of the engine
+
+OsReplayWorker::OsReplayWorker(OsReplayEngine* pEngine, bool decoder)
+{
+  m_pEngine = pEngine;
+  m_decoder = decoder;
+}
+
+// ----------------------------------------------------------------------------
+void OsReplayWorker::run()
+{
+  if (m_decoder)
+    m_pEngine->DecodeLoop();
+  else
+    m_pEngine->ReadLoop();
+}
+
+// ============================================================================
+// OsReplayEngine - reader and decoder threads feeding a ring of frames
+
+OsReplayEngine::OsReplayEngine() :
+  m_reader(this, false),
+  m_decoder(this, true)
+{
+  m_nUnderruns = 0;
+  m_nSkipped   = 0;
+  m_first      = 0;
+  m_skipTo     = 0;
+  m_readDone   = false;
+  m_nRead      = 0;
+  m_nDecoded   = 0;
+  m_nTaken     = 0;
+  m_nReleased  = 0;
+  m_stop       = false;
+  m_running    = false;
+}
+
+OsReplayEngine::~OsReplayEngine()
+{
+  Stop();
+}
+
+// ----------------------------------------------------------------------------
+// Start replaying the entries from first on. Any replay running is stopped
+bool OsReplayEngine::Start(const QVector<RmSessionEntry>& entries, const QStringList& files, int first)
+{
+  Stop();
+
+  if (first < 0 || first >= entries.size())
+    return false;
+
+  m_source.SetSession(entries, files);
+
+  m_first      = first;
+  m_nRead      = 0;
+  m_nDecoded   = 0;
+  m_nTaken     = 0;
+  m_nReleased  = 0;
+  m_nUnderruns = 0;
+  m_nSkipped   = 0;
+  m_skipTo     = first;
+  m_readDone   = false;
+  m_stop       = false;
+  m_running    = true;
+
+  m_reader.start();
+  m_decoder.start();
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Stop the workers and let go of the file being read
+void OsReplayEngine::Stop()
+{
+  if (!m_running)
+    return;
+
+  m_mutex.lock();
+  m_stop = true;
+  m_space.wakeAll();
+  m_work.wakeAll();
+  m_mutex.unlock();
+
+  m_reader.wait();
+  m_decoder.wait();
+
+  m_source.Close();
+
+  m_running = false;
+}
+
+// ----------------------------------------------------------------------------
+bool OsReplayEngine::IsRunning()
+{
+  return m_running;
+}
+
+// ----------------------------------------------------------------------------
+// The next frame for display, nullptr if the workers haven't got it ready.
+// The frame belongs to the caller until Release
+OsReplayFrame* OsReplayEngine::Take()
+{
+  QMutexLocker lock(&m_mutex);
+
+  if (m_nTaken > m_nReleased)
+    return &m_frames[(m_nTaken - 1) % REPLAY_RING];
+
+  // Frames read before a skip are handed straight back
+  while (m_nTaken < m_nDecoded && m_frames[m_nTaken % REPLAY_RING].index < m_skipTo)
+  {
+    m_nTaken++;
+    m_nReleased++;
+    m_nSkipped++;
+    m_space.wakeOne();
+  }
+
+  if (m_nTaken == m_nDecoded)
+  {
+    if (!m_readDone)
+      m_nUnderruns++;
+
+    return nullptr;
+  }
+
+  return &m_frames[m_nTaken++ % REPLAY_RING];
+}
+
+// ----------------------------------------------------------------------------
+// Hand the frame last taken back to the reader
+void OsReplayEngine::Release()
+{
+  QMutexLocker lock(&m_mutex);
+
+  if (m_nReleased < m_nTaken)
+  {
+    m_nReleased++;
+    m_space.wakeOne();
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Don't bother with the entries before this one. The reader jumps straight to
+// it and Take passes over the frames already read that come before it
+void OsReplayEngine::SkipTo(int entry)
+{
+  QMutexLocker lock(&m_mutex);
+
+  m_skipTo = qMax(m_skipTo, entry);
+}
+
+// ----------------------------------------------------------------------------
+// Has every frame to the end of the session been taken and given back
+bool OsReplayEngine::AtEnd()
+{
+  QMutexLocker lock(&m_mutex);
+
+  return m_running && m_readDone && m_nReleased == m_nRead;
+}
+
+// ----------------------------------------------------------------------------
+// Frames decoded and waiting for the display
+int OsReplayEngine::Ahead()
+{
+  QMutexLocker lock(&m_mutex);
+
+  return (int)(m_nDecoded - m_nTaken);
+}
+
+// ----------------------------------------------------------------------------
+// (READER THREAD) Read the records into free slots until the end of the
+// session
+void OsReplayEngine::ReadLoop()
+{
+  for (int e = m_first; ; e++)
+  {
+    m_mutex.lock();
+
+    while (!m_stop && m_nRead - m_nReleased >= REPLAY_RING)
+      m_space.wait(&m_mutex);
+
+    quint64 n    = m_nRead;
+    bool    stop = m_stop;
+
+    e = qMax(e, m_skipTo);
+
+    if (e >= m_source.Count())
+    {
+      m_readDone = true;
+      m_work.wakeOne();
+      stop = true;
+    }
+
+    m_mutex.unlock();
+
+    if (stop)
+      return;
+
+    // The slot is free, so nothing else touches it until it is counted as read
+    OsReplayFrame& frame = m_frames[n % REPLAY_RING];
+
+    frame.index = e;
+    frame.ok    = m_source.Read(e, frame.entry, &frame.time, &frame.version);
+
+    m_mutex.lock();
+    m_nRead++;
+    m_work.wakeOne();
+    m_mutex.unlock();
+  }
+}
+
+// ----------------------------------------------------------------------------
+// (DECODER THREAD) Unpack the records read into images, in order
+void OsReplayEngine::DecodeLoop()
+{
+  for (;;)
+  {
+    m_mutex.lock();
+
+    while (!m_stop && m_nDecoded == m_nRead)
+    {
+      if (m_readDone)
+      {
+        m_mutex.unlock();
+        return;
+      }
+
+      m_work.wait(&m_mutex);
+    }
+
+    quint64 n    = m_nDecoded;
+    bool    stop = m_stop;
+
+    m_mutex.unlock();
+
+    if (stop)
+      return;
+
+    OsReplayFrame& frame = m_frames[n % REPLAY_RING];
+
+    if (frame.ok)
+      frame.entry.ProcessRaw((char*) frame.entry.m_pRaw);
+
+    m_mutex.lock();
+    m_nDecoded++;
+    m_mutex.unlock();
+  }
+}
@@ -0,0 +1,144 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#pragma once
+
+#include <QThread>
+#include <QMutex>
+#include <QWaitCondition>
+#include <QFile>
+#include <QVector>
+#include <QStringList>
+
+#include "OsClientCtrl.h"
+#include "../RmUtil/RmLogSession.h"
+
+#define REPLAY_RING  16       // Frames read and decoded ahead of the display
+
+class OsReplayEngine;
+
+// ----------------------------------------------------------------------------
+// OsSessionReader - copies records of a session out of its files into an
+// entry's raw buffer, decompressing them on the way. One file is open (and
+// mapped where possible) at a time. Each thread reading has its own
+
+class OsSessionReader
+{
+public:
+  OsSessionReader();
+  ~OsSessionReader();
+
+  // Methods
+  void SetSession(const QVector<RmSessionEntry>& entries, const QStringList& files);
+  bool Read(int entry, OsBufferEntry& dst, double* pTime, unsigned short* pVersion);
+  void Close();
+  int  Count();
+
+protected:
+  bool MapSegment(int segment);
+
+  QVector<RmSessionEntry> m_entries;    // The session's sonar records
+  QStringList             m_files;      // The session's files
+  QFile                   m_file;       // Segment being read
+  int                     m_segment;    // Its number, -1 for none
+  uchar*                  m_pMap;       // Its mapping (nullptr when read through m_file)
+  quint64                 m_fileSize;   // Its size
+  quint8*                 m_pBuffer;    // Compressed payload when not mapped
+  unsigned                m_bufferSize;
+};
+
+// ----------------------------------------------------------------------------
+// A slot in the replay ring. The entry's raw buffer and image are reused as
+// the slot goes round, so nothing is allocated once the ring has warmed up
+struct OsReplayFrame
+{
+  OsBufferEntry  entry;       // Raw record (m_pRaw) and its decoded image
+  int            index;       // Session entry
+  double         time;        // Record time
+  unsigned short version;     // Record version
+  bool           ok;          // Read and decoded, false for a damaged record
+};
+
+// ----------------------------------------------------------------------------
+// OsReplayWorker - one of the two threads behind the engine
+class OsReplayWorker : public QThread
+{
+  Q_OBJECT
+
+public:
+  OsReplayWorker(OsReplayEngine* pEngine, bool decoder);
+
+  void run() Q_DECL_OVERRIDE;
+
+  OsReplayEngine* m_pEngine;  // The engine being served
+  bool            m_decoder;  // Decoding rather than reading
+};
+
+// ----------------------------------------------------------------------------
+// OsReplayEngine - replays the sonar records of a session off the GUI thread.
+// The reader pulls records out of the files into the ring (page faults and
+// decompression happen there), the decoder unpacks them into images, and the
+// GUI thread takes finished frames in order and only has to display them.
+// Frames are numbered as they are read; a frame is in the ring from being
+// read until the GUI releases it, so the workers stay at most REPLAY_RING
+// frames ahead. When the display falls behind SkipTo moves the reader on and
+// drops the frames in the ring that are now too old
+
+class OsReplayEngine
+{
+public:
+  OsReplayEngine();
+  ~OsReplayEngine();
+
+  // Methods
+  bool           Start(const QVector<RmSessionEntry>& entries, const QStringList& files, int first);
+  void           Stop();
+  bool           IsRunning();
+  OsReplayFrame* Take();
+  void           Release();
+  void           SkipTo(int entry);
+  bool           AtEnd();
+  int            Ahead();
+
+  void ReadLoop();
+  void DecodeLoop();
+
+  // Data
+  quint32 m_nUnderruns;   // Times the display asked before a frame was ready
+  quint32 m_nSkipped;     // Frames decoded but passed over by SkipTo
+
+protected:
+  OsReplayWorker  m_reader;
+  OsReplayWorker  m_decoder;
+  OsReplayFrame   m_frames[REPLAY_RING];
+  OsSessionReader m_source;     // Used by the reader thread only
+  int             m_first;      // Entry the replay started at
+
+  QMutex         m_mutex;       // Protects the counters below
+  QWaitCondition m_space;       // A slot has been released
+  QWaitCondition m_work;        // A frame has been read
+  quint64        m_nRead;       // Frames read
+  quint64        m_nDecoded;    // Frames decoded
+  quint64        m_nTaken;      // Frames handed to the display
+  quint64        m_nReleased;   // Frames given back
+  int            m_skipTo;      // Entries before this aren't wanted any more
+  bool           m_readDone;    // The reader has reached the end of the session
+  bool           m_stop;        // Workers to finish
+  bool           m_running;     // Started and not stopped
+};
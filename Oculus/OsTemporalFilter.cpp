@@ -0,0 +1,596 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "OsTemporalFilter.h"
+#include "OsClientCtrl.h"
+
+#if defined(__SSE2__) || defined(_M_X64) || (defined(_M_IX86_FP) && _M_IX86_FP >= 2)
+#define TF_SSE2
+#include <emmintrin.h>
+#endif
+
+// ============================================================================
+// Kernels - each works on a run of n contiguous pixels and the matching run of
+// state. The SSE2 versions handle 16 (8 bit) or 8 (16 bit) pixels at a time and
+// leave the tail to the scalar loop
+
+// ----------------------------------------------------------------------------
+// Exponential decay on 8 bit pixels with an 8.8 fixed point accumulator
+// s = s * (256 - a) / 256 + x * a, out = s / 256
+static void Decay8(uchar* p, quint16* s, int n, int a)
+{
+  int i = 0;
+
+#ifdef TF_SSE2
+  const __m128i zero  = _mm_setzero_si128();
+  const __m128i keep  = _mm_set1_epi16((short)((256 - a) << 8));
+  const __m128i gain  = _mm_set1_epi16((short)a);
+  const __m128i round = _mm_set1_epi16(128);
+
+  for (; i + 16 <= n; i += 16)
+  {
+    __m128i x  = _mm_loadu_si128((const __m128i*)&p[i]);
+    __m128i s0 = _mm_loadu_si128((const __m128i*)&s[i]);
+    __m128i s1 = _mm_loadu_si128((const __m128i*)&s[i + 8]);
+
+    s0 = _mm_add_epi16(_mm_mulhi_epu16(s0, keep), _mm_mullo_epi16(_mm_unpacklo_epi8(x, zero), gain));
+    s1 = _mm_add_epi16(_mm_mulhi_epu16(s1, keep), _mm_mullo_epi16(_mm_unpackhi_epi8(x, zero), gain));
+
+    _mm_storeu_si128((__m128i*)&s[i],     s0);
+    _mm_storeu_si128((__m128i*)&s[i + 8], s1);
+
+    s0 = _mm_srli_epi16(_mm_add_epi16(s0, round), 8);
+    s1 = _mm_srli_epi16(_mm_add_epi16(s1, round), 8);
+
+    _mm_storeu_si128((__m128i*)&p[i], _mm_packus_epi16(s0, s1));
+  }
+#endif
+
+  for (; i < n; i++)
+  {
+    s[i] = (quint16)(((s[i] * (256 - a)) >> 8) + p[i] * a);
+    p[i] = (uchar)((s[i] + 128) >> 8);
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Running mean on 8 bit pixels. The oldest frame (if the ring is full) leaves
+// the sum and the new frame enters it. recip is 65536 / count rounded up
+static void Mean8(uchar* p, quint16* sum, const uchar* pOld, uchar* pSlot, int n, int count)
+{
+  quint16 recip = (quint16)((65536 + count - 1) / count);
+  int i = 0;
+
+#ifdef TF_SSE2
+  const __m128i zero = _mm_setzero_si128();
+  const __m128i rcp  = _mm_set1_epi16((short)recip);
+
+  for (; i + 16 <= n; i += 16)
+  {
+    __m128i x  = _mm_loadu_si128((const __m128i*)&p[i]);
+    __m128i o  = pOld ? _mm_loadu_si128((const __m128i*)&pOld[i]) : zero;
+    __m128i s0 = _mm_loadu_si128((const __m128i*)&sum[i]);
+    __m128i s1 = _mm_loadu_si128((const __m128i*)&sum[i + 8]);
+
+    s0 = _mm_sub_epi16(_mm_add_epi16(s0, _mm_unpacklo_epi8(x, zero)), _mm_unpacklo_epi8(o, zero));
+    s1 = _mm_sub_epi16(_mm_add_epi16(s1, _mm_unpackhi_epi8(x, zero)), _mm_unpackhi_epi8(o, zero));
+
+    _mm_storeu_si128((__m128i*)&sum[i],     s0);
+    _mm_storeu_si128((__m128i*)&sum[i + 8], s1);
+    _mm_storeu_si128((__m128i*)&pSlot[i],   x);
+
+    if (count > 1)
+      _mm_storeu_si128((__m128i*)&p[i], _mm_packus_epi16(_mm_mulhi_epu16(s0, rcp), _mm_mulhi_epu16(s1, rcp)));
+  }
+#endif
+
+  for (; i < n; i++)
+  {
+    uchar x = p[i];
+
+    sum[i] = (quint16)(sum[i] + x - (pOld ? pOld[i] : 0));
+    pSlot[i] = x;
+
+    if (count > 1)
+      p[i] = (uchar)((sum[i] * recip) >> 16);
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Peak hold on 8 bit pixels, the held value drops by step every frame
+static void MaxHold8(uchar* p, uchar* h, int n, int step)
+{
+  int i = 0;
+
+#ifdef TF_SSE2
+  const __m128i drop = _mm_set1_epi8((char)step);
+
+  for (; i + 16 <= n; i += 16)
+  {
+    __m128i x = _mm_loadu_si128((const __m128i*)&p[i]);
+    __m128i v = _mm_loadu_si128((const __m128i*)&h[i]);
+
+    v = _mm_max_epu8(_mm_subs_epu8(v, drop), x);
+
+    _mm_storeu_si128((__m128i*)&h[i], v);
+    _mm_storeu_si128((__m128i*)&p[i], v);
+  }
+#endif
+
+  for (; i < n; i++)
+  {
+    int v = qMax(h[i] - step, (int)p[i]);
+
+    h[i] = p[i] = (uchar)v;
+  }
+}
+
+#ifdef TF_SSE2
+// ----------------------------------------------------------------------------
+// Pack two sets of four 32 bit values (0 - 65535) into eight 16 bit values
+// (SSE2 only has the signed pack)
+static inline __m128i PackU32(__m128i lo, __m128i hi)
+{
+  const __m128i bias32 = _mm_set1_epi32(32768);
+  const __m128i bias16 = _mm_set1_epi16((short)0x8000);
+
+  return _mm_xor_si128(_mm_packs_epi32(_mm_sub_epi32(lo, bias32), _mm_sub_epi32(hi, bias32)), bias16);
+}
+#endif
+
+// ----------------------------------------------------------------------------
+// Exponential decay on 16 bit pixels with a float accumulator
+static void Decay16(quint16* p, float* s, int n, float a)
+{
+  int i = 0;
+
+#ifdef TF_SSE2
+  const __m128i zero = _mm_setzero_si128();
+  const __m128  gain = _mm_set1_ps(a);
+  const __m128  half = _mm_set1_ps(0.5f);
+
+  for (; i + 8 <= n; i += 8)
+  {
+    __m128i x  = _mm_loadu_si128((const __m128i*)&p[i]);
+    __m128  s0 = _mm_loadu_ps(&s[i]);
+    __m128  s1 = _mm_loadu_ps(&s[i + 4]);
+
+    s0 = _mm_add_ps(s0, _mm_mul_ps(gain, _mm_sub_ps(_mm_cvtepi32_ps(_mm_unpacklo_epi16(x, zero)), s0)));
+    s1 = _mm_add_ps(s1, _mm_mul_ps(gain, _mm_sub_ps(_mm_cvtepi32_ps(_mm_unpackhi_epi16(x, zero)), s1)));
+
+    _mm_storeu_ps(&s[i],     s0);
+    _mm_storeu_ps(&s[i + 4], s1);
+
+    _mm_storeu_si128((__m128i*)&p[i], PackU32(_mm_cvttps_epi32(_mm_add_ps(s0, half)), _mm_cvttps_epi32(_mm_add_ps(s1, half))));
+  }
+#endif
+
+  for (; i < n; i++)
+  {
+    s[i] += a * ((float)p[i] - s[i]);
+    p[i] = (quint16)(s[i] + 0.5f);
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Running mean on 16 bit pixels
+static void Mean16(quint16* p, quint32* sum, const quint16* pOld, quint16* pSlot, int n, int count)
+{
+  float recip = 1.0f / (float)count;
+  int i = 0;
+
+#ifdef TF_SSE2
+  const __m128i zero = _mm_setzero_si128();
+  const __m128  rcp  = _mm_set1_ps(recip);
+
+  for (; i + 8 <= n; i += 8)
+  {
+    __m128i x  = _mm_loadu_si128((const __m128i*)&p[i]);
+    __m128i o  = pOld ? _mm_loadu_si128((const __m128i*)&pOld[i]) : zero;
+    __m128i s0 = _mm_loadu_si128((const __m128i*)&sum[i]);
+    __m128i s1 = _mm_loadu_si128((const __m128i*)&sum[i + 4]);
+
+    s0 = _mm_sub_epi32(_mm_add_epi32(s0, _mm_unpacklo_epi16(x, zero)), _mm_unpacklo_epi16(o, zero));
+    s1 = _mm_sub_epi32(_mm_add_epi32(s1, _mm_unpackhi_epi16(x, zero)), _mm_unpackhi_epi16(o, zero));
+
+    _mm_storeu_si128((__m128i*)&sum[i],     s0);
+    _mm_storeu_si128((__m128i*)&sum[i + 4], s1);
+    _mm_storeu_si128((__m128i*)&pSlot[i],   x);
+
+    if (count > 1)
+    {
+      __m128i m0 = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(s0), rcp));
+      __m128i m1 = _mm_cvttps_epi32(_mm_mul_ps(_mm_cvtepi32_ps(s1), rcp));
+
+      _mm_storeu_si128((__m128i*)&p[i], PackU32(m0, m1));
+    }
+  }
+#endif
+
+  for (; i < n; i++)
+  {
+    quint16 x = p[i];
+
+    sum[i] = sum[i] + x - (pOld ? pOld[i] : 0);
+    pSlot[i] = x;
+
+    if (count > 1)
+      p[i] = (quint16)((float)sum[i] * recip);
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Peak hold on 16 bit pixels
+static void MaxHold16(quint16* p, quint16* h, int n, int step)
+{
+  int i = 0;
+
+#ifdef TF_SSE2
+  const __m128i drop = _mm_set1_epi16((short)step);
+
+  for (; i + 8 <= n; i += 8)
+  {
+    __m128i x = _mm_loadu_si128((const __m128i*)&p[i]);
+    __m128i v = _mm_subs_epu16(_mm_loadu_si128((const __m128i*)&h[i]), drop);
+
+    // max(v, x) without SSE4.1
+    v = _mm_adds_epu16(_mm_subs_epu16(v, x), x);
+
+    _mm_storeu_si128((__m128i*)&h[i], v);
+    _mm_storeu_si128((__m128i*)&p[i], v);
+  }
+#endif
+
+  for (; i < n; i++)
+  {
+    int v = qMax(h[i] - step, (int)p[i]);
+
+    h[i] = p[i] = (quint16)v;
+  }
+}
+
+
+// ============================================================================
+// OsTemporalFilter - persistence filter for the polar image
+
+OsTemporalFilter::OsTemporalFilter()
+{
+  m_mode      = tfOff;
+  m_decay     = 64;       // 1/4 new frame, ~4 ping persistence
+  m_nFrames   = 4;
+  m_holdDecay = 4;
+
+  m_pState    = nullptr;
+  m_pHistory  = nullptr;
+  m_nHistory  = 0;
+  m_next      = 0;
+  m_nPixels   = 0;
+  m_bytes     = 0;
+
+  m_range     = 0.0;
+  m_frequency = 0.0;
+  m_nBrgs     = 0;
+  m_nRngs     = 0;
+}
+
+OsTemporalFilter::~OsTemporalFilter()
+{
+  if (m_pState)
+    free(m_pState);
+
+  if (m_pHistory)
+    free(m_pHistory);
+}
+
+// ----------------------------------------------------------------------------
+// Display name for a mode
+QString OsTemporalFilter::ModeName(eTemporalMode mode)
+{
+  switch (mode)
+  {
+    case tfOff:     return "Off";
+    case tfDecay:   return "Decay";
+    case tfMean:    return "Mean";
+    case tfMaxHold: return "Max Hold";
+  }
+
+  return "";
+}
+
+// ----------------------------------------------------------------------------
+// Changing any of the settings restarts the filter
+void OsTemporalFilter::SetMode(eTemporalMode mode)
+{
+  m_mode = mode;
+  Reset();
+}
+
+void OsTemporalFilter::SetDecay(int weight)
+{
+  m_decay = qBound(1, weight, 256);
+  Reset();
+}
+
+void OsTemporalFilter::SetFrames(int nFrames)
+{
+  m_nFrames = qBound(1, nFrames, TF_MAX_FRAMES);
+  Reset();
+}
+
+void OsTemporalFilter::SetHoldDecay(int step)
+{
+  m_holdDecay = qBound(0, step, 255);
+  Reset();
+}
+
+// ----------------------------------------------------------------------------
+// Forget the history, the next frame primes the filter
+void OsTemporalFilter::Reset()
+{
+  m_nHistory = 0;
+  m_next     = 0;
+  m_nPixels  = 0;
+}
+
+// ----------------------------------------------------------------------------
+// Make sure the state matches the image, (re)allocating it if it does not.
+// Returns false if the filter cannot run
+bool OsTemporalFilter::Prepare(int nPixels, int bytes)
+{
+  if (nPixels == m_nPixels && bytes == m_bytes)
+    return true;
+
+  Reset();
+
+  // A failed realloc keeps the old block, which is still freed by the destructor
+  void* pState = realloc(m_pState, (size_t)nPixels * 4);
+
+  if (!pState)
+    return false;
+
+  m_pState = pState;
+
+  if (m_mode == tfMean)
+  {
+    quint8* pHistory = (quint8*) realloc(m_pHistory, (size_t)nPixels * bytes * m_nFrames);
+
+    if (!pHistory)
+      return false;
+
+    m_pHistory = pHistory;
+  }
+
+  memset(m_pState, 0, (size_t)nPixels * 4);
+
+  m_nPixels = nPixels;
+  m_bytes   = bytes;
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Filter the image in a decoded ping. A change of range, frequency or image
+// size restarts the filter as the old frames no longer line up
+void OsTemporalFilter::Process(OsBufferEntry* pEntry)
+{
+  if (m_mode == tfOff || !pEntry || !pEntry->m_pImage)
+    return;
+
+  double   range     = 0.0;
+  double   frequency = 0.0;
+  int      nBrgs     = 0;
+  int      nRngs     = 0;
+  int      bytes     = 1;
+  unsigned imageSize = 0;
+
+  if (pEntry->m_simple)
+  {
+    if (pEntry->m_version == 2)
+    {
+      range     = pEntry->m_rfm2.fireMessage.range;
+      frequency = pEntry->m_rfm2.frequency;
+      nBrgs     = pEntry->m_rfm2.nBeams;
+      nRngs     = pEntry->m_rfm2.nRanges;
+      bytes     = pEntry->m_rfm2.dataSize == dataSize16Bit ? 2 : (pEntry->m_rfm2.dataSize == dataSize8Bit ? 1 : 0);
+      imageSize = pEntry->m_rfm2.imageSize;
+    }
+    else
+    {
+      range     = pEntry->m_rfm.fireMessage.range;
+      frequency = pEntry->m_rfm.frequency;
+      nBrgs     = pEntry->m_rfm.nBeams;
+      nRngs     = pEntry->m_rfm.nRanges;
+      bytes     = pEntry->m_rfm.dataSize == dataSize16Bit ? 2 : (pEntry->m_rfm.dataSize == dataSize8Bit ? 1 : 0);
+      imageSize = pEntry->m_rfm.imageSize;
+    }
+  }
+  else
+  {
+    range     = pEntry->m_rff.ping.range;
+    nBrgs     = pEntry->m_rff.ping.nBeams;
+    nRngs     = pEntry->m_rff.ping_params.nRangeLinesBfm;
+    imageSize = pEntry->m_rff.ping_params.imageSize;
+  }
+
+  // 24 and 32 bit images are not filtered
+  if (bytes == 0 || nBrgs < 1 || nRngs < 1)
+    return;
+
+  if (range != m_range || frequency != m_frequency || nBrgs != m_nBrgs || nRngs != m_nRngs)
+  {
+    m_range     = range;
+    m_frequency = frequency;
+    m_nBrgs     = nBrgs;
+    m_nRngs     = nRngs;
+
+    Reset();
+  }
+
+  // Rows may carry a gain prefix, the beams are at the end of each row
+  int stride = (int)(imageSize / nRngs);
+
+  if (stride < nBrgs * bytes)
+    return;
+
+  if (bytes == 2)
+    Process16((quint16*)pEntry->m_pImage, nRngs, nBrgs, stride);
+  else
+    Process8(pEntry->m_pImage, nRngs, nBrgs, stride);
+}
+
+// ----------------------------------------------------------------------------
+// Filter an 8 bit image of nRngs rows, each stride bytes with the nBrgs beam
+// values at the end of the row
+void OsTemporalFilter::Process8(uchar* pData, int nRngs, int nBrgs, int stride)
+{
+  if (m_mode == tfOff || !pData || !Prepare(nRngs * nBrgs, 1))
+    return;
+
+  int offset = stride - nBrgs;
+
+  // Without a row prefix the whole image is one run
+  int nRuns  = offset ? nRngs : 1;
+  int runLen = offset ? nBrgs : nRngs * nBrgs;
+
+  // The first frame primes the state and is passed through
+  bool prime = (m_nHistory == 0);
+
+  int    slot  = m_next;
+  int    count = qMin(m_nHistory + 1, m_nFrames);
+  bool   full  = (m_nHistory >= m_nFrames);
+
+  for (int r = 0; r < nRuns; r++)
+  {
+    uchar* p   = &pData[r * stride + offset];
+    int    idx = r * runLen;
+
+    switch (m_mode)
+    {
+    case tfDecay:
+    {
+      quint16* s = &((quint16*)m_pState)[idx];
+
+      if (prime)
+      {
+        for (int i = 0; i < runLen; i++)
+          s[i] = (quint16)(p[i] << 8);
+      }
+      else
+        Decay8(p, s, runLen, m_decay);
+
+      break;
+    }
+
+    case tfMean:
+    {
+      uchar* pSlot = &m_pHistory[(size_t)slot * m_nPixels + idx];
+
+      Mean8(p, &((quint16*)m_pState)[idx], full ? pSlot : nullptr, pSlot, runLen, count);
+      break;
+    }
+
+    case tfMaxHold:
+    {
+      uchar* h = &((uchar*)m_pState)[idx];
+
+      if (prime)
+        memcpy(h, p, runLen);
+      else
+        MaxHold8(p, h, runLen, m_holdDecay);
+
+      break;
+    }
+
+    case tfOff:
+      break;
+    }
+  }
+
+  m_nHistory = qMin(m_nHistory + 1, m_nFrames);
+  m_next     = (m_next + 1) % m_nFrames;
+}
+
+// ----------------------------------------------------------------------------
+// Filter a 16 bit image, stride is in bytes as for Process8
+void OsTemporalFilter::Process16(quint16* pData, int nRngs, int nBrgs, int stride)
+{
+  if (m_mode == tfOff || !pData || (stride & 1) || !Prepare(nRngs * nBrgs, 2))
+    return;
+
+  int offset = stride / 2 - nBrgs;
+
+  int nRuns  = offset ? nRngs : 1;
+  int runLen = offset ? nBrgs : nRngs * nBrgs;
+
+  bool prime = (m_nHistory == 0);
+
+  int  slot  = m_next;
+  int  count = qMin(m_nHistory + 1, m_nFrames);
+  bool full  = (m_nHistory >= m_nFrames);
+
+  for (int r = 0; r < nRuns; r++)
+  {
+    quint16* p   = &pData[r * (stride / 2) + offset];
+    int      idx = r * runLen;
+
+    switch (m_mode)
+    {
+    case tfDecay:
+    {
+      float* s = &((float*)m_pState)[idx];
+
+      if (prime)
+      {
+        for (int i = 0; i < runLen; i++)
+          s[i] = (float)p[i];
+      }
+      else
+        Decay16(p, s, runLen, (float)m_decay / 256.0f);
+
+      break;
+    }
+
+    case tfMean:
+    {
+      quint16* pSlot = &((quint16*)m_pHistory)[(size_t)slot * m_nPixels + idx];
+
+      Mean16(p, &((quint32*)m_pState)[idx], full ? pSlot : nullptr, pSlot, runLen, count);
+      break;
+    }
+
+    case tfMaxHold:
+    {
+      quint16* h = &((quint16*)m_pState)[idx];
+
+      if (prime)
+        memcpy(h, p, runLen * sizeof(quint16));
+      else
+        MaxHold16(p, h, runLen, m_holdDecay << 8);
+
+      break;
+    }
+
+    case tfOff:
+      break;
+    }
+  }
+
+  m_nHistory = qMin(m_nHistory + 1, m_nFrames);
+  m_next     = (m_next + 1) % m_nFrames;
+}
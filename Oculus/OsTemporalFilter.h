@@ -0,0 +1,82 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#pragma once
+
+#include <QString>
+
+class OsBufferEntry;
+
+// Temporal filter modes
+enum eTemporalMode : int
+{
+  tfOff,          // Pass the frames through untouched
+  tfDecay,        // Exponential decay (persistence)
+  tfMean,         // Mean of the last N frames
+  tfMaxHold       // Peak hold, decaying by a fixed step per frame
+};
+
+#define TF_MAX_FRAMES 32
+
+// ----------------------------------------------------------------------------
+// OsTemporalFilter - persistence filter applied to the polar image between the
+// decode and the display / detection. Works in place on 8 or 16 bit images and
+// resets itself when the ping geometry changes
+
+class OsTemporalFilter
+{
+public:
+  OsTemporalFilter();
+  ~OsTemporalFilter();
+
+  // Methods
+  void SetMode(eTemporalMode mode);
+  void SetDecay(int weight);
+  void SetFrames(int nFrames);
+  void SetHoldDecay(int step);
+  void Reset();
+  void Process(OsBufferEntry* pEntry);
+  void Process8(uchar* pData, int nRngs, int nBrgs, int stride);
+  void Process16(quint16* pData, int nRngs, int nBrgs, int stride);
+
+  static QString ModeName(eTemporalMode mode);
+
+  // Settings
+  eTemporalMode m_mode;       // Current filter
+  int           m_decay;      // Weight of the new frame in 1/256 (tfDecay)
+  int           m_nFrames;    // Frames averaged (tfMean)
+  int           m_holdDecay;  // Drop per frame in 8 bit counts (tfMaxHold)
+
+  // State
+  void*         m_pState;     // Accumulator / hold image
+  quint8*       m_pHistory;   // Ring of the last m_nFrames frames (tfMean)
+  int           m_nHistory;   // Frames held in the ring
+  int           m_next;       // Next ring slot to write
+  int           m_nPixels;    // Pixels in the filtered image
+  int           m_bytes;      // Bytes per pixel (1 or 2)
+
+  // Ping the state was built for, any change resets the filter
+  double        m_range;
+  double        m_frequency;
+  int           m_nBrgs;
+  int           m_nRngs;
+
+protected:
+  bool Prepare(int nPixels, int bytes);
+};
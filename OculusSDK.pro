@@ -42,11 +42,17 @@ SOURCES += main.cpp\
     DetectionParams.cpp \
     Oculus/OsClientCtrl.cpp \
     Oculus/OsStatusRx.cpp \
+    Oculus/OsTemporalFilter.cpp \
+    Oculus/OsReplayEngine.cpp \
+    Oculus/OsFrameCache.cpp \
     RmUtil/RmUtil.cpp \
     RmGl/RmGlOrtho.cpp \
     RmGl/RmGlSurface.cpp \
     RmGl/RmGlWidget.cpp \
+    RmGl/RmGlOffscreen.cpp \
+    RmGl/RmGlGrabber.cpp \
     Displays/SonarSurface.cpp \
+    Displays/WaterfallSurface.cpp \
     OculusSonar/MainView.cpp \
     OculusSonar/OnlineCtrls.cpp \
     OculusSonar/EnvCtrls.cpp \
@@ -55,7 +61,20 @@ SOURCES += main.cpp\
     OculusSonar/CtrlWidget.cpp \
     RmGl/PalWidget.cpp \
     RmUtil/RmLogger.cpp \
+    RmUtil/RmLogWriter.cpp \
+    RmUtil/RmCodec.cpp \
+    RmUtil/RmLogIndex.cpp \
+    RmUtil/RmLogRepair.cpp \
+    RmUtil/RmLogCut.cpp \
+    RmUtil/RmLogMeta.cpp \
+    RmUtil/RmLogStats.cpp \
+    RmUtil/RmLogVerify.cpp \
+    RmUtil/RmCrc32c.cpp \
+    RmUtil/RmLogSession.cpp \
+    RmUtil/RmLogMerge.cpp \
     RmUtil/RmPlayer.cpp \
+    RmUtil/RmPalette.cpp \
+    RmUtil/RmAviWriter.cpp \
     OculusSonar/SettingsForm.cpp \
     OculusSonar/ConnectForm.cpp \
     OculusSonar/ToolsCtrls.cpp \
@@ -69,18 +88,31 @@ SOURCES += main.cpp\
     OculusSonar/InfoForm.cpp \
     Controls/RangeSlider.cpp \
     OculusSonar/HelpForm.cpp \
-    inference.cpp
+    OculusSonar/LogExporter.cpp \
+    OculusSonar/SnapshotWriter.cpp \
+    OculusSonar/ScreenRecorder.cpp \
+    OculusSonar/MultiReplay.cpp \
+    OculusSonar/DatasetExporter.cpp \
+    OculusSonar/LogTools.cpp \
+    inference.cpp \
+    SonarYolo.cpp
 
 HEADERS  += \
     DetectionParams.h \
     Oculus/Oculus.h \
     Oculus/OsClientCtrl.h \
     Oculus/OsStatusRx.h \
+    Oculus/OsTemporalFilter.h \
+    Oculus/OsReplayEngine.h \
+    Oculus/OsFrameCache.h \
     RmUtil/RmUtil.h \
     RmGl/RmGlOrtho.h \
     RmGl/RmGlSurface.h \
     RmGl/RmGlWidget.h \
+    RmGl/RmGlOffscreen.h \
+    RmGl/RmGlGrabber.h \
     Displays/SonarSurface.h \
+    Displays/WaterfallSurface.h \
     OculusSonar/MainView.h \
     OnlineCtrls.h \
     OculusSonar/EnvCtrls.h \
@@ -89,7 +121,20 @@ HEADERS  += \
     OculusSonar/CtrlWidget.h \
     RmGl/PalWidget.h \
     RmUtil/RmLogger.h \
+    RmUtil/RmLogWriter.h \
+    RmUtil/RmCodec.h \
+    RmUtil/RmLogIndex.h \
+    RmUtil/RmLogRepair.h \
+    RmUtil/RmLogCut.h \
+    RmUtil/RmLogMeta.h \
+    RmUtil/RmLogStats.h \
+    RmUtil/RmLogVerify.h \
+    RmUtil/RmCrc32c.h \
+    RmUtil/RmLogSession.h \
+    RmUtil/RmLogMerge.h \
     RmUtil/RmPlayer.h \
+    RmUtil/RmPalette.h \
+    RmUtil/RmAviWriter.h \
     OculusSonar/SettingsForm.h \
     OculusSonar/ConnectForm.h \
     Oculus/OssDataWrapper.h \
@@ -107,7 +152,14 @@ HEADERS  += \
     Controls/RangeSlider.h \
     Controls/RangeSlider_p.h \
     OculusSonar/HelpForm.h \
-    inference.h
+    OculusSonar/LogExporter.h \
+    OculusSonar/SnapshotWriter.h \
+    OculusSonar/ScreenRecorder.h \
+    OculusSonar/MultiReplay.h \
+    OculusSonar/DatasetExporter.h \
+    OculusSonar/LogTools.h \
+    inference.h \
+    SonarYolo.h
 
 FORMS    += \
     OculusSonar/OnlineCtrls.ui \
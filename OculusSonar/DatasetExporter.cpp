@@ -0,0 +1,397 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "DatasetExporter.h"
+
+#include <QDir>
+#include <QFileInfo>
+#include <QFile>
+#include <QTextStream>
+#include <QThreadPool>
+#include <QThread>
+#include <QElapsedTimer>
+#include <QDebug>
+
+#include "../Oculus/OsReplayEngine.h"
+#include "../RmUtil/RmLogger.h"
+
+// ============================================================================
+// DatasetExporter - parallel log to training set conversion
+
+DatasetExporter::DatasetExporter()
+{
+    m_every    = 1;
+    m_labels   = true;
+    m_nThreads = 0;
+    m_nPings   = 0;
+    m_nObjects = 0;
+}
+
+// ----------------------------------------------------------------------------
+// The logs named and the .oculus logs in the directories named, each directory
+// in name order so every run sees the same list
+QStringList DatasetExporter::FindLogs(QStringList inputs)
+{
+    QStringList logs;
+
+    for (const QString& input : inputs)
+    {
+        QFileInfo info(input);
+
+        if (!info.isDir())
+        {
+            logs.append(input);
+            continue;
+        }
+
+        for (const QFileInfo& file : QDir(input).entryInfoList({ "*.oculus" }, QDir::Files, QDir::Name))
+            logs.append(file.filePath());
+    }
+
+    return logs;
+}
+
+// ----------------------------------------------------------------------------
+// Export every log. The logs are indexed first, then their pings are exported
+// in batches on the pool while this thread reports the progress
+bool DatasetExporter::Run(QStringList inputs)
+{
+    m_logs = FindLogs(inputs);
+    m_entries.clear();
+
+    if (m_logs.isEmpty())
+    {
+        m_error = "No logs found";
+        return false;
+    }
+
+    if (!QDir().mkpath(m_outDir))
+    {
+        m_error = "Unable to create '" + m_outDir + "'";
+        return false;
+    }
+
+    // Samples are named after their log, logs of the same name from different
+    // folders also get their number in the list so no two write one file
+    QStringList bases;
+
+    for (const QString& log : m_logs)
+        bases.append(QFileInfo(log).completeBaseName());
+
+    m_names.clear();
+
+    for (int l = 0; l < m_logs.size(); l++)
+        m_names.append(bases.count(bases[l]) > 1 ? QString("%1_log%2").arg(bases[l]).arg(l + 1) : bases[l]);
+
+    // Cut each log's sonar records into batches
+    QVector<DatasetBatch> batches;
+    quint64               total = 0;
+    int                   span  = DATASET_BATCH * m_every;
+
+    for (int l = 0; l < m_logs.size(); l++)
+    {
+        RmLogSession session;
+
+        if (!session.Open(m_logs[l], rt_oculusSonar, false))
+            qWarning().noquote() << "Skipping '" + m_logs[l] + "', it cannot be read";
+
+        m_entries.append(session.Entries());
+
+        int count = m_entries[l].size();
+
+        for (int first = 0; first < count; first += span)
+        {
+            DatasetBatch batch;
+
+            batch.log   = l;
+            batch.first = first;
+            batch.count = qMin(span, count - first);
+
+            batches.append(batch);
+        }
+
+        total += (count + m_every - 1) / m_every;
+    }
+
+    int nThreads = m_nThreads > 0 ? m_nThreads : QThread::idealThreadCount();
+
+    QVector<QStringList> manifests(batches.size());
+    QAtomicInt           next(0);
+    QAtomicInt           failed(0);
+    QThreadPool          pool;
+    QElapsedTimer        timer;
+
+    pool.setMaxThreadCount(nThreads);
+    timer.start();
+
+    for (int t = 0; t < nThreads; t++)
+    {
+        pool.start([&]() {
+            for (int b = next.fetchAndAddRelaxed(1); b < batches.size() && !failed.loadAcquire(); b = next.fetchAndAddRelaxed(1))
+                if (!ExportBatch(batches[b], manifests[b]))
+                    failed.storeRelease(1);
+        });
+    }
+
+    while (!pool.waitForDone(1000))
+    {
+        double secs = timer.elapsed() / 1000.0;
+
+        qInfo().noquote() << QString("%1 / %2 pings, %3 pings/s").arg(m_nPings.loadAcquire()).arg(total)
+                             .arg(m_nPings.loadAcquire() / qMax(secs, 0.001), 0, 'f', 1);
+    }
+
+    if (failed.loadAcquire())
+    {
+        m_error = "Unable to write to '" + m_outDir + "'";
+        return false;
+    }
+
+    // The manifest, in log and ping order
+    QDir  dir(m_outDir);
+    QFile manifest(dir.filePath("manifest.csv"));
+
+    if (!manifest.open(QIODevice::WriteOnly | QIODevice::Text))
+    {
+        m_error = "Unable to write the manifest";
+        return false;
+    }
+
+    QTextStream out(&manifest);
+
+    out << "image,log,entry,time,range,objects\n";
+
+    for (const QStringList& lines : manifests)
+        for (const QString& line : lines)
+            out << line << "\n";
+
+    out.flush();
+
+    if (out.status() != QTextStream::Ok)
+    {
+        m_error = "Unable to write the manifest";
+        return false;
+    }
+
+    // The one class the detector labels
+    if (m_labels)
+    {
+        QFile classes(dir.filePath("classes.txt"));
+
+        if (classes.open(QIODevice::WriteOnly | QIODevice::Text))
+            classes.write("object\n");
+    }
+
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// Export a batch of pings through a reader of its own (WORKER THREAD). The
+// manifest lines for the batch are returned in ping order
+bool DatasetExporter::ExportBatch(const DatasetBatch& batch, QStringList& manifest)
+{
+    OsSessionReader reader;
+    OsBufferEntry   raw;
+    OsBufferEntry   entry;
+    QDir            dir(m_outDir);
+    QString         base = m_names[batch.log];
+
+    reader.SetSession(m_entries.at(batch.log), QStringList(m_logs[batch.log]));
+
+    for (int e = batch.first; e < batch.first + batch.count; e++)
+    {
+        if (e % m_every != 0)
+            continue;
+
+        double         time;
+        unsigned short version;
+
+        if (!reader.Read(e, raw, &time, &version))
+            continue;
+
+        entry.ProcessRaw((char*) raw.m_pRaw);
+
+        int    width  = 0;
+        int    height = 0;
+        double range  = 0;
+
+        entry.GetImageInfo(width, height, range);
+
+        if (!entry.m_pImage || width <= 0 || height <= 0)
+            continue;
+
+        cv::Mat               image = PrepareImage(height, width, entry.m_pImage);
+        std::vector<cv::Rect> objects;
+
+        if (m_labels)
+            objects = FindObjects(image, m_params);
+
+        QString name = QString("%1_%2").arg(base).arg(e, 7, 10, QChar('0'));
+
+        if (!WriteSample(image, objects, dir.filePath(name + ".png"), m_labels ? dir.filePath(name + ".txt") : QString()))
+            return false;
+
+        manifest.append(QString("%1.png,%2,%3,%4,%5,%6").arg(name).arg(QFileInfo(m_logs[batch.log]).fileName()).arg(e)
+                        .arg(time, 0, 'f', 6).arg(range, 0, 'f', 3).arg(objects.size()));
+
+        m_nPings++;
+        m_nObjects += objects.size();
+    }
+
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// The polar image as the detector sees it: beams down the rows, flipped,
+// resized to the network's input and lightly blurred
+cv::Mat DatasetExporter::PrepareImage(int height, int width, const uchar* pImage)
+{
+    cv::Mat sonarImg(height, width, CV_8UC1, (void*) pImage);
+
+    cv::Mat rotatedImg;
+    cv::transpose(sonarImg, rotatedImg);
+    cv::flip(rotatedImg, rotatedImg, 1);
+
+    cv::Mat finalImg;
+    cv::resize(rotatedImg, finalImg, cv::Size(DATASET_IMAGE_SIZE, DATASET_IMAGE_SIZE), 0, 0, cv::INTER_LINEAR);
+
+    cv::GaussianBlur(finalImg, finalImg, cv::Size(3, 3), 0);
+
+    return finalImg;
+}
+
+// ----------------------------------------------------------------------------
+// Boxes round the blobs much brighter or darker than the image as a whole
+// that pass the size, shape and contrast limits
+std::vector<cv::Rect> DatasetExporter::FindObjects(const cv::Mat& image, const DetectionParameters& params)
+{
+    cv::Scalar mean, stddev;
+    cv::meanStdDev(image, mean, stddev);
+
+    // Bright objects (above the mean) and dark ones (below it)
+    double highThreshold = mean[0] + params.highThresholdMult * stddev[0];
+    cv::Mat brightMask;
+    cv::threshold(image, brightMask, highThreshold, 255, cv::THRESH_BINARY);
+
+    double lowThreshold = mean[0] - params.lowThresholdMult * stddev[0];
+    cv::Mat darkMask;
+    cv::threshold(image, darkMask, lowThreshold, 255, cv::THRESH_BINARY_INV);
+
+    cv::Mat anomalyMask;
+    cv::bitwise_or(brightMask, darkMask, anomalyMask);
+
+    cv::Mat kernel = cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(3, 3));
+    cv::morphologyEx(anomalyMask, anomalyMask, cv::MORPH_OPEN, kernel);
+    cv::morphologyEx(anomalyMask, anomalyMask, cv::MORPH_CLOSE, kernel);
+
+    std::vector<std::vector<cv::Point>> contours;
+    cv::findContours(anomalyMask.clone(), contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
+
+    std::vector<cv::Rect> objects;
+
+    for (size_t i = 0; i < contours.size(); i++) {
+        cv::Rect bbox = cv::boundingRect(contours[i]);
+
+        int bboxArea = bbox.width * bbox.height;
+
+        if (bboxArea < params.minBlobArea || bboxArea > params.maxBlobArea) {
+            continue;
+        }
+
+        if (bbox.width < params.minWidth || bbox.width > params.maxWidth ||
+            bbox.height < params.minHeight || bbox.height > params.maxHeight) {
+            continue;
+        }
+
+        double aspectRatio = (double)bbox.width / bbox.height;
+        if (aspectRatio < params.minAspectRatio || aspectRatio > params.maxAspectRatio) {
+            continue;
+        }
+
+        double contourArea = cv::contourArea(contours[i]);
+        double perimeter = cv::arcLength(contours[i], true);
+        double compactness = (4.0 * 3.14159265359 * contourArea) / (perimeter * perimeter);
+        if (compactness < params.minCompactness) {
+            continue;
+        }
+
+        cv::Mat mask = cv::Mat::zeros(image.size(), CV_8UC1);
+        cv::drawContours(mask, contours, (int) i, cv::Scalar(255), cv::FILLED);
+        cv::Scalar blobMean = cv::mean(image, mask);
+
+        double intensityDiff = std::abs(blobMean[0] - mean[0]);
+        if (intensityDiff < params.minIntensityDiff) {
+            continue;
+        }
+
+        std::vector<cv::Point> hull;
+        cv::convexHull(contours[i], hull);
+        double hullArea = cv::contourArea(hull);
+        double solidity = contourArea / hullArea;
+        if (solidity < params.minSolidity) {
+            continue;
+        }
+
+        objects.push_back(bbox);
+    }
+
+    return objects;
+}
+
+// ----------------------------------------------------------------------------
+// Write a prepared image turned upright (range up the image), and the boxes
+// as YOLO labels in the same orientation when a label file is given
+bool DatasetExporter::WriteSample(const cv::Mat& image, const std::vector<cv::Rect>& objects, QString imagePath, QString labelPath)
+{
+    cv::Mat rgbImg;
+    cv::cvtColor(image, rgbImg, cv::COLOR_GRAY2RGB);
+
+    cv::Mat rotatedRgb;
+    cv::rotate(rgbImg, rotatedRgb, cv::ROTATE_90_CLOCKWISE);
+
+    if (!cv::imwrite(imagePath.toStdString(), rotatedRgb))
+        return false;
+
+    if (labelPath.isEmpty())
+        return true;
+
+    QFile labelFile(labelPath);
+
+    if (!labelFile.open(QIODevice::WriteOnly | QIODevice::Text))
+        return false;
+
+    QTextStream out(&labelFile);
+    double      side = DATASET_IMAGE_SIZE;
+
+    for (const cv::Rect& bbox : objects) {
+        // The box turned with the image
+        double rotated_x = side - bbox.y - bbox.height;
+        double rotated_y = bbox.x;
+        double rotated_width = bbox.height;
+        double rotated_height = bbox.width;
+
+        out << "0 "
+            << QString::number((rotated_x + rotated_width / 2.0) / side, 'f', 6) << " "
+            << QString::number((rotated_y + rotated_height / 2.0) / side, 'f', 6) << " "
+            << QString::number(rotated_width / side, 'f', 6) << " "
+            << QString::number(rotated_height / side, 'f', 6) << "\n";
+    }
+
+    return true;
+}
@@ -0,0 +1,84 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QAtomicInteger>
+
+#include <vector>
+#include <opencv2/opencv.hpp>
+
+#include "DetectionParams.h"
+#include "../RmUtil/RmLogSession.h"
+
+#define DATASET_IMAGE_SIZE  640     // Side of the square training images (the YOLO input)
+#define DATASET_BATCH       256     // Pings a worker takes at a time
+
+// ----------------------------------------------------------------------------
+// A run of pings from one log, exported by one worker
+struct DatasetBatch
+{
+    int log;                // Log it comes from
+    int first;              // First sonar entry
+    int count;              // Entries
+};
+
+// ----------------------------------------------------------------------------
+// DatasetExporter - turns logs into a training set. The pings of every log are
+// shared out in batches over a thread pool; each is decoded and put through
+// the same transpose, flip, resize and blur as the live detector, then written
+// as an image with (optionally) the blob detector's boxes as YOLO labels. Files
+// are named after the log and ping, and the manifest is written in log order,
+// so the output doesn't depend on the thread count or timing
+
+class DatasetExporter
+{
+public:
+    DatasetExporter();
+
+    // Methods
+    bool Run(QStringList inputs);
+
+    static cv::Mat PrepareImage(int height, int width, const uchar* pImage);
+    static std::vector<cv::Rect> FindObjects(const cv::Mat& image, const DetectionParameters& params);
+    static bool WriteSample(const cv::Mat& image, const std::vector<cv::Rect>& objects, QString imagePath, QString labelPath);
+    static QStringList FindLogs(QStringList inputs);
+
+    // Options
+    QString       m_outDir;         // Where the images, labels and manifest go
+    int           m_every;          // Export every Nth ping of each log
+    bool          m_labels;         // Write the detector's boxes as labels
+    int           m_nThreads;       // Workers (0 = all cores)
+    DetectionParameters m_params;   // Detector settings for the labels
+
+    // Results
+    QAtomicInteger<quint64> m_nPings;     // Pings exported
+    QAtomicInteger<quint64> m_nObjects;   // Boxes labelled
+    QString       m_error;          // Reason for failure
+
+protected:
+    bool ExportBatch(const DatasetBatch& batch, QStringList& manifest);
+
+    QStringList   m_logs;           // Logs being exported
+    QStringList   m_names;          // Their samples' file name prefixes (unique)
+    QVector<QVector<RmSessionEntry>> m_entries;   // Their sonar records
+};
@@ -0,0 +1,419 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "LogExporter.h"
+
+#include <QGuiApplication>
+#include <QCommandLineParser>
+#include <QSettings>
+#include <QThreadPool>
+#include <QElapsedTimer>
+#include <QFileInfo>
+#include <QDir>
+#include <QDebug>
+#include <cstdio>
+
+#include "../Displays/SonarSurface.h"
+#include "../RmUtil/RmLogger.h"
+#include "SonarYolo.h"
+
+
+// ============================================================================
+// LogExporter - renders a .oculus log through an offscreen SonarSurface
+
+LogExporter::LogExporter()
+{
+    m_format    = exportPng;
+    m_width     = 1280;
+    m_height    = 720;
+    m_every     = 1;
+    m_maxFrames = 0;
+    m_palIndex  = 1;
+    m_sonarColourMap = false;
+    m_headDown  = true;
+    m_flipX     = true;
+    m_flipY     = false;
+    m_grid      = true;
+    m_gridText  = true;
+
+    m_nPings    = 0;
+    m_nFrames   = 0;
+
+    m_pSurface  = nullptr;
+    m_pYolo     = nullptr;
+    m_pRgb      = nullptr;
+
+    // Keep a couple of encodes queued per worker so the GPU never waits on disk
+    // but memory stays bounded
+    m_nWriteSlots = QThreadPool::globalInstance()->maxThreadCount() * 2;
+    m_writeSlots.release(m_nWriteSlots);
+
+    connect(&m_player, &RmPlayer::NewPayload, this, &LogExporter::OnNewPayload);
+}
+
+LogExporter::~LogExporter()
+{
+    // Let any outstanding image writes finish
+    QThreadPool::globalInstance()->waitForDone();
+
+    // The surface is owned (and freed) by the offscreen host
+    m_offscreen.RmglDestroy();
+    m_pSurface = nullptr;
+
+    if (m_pYolo)
+        delete m_pYolo;
+
+    if (m_pRgb)
+        free(m_pRgb);
+}
+
+// ----------------------------------------------------------------------------
+// Is this command line asking for a headless export (checked before any
+// application object exists, as the export does not use QApplication)
+bool LogExporter::IsExportCommand(int argc, char* argv[])
+{
+    for (int a = 1; a < argc; a++)
+        if (QByteArray(argv[a]) == "--export")
+            return true;
+
+    return false;
+}
+
+// ----------------------------------------------------------------------------
+// Command line entry point for the headless export
+int LogExporter::Main(int argc, char* argv[])
+{
+    // No window is ever shown so default to the offscreen platform, a platform
+    // given with -platform or QT_QPA_PLATFORM still wins
+    if (qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM"))
+        qputenv("QT_QPA_PLATFORM", "offscreen");
+
+    QGuiApplication a(argc, argv);
+
+    // Same settings as the viewer so the export matches the on screen view
+    a.setOrganizationName("Blueprint Subsea");
+    a.setOrganizationDomain("www.blueprintsubsea.com");
+    a.setApplicationName("Oculus Sonar");
+
+    QSettings::setDefaultFormat(QSettings::IniFormat);
+    QSettings::setPath(QSettings::IniFormat, QSettings::UserScope, a.applicationDirPath());
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Export an Oculus log to a PNG sequence or raw RGB frames");
+    parser.addHelpOption();
+
+    QCommandLineOption exportOpt("export",   "Log file to export.", "file");
+    QCommandLineOption outOpt   ("out",      "Output directory (png) or file (rgb, '-' for stdout).", "path");
+    QCommandLineOption formatOpt("format",   "Output format: png or rgb (default png).", "format", "png");
+    QCommandLineOption sizeOpt  ("size",     "Frame size WxH (default 1280x720).", "size", "1280x720");
+    QCommandLineOption everyOpt ("every",    "Export every Nth ping (default 1).", "n", "1");
+    QCommandLineOption maxOpt   ("max",      "Maximum number of frames (default all).", "n", "0");
+    QCommandLineOption palOpt   ("palette",  "Palette index or 'sonar' (default from the viewer settings).", "index");
+    QCommandLineOption noGrid   ("no-grid",  "Do not draw the grid lines.");
+    QCommandLineOption noText   ("no-grid-text", "Do not draw the grid range labels.");
+    QCommandLineOption detectOpt("detect",   "Draw the YOLO detection overlay using the given model.", "model");
+
+    parser.addOptions({ exportOpt, outOpt, formatOpt, sizeOpt, everyOpt, maxOpt, palOpt, noGrid, noText, detectOpt });
+    parser.process(a);
+
+    LogExporter exporter;
+
+    // Start from the viewer's display settings
+    QSettings settings;
+    exporter.m_palIndex = settings.value("PaletteIndex", 1).toInt();
+    exporter.m_headDown = settings.value("HeadDown", 1).toBool();
+    exporter.m_flipX    = settings.value("FlipX", 1).toBool();
+    exporter.m_sonarColourMap = settings.value("SonarColourMap", false).toBool();
+
+    exporter.m_logFile   = parser.value(exportOpt);
+    exporter.m_outPath   = parser.value(outOpt);
+    exporter.m_format    = (parser.value(formatOpt).toLower() == "rgb") ? exportRgb : exportPng;
+    exporter.m_every     = qMax(1, parser.value(everyOpt).toInt());
+    exporter.m_maxFrames = qMax(0, parser.value(maxOpt).toInt());
+    exporter.m_grid      = !parser.isSet(noGrid);
+    exporter.m_gridText  = !parser.isSet(noText);
+    exporter.m_modelPath = parser.value(detectOpt);
+
+    if (parser.isSet(palOpt))
+    {
+        exporter.m_sonarColourMap = (parser.value(palOpt).toLower() == "sonar");
+
+        if (!exporter.m_sonarColourMap)
+            exporter.m_palIndex = parser.value(palOpt).toInt();
+    }
+
+    QStringList size = parser.value(sizeOpt).toLower().split('x');
+
+    if (size.count() == 2)
+    {
+        exporter.m_width  = size[0].toInt();
+        exporter.m_height = size[1].toInt();
+    }
+
+    if (exporter.m_outPath.isEmpty())
+    {
+        QFileInfo info(exporter.m_logFile);
+        exporter.m_outPath = info.dir().absoluteFilePath(info.completeBaseName() + (exporter.m_format == exportRgb ? ".rgb" : ""));
+    }
+
+    QElapsedTimer timer;
+    timer.start();
+
+    bool ok = exporter.Run();
+
+    double secs = (double)timer.elapsed() / 1000.0;
+
+    if (!ok)
+    {
+        qCritical().noquote() << "Export failed:" << exporter.m_error;
+        return 1;
+    }
+
+    qInfo().noquote() << "Exported" << exporter.m_nFrames << "frames from" << exporter.m_nPings << "pings in"
+                      << QString::number(secs, 'f', 1) << "s (" + QString::number(exporter.m_nFrames / qMax(secs, 0.001), 'f', 1) + " fps)";
+
+    if (exporter.m_format == exportRgb)
+        qInfo().noquote() << "Raw frames are rgb24" << QString::number(exporter.m_width) + "x" + QString::number(exporter.m_height);
+
+    return 0;
+}
+
+// ----------------------------------------------------------------------------
+// Record the reason for a failure
+bool LogExporter::ExportFailed(QString reason)
+{
+    m_error = reason;
+
+    m_player.CloseFile();
+    m_out.close();
+    m_index.close();
+
+    return false;
+}
+
+// ----------------------------------------------------------------------------
+// Export the whole log
+bool LogExporter::Run()
+{
+    if (!m_player.OpenFile(m_logFile))
+        return ExportFailed("Cannot open log file '" + m_logFile + "'");
+
+    // Setup the surface the same way MainView does
+    m_pSurface = new SonarSurface;
+    m_pSurface->m_clearColour.setRgb(81, 81, 81);
+    m_pSurface->m_dwGridText     = m_gridText;
+    m_pSurface->m_showGrid       = m_grid;
+    m_pSurface->m_palIndex       = m_palIndex;
+    m_pSurface->m_headDown       = m_headDown;
+    m_pSurface->m_flipX          = m_flipX;
+    m_pSurface->m_flipY          = m_flipY;
+    m_pSurface->m_disconnected   = false;
+    m_pSurface->m_showDetections = !m_modelPath.isEmpty();
+
+    if (m_sonarColourMap)
+    {
+        m_palette.LoadFromFunction(RmPalette::SonarColourMap);
+        m_pSurface->SetRgbPalette(&m_palette);
+    }
+
+    if (!m_offscreen.RmglCreate(m_pSurface, m_width, m_height))
+    {
+        m_pSurface = nullptr;
+        return ExportFailed(m_offscreen.m_error);
+    }
+
+    // Optional detection overlay
+    if (!m_modelPath.isEmpty())
+    {
+        if (!QFile::exists(m_modelPath))
+            return ExportFailed("Model '" + m_modelPath + "' not found");
+
+        DL_INIT_PARAM params;
+        params.modelPath = m_modelPath.toStdString();
+        params.classNames = {"kutu"};
+        params.rectConfidenceThreshold = 0.1f;
+
+        m_pYolo = new YOLO_V8();
+
+        if (!m_pYolo->CreateSession(params))
+            return ExportFailed("Cannot load model '" + m_modelPath + "'");
+    }
+
+    // Prepare the outputs
+    QString indexName;
+
+    if (m_format == exportPng)
+    {
+        if (!QDir().mkpath(m_outPath))
+            return ExportFailed("Cannot create directory '" + m_outPath + "'");
+
+        indexName = QDir(m_outPath).absoluteFilePath("frames.csv");
+    }
+    else
+    {
+        m_pRgb = (quint8*) malloc (m_width * m_height * 3);
+
+        if (!m_pRgb)
+            return ExportFailed("Cannot allocate the frame buffer");
+
+        if (m_outPath == "-")
+        {
+            if (!m_out.open(stdout, QIODevice::WriteOnly))
+                return ExportFailed("Cannot write to stdout");
+        }
+        else
+        {
+            m_out.setFileName(m_outPath);
+
+            if (!m_out.open(QIODevice::WriteOnly))
+                return ExportFailed("Cannot create '" + m_outPath + "'");
+
+            indexName = m_outPath + ".csv";
+        }
+    }
+
+    if (!indexName.isEmpty())
+    {
+        m_index.setFileName(indexName);
+
+        if (m_index.open(QIODevice::WriteOnly | QIODevice::Text))
+            m_index.write("frame,time,ping\n");
+    }
+
+    // Walk the log, frames are rendered from the payload slot
+    int nextReport = 500;
+
+    while (m_player.ReadNextItem())
+    {
+        if (m_maxFrames > 0 && m_nFrames >= m_maxFrames)
+            break;
+
+        if (m_nFrames >= nextReport)
+        {
+            qInfo().noquote() << "Exported" << m_nFrames << "frames";
+            nextReport += 500;
+        }
+    }
+
+    m_player.CloseFile();
+
+    // Wait for the PNG encoders
+    QThreadPool::globalInstance()->waitForDone();
+
+    m_out.close();
+    m_index.close();
+
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// (SLOT) A record from the log
+void LogExporter::OnNewPayload(unsigned short type, unsigned short version, double time, unsigned payloadSize, quint8* pPayload)
+{
+    Q_UNUSED(version)
+    Q_UNUSED(payloadSize)
+
+    // Legacy rt_apSonarHeader / rt_rawSonarImage logs are not exported
+    if (type != rt_oculusSonar)
+        return;
+
+    m_nPings++;
+
+    if ((m_nPings - 1) % m_every != 0)
+        return;
+
+    if (m_maxFrames > 0 && m_nFrames >= m_maxFrames)
+        return;
+
+    m_entry.ProcessRaw((char*)pPayload);
+
+    quint32 pingId = 0;
+
+    m_entry.m_mutex.lock();
+    {
+        int    width  = 0;
+        int    height = 0;
+        double range  = 0.0;
+
+        m_entry.GetImageInfo(width, height, range);
+
+        pingId = (m_entry.m_version == 2) ? m_entry.m_rfm2.pingId : m_entry.m_rfm.pingId;
+
+        if (width <= 0 || height <= 0 || !m_entry.m_pImage || !m_entry.m_pBrgs)
+        {
+            m_entry.m_mutex.unlock();
+            return;
+        }
+
+        m_pSurface->UpdateFan(range, width, m_entry.m_pBrgs, true);
+        m_pSurface->UpdateImg(height, width, m_entry.m_pImage);
+
+        if (m_pYolo)
+        {
+            QList<SonarSurface::DetectedObject> detections;
+
+            try {
+                SonarYoloDetect(m_pYolo, width, height, m_entry.m_pImage, m_entry.m_pBrgs, range, detections);
+            } catch (const std::exception& e) {
+                qWarning() << "YOLO error:" << e.what();
+            }
+
+            m_pSurface->SetDetections(detections);
+        }
+    }
+    m_entry.m_mutex.unlock();
+
+    RenderFrame(time, pingId);
+}
+
+// ----------------------------------------------------------------------------
+// Render the surface and write the frame out, the index gives the sonar's ping id
+void LogExporter::RenderFrame(double time, quint32 pingId)
+{
+    if (m_format == exportPng)
+    {
+        if (!m_offscreen.RmglRender(m_image))
+            return;
+
+        QString name = QDir(m_outPath).absoluteFilePath(QString("frame_%1.png").arg(m_nFrames, 6, 10, QChar('0')));
+
+        // Encode on the thread pool, the image is shared (copy on write)
+        QImage image = m_image;
+
+        m_writeSlots.acquire();
+        QThreadPool::globalInstance()->start([this, image, name]() {
+            if (!image.save(name, "PNG"))
+                qWarning().noquote() << "Cannot write" << name;
+
+            m_writeSlots.release();
+        });
+    }
+    else
+    {
+        if (!m_offscreen.RmglRenderRgb(m_pRgb))
+            return;
+
+        m_out.write((const char*)m_pRgb, m_width * m_height * 3);
+    }
+
+    if (m_index.isOpen())
+        m_index.write(QString("%1,%2,%3\n").arg(m_nFrames).arg(time, 0, 'f', 3).arg(pingId).toLatin1());
+
+    m_nFrames++;
+}
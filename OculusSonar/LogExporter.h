@@ -0,0 +1,102 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#pragma once
+
+#include <QObject>
+#include <QFile>
+#include <QImage>
+#include <QSemaphore>
+
+#include "../RmGl/RmGlOffscreen.h"
+#include "../RmUtil/RmPlayer.h"
+#include "../RmUtil/RmPalette.h"
+#include "../Oculus/OsClientCtrl.h"
+
+class SonarSurface;
+class YOLO_V8;
+
+// Output formats for the exporter
+enum eExportFormat : int
+{
+    exportPng,      // Numbered PNG sequence in a directory
+    exportRgb       // Packed RGB24 frames in a single file (or stdout) for an external encoder
+};
+
+// ----------------------------------------------------------------------------
+// LogExporter - renders a .oculus log through an offscreen SonarSurface as fast
+// as the GPU and disk allow. Used by the --export command line mode, which runs
+// without a main window or a display server
+
+class LogExporter : public QObject
+{
+    Q_OBJECT
+
+public:
+    LogExporter();
+    ~LogExporter();
+
+    // Command line entry point
+    static bool IsExportCommand(int argc, char* argv[]);
+    static int  Main(int argc, char* argv[]);
+
+    // Methods
+    bool Run();
+    bool ExportFailed(QString reason);
+    void RenderFrame(double time, quint32 pingId);
+
+    // Options
+    QString       m_logFile;      // The log to export
+    QString       m_outPath;      // Output directory (png) or file (rgb, "-" for stdout)
+    eExportFormat m_format;       // Output format
+    int           m_width;        // Frame width
+    int           m_height;       // Frame height
+    int           m_every;        // Export every Nth ping
+    int           m_maxFrames;    // Stop after this many frames (0 = all)
+    int           m_palIndex;     // Palette index (as the on screen view)
+    bool          m_sonarColourMap; // Colour on the CPU with the sonar colour map instead
+    bool          m_headDown;     // Fan orientation
+    bool          m_flipX;        // Flip the fan horizontally
+    bool          m_flipY;        // Flip the fan vertically
+    bool          m_grid;         // Draw the grid lines
+    bool          m_gridText;     // Draw the grid range labels
+    QString       m_modelPath;    // YOLO model used for the detection overlay (empty = none)
+
+    // Results
+    int           m_nPings;       // Sonar records read
+    int           m_nFrames;      // Frames written
+    QString       m_error;        // Reason for failure
+
+public slots:
+    void OnNewPayload(unsigned short type, unsigned short version, double time, unsigned payloadSize, quint8* pPayload);
+
+private:
+    RmPlayer      m_player;       // Log reader
+    OsBufferEntry m_entry;        // Decoded ping
+    RmGlOffscreen m_offscreen;    // Offscreen GL host for the surface
+    SonarSurface* m_pSurface;     // The fan renderer (owned by m_offscreen)
+    YOLO_V8*      m_pYolo;        // Optional detector
+    RmPalette     m_palette;      // CPU palette for the sonar colour map
+    QImage        m_image;        // Last rendered frame (png)
+    quint8*       m_pRgb;         // Last rendered frame (rgb)
+    QFile         m_out;          // Raw frame output (rgb)
+    QFile         m_index;        // Frame index (frame, time, ping)
+    QSemaphore    m_writeSlots;   // Bounds the number of PNG encodes in flight
+    int           m_nWriteSlots;  // Initial number of write slots
+};
@@ -0,0 +1,795 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "LogTools.h"
+
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QThreadPool>
+#include <QThread>
+#include <QAtomicInt>
+#include <QVector>
+#include <QDebug>
+#include <QDateTime>
+#include <QFileInfo>
+#include <QDir>
+
+#include <algorithm>
+#include <limits>
+
+#include "../RmUtil/RmPlayer.h"
+#include "../RmUtil/RmLogger.h"
+#include "../RmUtil/RmCodec.h"
+#include "../RmUtil/RmLogIndex.h"
+#include "../RmUtil/RmLogRepair.h"
+#include "../RmUtil/RmLogCut.h"
+#include "../RmUtil/RmLogMeta.h"
+#include "../RmUtil/RmLogStats.h"
+#include "../RmUtil/RmLogVerify.h"
+#include "../RmUtil/RmCrc32c.h"
+#include "DatasetExporter.h"
+#include "../Oculus/OsClientCtrl.h"
+
+// The commands handled here
+static const char* s_commands[] = { "--codec-bench", "--index", "--repair", "--cut", "--split", "--merge", "--meta", "--dataset", "--stats", "--verify" };
+
+// ============================================================================
+// LogTools - command line log utilities
+
+// ----------------------------------------------------------------------------
+// Check the command line for one of the tool commands
+bool LogTools::IsToolCommand(int argc, char* argv[])
+{
+    for (int a = 1; a < argc; a++)
+        for (const char* command : s_commands)
+            if (QByteArray(argv[a]) == command)
+                return true;
+
+    return false;
+}
+
+// ----------------------------------------------------------------------------
+// Command line entry point for the tools
+int LogTools::Main(int argc, char* argv[])
+{
+    QCoreApplication a(argc, argv);
+
+    QCommandLineParser parser;
+    parser.setApplicationDescription("Oculus log tools");
+    parser.addHelpOption();
+    parser.addPositionalArgument("logs", "Log files to work on.", "[logs...]");
+
+    QCommandLineOption benchOpt  ("codec-bench", "Measure the log codecs on the sonar records of the logs.");
+    QCommandLineOption codecOpt  ("codec",       "Codec to measure (default all).", "name");
+    QCommandLineOption pingsOpt  ("pings",       "Pings to load for the benchmark (default 400).", "n", "400");
+    QCommandLineOption threadsOpt("threads",     "Worker threads (default all cores).", "n", "0");
+    QCommandLineOption indexOpt  ("index",       "Rebuild the record index of the logs and save it as a sidecar.");
+    QCommandLineOption repairOpt ("repair",      "Recover the intact records of damaged logs into <log>_repaired.oculus. Logs with a footer are not scanned for damage inside them (see --verify).");
+    QCommandLineOption outOpt    ("out",         "Log to write (one log only).", "file");
+    QCommandLineOption inPlaceOpt("in-place",    "Repair the logs where they are.");
+    QCommandLineOption cutOpt    ("cut",         "Copy the records from --from to --to into <log>_cut.oculus.");
+    QCommandLineOption fromOpt   ("from",        "Start of the cut, seconds into the log (default 0).", "secs", "0");
+    QCommandLineOption toOpt     ("to",          "End of the cut, seconds into the log (default the end).", "secs", "0");
+    QCommandLineOption splitOpt  ("split",       "Split the log into pieces of --every seconds, <log>_001.oculus on.");
+    QCommandLineOption everyOpt  ("every",       "Length of each piece in seconds (default 600).", "secs", "600");
+    QCommandLineOption mergeOpt  ("merge",       "Join the logs, in the order they start, into the --out log.");
+    QCommandLineOption metaOpt   ("meta",        "Build the ping metadata sidecar of the logs (<log>.meta).");
+    QCommandLineOption whereOpt  ("where",       "List the pings matching every condition, e.g. range=5:30,gain=:50.", "conditions");
+    QCommandLineOption datasetOpt("dataset",     "Export the pings of the logs (or of the logs in directories) as training images into --out.");
+    QCommandLineOption strideOpt ("stride",      "Export every nth ping of each log (default 1).", "n", "1");
+    QCommandLineOption noLabelOpt("no-labels",   "Leave out the detector's YOLO labels.");
+    QCommandLineOption statsOpt  ("stats",       "Report the health of the logs (or of the logs in directories).");
+    QCommandLineOption jsonOpt   ("json",        "Write the statistics as JSON.", "file");
+    QCommandLineOption csvOpt    ("csv",         "Write the statistics as CSV.", "file");
+    QCommandLineOption verifyOpt ("verify",      "Check every record of the logs (or of the logs in directories) against its checksum.");
+
+    parser.addOptions({ benchOpt, codecOpt, pingsOpt, threadsOpt, indexOpt, repairOpt, outOpt, inPlaceOpt,
+                        cutOpt, fromOpt, toOpt, splitOpt, everyOpt, mergeOpt, metaOpt, whereOpt,
+                        datasetOpt, strideOpt, noLabelOpt, statsOpt, jsonOpt, csvOpt, verifyOpt });
+    parser.process(a);
+
+    QStringList files = parser.positionalArguments();
+    int nThreads = parser.value(threadsOpt).toInt();
+
+    if (nThreads <= 0)
+        nThreads = QThread::idealThreadCount();
+
+    if (files.isEmpty())
+    {
+        qCritical().noquote() << "No log files given";
+        return 1;
+    }
+
+    if (parser.isSet(benchOpt))
+        return CodecBench(files, parser.value(codecOpt), qMax(1, parser.value(pingsOpt).toInt()), nThreads);
+
+    if (parser.isSet(indexOpt))
+        return Index(files, nThreads);
+
+    if (parser.isSet(repairOpt))
+    {
+        if (parser.isSet(outOpt) && files.size() > 1)
+        {
+            qCritical().noquote() << "--out takes a single log";
+            return 1;
+        }
+
+        return Repair(files, parser.value(outOpt), parser.isSet(inPlaceOpt), nThreads);
+    }
+
+    if (parser.isSet(cutOpt))
+        return Cut(files.first(), parser.value(fromOpt).toDouble(), parser.value(toOpt).toDouble(), parser.value(outOpt));
+
+    if (parser.isSet(splitOpt))
+        return Split(files.first(), parser.value(everyOpt).toDouble());
+
+    if (parser.isSet(mergeOpt))
+    {
+        if (!parser.isSet(outOpt))
+        {
+            qCritical().noquote() << "--merge needs --out";
+            return 1;
+        }
+
+        return Merge(files, parser.value(outOpt));
+    }
+
+    if (parser.isSet(metaOpt))
+        return Meta(files, parser.value(whereOpt), nThreads);
+
+    if (parser.isSet(datasetOpt))
+    {
+        if (!parser.isSet(outOpt))
+        {
+            qCritical().noquote() << "--dataset needs --out";
+            return 1;
+        }
+
+        return Dataset(files, parser.value(outOpt), qMax(1, parser.value(strideOpt).toInt()), !parser.isSet(noLabelOpt), nThreads);
+    }
+
+    if (parser.isSet(statsOpt))
+        return Stats(DatasetExporter::FindLogs(files), parser.value(jsonOpt), parser.value(csvOpt), nThreads);
+
+    if (parser.isSet(verifyOpt))
+        return Verify(DatasetExporter::FindLogs(files), nThreads);
+
+    return 1;
+}
+
+// ----------------------------------------------------------------------------
+// Load sonar pings from the logs and time every codec on them: compression
+// ratio, single thread compress / decompress speed and the compress speed
+// across the worker threads (what the logger's pool sees). Every payload is
+// checked to come back bit exact
+int LogTools::CodecBench(QStringList files, QString codec, int maxPings, int nThreads)
+{
+    QVector<QByteArray>    pings;
+    QVector<RmCodecLayout> layouts;
+    QVector<bool>          hasLayout;
+    quint64                totalBytes = 0;
+    double                 firstTime  = 0.0;
+    double                 lastTime   = 0.0;
+
+    for (const QString& file : files)
+    {
+        RmPlayer player;
+
+        if (!player.OpenFile(file))
+        {
+            qCritical().noquote() << "Cannot open log file '" + file + "'";
+            return 1;
+        }
+
+        QObject::connect(&player, &RmPlayer::NewPayload, [&](unsigned short type, unsigned short, double time, unsigned payloadSize, quint8* pPayload) {
+            if (type != rt_oculusSonar || pings.size() >= maxPings)
+                return;
+
+            RmCodecLayout layout;
+
+            pings.append(QByteArray((const char*) pPayload, payloadSize));
+            hasLayout.append(OsBufferEntry::CodecLayout(pPayload, payloadSize, layout));
+            layouts.append(layout);
+
+            totalBytes += payloadSize;
+
+            if (firstTime == 0.0)
+                firstTime = time;
+
+            lastTime = time;
+        });
+
+        while (pings.size() < maxPings && player.ReadNextItem())
+            ;
+
+        player.CloseFile();
+    }
+
+    if (pings.isEmpty())
+    {
+        qCritical().noquote() << "No sonar records found";
+        return 1;
+    }
+
+    double pingRate = (pings.size() > 1 && lastTime > firstTime) ? (pings.size() - 1) / (lastTime - firstTime) : 0.0;
+    double lineRate = pingRate * totalBytes / pings.size() / 1e6;
+
+    qInfo().noquote() << "Loaded" << pings.size() << "pings," << QString::number(totalBytes / 1e6, 'f', 1) << "MB"
+                      << "(" + QString::number(pingRate, 'f', 1) + " Hz," << QString::number(lineRate, 'f', 2) << "MB/s line rate)";
+    qInfo().noquote() << QString("%1 %2 %3 %4 %5").arg("codec", -8).arg("ratio", 8).arg("comp MB/s", 12).arg("decomp MB/s", 12)
+                         .arg(QString("x%1 MB/s").arg(nThreads), 12);
+
+    int nCodecs;
+    const RmCodecInfo* pCodecs = RmCodec::Codecs(&nCodecs);
+
+    QThreadPool pool;
+    pool.setMaxThreadCount(nThreads);
+
+    for (int c = 0; c < nCodecs; c++)
+    {
+        const RmCodecInfo& info = pCodecs[c];
+
+        if (!codec.isEmpty() && codec.compare(info.name, Qt::CaseInsensitive) != 0)
+            continue;
+
+        QVector<QByteArray> packed(pings.size());
+        QElapsedTimer timer;
+        quint64 packedBytes = 0;
+        bool    exact       = true;
+
+        // Single thread compress
+        timer.start();
+
+        for (int p = 0; p < pings.size(); p++)
+        {
+            if (!RmCodec::Compress(info.id, (const quint8*) pings[p].constData(), pings[p].size(), hasLayout[p] ? &layouts[p] : nullptr, packed[p]))
+                packed[p] = pings[p];       // Stored as is, as the logger would
+
+            packedBytes += packed[p].size();
+        }
+
+        double compSecs = timer.nsecsElapsed() / 1e9;
+
+        // Single thread decompress
+        QByteArray out;
+        timer.restart();
+
+        for (int p = 0; p < pings.size(); p++)
+        {
+            out.resize(pings[p].size());
+
+            if (packed[p].constData() == pings[p].constData())
+                continue;
+
+            if (!RmCodec::Decompress(info.id, (const quint8*) packed[p].constData(), packed[p].size(), (quint8*) out.data(), out.size()))
+                exact = false;
+        }
+
+        double decompSecs = timer.nsecsElapsed() / 1e9;
+
+        // Check the round trip outside the timing
+        for (int p = 0; p < pings.size() && exact; p++)
+        {
+            if (packed[p].constData() == pings[p].constData())
+                continue;
+
+            out.resize(pings[p].size());
+
+            exact = RmCodec::Decompress(info.id, (const quint8*) packed[p].constData(), packed[p].size(), (quint8*) out.data(), out.size()) &&
+                    out == pings[p];
+        }
+
+        // Compress across the pool
+        QAtomicInt next(0);
+        timer.restart();
+
+        for (int t = 0; t < nThreads; t++)
+        {
+            pool.start([&]() {
+                QByteArray result;
+
+                for (int p = next.fetchAndAddRelaxed(1); p < pings.size(); p = next.fetchAndAddRelaxed(1))
+                    RmCodec::Compress(info.id, (const quint8*) pings[p].constData(), pings[p].size(), hasLayout[p] ? &layouts[p] : nullptr, result);
+            });
+        }
+
+        pool.waitForDone();
+
+        double poolSecs = timer.nsecsElapsed() / 1e9;
+
+        qInfo().noquote() << QString("%1 %2 %3 %4 %5%6")
+                             .arg(info.name, -8)
+                             .arg((double) totalBytes / packedBytes, 8, 'f', 2)
+                             .arg(totalBytes / 1e6 / qMax(compSecs, 1e-9), 12, 'f', 1)
+                             .arg(totalBytes / 1e6 / qMax(decompSecs, 1e-9), 12, 'f', 1)
+                             .arg(totalBytes / 1e6 / qMax(poolSecs, 1e-9), 12, 'f', 1)
+                             .arg(exact ? "" : "  ROUND TRIP FAILED");
+
+        if (!exact)
+            return 1;
+    }
+
+    return 0;
+}
+
+// ----------------------------------------------------------------------------
+// Scan each log for its records on all threads, whatever index it has, and
+// save the result as a sidecar. Corrupt regions are listed rather than ending
+// the scan; the exit code is 2 if any were found
+int LogTools::Index(QStringList files, int nThreads)
+{
+    int result = 0;
+
+    for (const QString& file : files)
+    {
+        RmLogIndex    index;
+        QElapsedTimer timer;
+
+        timer.start();
+
+        if (!index.Rebuild(file, nThreads))
+        {
+            qCritical().noquote() << "Cannot read log file '" + file + "'";
+            result = 1;
+            continue;
+        }
+
+        double secs = qMax(timer.nsecsElapsed() / 1e9, 1e-9);
+
+        qInfo().noquote() << file + ":" << index.m_nEntries << "records," << index.CountOfType(rt_oculusSonar) << "sonar,"
+                          << QString::number(index.m_fileSize / 1e6 / secs, 'f', 0) << "MB/s";
+
+        for (const RmIndexGap& gap : index.m_corrupt)
+            qInfo().noquote() << "  corrupt" << gap.size << "bytes at" << gap.offset;
+
+        if (!index.m_corrupt.isEmpty() && result == 0)
+            result = 2;
+
+        if (!index.WriteSidecar(file))
+            qCritical().noquote() << "Unable to write" << RmLogIndex::SidecarName(file);
+    }
+
+    return result;
+}
+
+// ----------------------------------------------------------------------------
+// Repair damaged logs and report what was lost. Without --out or --in-place
+// the repaired log is written next to the original as <log>_repaired.oculus
+int LogTools::Repair(QStringList files, QString out, bool inPlace, int nThreads)
+{
+    int result = 0;
+
+    for (const QString& file : files)
+    {
+        QString outFile = out;
+
+        if (inPlace)
+            outFile.clear();
+        else if (outFile.isEmpty())
+        {
+            QFileInfo info(file);
+            outFile = info.dir().filePath(info.completeBaseName() + "_repaired." + info.suffix());
+        }
+
+        RmRepairReport report;
+
+        if (!RmLogRepair::Repair(file, outFile, report, nThreads))
+        {
+            qCritical().noquote() << "Unable to repair '" + file + "'";
+            result = 1;
+            continue;
+        }
+
+        QString target = outFile.isEmpty() ? file : outFile;
+
+        if (report.closed)
+        {
+            qInfo().noquote() << file + ": closed properly," << report.nRecords << "records, nothing to repair";
+            continue;
+        }
+
+        qInfo().noquote() << file + ":" << report.nRecords << "records recovered," << report.lostBytes << "bytes lost"
+                          << (report.truncated ? "(tail cut, footer added)" : "") << "->" << target;
+
+        for (const RmRepairGap& gap : report.lost)
+        {
+            QString from = gap.timeBefore > 0.0 ? QDateTime::fromMSecsSinceEpoch(gap.timeBefore * 1000.0).toString("hh:mm:ss.zzz") : "start";
+            QString to   = gap.timeAfter  > 0.0 ? QDateTime::fromMSecsSinceEpoch(gap.timeAfter  * 1000.0).toString("hh:mm:ss.zzz") : "end";
+
+            qInfo().noquote() << "  lost" << gap.size << "bytes at" << gap.offset << "between" << from << "and" << to;
+        }
+    }
+
+    return result;
+}
+
+// ----------------------------------------------------------------------------
+// Name for a log written from another, e.g. dive.oculus -> dive_cut.oculus
+static QString DerivedName(QString file, QString tag)
+{
+    QFileInfo info(file);
+
+    return info.dir().filePath(info.completeBaseName() + "_" + tag + "." + info.suffix());
+}
+
+// ----------------------------------------------------------------------------
+// Report a log written by a cut
+static void CutWritten(QString file, const RmCutReport& report, QElapsedTimer& timer)
+{
+    double secs = qMax(timer.nsecsElapsed() / 1e9, 1e-9);
+
+    qInfo().noquote() << file + ":" << report.nRecords << "records," << QString::number(report.outputSize / 1e6, 'f', 1) << "MB in"
+                      << QString::number(secs, 'f', 2) << "s (" + QString::number(report.kernelBytes / 1e6, 'f', 1) + " MB kernel copied)";
+}
+
+// ----------------------------------------------------------------------------
+// Copy the records between two times, in seconds from the log's first record,
+// to a new log. A zero end time means the end of the log
+int LogTools::Cut(QString file, double from, double to, QString out)
+{
+    RmLogIndex index;
+
+    if (!index.Load(file) || index.m_nEntries == 0)
+    {
+        qCritical().noquote() << "Cannot read log file '" + file + "'";
+        return 1;
+    }
+
+    double     start = index.m_pEntries[0].time;
+    RmCutRange range;
+
+    if (!RmLogCut::TimeRange(index, start + from, to > 0.0 ? start + to : index.m_pEntries[index.m_nEntries - 1].time + 1.0, range))
+    {
+        qCritical().noquote() << "No records between" << from << "and" << to << "s";
+        return 1;
+    }
+
+    QString       outFile = out.isEmpty() ? DerivedName(file, "cut") : out;
+    RmCutReport   report;
+    QElapsedTimer timer;
+
+    if (RmLogCut::Overwrites({ range }, outFile))
+    {
+        qCritical().noquote() << "Cannot write the cut over the log being cut";
+        return 1;
+    }
+
+    timer.start();
+
+    if (!RmLogCut::Write({ range }, outFile, report))
+    {
+        qCritical().noquote() << "Unable to write '" + outFile + "'";
+        return 1;
+    }
+
+    CutWritten(outFile, report, timer);
+
+    return 0;
+}
+
+// ----------------------------------------------------------------------------
+// Cut a log into pieces of a fixed length, each a log of its own
+int LogTools::Split(QString file, double every)
+{
+    RmLogIndex index;
+
+    if (every <= 0.0)
+    {
+        qCritical().noquote() << "--every must be more than 0";
+        return 1;
+    }
+
+    if (!index.Load(file) || index.m_nEntries == 0)
+    {
+        qCritical().noquote() << "Cannot read log file '" + file + "'";
+        return 1;
+    }
+
+    double first = index.m_pEntries[0].time;
+    double last  = index.m_pEntries[index.m_nEntries - 1].time;
+    int    piece = 1;
+
+    for (double start = first; start <= last; start += every)
+    {
+        RmCutRange range;
+
+        // Nothing logged in this stretch
+        if (!RmLogCut::TimeRange(index, start, start + every, range))
+            continue;
+
+        QString       outFile = DerivedName(file, QString("%1").arg(piece++, 3, 10, QChar('0')));
+        RmCutReport   report;
+        QElapsedTimer timer;
+
+        timer.start();
+
+        if (!RmLogCut::Write({ range }, outFile, report))
+        {
+            qCritical().noquote() << "Unable to write '" + outFile + "'";
+            return 1;
+        }
+
+        CutWritten(outFile, report, timer);
+    }
+
+    return 0;
+}
+
+// ----------------------------------------------------------------------------
+// Join whole logs into one, in the order their first records were logged
+int LogTools::Merge(QStringList files, QString out)
+{
+    QVector<QPair<double, QString>> starts;
+
+    for (const QString& file : files)
+    {
+        RmLogIndex index;
+
+        if (!index.Load(file) || index.m_nEntries == 0)
+        {
+            qCritical().noquote() << "Cannot read log file '" + file + "'";
+            return 1;
+        }
+
+        starts.append(qMakePair(index.m_pEntries[0].time, file));
+    }
+
+    std::sort(starts.begin(), starts.end());
+
+    QVector<RmCutRange> ranges;
+
+    for (const QPair<double, QString>& start : starts)
+    {
+        RmCutRange range;
+
+        range.file = start.second;
+        range.from = 0;
+        range.to   = QFileInfo(start.second).size();
+
+        ranges.append(range);
+    }
+
+    RmCutReport   report;
+    QElapsedTimer timer;
+
+    if (RmLogCut::Overwrites(ranges, out))
+    {
+        qCritical().noquote() << "--out cannot be one of the logs being merged";
+        return 1;
+    }
+
+    timer.start();
+
+    if (!RmLogCut::Write(ranges, out, report))
+    {
+        qCritical().noquote() << "Unable to write '" + out + "'";
+        return 1;
+    }
+
+    CutWritten(out, report, timer);
+
+    return 0;
+}
+
+// ----------------------------------------------------------------------------
+// Build each log's metadata sidecar. With conditions (column=min:max, either
+// limit may be left out) the pings matching all of them are listed instead,
+// the sidecar only being built where it is missing or out of date
+int LogTools::Meta(QStringList files, QString where, int nThreads)
+{
+    QVector<RmMetaFilter> filters;
+
+    for (const QString& condition : where.split(',', Qt::SkipEmptyParts))
+    {
+        QStringList  parts  = condition.split('=');
+        QStringList  limits = parts.value(1).split(':');
+        int          column = RmLogMeta::FindColumn(parts.value(0).trimmed());
+        RmMetaFilter filter;
+
+        if (parts.size() != 2 || limits.size() != 2 || column < 0)
+        {
+            qCritical().noquote() << "Bad condition '" + condition + "', expected column=min:max";
+            return 1;
+        }
+
+        filter.column = (eMetaColumn) column;
+        filter.min    = limits[0].isEmpty() ? -std::numeric_limits<double>::max() : limits[0].toDouble();
+        filter.max    = limits[1].isEmpty() ?  std::numeric_limits<double>::max() : limits[1].toDouble();
+
+        filters.append(filter);
+    }
+
+    int result = 0;
+
+    for (const QString& file : files)
+    {
+        RmLogMeta     meta;
+        QElapsedTimer timer;
+
+        timer.start();
+
+        bool ok = where.isEmpty() ? (meta.Build(file, nThreads) && meta.Load(file, false)) : meta.Load(file, true, nThreads);
+
+        if (!ok)
+        {
+            qCritical().noquote() << "Cannot read log file '" + file + "'";
+            result = 1;
+            continue;
+        }
+
+        if (where.isEmpty())
+        {
+            qInfo().noquote() << file + ":" << meta.Count() << "pings in" << RmLogMeta::SidecarName(file)
+                              << "(" + QString::number(timer.nsecsElapsed() / 1e9, 'f', 2) + " s)";
+            continue;
+        }
+
+        timer.restart();
+
+        QVector<int> rows = meta.Select(filters);
+        double       ms   = timer.nsecsElapsed() / 1e6;
+
+        qInfo().noquote() << file + ":" << rows.size() << "of" << meta.Count() << "pings match (" + QString::number(ms, 'f', 2) + " ms)";
+
+        for (int row : rows)
+        {
+            QString time = QDateTime::fromMSecsSinceEpoch(meta.Value(metaTime, row) * 1000.0).toString("hh:mm:ss.zzz");
+
+            qInfo().noquote() << " " << time << "ping" << (quint32) meta.Value(metaPingId, row) << "at" << (quint64) meta.Value(metaOffset, row)
+                              << "range" << meta.Value(metaRange, row) << "gain" << meta.Value(metaGain, row);
+        }
+    }
+
+    return result;
+}
+
+// ----------------------------------------------------------------------------
+// Export the pings of the logs as a training set, reporting progress as it
+// goes and the throughput at the end
+int LogTools::Dataset(QStringList files, QString out, int stride, bool labels, int nThreads)
+{
+    DatasetExporter exporter;
+    QElapsedTimer   timer;
+
+    exporter.m_outDir   = out;
+    exporter.m_every    = stride;
+    exporter.m_labels   = labels;
+    exporter.m_nThreads = nThreads;
+
+    timer.start();
+
+    if (!exporter.Run(files))
+    {
+        qCritical().noquote() << exporter.m_error;
+        return 1;
+    }
+
+    double  secs  = timer.nsecsElapsed() / 1e9;
+    quint64 pings = exporter.m_nPings.loadAcquire();
+
+    qInfo().noquote() << pings << "images," << exporter.m_nObjects.loadAcquire() << "labelled objects in" << out
+                      << "(" + QString::number(secs, 'f', 2) + " s, " + QString::number(pings / qMax(secs, 1e-3), 'f', 1) + " pings/s)";
+
+    return 0;
+}
+
+// ----------------------------------------------------------------------------
+// Scan the logs for their health figures, list them and write them as JSON
+// and / or CSV
+int LogTools::Stats(QStringList files, QString json, QString csv, int nThreads)
+{
+    QElapsedTimer timer;
+    timer.start();
+
+    QVector<RmLogHealth> logs   = RmLogStats::ScanAll(files, nThreads);
+    double               secs   = timer.nsecsElapsed() / 1e9;
+    quint64              bytes  = 0;
+    int                  result = 0;
+
+    for (const RmLogHealth& health : logs)
+    {
+        if (!health.ok)
+        {
+            qCritical().noquote() << "Cannot read log file '" + health.file + "'";
+            result = 1;
+            continue;
+        }
+
+        bytes += health.size;
+
+        qInfo().noquote() << health.file + ":" << health.nPings << "pings at" << QString::number(health.pingRate, 'f', 1) + " Hz,"
+                          << health.nGaps << "gaps," << health.nOutOfOrder << "out of order," << health.nMissing << "missing ids,"
+                          << health.nResyncs << "resyncs," << health.nCorrupt << "corrupt regions, ratio"
+                          << QString::number(health.payloadBytes ? (double) health.originalBytes / health.payloadBytes : 1.0, 'f', 2);
+    }
+
+    qInfo().noquote() << logs.size() << "logs," << QString::number(bytes / 1e6, 'f', 1) + " MB in" << QString::number(secs, 'f', 2)
+                      << "s (" + QString::number(bytes / 1e6 / qMax(secs, 1e-3), 'f', 0) + " MB/s)";
+
+    if (!json.isEmpty() && !RmLogStats::WriteJson(logs, json))
+    {
+        qCritical().noquote() << "Unable to write '" + json + "'";
+        result = 1;
+    }
+
+    if (!csv.isEmpty() && !RmLogStats::WriteCsv(logs, csv))
+    {
+        qCritical().noquote() << "Unable to write '" + csv + "'";
+        result = 1;
+    }
+
+    return result;
+}
+
+// ----------------------------------------------------------------------------
+// Check the records of each log against their checksums, listing the ones
+// that fail. Logs written before the checksums only have their structure
+// checked
+int LogTools::Verify(QStringList files, int nThreads)
+{
+    QElapsedTimer timer;
+    quint64       bytes  = 0;
+    int           result = 0;
+
+    timer.start();
+
+    qInfo().noquote() << "CRC-32C:" << RmCrc32c::Engine();
+
+    for (const QString& file : files)
+    {
+        RmVerifyReport report;
+
+        if (!RmLogVerify::Verify(file, report, nThreads))
+        {
+            qCritical().noquote() << "Cannot read log file '" + file + "'";
+            result = 1;
+            continue;
+        }
+
+        bytes += report.bytes;
+
+        QString checked = report.checksums ? QString::number(report.bytes / 1e6 / qMax(report.seconds, 1e-3), 'f', 0) + " MB/s"
+                                           : "version " + QString::number(report.version) + ", no checksums";
+
+        qInfo().noquote() << file + ":" << report.nRecords << "records," << report.bad.size() << "bad,"
+                          << report.corrupt.size() << "corrupt regions (" + checked + ")";
+
+        for (const RmVerifyError& error : report.bad)
+        {
+            QString time = QDateTime::fromMSecsSinceEpoch(error.time * 1000.0).toString("hh:mm:ss.zzz");
+
+            qInfo().noquote() << "  record at" << error.offset << time << "type" << error.type
+                              << QString("crc %1, expected %2").arg(error.computed, 8, 16, QChar('0')).arg(error.stored, 8, 16, QChar('0'));
+        }
+
+        for (const RmIndexGap& gap : report.corrupt)
+            qInfo().noquote() << "  unreadable from" << gap.offset << "for" << gap.size << "bytes";
+
+        if (!report.bad.isEmpty() || !report.corrupt.isEmpty())
+            result = 1;
+    }
+
+    double secs = timer.nsecsElapsed() / 1e9;
+
+    qInfo().noquote() << files.size() << "logs," << QString::number(bytes / 1e6, 'f', 1) + " MB checked in" << QString::number(secs, 'f', 2)
+                      << "s (" + QString::number(bytes / 1e6 / qMax(secs, 1e-3), 'f', 0) + " MB/s)";
+
+    return result;
+}
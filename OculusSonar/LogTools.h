@@ -0,0 +1,58 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#pragma once
+
+#include <QString>
+#include <QStringList>
+
+// ----------------------------------------------------------------------------
+// LogTools - command line utilities for .oculus logs. Like the exporter these
+// run without the main window, each is picked by its command option
+//
+//   --codec-bench <log>   ratio and speed of the log codecs on real pings
+//   --index <logs>        rebuild the record index, report corrupt regions
+//   --repair <logs>       recover the intact records of damaged logs
+//   --cut <log>           copy the records between two times to a new log
+//   --split <log>         cut a log into pieces of a fixed length
+//   --merge <logs>        join logs into one, in time order
+//   --meta <logs>         build the ping metadata sidecars, query them
+//   --dataset <logs|dirs> export the pings as images and labels for training
+//   --stats <logs|dirs>   health figures of each log, as JSON and / or CSV
+//   --verify <logs|dirs>  check every record against its checksum
+
+class LogTools
+{
+public:
+    // Command line entry point
+    static bool IsToolCommand(int argc, char* argv[]);
+    static int  Main(int argc, char* argv[]);
+
+    // Commands
+    static int CodecBench(QStringList files, QString codec, int maxPings, int nThreads);
+    static int Index(QStringList files, int nThreads);
+    static int Repair(QStringList files, QString out, bool inPlace, int nThreads);
+    static int Cut(QString file, double from, double to, QString out);
+    static int Split(QString file, double every);
+    static int Merge(QStringList files, QString out);
+    static int Meta(QStringList files, QString where, int nThreads);
+    static int Dataset(QStringList files, QString out, int stride, bool labels, int nThreads);
+    static int Stats(QStringList files, QString json, QString csv, int nThreads);
+    static int Verify(QStringList files, int nThreads);
+};
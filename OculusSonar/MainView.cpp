@@ -10,6 +10,7 @@
 #include <QDir>
 #include <QApplication>
 #include <QStatusBar>
+#include <QtMath>
 #if QT_VERSION < QT_VERSION_CHECK(6, 0, 0)
 #include <QtWinExtras/qwinfunctions.h>
 #else
@@ -19,11 +20,16 @@
 
 #include <QKeyEvent>
 #include <QMessageBox>
+#include <QFileDialog>
 
 #include "MainView.h"
 #include "../Displays/SonarSurface.h"
+#include "../Displays/WaterfallSurface.h"
+#include "SonarYolo.h"
 #include "ConnectForm.h"
 #include "ModeCtrls.h"
+#include "../RmUtil/RmLogCut.h"
+#include "DatasetExporter.h"
 
 double MainView::NAVIGATION_RANGES[] = { 1, 2, 5, 7.5, 10, 20, 30, 40, 50, 75, 100, 120, 140, 160, 180, 200 };
 double MainView::INSPECTION_RANGES[] = { 0.3, 0.5, 1, 2, 3, 4, 5, 7.5, 10, 20, 40 };
@@ -45,9 +51,20 @@ MainView::MainView(QWidget *parent) :
     m_connectForm(this),
     m_deviceForm(this),
     m_fanDisplay(this),
+    m_waterfallDisplay(this),
+    m_showWaterfall(false),
+    m_sonarColourMap(false),
+    m_snapshotPalIndex(-1),
+    m_burstLeft(0),
+    m_burstIndex(0),
+    m_snapshotBurst(10),
+    m_recordFormat(recAvi),
+    m_recordQuality(85),
+    m_recordGrabDropped(0),
     m_info(this),
     m_reconnect(false),
     m_timeout(false),
+    m_multiReplay(this),
     m_hexViewer(nullptr),
     m_hexContainer(nullptr),
     m_showHexViewer(false),
@@ -61,11 +78,16 @@ MainView::MainView(QWidget *parent) :
     counter = 0;
     statusBar()->setSizeGripEnabled(true);
 
-    m_playSpeed = 1;
+    m_playSpeed = 1.0;
+    m_playDirection = 1;
+    m_playOrigin = 0.0;
+    m_nPlayShown = 0;
+    m_nPlayDropped = 0;
 
     m_partNumber = partNumberUndefined;
 
     m_indexLower = 0;
+    m_indexUpper = 0;
 
     // Default settings mode
     m_displayMode = offline;
@@ -82,6 +104,25 @@ MainView::MainView(QWidget *parent) :
     m_pSonarSurface->m_clearColour.setRgb(81, 81, 81);
     m_fanDisplay.RmglSetupSurface(m_pSonarSurface);
 
+    // Snapshots are read back asynchronously and written by the snapshot workers
+    connect(&m_fanDisplay.m_grabber, &RmGlGrabber::FrameReady, this, &MainView::OnFrameCaptured);
+    connect(&m_fanDisplay.m_grabber, &RmGlGrabber::FrameDropped, this, &MainView::OnFrameDropped);
+    connect(&m_snapshots, &SnapshotWriter::Failed, this, &MainView::SnapshotFailed);
+
+    // The screen recorder takes every frame read back while it is running
+    connect(&m_fanDisplay.m_grabber, &RmGlGrabber::FrameReady, &m_recorder, &ScreenRecorder::AddFrame);
+    connect(&m_recorder, &ScreenRecorder::Failed, this, &MainView::ScreenRecordFailed);
+
+    // CPU palette for the sonar colour map (drawn through the RGB image path)
+    m_sonarPalette.LoadFromFunction(RmPalette::SonarColourMap);
+
+    // Time history of the fan, shown under it on demand
+    m_waterfallDisplay.lower();
+    m_pWaterfallSurface = new WaterfallSurface;
+    m_waterfallDisplay.RmglSetupSurface(m_pWaterfallSurface);
+    m_waterfallDisplay.m_version.setVisible(false);
+    m_waterfallDisplay.setVisible(false);
+
     // Diagnostic info label
     //m_modeCtrls.setInfo("hhhiuhiufegfiqgfeq");
     m_info.setText("hhhiuhiufegfiqgfeq");
@@ -95,8 +136,8 @@ MainView::MainView(QWidget *parent) :
 
     // Replay index initialisation
     m_nEntries = 0;
-    m_pEntries = nullptr;
     m_useRawSonar = false;
+    m_joinSegments = true;
 
     m_nViewInfoEntries = 0;
     m_pViewInfoEntries = nullptr;
@@ -106,6 +147,7 @@ MainView::MainView(QWidget *parent) :
 
     // Set the default playback speed
     m_replay.setInterval(100); // 10Hz ?
+    m_replay.setTimerType(Qt::PreciseTimer);
 
     m_measureMode = false;
 
@@ -145,16 +187,19 @@ MainView::MainView(QWidget *parent) :
     // Connect updated log directory to the logger
     connect(&m_settings.m_settingsCtrls, &SettingsCtrls::NewLogDirectory, &m_logger, &RmLogger::SetLogDirectory);
     connect(&m_settings.m_settingsCtrls, &SettingsCtrls::MaxLogSize, &m_logger, &RmLogger::SetMaxLogSize);
+    connect(&m_logger, &RmLogger::LogFailed, this, &MainView::LogFailed);
 
     connect(&m_settings.m_appCtrls, &AppCtrls::StyleChanged, this, &MainView::StyleChanged);
 
     // Link the player output to the payload slot
     connect(&m_player, &RmPlayer::NewPayload, this, &MainView::OnNewPayload);
+    connect(&m_session, &RmLogSession::NewPayload, this, &MainView::OnNewPayload);
 
     // Link the review slider with the show entry
     connect(&m_reviewCtrls, &ReviewCtrls::EntryChanged, this, &MainView::ReviewEntryChanged);
     connect(&m_reviewCtrls, &ReviewCtrls::LowerEntryChanged, this, &MainView::ReviewLowerEntryChanged);
     connect(&m_reviewCtrls, &ReviewCtrls::UpperEntryChanged, this, &MainView::ReviewUpperEntryChanged);
+    connect(&m_reviewCtrls, &ReviewCtrls::JumpToTime, this, &MainView::ReviewJumpToTime);
     connect(&m_reviewCtrls, &ReviewCtrls::OnPlay, this, &MainView::StartReplay);
     connect(&m_reviewCtrls, &ReviewCtrls::OnStop, this, &MainView::StopReplay);
 
@@ -234,12 +279,10 @@ MainView::~MainView()
         m_yoloDetector = nullptr;
     }
 
-    // If there is an entry table then clena up
-    if (m_pEntries)
-    {
-        delete m_pEntries;
-        m_nEntries = 0;
-    }
+    m_multiReplay.Clear();
+    m_frameCache.Close();
+    m_session.Close();
+    m_nEntries = 0;
 
     if (m_pViewInfoEntries) {
         delete m_pViewInfoEntries;
@@ -273,6 +316,18 @@ void MainView::keyPressEvent(QKeyEvent* event) {
     else if (key == 'X') {
         ToggleHexViewer();
     }
+    else if (key == 'E') {
+        ToggleWaterfall();
+    }
+    else if (key == 'B') {
+        CycleWaterfallSource();
+    }
+    else if (key == 'F') {
+        CycleTemporalFilter();
+    }
+    else if (key == 'K') {
+        SetSonarColourMap(!m_sonarColourMap);
+    }
     else if ((key >= '1') && (key <= '6')) {
         int index = key - (int)('1');
         // Change the palette
@@ -306,7 +361,10 @@ void MainView::keyPressEvent(QKeyEvent* event) {
 
     if ((m_displayMode == online) || (m_displayMode == review)) {
         if (key == 'P') {
-            m_toolsCtrls.on_snapshot_clicked();
+            if (event->modifiers() & Qt::ShiftModifier)
+                SnapshotBurst(m_snapshotBurst);
+            else
+                m_toolsCtrls.on_snapshot_clicked();
         }
         else if (key == 'H') {
             m_toolsCtrls.ToggleFlipHoriz();
@@ -320,11 +378,25 @@ void MainView::keyPressEvent(QKeyEvent* event) {
         else if (key == 'G') {
             m_pSonarSurface->ToggleGridLines();
         }
+        else if (key == 'Y') {
+            if (m_recorder.IsRecording())
+                StopScreenRecord();
+            else
+                StartScreenRecord();
+        }
     }
 
     if (m_displayMode == review) {
         if (key == ' ') {
         }
+        else if (key == 'L') {
+            if (event->modifiers() & Qt::ShiftModifier) {
+                m_multiReplay.Clear();
+                resizeEvent(nullptr);
+            }
+            else
+                AddReplayHead();
+        }
     }
 }
 
@@ -408,6 +480,19 @@ void MainView::SetDisplayMode(eDisplayMode displayMode)
     if (displayMode == review)
     {
         m_reviewCtrls.SetNEntries(m_nEntries);
+        m_indexLower = 0;
+        m_indexUpper = m_nEntries - 1;
+        m_reviewCtrls.SetTimeRange(QDateTime::fromMSecsSinceEpoch((quint64)(m_session.SyncTime(0) * 1000.0)),
+                                   QDateTime::fromMSecsSinceEpoch((quint64)(m_session.SyncTime(m_nEntries - 1) * 1000.0)));
+
+        // Decoded frames of the new log are cached for scrubbing and reverse play
+        if (m_useRawSonar)
+            m_frameCache.Close();
+        else
+            m_frameCache.Open(m_session.Entries(), m_session.Files());
+
+        // Logs played alongside are timed against this one
+        m_multiReplay.SetMain(m_session.Entries());
     }
     else {
         if (displayMode == offline) {
@@ -447,6 +532,36 @@ void MainView::ReadSettings()
         m_hexContainer->setVisible(m_showHexViewer);
     }
 
+    m_showWaterfall = settings.value("ShowWaterfall", false).toBool();
+    m_pWaterfallSurface->m_palIndex = m_pSonarSurface->m_palIndex;
+    m_pWaterfallSurface->SetSource((eWaterfallSource) settings.value("WaterfallSource", wfSectorMax).toInt(),
+                                   settings.value("WaterfallLeft", -180.0).toFloat(),
+                                   settings.value("WaterfallRight", 180.0).toFloat());
+    m_waterfallDisplay.setVisible(m_showWaterfall);
+
+    m_temporalFilter.m_decay     = qBound(1, settings.value("TemporalDecay", 64).toInt(), 256);
+    m_temporalFilter.m_nFrames   = qBound(1, settings.value("TemporalFrames", 4).toInt(), TF_MAX_FRAMES);
+    m_temporalFilter.m_holdDecay = qBound(0, settings.value("TemporalHoldDecay", 4).toInt(), 255);
+    m_temporalFilter.SetMode((eTemporalMode) settings.value("TemporalMode", tfOff).toInt());
+
+    SetSonarColourMap(settings.value("SonarColourMap", false).toBool());
+
+    m_snapshotBurst = qBound(1, settings.value("SnapshotBurst", 10).toInt(), 1000);
+
+    m_logger.m_writer.m_preallocate = (quint64) qBound(0, settings.value("LogPreallocateMB", 64).toInt(), 1024) * 1024 * 1024;
+    m_logger.m_writer.m_syncMs      = qBound(100, settings.value("LogSyncMs", 1000).toInt(), 60000);
+
+    const RmCodecInfo* pCodec = RmCodec::Find(settings.value("LogCompression", "none").toString());
+    m_logger.m_codec = pCodec ? pCodec->id : (quint16) codecNone;
+
+    QString recordFormat = settings.value("RecordFormat", "avi").toString().toLower();
+    m_recordFormat  = (recordFormat == "png") ? recPng : (recordFormat == "qoi") ? recQoi : recAvi;
+    m_recordQuality = qBound(1, settings.value("RecordQuality", 85).toInt(), 100);
+
+    m_joinSegments = settings.value("ReplayJoinSegments", true).toBool();
+    m_cacheMb = settings.value("ReplayCacheMB", FRAME_CACHE_MB).toInt();
+    m_frameCache.SetBudget(m_cacheMb);
+
     m_onlineCtrls.ReadSettings();
     m_settings.ReadSettings();
     m_toolsCtrls.ReadSettings();
@@ -475,6 +590,26 @@ void MainView::WriteSettings()
     settings.setValue("ShowHexViewer", m_showHexViewer);
     settings.setValue("MaxHexBytes", m_maxHexBytes);
 
+    settings.setValue("ShowWaterfall", m_showWaterfall);
+    settings.setValue("WaterfallSource", (int) m_pWaterfallSurface->m_source);
+    settings.setValue("WaterfallLeft", m_pWaterfallSurface->m_left);
+    settings.setValue("WaterfallRight", m_pWaterfallSurface->m_right);
+
+    settings.setValue("TemporalMode", (int) m_temporalFilter.m_mode);
+    settings.setValue("TemporalDecay", m_temporalFilter.m_decay);
+    settings.setValue("TemporalFrames", m_temporalFilter.m_nFrames);
+    settings.setValue("TemporalHoldDecay", m_temporalFilter.m_holdDecay);
+    settings.setValue("SonarColourMap", m_sonarColourMap);
+    settings.setValue("SnapshotBurst", m_snapshotBurst);
+    settings.setValue("LogPreallocateMB", (int) (m_logger.m_writer.m_preallocate / (1024 * 1024)));
+    settings.setValue("LogSyncMs", m_logger.m_writer.m_syncMs);
+    const RmCodecInfo* pCodec = RmCodec::Find(m_logger.m_codec);
+    settings.setValue("LogCompression", pCodec ? pCodec->name : "none");
+    settings.setValue("RecordFormat", m_recordFormat == recPng ? "png" : m_recordFormat == recQoi ? "qoi" : "avi");
+    settings.setValue("RecordQuality", m_recordQuality);
+    settings.setValue("ReplayJoinSegments", m_joinSegments);
+    settings.setValue("ReplayCacheMB", m_cacheMb);
+
     m_onlineCtrls.WriteSettings();
     m_settings.WriteSettings();
     m_toolsCtrls.WriteSettings();
@@ -486,25 +621,194 @@ void MainView::StartReplay()
 {
     int entry = m_reviewCtrls.GetEntry();
 
-    if (entry == (m_nEntries - 2)) {
+    // From the other end when already at the end
+    if (m_playDirection > 0 && entry == (m_nEntries - 2)) {
         entry = 0;
     }
+    else if (m_playDirection < 0 && entry == 0) {
+        entry = m_nEntries - 2;
+    }
 
-    if (m_pEntries && entry < m_nEntries)
+    if (entry < m_nEntries)
     {
-        m_index = entry;
-        m_player.OpenFileAt(m_replayFile, m_pEntries[m_index]);
-        m_replay.start();
+        StartPlayClock(entry);
+
+        m_replay.start(0);
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Start the playback clock at an entry. PlayNext shows the entries after it
+// (before it in reverse)
+void MainView::StartPlayClock(int entry)
+{
+    m_index      = entry;
+    m_playOrigin = m_session.SyncTime(entry);
+    m_playClock.start();
+
+    m_playRateClock.start();
+    m_nPlayShown   = 0;
+    m_nPlayDropped = 0;
+
+    // Sonar records are read and decoded ahead on the engine's threads when
+    // playing forward. Raw sonar records come in pairs and are still read by
+    // PlayNext, as is reverse play (from the frame cache)
+    if (!m_useRawSonar && m_playDirection > 0)
+        m_replayEngine.Start(m_session.Entries(), m_session.Files(), entry + 1);
+    else
+        m_replayEngine.Stop();
+
+    m_frameCache.SetPlayhead(entry, m_playDirection, !m_replayEngine.IsRunning());
+
+    m_multiReplay.Start(m_playOrigin, m_playDirection);
+}
+
+// ----------------------------------------------------------------------------
+// Where in the log the playback clock has got to
+double MainView::PlayClockTime()
+{
+    return m_playOrigin + m_playDirection * m_playClock.nsecsElapsed() * 1e-9 * m_playSpeed;
+}
+
+// ----------------------------------------------------------------------------
+// Change the play speed, carrying on from the current point in the log
+void MainView::SetPlaySpeed(double speed)
+{
+    if (m_replay.isActive()) {
+        m_playOrigin = PlayClockTime();
+        m_playClock.restart();
+    }
+
+    m_playSpeed = speed;
+}
+
+// ----------------------------------------------------------------------------
+// Play forwards (1) or backwards (-1), carrying on from the frame on display
+void MainView::SetPlayDirection(int direction)
+{
+    if (direction == m_playDirection)
+        return;
+
+    m_playDirection = direction;
+
+    if (m_replay.isActive())
+        StartPlayClock(m_index);
+    else
+        m_frameCache.SetPlayhead(m_index, m_playDirection, true);
+}
+
+// ----------------------------------------------------------------------------
+// Show a frame, from the frame cache if it is there and from the file if not
+void MainView::ShowEntry(int entry, ePlayAccess access)
+{
+    double time;
+
+    if (!m_useRawSonar && m_frameCache.Fetch(entry, m_entry, &time)) {
+        m_payloadDateTime = QDateTime::fromMSecsSinceEpoch((quint64)(time * 1000.0));
+        m_reviewCtrls.SetPlaybackTime(m_payloadDateTime);
+
+        NewReturnFire(&m_entry);
+        return;
+    }
+
+    m_session.ReadEntry(entry, access);
+
+    // Raw sonar records are in pairs
+    if (m_useRawSonar)
+        m_session.ReadNextItem();
+}
+
+// ----------------------------------------------------------------------------
+// Open a further log (e.g. from another sonar head) to play in step with the
+// one being reviewed, in a display of its own next to the fan
+void MainView::AddReplayHead()
+{
+    QString logFile = QFileDialog::getOpenFileName(&m_fanDisplay, tr("Select log file to play alongside"), QFileInfo(m_replayFile).absolutePath(), "Oculus Log Files (*.oculus);; Oculus Log Files (*.log)");
+
+    if (logFile.isEmpty())
+        return;
+
+    bool playing = m_replay.isActive();
+
+    if (playing)
+        StopReplay();
+
+    if (m_multiReplay.AddLog(logFile))
+        m_multiReplay.ShowTime(m_session.SyncTime(m_index));
+    else
+        statusBar()->showMessage("No Oculus entries in " + logFile, 5000);
+
+    resizeEvent(nullptr);
+
+    if (playing)
+        StartReplay();
+}
+
+// ----------------------------------------------------------------------------
+// Save the records between the review range markers as a new log. Everything
+// logged in between is kept, the records are copied without being decoded
+void MainView::ShowLogEditor()
+{
+    if (m_displayMode != review || !m_session.IsOpen() || m_nEntries == 0)
+        return;
+
+    int lower = qBound(0, m_indexLower, m_nEntries - 1);
+    int upper = qBound(lower, m_indexUpper, m_nEntries - 1);
+
+    QVector<RmSessionEntry> entries = m_session.Entries();
+    QStringList             files   = m_session.Files();
+
+    const RmSessionEntry& first = entries.at(lower);
+    const RmSessionEntry& last  = entries.at(upper);
+
+    // A range for each file of the session the markers span
+    QVector<RmCutRange> ranges;
+
+    for (int segment = first.segment; segment <= last.segment; segment++) {
+        RmCutRange range;
+
+        range.file = files.at(segment);
+        range.from = (segment == first.segment) ? first.offset : 0;
+        range.to   = (segment == last.segment) ? last.offset + 1 : QFileInfo(range.file).size();
+
+        ranges.append(range);
+    }
+
+    QFileInfo info(m_replayFile);
+    QString   suggested = info.dir().filePath(info.completeBaseName() + "_cut." + info.suffix());
+    QString   outFile   = QFileDialog::getSaveFileName(&m_fanDisplay, tr("Save the marked records as"), suggested, "Oculus Log Files (*.oculus)");
 
+    if (outFile.isEmpty())
+        return;
+
+    foreach (QString file, files) {
+        if (QFileInfo(file).absoluteFilePath() == QFileInfo(outFile).absoluteFilePath()) {
+            statusBar()->showMessage("Cannot write the cut over the log being cut", 5000);
+            return;
+        }
     }
+
+    QElapsedTimer timer;
+    RmCutReport   report;
+
+    timer.start();
+
+    if (!RmLogCut::Write(ranges, outFile, report)) {
+        statusBar()->showMessage("Unable to write " + outFile, 5000);
+        return;
+    }
+
+    statusBar()->showMessage(QString::number(report.nRecords) + " records (" + QString::number(report.outputSize / 1e6, 'f', 1) +
+                             " MB) written to " + outFile + " in " + QString::number(timer.elapsed() / 1000.0, 'f', 1) + " s", 10000);
 }
 
 // ----------------------------------------------------------------------------
-// (SLOT) Close the current replay
+// (SLOT) Stop the current replay. The files stay mapped for scrubbing
 void MainView::StopReplay()
 {
     m_replay.stop();
-    m_player.CloseFile();
+    m_replayEngine.Stop();
+    m_multiReplay.Stop();
     m_reviewCtrls.SetStop();
     counter = 0;
 }
@@ -735,7 +1039,8 @@ void MainView::NewReturnFire(OsBufferEntry* pEntry)
         int height = 0;
         double range = 0;
         uint16_t ver = 0;
-        if (m_showHexViewer && m_hexViewer) {
+        // A frame from the frame cache has no raw record to show or log
+        if (m_showHexViewer && m_hexViewer && pEntry->m_rawSize) {
             QString hexData = FormatHexData(pEntry);
             m_hexViewer->append(hexData);
             QTextCursor cursor = m_hexViewer->textCursor();
@@ -764,9 +1069,13 @@ void MainView::NewReturnFire(OsBufferEntry* pEntry)
             ver = pEntry->m_rff.head.msgVersion;
         }
 
+        // Persistence filter, ahead of the display and the detector
+        m_temporalFilter.Process(pEntry);
+
         // Sonar display güncelle
         m_pSonarSurface->UpdateFan(range, width, pEntry->m_pBrgs, true);
         m_pSonarSurface->UpdateImg(height, width, pEntry->m_pImage);
+        m_pWaterfallSurface->AddPing(range, height, width, pEntry->m_pBrgs, pEntry->m_pImage);
 
         // Dataset oluşturma (Generate Dataset checkbox ile kontrol)
         if (m_generateDatasetCheckbox && m_generateDatasetCheckbox->isChecked())
@@ -777,95 +1086,40 @@ void MainView::NewReturnFire(OsBufferEntry* pEntry)
         // YOLO OBJECT DETECTION
         if (m_yoloEnabled && m_yoloDetector && pEntry->m_pImage && width > 0 && height > 0) {
             try {
+                // An empty list clears the previous detections
+                QList<SonarSurface::DetectedObject> detections;
+                SonarYoloDetect(m_yoloDetector, width, height, pEntry->m_pImage, pEntry->m_pBrgs, range, detections);
+                m_pSonarSurface->SetDetections(detections);
 
-                // 1. Ham sonar görüntüsünü oluştur
-                cv::Mat sonarImage(height, width, CV_8UC1, pEntry->m_pImage);
-
-                // 2. Transpose + Flip
-                cv::Mat transformedImg;
-                cv::transpose(sonarImage, transformedImg);
-                cv::flip(transformedImg, transformedImg, 1);
-
-                // 3. 640x640 resize
-                cv::Mat resizedImg;
-                cv::resize(transformedImg, resizedImg, cv::Size(640, 640), 0, 0, cv::INTER_LINEAR);
-
-                cv::Mat rgbImg;
-                cv::cvtColor(resizedImg, rgbImg, cv::COLOR_GRAY2RGB);
-
-                cv::Mat rotatedImg;
-                cv::rotate(rgbImg, rotatedImg, cv::ROTATE_90_CLOCKWISE);
-
-                // 4. YOLO inference
-                std::vector<DL_RESULT> results;
-                m_yoloDetector->RunSession(rotatedImg, results);
-
-                if (!results.empty()) {
-                    std::sort(results.begin(), results.end(),
-                              [](const DL_RESULT& a, const DL_RESULT& b) {
-                                  return a.confidence > b.confidence;
-                              });
-
-                    int maxDetections = 10;
-                    int numToShow = std::min((int)results.size(), maxDetections);
-
-                    QList<SonarSurface::DetectedObject> detections;
-
-                    for (int i = 0; i < numToShow; i++) {
-                        const auto& det = results[i];
-
-                        // YOLO rotated image'de detection yaptı (640x640)
-                        // X ekseni = bearing (soldan sağa)
-                        // Y ekseni = range (yukarıdan aşağı, 0=yakın, 640=uzak)
-
-                        float yolo_centerX = det.box.x + det.box.width / 2.0f;
-                        float yolo_centerY = det.box.y + det.box.height / 2.0f;
-
-                        // X → Bearing index
-                        float normalized_x = (640.0f - yolo_centerX) / 640.0f;
-                        int bearingIndex = (int)(normalized_x * width);
-                        bearingIndex = std::max(0, std::min(bearingIndex, width - 1));
-
-                        float bearingRad = 0.0f;
-                        if (pEntry->m_pBrgs) {
-                            bearingRad = pEntry->m_pBrgs[bearingIndex] * 0.01f * M_PI / 180.0f;
-                        }
-
-                        // Y → Distance (mesafe)
-                        float distance = ((640.0f - yolo_centerY) / 640.0f) * range;
-
-                        // Polar to Cartesian
-                        float x = distance * sin(bearingRad);
-                        float y = distance * cos(bearingRad);
+            } catch (const std::exception& e) {
+                qDebug() << "*** YOLO ERROR:" << e.what() << "***";
+                m_yoloEnabled = false;
+            }
+        }
 
-                        float objectWidthMeters = (det.box.width / 640.0f) * range * 0.2f;
-                        float objectHeightMeters = (det.box.height / 640.0f) * range * 0.15f;
+        if (pEntry->m_rawSize) {
+            if (m_logger.m_codec != codecNone) {
+                RmCodecLayout layout;
 
+                bool image = OsBufferEntry::CodecLayout(pEntry->m_pRaw, pEntry->m_rawSize, layout);
 
-                        SonarSurface::DetectedObject obj;
-                        obj.meterPos = QPointF(x, y);
-                        obj.meterWidth = objectWidthMeters;
-                        obj.meterHeight = objectHeightMeters;
-                        obj.confidence = det.confidence;
+                m_logger.LogData(rt_oculusSonar, ver, true, pEntry->m_rawSize, pEntry->m_pRaw, image ? &layout : nullptr);
+            }
+            else
+                m_logger.LogData(rt_oculusSonar, ver, false, pEntry->m_rawSize, pEntry->m_pRaw);
+        }
+        if (m_logger.LogIsActive()) {
+            QString info = "Logging To: '" + m_logger.m_fileName + "' Size: " + QString::number((double)m_logger.m_loggedSize / (1024 * 1024), 'f', 1);
 
-                        detections.append(obj);
-                    }
+            // Only worth showing when the disk is falling behind
+            quint64 behind  = m_logger.BytesBehind();
+            quint32 dropped = m_logger.DroppedRecords();
 
-                    m_pSonarSurface->SetDetections(detections);
-                } else {
-                    // Detection bulunamadı, eski detection'ları temizle
-                    QList<SonarSurface::DetectedObject> emptyList;
-                    m_pSonarSurface->SetDetections(emptyList);
-                }
+            if (behind > 4 * 1024 * 1024 || dropped > 0)
+                info += " Behind: " + QString::number((double)behind / (1024 * 1024), 'f', 1) + "MB Dropped: " + QString::number(dropped);
 
-            } catch (const std::exception& e) {
-                qDebug() << "*** YOLO ERROR:" << e.what() << "***";
-                m_yoloEnabled = false;
-            }
+            m_info.setText(info);
         }
-
-        m_logger.LogData(rt_oculusSonar, ver, false, pEntry->m_rawSize, pEntry->m_pRaw);
-        m_info.setText("Logging To: '" + m_logger.m_fileName + "' Size: " + QString::number((double)m_logger.m_loggedSize / (1024 * 1024), 'f', 1));
         if (m_displayMode == review) {
             m_infoCtrls.HideInfo();
         }
@@ -873,7 +1127,20 @@ void MainView::NewReturnFire(OsBufferEntry* pEntry)
     pEntry->m_mutex.unlock();
 
     FireSonar();
-    m_fanDisplay.update();
+
+    // A burst draws (and reads back) every ping rather than letting paints merge
+    if (m_burstLeft > 0)
+    {
+        CaptureSnapshot(m_burstBase + QString("_%1").arg(m_burstIndex++, 4, 10, QChar('0')));
+        m_fanDisplay.repaint();
+        m_burstLeft--;
+    }
+    else
+        m_fanDisplay.update();
+
+    if (m_showWaterfall)
+        m_waterfallDisplay.update();
+
     if (m_logger.LogIsActive()) {
         UpdateLogFileName();
     }
@@ -882,40 +1149,7 @@ void MainView::NewReturnFire(OsBufferEntry* pEntry)
 // Helper function to apply sonar color mapping
 QColor MainView::applySonarColorMap(float intensity)
 {
-    // Clamp intensity to 0-1 range
-    intensity = qBound(0.0f, intensity, 1.0f);
-
-    int red, green, blue;
-
-    if (intensity < 0.15f) {
-        // Reduced blue range - darker blue for low intensity (deep water/no return)
-        red = 0;
-        green = static_cast<int>(intensity * 6.67f * 80); // 0 to 80 (reduced green component)
-        blue = static_cast<int>(150 + intensity * 6.67f * 105); // 150 to 255 (less intense blue)
-    }
-    else if (intensity < 0.35f) {
-        // Shorter blue to cyan transition
-        float t = (intensity - 0.15f) * 5; // 0 to 1
-        red = static_cast<int>(t * 100); // Start adding red earlier
-        green = static_cast<int>(80 + t * 175); // 80 to 255
-        blue = static_cast<int>(255 * (1 - t * 0.6f)); // 255 to ~100 (reduce blue faster)
-    }
-    else if (intensity < 0.65f) {
-        // Extended yellow range - cyan to yellow transition
-        float t = (intensity - 0.35f) * 3.33f; // 0 to 1
-        red = static_cast<int>(100 + t * 155); // 100 to 255
-        green = 255;
-        blue = static_cast<int>(100 * (1 - t)); // 100 to 0 (remove remaining blue)
-    }
-    else {
-        // Extended yellow to bright yellow/white for high intensity
-        float t = (intensity - 0.65f) * 2.86f; // 0 to 1
-        red = 255;
-        green = 255;
-        blue = static_cast<int>(t * 150); // 0 to 150 (more yellow, less white)
-    }
-
-    return QColor(red, green, blue);
+    return QColor(RmPalette::SonarColourMap(intensity));
 }
 
 
@@ -973,7 +1207,17 @@ void MainView::FireSonar()
 void MainView::PalSelected(int pal)
 {
     m_pSonarSurface->m_palIndex = pal;
+
+    // Picking a palette leaves the sonar colour map
+    if (m_sonarColourMap)
+        SetSonarColourMap(false);
+
     m_pSonarSurface->Recalculate();
+
+    m_pWaterfallSurface->m_palIndex = pal;
+    m_waterfallDisplay.update();
+
+    m_multiReplay.MatchDisplay();
 }
 
 // ----------------------------------------------------------------------------
@@ -1051,9 +1295,15 @@ void MainView::OnNewPayload(unsigned short type, unsigned short version, double
                 memcpy(m_pSonarSurface->m_pData, pPayload, payloadSize);
 
                 m_pSonarSurface->m_newImgData = true;
+                m_pSonarSurface->ColouriseImg();
+
+                m_pWaterfallSurface->AddPing(m_sonarReplay.range, m_sonarReplay.nRngs, m_sonarReplay.nBrgs, m_sonarReplay.pBrgs, m_pSonarSurface->m_pData);
 
                 // Update the dipslay
                 m_fanDisplay.update();
+
+                if (m_showWaterfall)
+                    m_waterfallDisplay.update();
             }
         }
     }
@@ -1069,17 +1319,16 @@ void MainView::ReviewEntryChanged(int entry)
         this->StopReplay();
     }
 
-    if (m_pEntries && entry < m_nEntries)
+    if (entry < m_nEntries)
     {
-        m_index = entry;
-        m_player.OpenFileAt(m_replayFile, m_pEntries[entry]);
-        m_player.ReadNextItem();
+        // Frames either side of a jump do not belong together
+        m_temporalFilter.Reset();
 
-        // Raw sonar records are in pairs
-        if (m_useRawSonar)
-            m_player.ReadNextItem();
+        m_index = entry;
+        ShowEntry(entry, playRandom);
+        m_multiReplay.ShowTime(m_session.SyncTime(entry));
 
-        m_player.CloseFile();
+        m_frameCache.SetPlayhead(entry, m_playDirection, true);
     }
 
     if (playing)
@@ -1094,17 +1343,10 @@ void MainView::ReviewLowerEntryChanged(int entry) {
     if (playing)
         this->StopReplay();
 
-    if (m_pEntries && entry < m_nEntries)
+    if (entry < m_nEntries)
     {
         m_indexLower = entry;
-        m_player.OpenFileAt(m_replayFile, m_pEntries[entry]);
-        m_player.ReadNextItem();
-
-        // Raw sonar records are in pairs
-        if (m_useRawSonar)
-            m_player.ReadNextItem();
-
-        m_player.CloseFile();
+        ShowEntry(entry, playRandom);
     }
 }
 
@@ -1117,85 +1359,166 @@ void MainView::ReviewUpperEntryChanged(int entry) {
     if (playing)
         this->StopReplay();
 
-    if (m_pEntries && entry < m_nEntries)
+    if (entry < m_nEntries)
     {
         m_indexUpper = entry;
-        m_player.OpenFileAt(m_replayFile, m_pEntries[entry]);
-        m_player.ReadNextItem();
+        ShowEntry(entry, playRandom);
+    }
 
-        // Raw sonar records are in pairs
-        if (m_useRawSonar)
-            m_player.ReadNextItem();
+}
 
-        m_player.CloseFile();
-    }
+// ----------------------------------------------------------------------------
+// Show the frame at a time, looked up in the session's time index
+void MainView::ReviewJumpToTime(QDateTime time)
+{
+    int entry = m_session.FindTime(time.toMSecsSinceEpoch() / 1000.0);
+
+    if (entry < 0)
+        return;
+
+    m_reviewCtrls.blockSignals(true);
+    m_reviewCtrls.SetEntry(entry);
+    m_reviewCtrls.blockSignals(false);
 
+    ReviewEntryChanged(entry);
 }
 
 // ----------------------------------------------------------------------------
+// (SLOT) Playback tick. The clock runs on the log's own times scaled by the
+// play speed, backwards in reverse. When the display can't keep up, the frames
+// that are already overdue are passed over rather than letting the replay fall
+// behind
 void MainView::PlayNext()
 {
+    bool reverse = m_playDirection < 0;
 
-    if (0 <= m_index && m_index < m_nEntries - 2)
-    {
-        m_index++;
-        m_player.Seek(m_pEntries[m_index]);
-        m_player.ReadNextItem();
+    // Off the end of the log
+    if (reverse ? m_index <= 0 : m_index >= m_nEntries - 2) {
+        if (m_player.m_repeat)
+            StartPlayClock(reverse ? m_nEntries - 2 : 0);
+        else
+            this->StopReplay();
 
-        // Raw sonar records are in pairs
-        if (m_useRawSonar)
-            m_player.ReadNextItem();
+        return;
+    }
 
-        m_reviewCtrls.blockSignals(true);
-        m_reviewCtrls.SetEntry(m_index);
-        m_reviewCtrls.blockSignals(false);
+    // The frame due now - the one showing at the clock time, or in reverse
+    // the first one at or after it
+    double now = PlayClockTime();
+    int    due = m_session.FindTime(now);
 
-        double next;
-        m_player.PeekNextItem(&next);
+    if (reverse && m_session.SyncTime(due) < now)
+        due++;
 
-        QDateTime nextTime = QDateTime::fromMSecsSinceEpoch((quint64)(next * 1000.0));
+    due = qBound(0, due, m_nEntries - 2);
 
+    // The logs played alongside keep to the same clock
+    m_multiReplay.ShowTime(now);
 
-        // Work out the time delta
-        qint64 delta = m_payloadDateTime.msecsTo(nextTime);
+    // Nothing due yet
+    if (reverse ? due >= m_index : due <= m_index) {
+        ScheduleNext();
+        return;
+    }
 
+    int previous = m_index;
 
-        // Default to a 10Hz replay speed if the delta time is stupid
-        if ((delta < 10) || (delta > 500))
-            delta = 100;
+    if (m_replayEngine.IsRunning()) {
+        if (due > m_index + 1)
+            m_replayEngine.SkipTo(due);
 
-        // Account for the play speed
-        delta = (delta / m_playSpeed);
+        OsReplayFrame* pFrame = m_replayEngine.Take();
 
-        // Update the timer interval
-        m_replay.setInterval(delta);
-    }
+        // The reader is behind, try again shortly
+        if (!pFrame) {
+            m_replay.setInterval(REPLAY_RETRY_MS);
+            return;
+        }
 
-    // Check if we need to reset the index if repeat is enabled
-    if ((m_index >= (m_nEntries - 2)) && (m_player.m_repeat)) {
-        m_index = 0;
-    }
+        m_index = pFrame->index;
 
-    if (m_index == (m_nEntries-2)) {
-        this->StopReplay();
+        if (pFrame->ok) {
+            m_payloadDateTime = QDateTime::fromMSecsSinceEpoch((quint64)(pFrame->time * 1000.0));
+            m_reviewCtrls.SetPlaybackTime(m_payloadDateTime);
+
+            // Kept for scrubbing back, before the display filters it
+            m_frameCache.Insert(m_index, pFrame->entry, pFrame->time);
+
+            NewReturnFire(&pFrame->entry);
+        }
+
+        m_replayEngine.Release();
     }
+    else {
+        m_index = due;
+        ShowEntry(m_index, (qAbs(due - previous) > 1 || reverse) ? playRandom : playSequential);
+    }
+
+    m_nPlayShown++;
+    m_nPlayDropped += qAbs(m_index - previous) - 1;
+
+    m_frameCache.SetPlayhead(m_index, m_playDirection, !m_replayEngine.IsRunning());
+
+    m_reviewCtrls.blockSignals(true);
+    m_reviewCtrls.SetEntry(m_index);
+    m_reviewCtrls.blockSignals(false);
+
+    ScheduleNext();
+
+    // Report the frame rate and the cache use once a second
+    qint64 elapsed = m_playRateClock.elapsed();
+
+    if (elapsed >= 1000) {
+        double shown  = m_nPlayShown * 1000.0 / elapsed;
+        double target = (m_nPlayShown + m_nPlayDropped) * 1000.0 / elapsed;
 
+        m_reviewCtrls.SetPlaybackRate(shown, target, m_frameCache.HitRate(), m_frameCache.Bytes());
+
+        m_playRateClock.restart();
+        m_nPlayShown   = 0;
+        m_nPlayDropped = 0;
+    }
 }
 
 // ----------------------------------------------------------------------------
-bool MainView::Snapshot()
+// Set the timer for when the next frame is due. Gaps in the recording are
+// cut short, the clock being moved on to just before the next frame
+void MainView::ScheduleNext()
 {
-    // Get the primary screen
-    QScreen* screen = QGuiApplication::primaryScreen();
-    //QPixmap pixmap = screen->grabWindow(0);
-    QPixmap pixmap = this->grab();
+    double now     = PlayClockTime();
+    double current = m_session.SyncTime(m_index);
+    double next    = m_session.SyncTime(m_index + m_playDirection);
+    double pause   = REPLAY_GAP_PAUSE * m_playSpeed;
+    double other;
 
-    // Grab the framebuffer
-    //QImage snapshot = m_pMainWnd->m_fanDisplay.grabFramebuffer();
+    // A log played alongside may have a frame due sooner. The gap is then
+    // what is left before the next frame of any of them
+    if (m_multiReplay.NextTime(now, m_playDirection, &other)) {
+        if ((other - next) * m_playDirection < 0)
+            next = other;
 
-    // Create the output filename
-    QDateTime dt = QDateTime::currentDateTime();
+        current = now;
+    }
+
+    // Log time still to go, positive whichever way play is going
+    double togo = (next - now) * m_playDirection;
 
+    if (qAbs(next - current) > REPLAY_MAX_GAP && togo > pause) {
+        m_playOrigin = next - pause * m_playDirection;
+        m_playClock.restart();
+        togo = pause;
+    }
+
+    double wait = togo / m_playSpeed * 1000.0;
+
+    m_replay.setInterval(qBound(0, (int) qCeil(wait), REPLAY_MAX_WAIT_MS));
+}
+
+// ----------------------------------------------------------------------------
+// Work out the snapshot file name (without extension) from the log being
+// written or replayed. Returns an empty string if the directory is missing
+QString MainView::SnapshotBase()
+{
     // Source file
     QString srcFile;
     QDateTime srcDate;
@@ -1206,8 +1529,8 @@ bool MainView::Snapshot()
         srcFile = m_logger.m_fileName;
     }
     else if (m_replayFile != "") {
-        // Replaying
-        srcFile = m_replayFile;
+        // Replaying - name after the file of the session being shown
+        srcFile = m_session.IsOpen() ? m_session.CurrentFile() : m_replayFile;
         srcDate = m_payloadDateTime;
     }
     else {
@@ -1215,9 +1538,6 @@ bool MainView::Snapshot()
         srcFile = m_logger.m_logDir + QDir::separator() + QString(m_logger.s_source);
     }
 
-
-
-
     // Check the date
     if (!srcDate.isValid()) {
         srcDate = QDateTime::currentDateTime();
@@ -1226,32 +1546,148 @@ bool MainView::Snapshot()
     // Compile a file name
     QFileInfo info(srcFile);
     QString destPath = info.dir().absolutePath();
-    QString destFile = destPath + QDir::separator() + info.baseName() + srcDate.toString("_yyyyMMdd_hhmmss.png");
 
-    // Create the log directory if it doesn't exist
-    QDir ld(destPath);
+    // If the log directory doesn't exist we cannot save
+    if (!QDir(destPath).exists()) {
+        statusBar()->showMessage("Unable to save the snapshot, the directory '" + destPath + "' does not exist", 5000);
+        return QString();
+    }
 
-    // If the log directory doesn't exist, create it
-    if (!ld.exists(destPath)) {
-        QMessageBox msg;
-        msg.setIcon(QMessageBox::Critical);
-        msg.setStandardButtons(QMessageBox::Ok);
+    return destPath + QDir::separator() + info.baseName() + srcDate.toString("_yyyyMMdd_hhmmss");
+}
 
-        QString str = "Unable to save the snapshot.\r\n\r\nThe following directory does not exist:\r\n\r\n";
-        str += destPath;
+// ----------------------------------------------------------------------------
+// Queue a snapshot of the next frame drawn: the fan as displayed (read back
+// from the GPU without stalling) plus the polar image at native resolution
+// and its raw data. Everything is encoded on the snapshot workers
+void MainView::CaptureSnapshot(QString baseName)
+{
+    SonarSurface* pSonar = m_pSonarSurface;
 
-        msg.setText(str);
-        msg.setWindowTitle("Snapshot Error");
-        msg.exec();
-        return false;
+    if (pSonar->m_pData && pSonar->m_nRngs && pSonar->m_nBrgs)
+    {
+        // Bursts capture every ping, the palette is only loaded when it changes
+        if (!m_sonarColourMap && m_snapshotPalIndex != pSonar->m_palIndex)
+        {
+            if (m_snapshotPalette.LoadFromResource(pSonar->m_palIndex))
+                m_snapshotPalIndex = pSonar->m_palIndex;
+        }
+
+        const RmPalette& palette = m_sonarColourMap ? m_sonarPalette : m_snapshotPalette;
+
+        m_snapshots.SavePolar(baseName, pSonar->m_nRngs, pSonar->m_nBrgs, pSonar->m_pData, pSonar->m_pBrgs,
+                              pSonar->m_range, m_payloadDateTime.isValid() ? m_payloadDateTime : QDateTime::currentDateTime(), palette);
     }
 
-    // Save the snapshot
-    pixmap.save(destFile, "PNG");
+    quint64 tag = m_fanDisplay.RmglCaptureFrames(1, false);
+
+    m_snapshotFiles.insert(tag, baseName + ".png");
+}
+
+// ----------------------------------------------------------------------------
+bool MainView::Snapshot()
+{
+    QString base = SnapshotBase();
+
+    if (base.isEmpty())
+        return false;
+
+    CaptureSnapshot(base);
+    m_fanDisplay.update();
 
     return true;
 }
 
+// ----------------------------------------------------------------------------
+// Capture the next nFrames pings, each one is drawn and read back so none are
+// skipped
+void MainView::SnapshotBurst(int nFrames)
+{
+    m_burstBase = SnapshotBase();
+
+    if (m_burstBase.isEmpty())
+        return;
+
+    m_burstLeft  = nFrames;
+    m_burstIndex = 0;
+
+    statusBar()->showMessage("Capturing the next " + QString::number(nFrames) + " frames", 2000);
+}
+
+// ----------------------------------------------------------------------------
+// (SLOT) A frame has been read back from the fan display
+void MainView::OnFrameCaptured(QImage image, quint64 tag)
+{
+    QString fileName = m_snapshotFiles.take(tag);
+
+    if (!fileName.isEmpty())
+        m_snapshots.SaveImage(image, fileName);
+}
+
+// ----------------------------------------------------------------------------
+// (SLOT) A frame could not be read back, forget its snapshot
+void MainView::OnFrameDropped(quint64 tag)
+{
+    if (m_snapshotFiles.remove(tag))
+        statusBar()->showMessage("Unable to capture the display for the snapshot", 5000);
+}
+
+// ----------------------------------------------------------------------------
+// (SLOT) A snapshot could not be written
+void MainView::SnapshotFailed(QString reason)
+{
+    statusBar()->showMessage(reason, 5000);
+}
+
+// ----------------------------------------------------------------------------
+// Record the fan display as it is drawn, overlays included, next to the
+// snapshots. Every frame is read back; frames the encoders can't keep up with
+// are dropped rather than holding up the display
+void MainView::StartScreenRecord()
+{
+    QString base = SnapshotBase();
+
+    if (base.isEmpty())
+        return;
+
+    if (!m_recorder.Start(base + "_screen", m_recordFormat, m_recordQuality))
+        return;
+
+    m_recordGrabDropped = m_fanDisplay.m_grabber.m_nDropped;
+    m_fanDisplay.RmglCaptureContinuous(true);
+    m_fanDisplay.update();
+
+    statusBar()->showMessage("Recording the display (" + ScreenRecorder::FormatName(m_recordFormat) + ") to '" +
+                             m_recorder.Output() + "', press Y to stop");
+}
+
+// ----------------------------------------------------------------------------
+// Stop recording, finish the files and report what was dropped
+void MainView::StopScreenRecord()
+{
+    m_fanDisplay.RmglCaptureContinuous(false);
+
+    m_recorder.Stop();
+
+    quint64 dropped = m_recorder.m_nDropped + (m_fanDisplay.m_grabber.m_nDropped - m_recordGrabDropped);
+
+    statusBar()->showMessage("Recorded " + QString::number(m_recorder.m_nWritten) + " frames to '" + m_recorder.Output() +
+                             "' (" + QString::number(dropped) + " dropped)", 10000);
+}
+
+// ----------------------------------------------------------------------------
+// (SLOT) The recording could not be written, stop capturing
+void MainView::ScreenRecordFailed(QString reason)
+{
+    if (m_recorder.IsRecording())
+    {
+        m_fanDisplay.RmglCaptureContinuous(false);
+        m_recorder.Stop();
+    }
+
+    statusBar()->showMessage(reason, 10000);
+}
+
 // ----------------------------------------------------------------------------
 void MainView::StartLog()
 {
@@ -1291,6 +1727,17 @@ void MainView::StopLog()
         m_info.setText("");
 }
 
+// ----------------------------------------------------------------------------
+// (SLOT) The log could not be opened or written, logging has stopped
+void MainView::LogFailed(QString reason)
+{
+    // Release the record button first, it clears the info line
+    m_onlineCtrls.CancelRecord();
+
+    m_info.setText("Logging Failed! " + reason);
+    statusBar()->showMessage(reason, 10000);
+}
+
 // ----------------------------------------------------------------------------
 void MainView::FlipX(bool flip)
 {
@@ -1298,6 +1745,8 @@ void MainView::FlipX(bool flip)
 
     pSonar->m_flipX = flip;
     pSonar->Recalculate();
+
+    m_multiReplay.MatchDisplay();
 }
 
 // ----------------------------------------------------------------------------
@@ -1307,6 +1756,8 @@ void MainView::FlipY(bool flip)
 
     pSonar->m_headDown = !flip;
     pSonar->Recalculate();
+
+    m_multiReplay.MatchDisplay();
 }
 
 // ----------------------------------------------------------------------------
@@ -1463,6 +1914,51 @@ void MainView::ToggleHexViewer()
     resizeEvent(nullptr);
 }
 
+// ----------------------------------------------------------------------------
+// Show or hide the waterfall under the fan. The history keeps filling while it
+// is hidden so nothing is lost when it is shown again
+void MainView::ToggleWaterfall()
+{
+    m_showWaterfall = !m_showWaterfall;
+
+    m_waterfallDisplay.setVisible(m_showWaterfall);
+
+    resizeEvent(nullptr);
+}
+
+// ----------------------------------------------------------------------------
+// Step the waterfall through beam, sector max and sector mean
+void MainView::CycleWaterfallSource()
+{
+    eWaterfallSource source = (eWaterfallSource) ((m_pWaterfallSurface->m_source + 1) % (wfSectorMean + 1));
+
+    m_pWaterfallSurface->SetSource(source, m_pWaterfallSurface->m_left, m_pWaterfallSurface->m_right);
+    m_waterfallDisplay.update();
+}
+
+// ----------------------------------------------------------------------------
+// Step the persistence filter through off, decay, mean and max hold
+void MainView::CycleTemporalFilter()
+{
+    eTemporalMode mode = (eTemporalMode) ((m_temporalFilter.m_mode + 1) % (tfMaxHold + 1));
+
+    m_temporalFilter.SetMode(mode);
+
+    statusBar()->showMessage("Persistence: " + OsTemporalFilter::ModeName(mode), 2000);
+}
+
+// ----------------------------------------------------------------------------
+// Switch the fan between the sonar colour map (CPU palette) and the palette
+// selected in the palette widget (GPU palette)
+void MainView::SetSonarColourMap(bool enable)
+{
+    m_sonarColourMap = enable;
+
+    m_pSonarSurface->SetRgbPalette(enable ? &m_sonarPalette : nullptr);
+
+    m_multiReplay.MatchDisplay();
+}
+
 // Send Ping button click handler (MainView.h'a da eklenmeli)
 void MainView::OnSendPingClicked()
 {
@@ -1946,8 +2442,20 @@ void MainView::resizeEvent(QResizeEvent* event)
     if ((leftArea.height() % 2) != 0)
         leftArea.setHeight(leftArea.height() + 1);
 
-    // Fan display'i sol alana yerleştir
-    m_fanDisplay.setGeometry(leftArea);
+    // The waterfall takes the lower third of the sonar area when shown
+    if (m_showWaterfall)
+    {
+        QRect waterfallArea = leftArea;
+        int   fanHeight     = (leftArea.height() * 2 / 3) & ~1;
+
+        leftArea.setHeight(fanHeight);
+        waterfallArea.setTop(leftArea.bottom() + 1);
+
+        m_waterfallDisplay.setGeometry(waterfallArea);
+    }
+
+    // Fan display'i sol alana yerleştir, beside the logs played alongside
+    m_fanDisplay.setGeometry(m_multiReplay.Layout(leftArea));
 
     // Hex container'ı sağ alana yerleştir - daha aşağıda başla
     if (m_hexContainer) {
@@ -2085,127 +2593,16 @@ void MainView::analyzeImage(int height, int width, uchar* image,
         return;
     }
 
-    cv::Mat sonarImg(height, width, CV_8UC1, image);
-
-    cv::Mat rotatedImg;
-    cv::transpose(sonarImg, rotatedImg);
-    cv::flip(rotatedImg, rotatedImg, 1);
-
-    cv::Mat finalImg;
-    cv::resize(rotatedImg, finalImg, cv::Size(640, 640), 0, 0, cv::INTER_LINEAR);
-
-    cv::GaussianBlur(finalImg, finalImg, cv::Size(3, 3), 0);
-
-    cv::Scalar mean, stddev;
-    cv::meanStdDev(finalImg, mean, stddev);
-
-    // ÇİFT EŞİK: Hem parlak hem koyu nesneler için
-    // Parlak nesneler için (mean'in üstü)
-    double highThreshold = mean[0] + m_detectionParams.highThresholdMult * stddev[0];
-    cv::Mat brightMask;
-    cv::threshold(finalImg, brightMask, highThreshold, 255, cv::THRESH_BINARY);
-
-    // Koyu nesneler için (mean'in altı)
-    double lowThreshold = mean[0] - m_detectionParams.lowThresholdMult * stddev[0];
-    cv::Mat darkMask;
-    cv::threshold(finalImg, darkMask, lowThreshold, 255, cv::THRESH_BINARY_INV);
-
-    // İki mask'i birleştir
-    cv::Mat anomalyMask;
-    cv::bitwise_or(brightMask, darkMask, anomalyMask);
-
-    cv::Mat kernel = cv::getStructuringElement(cv::MORPH_ELLIPSE, cv::Size(3, 3));
-    cv::morphologyEx(anomalyMask, anomalyMask, cv::MORPH_OPEN, kernel);
-    cv::morphologyEx(anomalyMask, anomalyMask, cv::MORPH_CLOSE, kernel);
-
-    std::vector<std::vector<cv::Point>> contours;
-    cv::findContours(anomalyMask.clone(), contours, cv::RETR_EXTERNAL, cv::CHAIN_APPROX_SIMPLE);
-
-    int minBlobArea = m_detectionParams.minBlobArea;
-    int maxBlobArea = m_detectionParams.maxBlobArea;
-    int minWidth = m_detectionParams.minWidth;
-    int minHeight = m_detectionParams.minHeight;
-    int maxWidth = m_detectionParams.maxWidth;
-    int maxHeight = m_detectionParams.maxHeight;
-    double minIntensityDiff = m_detectionParams.minIntensityDiff;
-    double minAspectRatio = m_detectionParams.minAspectRatio;
-    double maxAspectRatio = m_detectionParams.maxAspectRatio;
-    double minSolidity = m_detectionParams.minSolidity;
-    double minCompactness = m_detectionParams.minCompactness;
-
-    //minSolidity
-    // 1.0 = tamamen dolu (kare, daire)
-    // 0.8 = biraz girintili ama hala kompakt
-    // 0.5 = orta düzey girintili
-    // 0.2 = çok girintili, saçılmış
+    cv::Mat finalImg = DatasetExporter::PrepareImage(height, width, image);
 
-    //minCompactness
-    // 1.0 = mükemmel daire (en kompakt şekil)
-    // 0.8 = kare
-    // 0.5-0.7 = normal nesneler (balık, kaya)
-    // 0.2-0.4 = uzunca dikdörtgen
-    // 0.1 = çok uzun ince şekil
-    // < 0.1 = düzensiz gürültü pattern'i
-
-    std::vector<std::tuple<cv::Rect, double, double>> significantObjects;
-
-    for (size_t i = 0; i < contours.size(); i++) {
-        cv::Rect bbox = cv::boundingRect(contours[i]);
-
-        int bboxArea = bbox.width * bbox.height;
-
-        if (bboxArea < minBlobArea || bboxArea > maxBlobArea) {
-            continue;
-        }
-
-        if (bbox.width < minWidth || bbox.width > maxWidth ||
-            bbox.height < minHeight || bbox.height > maxHeight) {
-            continue;
-        }
-
-        double aspectRatio = (double)bbox.width / bbox.height;
-        if (aspectRatio < minAspectRatio || aspectRatio > maxAspectRatio) {
-            continue;
-        }
-
-        double contourArea = cv::contourArea(contours[i]);
-        double perimeter = cv::arcLength(contours[i], true);
-        double compactness = (4.0 * 3.14159265359 * contourArea) / (perimeter * perimeter);
-        if (compactness < minCompactness) {
-            continue;
-        }
-
-        cv::Mat mask = cv::Mat::zeros(finalImg.size(), CV_8UC1);
-        cv::drawContours(mask, contours, i, cv::Scalar(255), cv::FILLED);
-        cv::Scalar blobMean = cv::mean(finalImg, mask);
-
-        double intensityDiff = std::abs(blobMean[0] - mean[0]);
-        if (intensityDiff < minIntensityDiff) {
-            continue;
-        }
-
-        std::vector<cv::Point> hull;
-        cv::convexHull(contours[i], hull);
-        double hullArea = cv::contourArea(hull);
-        double solidity = contourArea / hullArea;
-        if (solidity < minSolidity) {
-            continue;
-        }
-
-        cv::Moments moments = cv::moments(contours[i]);
-        float centerY = moments.m01 / moments.m00;
-        float objectRange = (centerY / 640.0) * range;
-
-        significantObjects.push_back(std::make_tuple(bbox, objectRange, blobMean[0]));
-    }
+    std::vector<cv::Rect> significantObjects = DatasetExporter::FindObjects(finalImg, m_detectionParams);
 
     if (significantObjects.size() > 0) {
         // Send detections to sonar surface
         QList<SonarSurface::DetectedObject> detections;
 
         for (size_t i = 0; i < significantObjects.size(); i++) {
-            cv::Rect bbox = std::get<0>(significantObjects[i]);
-            double objRange = std::get<1>(significantObjects[i]);
+            cv::Rect bbox = significantObjects[i];
 
             // bbox koordinatları ROTATE ÖNCESİ (transpose+flip+resize sonrası 640x640)
             // Rotate 90° CW transform uygula
@@ -2261,14 +2658,7 @@ void MainView::analyzeImage(int height, int width, uchar* image,
                 QString imageFullPath = dir.filePath(imageFilename);
 
                 // Rotated image'i kaydet (YOLO için 640x640 RGB)
-                cv::Mat rgbImg;
-                cv::cvtColor(finalImg, rgbImg, cv::COLOR_GRAY2RGB);
-
-                cv::Mat rotatedRgb;
-                cv::rotate(rgbImg, rotatedRgb, cv::ROTATE_90_CLOCKWISE);
-
-                // Image'i kaydet
-                cv::imwrite(imageFullPath.toStdString(), rotatedRgb);
+                DatasetExporter::WriteSample(finalImg, {}, imageFullPath, QString());
             }
 
             // if (!directoryPath.isEmpty()) {
@@ -2281,7 +2671,7 @@ void MainView::analyzeImage(int height, int width, uchar* image,
             //     cv::cvtColor(finalImg, colorImg, cv::COLOR_GRAY2BGR);
 
             //     for (size_t i = 0; i < significantObjects.size(); i++) {
-            //         cv::Rect bbox = std::get<0>(significantObjects[i]);
+            //         cv::Rect bbox = significantObjects[i];
             //         int area = bbox.width * bbox.height;
             //         cv::rectangle(colorImg, bbox, cv::Scalar(0, 255, 0), 2);
 
@@ -2348,7 +2738,7 @@ void MainView::analyzeImage(int height, int width, uchar* image,
             //         QTextStream out(&labelFile);
 
             //         for (size_t i = 0; i < significantObjects.size(); i++) {
-            //             cv::Rect bbox = std::get<0>(significantObjects[i]);
+            //             cv::Rect bbox = significantObjects[i];
 
             //             double rotated_x = 640.0 - bbox.y - bbox.height;
             //             double rotated_y = bbox.x;
@@ -5,6 +5,7 @@
 #include <QLabel>
 #include <QPushButton>
 #include <QTimer>
+#include <QElapsedTimer>
 #include <QTextBrowser>
 #include <QVBoxLayout>
 #include <QCheckBox>
@@ -28,9 +29,17 @@
 #include "../RmGl/PalWidget.h"
 #include "../Oculus/OsStatusRx.h"
 #include "../Oculus/OsClientCtrl.h"
+#include "../Oculus/OsTemporalFilter.h"
+#include "../Oculus/OsReplayEngine.h"
+#include "../Oculus/OsFrameCache.h"
+#include "../RmUtil/RmPalette.h"
+#include "SnapshotWriter.h"
+#include "ScreenRecorder.h"
+#include "MultiReplay.h"
 #include "../Oculus/OssDataWrapper.h"
 #include "../RmUtil/RmLogger.h"
 #include "../RmUtil/RmPlayer.h"
+#include "../RmUtil/RmLogSession.h"
 
 // ============================================================================
 // YOLO Detection (ONNX Runtime) - Direkt MainView'de
@@ -39,8 +48,15 @@
 #include "DetectionParams.h"
 #include <opencv2/opencv.hpp>
 
+// Replay timing
+#define REPLAY_MAX_GAP      0.5     // Seconds of log between frames treated as a gap
+#define REPLAY_GAP_PAUSE    0.1     // Seconds a gap is shown for
+#define REPLAY_MAX_WAIT_MS  100     // Longest timer wait, so speed changes are picked up
+#define REPLAY_RETRY_MS     2       // Wait when the replay engine has no frame ready
+
 // forward definition for the sonar surface
 class SonarSurface;
+class WaterfallSurface;
 
 // Enumerate different display modes
 enum eDisplayMode : int
@@ -97,9 +113,16 @@ public:
 
     void LayoutCtrls();
     void SetDisplayMode(eDisplayMode displayMode);
+    void SetPlaySpeed(double speed);
+    void SetPlayDirection(int direction);
     void ReadSettings();
     void WriteSettings();
     bool Snapshot();
+    QString SnapshotBase();
+    void CaptureSnapshot(QString baseName);
+    void SnapshotBurst(int nFrames);
+    void StartScreenRecord();
+    void StopScreenRecord();
     void FlipX(bool flip);
     void FlipY(bool flip);
     void StartLog();
@@ -112,6 +135,11 @@ public:
     void MouseEnterFan();
     void SetTitleLogFile(QString string);
     void ShowLogEditor();
+    void ToggleWaterfall();
+    void CycleWaterfallSource();
+    void CycleTemporalFilter();
+    void SetSonarColourMap(bool enable);
+    void AddReplayHead();
 
     // Controls
     TitleCtrls    m_titleCtrls;
@@ -132,10 +160,34 @@ public:
     // Data
     RmGlWidget    m_fanDisplay;
     SonarSurface* m_pSonarSurface;
+    RmGlWidget    m_waterfallDisplay;
+    WaterfallSurface* m_pWaterfallSurface;
+    bool          m_showWaterfall;
+    OsTemporalFilter m_temporalFilter;
+    RmPalette     m_sonarPalette;
+    bool          m_sonarColourMap;
+
+    // Snapshots
+    SnapshotWriter         m_snapshots;      // Background encoders
+    QMap<quint64, QString> m_snapshotFiles;  // Frame tag -> file for reads in flight
+    RmPalette     m_snapshotPalette;         // Colours the polar snapshots
+    int           m_snapshotPalIndex;        // Palette loaded into m_snapshotPalette (-1 none)
+    QString       m_burstBase;               // File name base of the current burst
+    int           m_burstLeft;               // Pings still to capture in the burst
+    int           m_burstIndex;              // Next frame number in the burst
+    int           m_snapshotBurst;           // Frames in a burst
+
+    // Screen recording
+    ScreenRecorder m_recorder;               // Background encoders for the display
+    eRecordFormat  m_recordFormat;           // AVI, PNG or QOI
+    int            m_recordQuality;          // JPEG quality for the AVI
+    quint64        m_recordGrabDropped;      // Read back drops when the recording started
     OsClientCtrl  m_oculusClient;
     OsStatusRx    m_oculusStatus;
     RmLogger      m_logger;
     RmPlayer      m_player;
+    RmLogSession  m_session;                 // The replay file and the rest of its session
+    bool          m_joinSegments;            // Replay the files of a session as one
     QLabel        m_info;
 
     QString       m_themeName;
@@ -159,23 +211,36 @@ public:
 
     // Replay
     QString       m_replayFile;
-    quint64*      m_pEntries;
     int           m_nEntries;
     int           m_index;
     int           m_indexLower;
     int           m_indexUpper;
     OsBufferEntry m_entry;
     QTimer        m_replay;
+    OsReplayEngine m_replayEngine;          // Reads and decodes ahead of PlayNext
+    OsFrameCache  m_frameCache;              // Decoded frames around the playhead
+    int           m_cacheMb;                 // Its memory budget
+    MultiReplay   m_multiReplay;             // Logs played in step with this one
     quint64*      m_pViewInfoEntries;
     int           m_nViewInfoEntries;
     ApSonarDataHeader m_sonarReplay;
     bool              m_useRawSonar;
     QDateTime         m_payloadDateTime;
-    int               m_playSpeed;
+    double            m_playSpeed;           // 0.1 to 100 times real time
+    int               m_playDirection;       // 1 forward, -1 reverse
+    double            m_playOrigin;          // Log time when the play clock started
+    QElapsedTimer     m_playClock;           // Wall time since then
+    QElapsedTimer     m_playRateClock;       // Frame rate reporting period
+    int               m_nPlayShown;          // Frames shown in the period
+    int               m_nPlayDropped;        // Frames passed over in the period
     int               counter;
     OculusInfo*       m_pSonarInfo;
 
     void UpdateLogFileName();
+    void StartPlayClock(int entry);
+    double PlayClockTime();
+    void ScheduleNext();
+    void ShowEntry(int entry, ePlayAccess access);
     void AbortReconnect();
     void UpdateSonarInfo(OculusPartNumberType pn);
 
@@ -186,6 +251,11 @@ signals:
 public slots:
     void NewStatusMsg(OculusStatusMsg osm, quint16 valid, quint16 invalid);
     void NewReturnFire(OsBufferEntry* pEntry);   
+    void OnFrameCaptured(QImage image, quint64 tag);
+    void OnFrameDropped(quint64 tag);
+    void SnapshotFailed(QString reason);
+    void ScreenRecordFailed(QString reason);
+    void LogFailed(QString reason);
     void analyzeImage(int height, int width, uchar* image,
                                 short* bearings, double range,
                                 const QString& directoryPath);
@@ -199,6 +269,7 @@ public slots:
     void ReviewEntryChanged(int enrr);
     void ReviewLowerEntryChanged(int entry);
     void ReviewUpperEntryChanged(int entry);
+    void ReviewJumpToTime(QDateTime time);
     void StartReplay();
     void StopReplay();
     void PlayNext();
@@ -355,7 +355,8 @@ void ModeCtrls::Connect(bool checked) {
 
 void ModeCtrls::OpenFileEx(QString fileName) {
 
-	RmPlayer player;
+	// The file is replayed along with the rest of its session
+	RmLogSession& session = m_pMainWnd->m_session;
 
 	if (fileName.length() > 0)
 	{
@@ -369,12 +370,14 @@ void ModeCtrls::OpenFileEx(QString fileName) {
 		m_pMainWnd->m_nViewInfoEntries = player.CreateTypeIndex(fileName, rt_ocViewInfo, &m_pMainWnd->m_pViewInfoEntries);
 */
 		// Build an index of the sonar types
-		m_pMainWnd->m_nEntries = player.CreateTypeIndex(fileName, rt_oculusSonar, &m_pMainWnd->m_pEntries);
+		session.Open(fileName, rt_oculusSonar, m_pMainWnd->m_joinSegments);
+		m_pMainWnd->m_nEntries = session.Count();
 
 		if (m_pMainWnd->m_nEntries == 0)
 		{
 			m_pMainWnd->m_info.setText(tr("No oculus entries in file, trying sonar header"));
-			m_pMainWnd->m_nEntries = player.CreateTypeIndex(fileName, rt_apSonarHeader, &m_pMainWnd->m_pEntries);
+			session.Open(fileName, rt_apSonarHeader, m_pMainWnd->m_joinSegments);
+			m_pMainWnd->m_nEntries = session.Count();
 			m_pMainWnd->m_useRawSonar = true;
 		}
 		else
@@ -382,7 +385,16 @@ void ModeCtrls::OpenFileEx(QString fileName) {
 
 	  if (m_pMainWnd->m_nEntries > 0)
 	  {
-		m_pMainWnd->m_info.setText(QString::number(m_pMainWnd->m_nEntries) + tr(" Oculus entries identified in file."));
+		QString info = QString::number(m_pMainWnd->m_nEntries) + tr(" Oculus entries identified in file.");
+
+		if (session.Segments() > 1)
+			info = QString::number(m_pMainWnd->m_nEntries) + tr(" Oculus entries identified in ") + QString::number(session.Segments()) + tr(" session files.");
+
+		// Damaged logs are indexed around the bad data
+		if (session.CorruptRegions() > 0)
+			info += " " + QString::number(session.CorruptRegions()) + tr(" corrupt regions skipped.");
+
+		m_pMainWnd->m_info.setText(info);
 		m_pMainWnd->m_replayFile = fileName;
 
 
@@ -450,7 +462,17 @@ void ModeCtrls::OpenFile(bool checked)
 // -----------------------------------------------------------------------------
 void ModeCtrls::CloseFile()
 {
+	// Release the replay files (and their mappings)
+	m_pMainWnd->StopReplay();
+	m_pMainWnd->m_frameCache.Close();
+	m_pMainWnd->m_session.Close();
 
+	// The logs played alongside go with it
+	if (m_pMainWnd->m_multiReplay.Count() > 0)
+	{
+		m_pMainWnd->m_multiReplay.Clear();
+		m_pMainWnd->resizeEvent(nullptr);
+	}
 }
 
 // -----------------------------------------------------------------------------
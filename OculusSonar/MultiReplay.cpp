@@ -0,0 +1,260 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "MultiReplay.h"
+#include "MainView.h"
+#include "../Displays/SonarSurface.h"
+
+// ============================================================================
+// MultiReplay - further logs played in step with the main one
+
+MultiReplay::MultiReplay(MainView* pMainWnd)
+{
+    m_pMainWnd = pMainWnd;
+}
+
+MultiReplay::~MultiReplay()
+{
+    Clear();
+}
+
+// ----------------------------------------------------------------------------
+// Add a log to replay alongside the main one, in a display next to the fan
+bool MultiReplay::AddLog(QString file)
+{
+    ReplayHead* pHead = new ReplayHead;
+
+    if (!pHead->session.Open(file, rt_oculusSonar, m_pMainWnd->m_joinSegments) || pHead->session.Count() == 0)
+    {
+        delete pHead;
+        return false;
+    }
+
+    pHead->reader.SetSession(pHead->session.Entries(), pHead->session.Files());
+    pHead->index = -1;
+
+    // A fan display set up like the main one
+    pHead->pSurface = new SonarSurface;
+    pHead->pSurface->m_background   = m_pMainWnd->m_pSonarSurface->m_background;
+    pHead->pSurface->m_dwGridText   = m_pMainWnd->m_pSonarSurface->m_dwGridText;
+    pHead->pSurface->m_clearColour  = m_pMainWnd->m_pSonarSurface->m_clearColour;
+
+    pHead->pDisplay = new RmGlWidget(m_pMainWnd);
+    pHead->pDisplay->RmglSetupSurface(pHead->pSurface);
+    pHead->pDisplay->m_version.setVisible(false);
+    pHead->pDisplay->lower();
+    pHead->pDisplay->show();
+
+    m_heads.append(pHead);
+
+    MatchDisplay();
+    Rebuild();
+
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// Drop all the logs alongside the main one
+void MultiReplay::Clear()
+{
+    foreach (ReplayHead* pHead, m_heads)
+    {
+        pHead->engine.Stop();
+        pHead->reader.Close();
+        pHead->session.Close();
+
+        // The display deletes its surface
+        delete pHead->pDisplay;
+        delete pHead;
+    }
+
+    m_heads.clear();
+    Rebuild();
+}
+
+// ----------------------------------------------------------------------------
+// The main log's entries, for the merged timeline
+void MultiReplay::SetMain(const QVector<RmSessionEntry>& entries)
+{
+    m_main = entries;
+    Rebuild();
+}
+
+// ----------------------------------------------------------------------------
+// Give the heads' displays the main display's palette and orientation
+void MultiReplay::MatchDisplay()
+{
+    SonarSurface* pMain = m_pMainWnd->m_pSonarSurface;
+
+    foreach (ReplayHead* pHead, m_heads)
+    {
+        pHead->pSurface->m_palIndex = pMain->m_palIndex;
+        pHead->pSurface->m_headDown = pMain->m_headDown;
+        pHead->pSurface->m_flipX    = pMain->m_flipX;
+        pHead->pSurface->SetRgbPalette(m_pMainWnd->m_sonarColourMap ? &m_pMainWnd->m_sonarPalette : nullptr);
+        pHead->pSurface->Recalculate();
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Share the fan area out in columns, the main display on the left. Returns
+// the main display's part
+QRect MultiReplay::Layout(QRect area)
+{
+    if (m_heads.isEmpty())
+        return area;
+
+    int width = (area.width() / (m_heads.count() + 1)) & ~1;
+
+    QRect column = area;
+    column.setWidth(width);
+
+    for (int i = 0; i < m_heads.count(); i++)
+        m_heads[i]->pDisplay->setGeometry(column.translated(width * (i + 1), 0));
+
+    return column;
+}
+
+// ----------------------------------------------------------------------------
+// Start playing from a time. Playing forward each head reads ahead on its own
+// engine, in reverse its frames are read as they are due
+void MultiReplay::Start(double time, int direction)
+{
+    foreach (ReplayHead* pHead, m_heads)
+    {
+        if (direction > 0)
+        {
+            int first = pHead->session.FindTime(time);
+
+            // From the frame after the one on display
+            if (first == pHead->index)
+                first = qMin(first + 1, pHead->session.Count() - 1);
+
+            pHead->engine.Start(pHead->session.Entries(), pHead->session.Files(), first);
+        }
+        else
+            pHead->engine.Stop();
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Stop the heads' engines
+void MultiReplay::Stop()
+{
+    foreach (ReplayHead* pHead, m_heads)
+        pHead->engine.Stop();
+}
+
+// ----------------------------------------------------------------------------
+// Show each head's frame for a log time
+void MultiReplay::ShowTime(double time)
+{
+    foreach (ReplayHead* pHead, m_heads)
+    {
+        int due = pHead->session.FindTime(time);
+
+        if (due < 0 || due == pHead->index)
+            continue;
+
+        if (pHead->engine.IsRunning() && due > pHead->index)
+        {
+            if (due > pHead->index + 1)
+                pHead->engine.SkipTo(due);
+
+            // Not read yet, the next tick picks it up
+            OsReplayFrame* pFrame = pHead->engine.Take();
+
+            if (!pFrame)
+                continue;
+
+            pHead->index = pFrame->index;
+
+            if (pFrame->ok)
+                Present(pHead, &pFrame->entry);
+
+            pHead->engine.Release();
+        }
+        else
+        {
+            double         frameTime;
+            unsigned short version;
+
+            pHead->index = due;
+
+            if (pHead->reader.Read(due, pHead->raw, &frameTime, &version))
+            {
+                pHead->entry.ProcessRaw((char*) pHead->raw.m_pRaw);
+                Present(pHead, &pHead->entry);
+            }
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+// The time of the next record of any of the logs after (before in reverse) a
+// time
+bool MultiReplay::NextTime(double time, int direction, double* pNext)
+{
+    if (m_heads.isEmpty())
+        return false;
+
+    return m_merge.NextTime(time, direction, pNext);
+}
+
+// ----------------------------------------------------------------------------
+// Merge the main log's and the heads' indexes
+void MultiReplay::Rebuild()
+{
+    if (m_heads.isEmpty())
+    {
+        m_merge.Clear();
+        return;
+    }
+
+    QVector<QVector<RmSessionEntry>> sources;
+    sources.append(m_main);
+
+    foreach (ReplayHead* pHead, m_heads)
+        sources.append(pHead->session.Entries());
+
+    m_merge.Build(sources);
+}
+
+// ----------------------------------------------------------------------------
+// Put a decoded frame on a head's display
+void MultiReplay::Present(ReplayHead* pHead, OsBufferEntry* pEntry)
+{
+    int    width  = 0;
+    int    height = 0;
+    double range  = 0;
+
+    pEntry->m_mutex.lock();
+
+    if (pEntry->m_pImage)
+    {
+        pEntry->GetImageInfo(width, height, range);
+
+        pHead->pSurface->UpdateFan(range, width, pEntry->m_pBrgs, true);
+        pHead->pSurface->UpdateImg(height, width, pEntry->m_pImage);
+    }
+
+    pEntry->m_mutex.unlock();
+
+    pHead->pDisplay->update();
+}
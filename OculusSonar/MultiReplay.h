@@ -0,0 +1,82 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#pragma once
+
+#include <QList>
+#include <QRect>
+#include <QVector>
+#include <QStringList>
+
+#include "../RmGl/RmGlWidget.h"
+#include "../Oculus/OsReplayEngine.h"
+#include "../RmUtil/RmLogSession.h"
+#include "../RmUtil/RmLogMerge.h"
+
+class MainView;
+class SonarSurface;
+
+// ----------------------------------------------------------------------------
+// A further log replayed alongside the main one, in a view of its own
+struct ReplayHead
+{
+    RmLogSession    session;    // The log and the rest of its session
+    OsReplayEngine  engine;     // Reads and decodes ahead when playing forward
+    OsSessionReader reader;     // Reads single frames when scrubbing or in reverse
+    OsBufferEntry   raw;        // Record read by the reader
+    OsBufferEntry   entry;      // ... and decoded
+    RmGlWidget*     pDisplay;   // Its fan display (owns pSurface)
+    SonarSurface*   pSurface;
+    int             index;      // Entry on display, -1 for none
+};
+
+// ----------------------------------------------------------------------------
+// MultiReplay - logs recorded at the same time (e.g. one per sonar head)
+// replayed in step with the main log. The main log's play clock drives them
+// all; each head shows its frame for the clock time and reads ahead on its own
+// threads. The logs' indexes are merged into one timeline so the replay timer
+// wakes for whichever log has the next frame
+
+class MultiReplay
+{
+public:
+    MultiReplay(MainView* pMainWnd);
+    ~MultiReplay();
+
+    // Methods
+    bool  AddLog(QString file);
+    void  Clear();
+    int   Count() { return m_heads.count(); }
+    void  SetMain(const QVector<RmSessionEntry>& entries);
+    void  MatchDisplay();
+    QRect Layout(QRect area);
+    void  Start(double time, int direction);
+    void  Stop();
+    void  ShowTime(double time);
+    bool  NextTime(double time, int direction, double* pNext);
+
+protected:
+    void Rebuild();
+    void Present(ReplayHead* pHead, OsBufferEntry* pEntry);
+
+    MainView*               m_pMainWnd;
+    QList<ReplayHead*>      m_heads;    // Logs alongside the main one
+    QVector<RmSessionEntry> m_main;     // Main log's entries
+    RmLogMerge              m_merge;    // Main log and heads on one timeline
+};
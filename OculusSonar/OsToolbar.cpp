@@ -770,7 +770,8 @@ void MainToolbar::StopLog()
 // ----------------------------------------------------------------------------
 void MainToolbar::OpenFile()
 {
-  RmPlayer player;
+  // The file is replayed along with the rest of its session
+  RmLogSession& session = m_pMainWnd->m_session;
 
   QFileDialog fd;
 
@@ -778,12 +779,14 @@ void MainToolbar::OpenFile()
 
   if (logFile.length() > 0)
   {
-    m_pMainWnd->m_nEntries = player.CreateTypeIndex(logFile, rt_oculusSonar, &m_pMainWnd->m_pEntries);
+    session.Open(logFile, rt_oculusSonar, m_pMainWnd->m_joinSegments);
+    m_pMainWnd->m_nEntries = session.Count();
 
     if (m_pMainWnd->m_nEntries == 0)
     {
       m_pMainWnd->m_info.setText(tr("No oculus entries in file, trying sonar header"));
-      m_pMainWnd->m_nEntries = player.CreateTypeIndex(logFile, rt_apSonarHeader, &m_pMainWnd->m_pEntries);
+      session.Open(logFile, rt_apSonarHeader, m_pMainWnd->m_joinSegments);
+      m_pMainWnd->m_nEntries = session.Count();
       m_pMainWnd->m_useRawSonar = true;
     }
     else
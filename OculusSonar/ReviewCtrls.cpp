@@ -25,11 +25,15 @@ ReviewCtrls::ReviewCtrls(QWidget *parent) :
   connect(ui->reviewSlider, &RangeSlider::upperValueChanged, this, &ReviewCtrls::UpperSliderChanged);
 
   connect(ui->repeat, &QPushButton::toggled, this, &ReviewCtrls::RepeatChanged);
+  connect(ui->reverse, &QPushButton::toggled, this, &ReviewCtrls::ReverseChanged);
 
   connect(ui->speedSlider, &QSlider::valueChanged, this, &ReviewCtrls::SpeedChanged);
 
   connect(ui->play, &QPushButton::toggled, this, &ReviewCtrls::PlayChanged);
 
+  connect(ui->jump, &QPushButton::clicked, this, &ReviewCtrls::JumpClicked);
+  connect(ui->cut, &QPushButton::clicked, this, &ReviewCtrls::CutClicked);
+
 }
 
 // -----------------------------------------------------------------------------
@@ -83,10 +87,10 @@ void ReviewCtrls::UpperSliderChanged(int value) {
 // Speed changed
 void ReviewCtrls::SpeedChanged(int value)
 {
-    int speeds[] = { 1, 2, 4, 8 };
-    int speed = speeds[value];
+    double speeds[] = { 0.1, 0.25, 0.5, 1, 2, 4, 8, 16, 32, 64, 100 };
+    double speed = speeds[value];
 
-	m_pMainWnd->m_playSpeed = speed;
+	m_pMainWnd->SetPlaySpeed(speed);
 
     // Update the speed text
     ui->playbackSpeed->setText(QString::number(speed) + "x");
@@ -113,12 +117,52 @@ void ReviewCtrls::RepeatChanged(bool checked)
     m_pMainWnd->m_player.m_repeat = checked;
 }
 
+// ----------------------------------------------------------------------------
+// Play backwards
+void ReviewCtrls::ReverseChanged(bool checked)
+{
+    m_pMainWnd->SetPlayDirection(checked ? -1 : 1);
+}
+
 void ReviewCtrls::SetPlaybackTime(QDateTime time) {
 
 		ui->playbackTime->setText(time.toString("dd-MM-yyyy HH:mm:ss.zzz"));
 
 }
 
+// ----------------------------------------------------------------------------
+// Limit the jump time to the span of the log
+void ReviewCtrls::SetTimeRange(QDateTime start, QDateTime end)
+{
+  ui->jumpTime->setDateTimeRange(start, end);
+  ui->jumpTime->setDateTime(start);
+}
+
+// ----------------------------------------------------------------------------
+// Pass through the time to jump to
+void ReviewCtrls::JumpClicked()
+{
+  emit JumpToTime(ui->jumpTime->dateTime());
+}
+
+// ----------------------------------------------------------------------------
+// Cut the marked range out to a new log
+void ReviewCtrls::CutClicked()
+{
+  m_pMainWnd->ShowLogEditor();
+}
+
+// ----------------------------------------------------------------------------
+// Show the frames shown per second against the frames the log has per second
+// at the play speed, and how well the frame cache is doing
+void ReviewCtrls::SetPlaybackRate(double shown, double due, double hitRate, quint64 cacheBytes)
+{
+  ui->playbackRate->setText(QString::number(shown, 'f', 1) + " / " + QString::number(due, 'f', 1) + " fps");
+  ui->playbackRate->setToolTip(tr("Frames shown / frames due per second at this speed\nFrame cache: ") +
+                               QString::number(hitRate * 100.0, 'f', 0) + tr("% hits, ") +
+                               QString::number(cacheBytes / (1024.0 * 1024.0), 'f', 0) + " MB");
+}
+
 void ReviewCtrls::SetStop() {
 	ui->play->setChecked(false);
 }
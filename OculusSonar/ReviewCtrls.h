@@ -2,6 +2,7 @@
 #define REVIEWCTRLS_H
 
 #include <QWidget>
+#include <QDateTime>
 
 
 class MainView;
@@ -30,11 +31,14 @@ public:
   void SetStop();
   void EnsureChecked();
   void SetPlaybackTime(QDateTime time);
+  void SetTimeRange(QDateTime start, QDateTime end);
+  void SetPlaybackRate(double shown, double due, double hitRate, quint64 cacheBytes);
 
 signals:
   void EntryChanged(int entry);
   void LowerEntryChanged(int entry);
   void UpperEntryChanged(int entry);
+  void JumpToTime(QDateTime time);
   void OnPlay();
   void OnStop();
 
@@ -43,8 +47,11 @@ public slots:
   void LowerSliderChanged(int value);
   void UpperSliderChanged(int value);
   void RepeatChanged(bool checked);
+  void ReverseChanged(bool checked);
   void SpeedChanged(int value);
   void PlayChanged(bool checked);
+  void JumpClicked();
+  void CutClicked();
 
 private:
   Ui::ReviewCtrls *ui;
@@ -0,0 +1,483 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "ScreenRecorder.h"
+
+#include <QBuffer>
+#include <QDir>
+#include <QFileInfo>
+#include <QThread>
+
+// Start a new AVI before a file passes what AVI 1.0 players handle
+#define REC_SEGMENT_SIZE  (1024LL * 1024 * 1024)
+
+// ============================================================================
+// ScreenRecorder - background encoding of the rendered display
+
+ScreenRecorder::ScreenRecorder()
+{
+    m_format        = recAvi;
+    m_quality       = 85;
+    m_maxQueue      = 8;
+    m_nAccepted     = 0;
+    m_nWritten      = 0;
+    m_nDropped      = 0;
+    m_stopping      = false;
+    m_nextWrite     = 0;
+    m_segment       = 0;
+    m_segmentStart  = -1;
+    m_segmentFrames = 0;
+    m_lastMsecs     = 0;
+    m_failed.storeRelaxed(0);
+    m_recording     = false;
+}
+
+ScreenRecorder::~ScreenRecorder()
+{
+    Stop();
+}
+
+// ----------------------------------------------------------------------------
+// Short name for the status bar
+QString ScreenRecorder::FormatName(eRecordFormat format)
+{
+    switch (format)
+    {
+    case recAvi: return "MJPEG AVI";
+    case recPng: return "PNG sequence";
+    case recQoi: return "QOI sequence";
+    }
+
+    return "";
+}
+
+// ----------------------------------------------------------------------------
+// Stop writing after an error, the encoders keep draining the queue
+bool ScreenRecorder::RecordFailed(QString reason)
+{
+    if (m_failed.testAndSetOrdered(0, 1))
+        emit Failed(reason);
+
+    return false;
+}
+
+// ----------------------------------------------------------------------------
+// Open the outputs and start the encoders. The AVI itself is created when the
+// first frame arrives and its size is known
+bool ScreenRecorder::Start(QString baseName, eRecordFormat format, int quality)
+{
+    if (m_recording)
+        return false;
+
+    m_format        = format;
+    m_quality       = qBound(1, quality, 100);
+    m_baseName      = baseName;
+    m_nAccepted     = 0;
+    m_nWritten      = 0;
+    m_nDropped      = 0;
+    m_nextWrite     = 0;
+    m_segment       = 0;
+    m_segmentStart  = -1;
+    m_segmentFrames = 0;
+    m_lastMsecs     = 0;
+    m_failed.storeRelaxed(0);
+    m_stopping      = false;
+    m_size          = QSize();
+    m_queue.clear();
+    m_done.clear();
+
+    QString indexName;
+
+    if (m_format == recAvi)
+    {
+        m_output  = baseName + ".avi";
+        indexName = baseName + ".csv";
+    }
+    else
+    {
+        m_output  = baseName;
+        indexName = baseName + "/index.csv";
+
+        if (!QDir().mkpath(baseName))
+        {
+            emit Failed("Unable to create the recording folder '" + baseName + "'");
+            return false;
+        }
+    }
+
+    m_index.setFileName(indexName);
+
+    if (!m_index.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Text))
+    {
+        emit Failed("Unable to create the recording index '" + indexName + "'");
+        return false;
+    }
+
+    m_index.write("frame,time_ms,display_frame,file,offset,size\n");
+
+    // Enough encoders to keep up with the display, but leave the rest of the
+    // machine for the sonar. The queue only needs to cover a short stall
+    int nEncoders = qBound(1, QThread::idealThreadCount() / 2, 4);
+
+    m_maxQueue = nEncoders * 2;
+    m_pool.setMaxThreadCount(nEncoders);
+
+    for (int i = 0; i < nEncoders; i++)
+        m_pool.start([this]() { Encode(); });
+
+    m_clock.start();
+    m_recording = true;
+
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// Drain the queue and finish the files
+void ScreenRecorder::Stop()
+{
+    if (!m_recording)
+        return;
+
+    m_recording = false;
+
+    m_lock.lock();
+    m_stopping = true;
+    m_wake.wakeAll();
+    m_lock.unlock();
+
+    m_pool.waitForDone();
+
+    QMutexLocker writeLock(&m_writeLock);
+
+    if (m_avi.IsOpen())
+    {
+        double fps = 0.0;
+
+        if (m_segmentFrames > 1 && m_lastMsecs > m_segmentStart)
+            fps = (m_segmentFrames - 1) * 1000.0 / (m_lastMsecs - m_segmentStart);
+
+        if (!m_avi.Close(fps))
+            RecordFailed(m_avi.m_error);
+    }
+
+    m_index.close();
+}
+
+// ----------------------------------------------------------------------------
+// Accept a frame from the display. Never blocks: a full queue means the
+// encoders are behind and the frame is dropped
+void ScreenRecorder::AddFrame(QImage image, quint64 tag)
+{
+    if (!m_recording || image.isNull())
+        return;
+
+    if (m_failed.loadAcquire())
+        return;
+
+    QMutexLocker lock(&m_lock);
+
+    if (m_queue.size() >= m_maxQueue)
+    {
+        m_nDropped++;
+        return;
+    }
+
+    // The first frame sets the size, a resized display is scaled to match
+    if (!m_size.isValid())
+        m_size = image.size();
+
+    RecordFrame frame;
+    frame.seq   = m_nAccepted++;
+    frame.tag   = tag;
+    frame.msecs = m_clock.elapsed();
+    frame.image = image;
+
+    m_queue.enqueue(frame);
+    m_wake.wakeOne();
+}
+
+// ----------------------------------------------------------------------------
+// Encoder thread - compress frames as they arrive and hand them to the writer
+// in the order they were accepted
+void ScreenRecorder::Encode()
+{
+    forever
+    {
+        RecordFrame frame;
+        QSize size;
+
+        m_lock.lock();
+
+        while (m_queue.isEmpty() && !m_stopping)
+            m_wake.wait(&m_lock);
+
+        if (m_queue.isEmpty())
+        {
+            m_lock.unlock();
+            return;
+        }
+
+        frame = m_queue.dequeue();
+        size  = m_size;
+
+        m_lock.unlock();
+
+        QImage image = frame.image;
+        frame.image  = QImage();
+
+        if (image.size() != size)
+            image = image.scaled(size, Qt::IgnoreAspectRatio, Qt::SmoothTransformation);
+
+        switch (m_format)
+        {
+        case recAvi:
+        {
+            QBuffer buffer(&frame.data);
+            buffer.open(QIODevice::WriteOnly);
+            image.convertToFormat(QImage::Format_RGB888).save(&buffer, "JPG", m_quality);
+            break;
+        }
+        case recPng:
+        {
+            QBuffer buffer(&frame.data);
+            buffer.open(QIODevice::WriteOnly);
+            image.save(&buffer, "PNG");
+            break;
+        }
+        case recQoi:
+            frame.data = EncodeQoi(image);
+            break;
+        }
+
+        // Write whatever is now in sequence
+        QMutexLocker writeLock(&m_writeLock);
+
+        m_done.insert(frame.seq, frame);
+
+        while (!m_done.isEmpty() && m_done.firstKey() == m_nextWrite)
+        {
+            RecordFrame next = m_done.take(m_nextWrite);
+            m_nextWrite++;
+
+            if (!m_failed.loadAcquire())
+                Write(next);
+        }
+    }
+}
+
+// ----------------------------------------------------------------------------
+// Create the next AVI segment
+bool ScreenRecorder::OpenSegment()
+{
+    QString fileName = m_output;
+
+    if (m_segment > 0)
+        fileName = m_baseName + QString("_%1.avi").arg(m_segment, 3, 10, QChar('0'));
+
+    m_segmentStart  = -1;
+    m_segmentFrames = 0;
+
+    if (!m_avi.Open(fileName, m_size.width(), m_size.height()))
+        return RecordFailed(m_avi.m_error);
+
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// Write one encoded frame and its index line (called with m_writeLock held)
+bool ScreenRecorder::Write(RecordFrame& frame)
+{
+    if (frame.data.isEmpty())
+    {
+        QMutexLocker lock(&m_lock);
+        m_nDropped++;
+        return false;
+    }
+
+    QString fileName;
+    qint64  offset = 0;
+
+    if (m_format == recAvi)
+    {
+        if (m_avi.IsOpen() && m_avi.Size() > REC_SEGMENT_SIZE)
+        {
+            double fps = 0.0;
+
+            if (m_segmentFrames > 1 && m_lastMsecs > m_segmentStart)
+                fps = (m_segmentFrames - 1) * 1000.0 / (m_lastMsecs - m_segmentStart);
+
+            if (!m_avi.Close(fps))
+                return RecordFailed(m_avi.m_error);
+
+            m_segment++;
+        }
+
+        if (!m_avi.IsOpen() && !OpenSegment())
+            return false;
+
+        offset = m_avi.m_file.pos();
+
+        if (!m_avi.AddFrame(frame.data))
+            return RecordFailed(m_avi.m_error);
+
+        if (m_segmentStart < 0)
+            m_segmentStart = frame.msecs;
+
+        m_segmentFrames++;
+        fileName = QFileInfo(m_avi.m_file.fileName()).fileName();
+    }
+    else
+    {
+        fileName = QString("frame_%1.%2").arg(m_nWritten, 6, 10, QChar('0')).arg(m_format == recPng ? "png" : "qoi");
+
+        QFile file(m_output + "/" + fileName);
+
+        if (!file.open(QIODevice::WriteOnly) || file.write(frame.data) != frame.data.size())
+            return RecordFailed("Unable to write '" + file.fileName() + "': " + file.errorString());
+    }
+
+    QString line = QString("%1,%2,%3,%4,%5,%6\n")
+            .arg(m_nWritten)
+            .arg(frame.msecs)
+            .arg(frame.tag)
+            .arg(fileName)
+            .arg(offset)
+            .arg(frame.data.size());
+
+    if (m_index.write(line.toLatin1()) < 0)
+        return RecordFailed("Unable to write the recording index: " + m_index.errorString());
+
+    m_nWritten++;
+    m_lastMsecs = frame.msecs;
+
+    return true;
+}
+
+// ----------------------------------------------------------------------------
+// Encode an image as QOI (the "Quite OK Image" format): lossless, a single
+// pass with a 64 entry colour cache, several times faster than PNG. Written
+// with 3 channels, the display has no meaningful alpha
+QByteArray ScreenRecorder::EncodeQoi(const QImage& image)
+{
+    QImage rgb = image.convertToFormat(QImage::Format_RGB888);
+
+    int width  = rgb.width();
+    int height = rgb.height();
+
+    if (width < 1 || height < 1)
+        return QByteArray();
+
+    QByteArray out;
+    out.resize(14 + width * height * 4 + 8);      // Worst case
+    uchar* p = (uchar*)out.data();
+
+    memcpy(p, "qoif", 4);
+    p[4]  = (uchar)(width >> 24);
+    p[5]  = (uchar)(width >> 16);
+    p[6]  = (uchar)(width >> 8);
+    p[7]  = (uchar)width;
+    p[8]  = (uchar)(height >> 24);
+    p[9]  = (uchar)(height >> 16);
+    p[10] = (uchar)(height >> 8);
+    p[11] = (uchar)height;
+    p[12] = 3;                                      // Channels
+    p[13] = 0;                                      // sRGB
+    p += 14;
+
+    quint32 index[64] = {0};
+    quint32 prev = 0x000000FF;                      // r g b a, packed big end first
+    int     run  = 0;
+
+    for (int y = 0; y < height; y++)
+    {
+        const uchar* pLine = rgb.constScanLine(y);
+        bool lastLine = (y == height - 1);
+
+        for (int x = 0; x < width; x++, pLine += 3)
+        {
+            uchar r = pLine[0];
+            uchar g = pLine[1];
+            uchar b = pLine[2];
+            quint32 px = ((quint32)r << 24) | ((quint32)g << 16) | ((quint32)b << 8) | 0xFF;
+
+            if (px == prev)
+            {
+                run++;
+
+                if (run == 62 || (lastLine && x == width - 1))
+                {
+                    *p++ = (uchar)(0xC0 | (run - 1));
+                    run  = 0;
+                }
+                continue;
+            }
+
+            if (run > 0)
+            {
+                *p++ = (uchar)(0xC0 | (run - 1));
+                run  = 0;
+            }
+
+            int hash = (r * 3 + g * 5 + b * 7 + 255 * 11) & 63;
+
+            if (index[hash] == px)
+            {
+                *p++ = (uchar)hash;
+            }
+            else
+            {
+                index[hash] = px;
+
+                signed char vr = (signed char)(r - (uchar)(prev >> 24));
+                signed char vg = (signed char)(g - (uchar)(prev >> 16));
+                signed char vb = (signed char)(b - (uchar)(prev >> 8));
+                signed char vgr = vr - vg;
+                signed char vgb = vb - vg;
+
+                if (vr > -3 && vr < 2 && vg > -3 && vg < 2 && vb > -3 && vb < 2)
+                {
+                    *p++ = (uchar)(0x40 | ((vr + 2) << 4) | ((vg + 2) << 2) | (vb + 2));
+                }
+                else if (vgr > -9 && vgr < 8 && vg > -33 && vg < 32 && vgb > -9 && vgb < 8)
+                {
+                    *p++ = (uchar)(0x80 | (vg + 32));
+                    *p++ = (uchar)(((vgr + 8) << 4) | (vgb + 8));
+                }
+                else
+                {
+                    *p++ = 0xFE;
+                    *p++ = r;
+                    *p++ = g;
+                    *p++ = b;
+                }
+            }
+
+            prev = px;
+        }
+    }
+
+    // End marker
+    static const uchar padding[8] = {0, 0, 0, 0, 0, 0, 0, 1};
+    memcpy(p, padding, 8);
+    p += 8;
+
+    out.resize(p - (uchar*)out.data());
+
+    return out;
+}
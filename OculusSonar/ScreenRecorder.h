@@ -0,0 +1,122 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#pragma once
+
+#include <QObject>
+#include <QImage>
+#include <QThreadPool>
+#include <QMutex>
+#include <QAtomicInt>
+#include <QWaitCondition>
+#include <QQueue>
+#include <QMap>
+#include <QFile>
+#include <QElapsedTimer>
+
+#include "../RmUtil/RmAviWriter.h"
+
+// ----------------------------------------------------------------------------
+// Output formats for the screen recorder
+enum eRecordFormat
+{
+    recAvi,           // Motion JPEG AVI
+    recPng,           // Numbered PNG files
+    recQoi            // Numbered QOI files (lossless, much cheaper than PNG)
+};
+
+// ----------------------------------------------------------------------------
+// A frame on its way through the recorder
+struct RecordFrame
+{
+    quint64    seq;       // Order the frame was accepted in
+    quint64    tag;       // Display frame number
+    qint64     msecs;     // Time since the recording started
+    QImage     image;     // Frame as read back (waiting to encode)
+    QByteArray data;      // Encoded frame (waiting to write)
+};
+
+// ----------------------------------------------------------------------------
+// ScreenRecorder - records the rendered display, overlays included. Frames are
+// handed over by the display's read back into a bounded queue and encoded on
+// worker threads; a full queue drops the frame so the display never waits.
+// Encoded frames are put back in order before they are written together with
+// a CSV timing index
+
+class ScreenRecorder : public QObject
+{
+    Q_OBJECT
+
+public:
+    ScreenRecorder();
+    ~ScreenRecorder();
+
+    // Methods
+    bool Start(QString baseName, eRecordFormat format, int quality);
+    void Stop();
+
+    bool IsRecording() { return m_recording; }
+    QString Output() { return m_output; }
+
+    static QString FormatName(eRecordFormat format);
+    static QByteArray EncodeQoi(const QImage& image);
+
+    // Data
+    eRecordFormat m_format;         // Output format
+    int           m_quality;        // JPEG quality
+    int           m_maxQueue;       // Frames allowed to wait for an encoder
+    quint64       m_nAccepted;      // Frames queued for encoding
+    quint64       m_nWritten;       // Frames written
+    quint64       m_nDropped;       // Frames skipped because the queue was full
+
+public slots:
+    void AddFrame(QImage image, quint64 tag);
+
+signals:
+    void Failed(QString reason);
+
+protected:
+    void Encode();
+    bool Write(RecordFrame& frame);
+    bool OpenSegment();
+    bool RecordFailed(QString reason);
+
+    QThreadPool          m_pool;        // Encoders
+    QMutex               m_lock;        // Guards the queue
+    QWaitCondition       m_wake;        // Signals frames to encode or a stop
+    QQueue<RecordFrame>  m_queue;       // Frames waiting to be encoded
+    bool                 m_stopping;    // Encoders should drain and exit
+    QAtomicInt           m_failed;      // Writing failed, frames are discarded (read without a lock)
+
+    QMutex               m_writeLock;   // Guards everything below
+    QMap<quint64, RecordFrame> m_done;  // Encoded frames waiting for their turn
+    quint64              m_nextWrite;   // Sequence number of the next frame to write
+    RmAviWriter          m_avi;         // AVI output
+    QFile                m_index;       // Timing index
+    int                  m_segment;     // AVI file number (a new file every 1GB)
+    qint64               m_segmentStart;// Time of the first frame in the segment
+    quint32              m_segmentFrames;
+    qint64               m_lastMsecs;   // Time of the last frame written
+    QSize                m_size;        // Frame size, later frames are scaled to it
+
+    bool                 m_recording;
+    QString              m_baseName;    // Output name without an extension
+    QString              m_output;      // File or directory being written
+    QElapsedTimer        m_clock;       // Frame times
+};
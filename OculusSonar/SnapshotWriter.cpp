@@ -0,0 +1,126 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "SnapshotWriter.h"
+
+#include <QFile>
+#include <QTextStream>
+#include <QThread>
+
+// ============================================================================
+// SnapshotWriter - background snapshot encoding
+
+SnapshotWriter::SnapshotWriter()
+{
+    // Leave the rest of the machine for the sonar and the display
+    m_pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() / 2));
+}
+
+SnapshotWriter::~SnapshotWriter()
+{
+    m_pool.waitForDone();
+}
+
+// ----------------------------------------------------------------------------
+// Wait for everything queued to be written
+void SnapshotWriter::WaitForDone()
+{
+    m_pool.waitForDone();
+}
+
+// ----------------------------------------------------------------------------
+// Queue a rendered frame to be written as a PNG
+void SnapshotWriter::SaveImage(QImage image, QString fileName)
+{
+    m_pool.start([this, image, fileName]() {
+        if (image.save(fileName, "PNG"))
+            emit Saved(fileName);
+        else
+            emit Failed("Unable to save the snapshot '" + fileName + "'");
+    });
+}
+
+// ----------------------------------------------------------------------------
+// Queue the polar image at native sonar resolution: a coloured PNG, the raw
+// intensities as a PGM and a text sidecar with the range and bearing table
+void SnapshotWriter::SavePolar(QString baseName, int nRngs, int nBrgs, const uchar* pData, const short* pBrgs, double range, QDateTime time, const RmPalette& palette)
+{
+    if (!pData || nRngs < 1 || nBrgs < 1)
+        return;
+
+    // Copy what the workers need, the image buffer is reused by the next ping
+    QByteArray raw((const char*)pData, nRngs * nBrgs);
+    QVector<short> brgs;
+
+    if (pBrgs)
+        brgs = QVector<short>(pBrgs, pBrgs + nBrgs);
+
+    QImage polar(nBrgs, nRngs, QImage::Format_RGB888);
+
+    for (int r = 0; r < nRngs; r++)
+        palette.Colourise8(&pData[r * nBrgs], nBrgs, polar.scanLine(r), pixRgb);
+
+    m_pool.start([this, baseName, raw, brgs, polar, nRngs, nBrgs, range, time]() {
+        QString pngName = baseName + "_polar.png";
+        QString rawName = baseName + "_raw.pgm";
+        QString txtName = baseName + "_raw.txt";
+
+        if (!polar.save(pngName, "PNG"))
+        {
+            emit Failed("Unable to save the snapshot '" + pngName + "'");
+            return;
+        }
+
+        // Binary PGM, one row per range line
+        QFile pgm(rawName);
+
+        if (!pgm.open(QIODevice::WriteOnly))
+        {
+            emit Failed("Unable to save the snapshot data '" + rawName + "'");
+            return;
+        }
+
+        pgm.write(QString("P5\n%1 %2\n255\n").arg(nBrgs).arg(nRngs).toLatin1());
+        pgm.write(raw);
+        pgm.close();
+
+        QFile txt(txtName);
+
+        if (!txt.open(QIODevice::WriteOnly | QIODevice::Text))
+        {
+            emit Failed("Unable to save the snapshot data '" + txtName + "'");
+            return;
+        }
+
+        QTextStream out(&txt);
+
+        out << "time=" << time.toString(Qt::ISODateWithMs) << "\n";
+        out << "range=" << QString::number(range, 'f', 3) << "\n";
+        out << "ranges=" << nRngs << "\n";
+        out << "beams=" << nBrgs << "\n";
+        out << "bearings=";
+
+        for (int b = 0; b < brgs.count(); b++)
+            out << (b ? "," : "") << brgs[b];
+
+        out << "\n";
+
+        emit Saved(pngName);
+    });
+}
@@ -0,0 +1,54 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#pragma once
+
+#include <QObject>
+#include <QImage>
+#include <QThreadPool>
+#include <QDateTime>
+#include <QVector>
+
+#include "../RmUtil/RmPalette.h"
+
+// ----------------------------------------------------------------------------
+// SnapshotWriter - encodes and writes snapshots on a pool of worker threads so
+// the display never waits on the disk. Failures are reported through a signal
+// rather than a dialog
+
+class SnapshotWriter : public QObject
+{
+    Q_OBJECT
+
+public:
+    SnapshotWriter();
+    ~SnapshotWriter();
+
+    // Methods
+    void SaveImage(QImage image, QString fileName);
+    void SavePolar(QString baseName, int nRngs, int nBrgs, const uchar* pData, const short* pBrgs, double range, QDateTime time, const RmPalette& palette);
+    void WaitForDone();
+
+    // Data
+    QThreadPool m_pool;         // Encoders
+
+signals:
+    void Saved(QString fileName);
+    void Failed(QString reason);
+};
@@ -0,0 +1,270 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "RmGlGrabber.h"
+
+#include <QOpenGLContext>
+#include <QDebug>
+
+// ============================================================================
+// RmGlGrabber - asynchronous framebuffer read back
+
+RmGlGrabber::RmGlGrabber()
+{
+  memset(m_slots, 0, sizeof(m_slots));
+
+  m_next      = 0;
+  m_oldest    = 0;
+  m_init      = false;
+  m_async     = false;
+  m_nCaptured = 0;
+  m_nDropped  = 0;
+}
+
+RmGlGrabber::~RmGlGrabber()
+{
+  // The buffers belong to the context, RmglRelease must be called while it is current
+}
+
+// ----------------------------------------------------------------------------
+// Resolve the functions and decide whether reads can be asynchronous (fences
+// need GL 3.2 / ES 3.0 or the extensions)
+void RmGlGrabber::RmglInit()
+{
+  QOpenGLContext* pCtx = QOpenGLContext::currentContext();
+
+  if (!pCtx)
+    return;
+
+  initializeOpenGLFunctions();
+
+  QSurfaceFormat fmt = pCtx->format();
+
+  if (pCtx->isOpenGLES())
+    m_async = fmt.majorVersion() >= 3;
+  else
+    m_async = fmt.version() >= qMakePair(3, 2) ||
+              (pCtx->hasExtension("GL_ARB_sync") && pCtx->hasExtension("GL_ARB_pixel_buffer_object") && pCtx->hasExtension("GL_ARB_map_buffer_range"));
+
+  m_init = true;
+
+  qDebug() << "RmGlGrabber:" << (m_async ? "asynchronous (PBO + fence)" : "synchronous") << "read back";
+}
+
+// ----------------------------------------------------------------------------
+// Drop anything in flight and free the buffers
+void RmGlGrabber::RmglRelease()
+{
+  if (!m_init)
+    return;
+
+  for (int s = 0; s < GRAB_SLOTS; s++)
+  {
+    RmGlGrabSlot& slot = m_slots[s];
+
+    if (slot.m_fence)
+      glDeleteSync(slot.m_fence);
+
+    if (slot.m_pbo)
+      glDeleteBuffers(1, &slot.m_pbo);
+  }
+
+  memset(m_slots, 0, sizeof(m_slots));
+
+  m_next   = 0;
+  m_oldest = 0;
+  m_init   = false;
+}
+
+// ----------------------------------------------------------------------------
+// Number of reads in flight
+int RmGlGrabber::RmglPending()
+{
+  int n = 0;
+
+  for (int s = 0; s < GRAB_SLOTS; s++)
+    n += m_slots[s].m_busy ? 1 : 0;
+
+  return n;
+}
+
+// ----------------------------------------------------------------------------
+// Queue a read of the current viewport. When every slot is still in flight the
+// frame is dropped (mayDrop) or the oldest read is waited for
+bool RmGlGrabber::RmglCapture(quint64 tag, bool mayDrop)
+{
+  if (!m_init)
+  {
+    emit FrameDropped(tag);
+    return false;
+  }
+
+  GLint vp[4];
+  glGetIntegerv(GL_VIEWPORT, vp);
+
+  int width  = vp[2];
+  int height = vp[3];
+
+  if (width < 1 || height < 1)
+  {
+    emit FrameDropped(tag);
+    return false;
+  }
+
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+
+  // No fences - read straight into an image
+  if (!m_async)
+  {
+    QImage image(width, height, QImage::Format_RGBA8888);
+
+    glReadPixels(vp[0], vp[1], width, height, GL_RGBA, GL_UNSIGNED_BYTE, image.bits());
+
+    m_nCaptured++;
+
+    emit FrameReady(image.mirrored(), tag);
+    return true;
+  }
+
+  RmGlGrabSlot& slot = m_slots[m_next];
+
+  if (slot.m_busy)
+  {
+    // Deliver what has finished, the slot may have been freed
+    RmglPoll(false);
+
+    if (slot.m_busy)
+    {
+      if (mayDrop)
+      {
+        m_nDropped++;
+        emit FrameDropped(tag);
+        return false;
+      }
+
+      // Frames have to come out in order so everything up to this slot is collected
+      while (slot.m_busy)
+      {
+        if (!Collect(m_slots[m_oldest], true) && m_slots[m_oldest].m_busy)
+        {
+          m_nDropped++;
+          emit FrameDropped(tag);
+          return false;
+        }
+      }
+    }
+  }
+
+  int size = width * height * 4;
+
+  if (!slot.m_pbo)
+    glGenBuffers(1, &slot.m_pbo);
+
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.m_pbo);
+
+  if (size != slot.m_size)
+  {
+    glBufferData(GL_PIXEL_PACK_BUFFER, size, nullptr, GL_STREAM_READ);
+    slot.m_size = size;
+  }
+
+  glReadPixels(vp[0], vp[1], width, height, GL_RGBA, GL_UNSIGNED_BYTE, nullptr);
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+  slot.m_fence  = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+  slot.m_width  = width;
+  slot.m_height = height;
+  slot.m_tag    = tag;
+  slot.m_busy   = true;
+
+  m_next = (m_next + 1) % GRAB_SLOTS;
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Collect a slot if its fence has passed (or wait for it). The rows are flipped
+// into a top down image as they are copied out of the mapped buffer
+bool RmGlGrabber::Collect(RmGlGrabSlot& slot, bool wait)
+{
+  if (!slot.m_busy)
+    return false;
+
+  GLenum state = glClientWaitSync(slot.m_fence, GL_SYNC_FLUSH_COMMANDS_BIT, wait ? 1000000000ull : 0);
+
+  if (state == GL_TIMEOUT_EXPIRED)
+    return false;
+
+  glDeleteSync(slot.m_fence);
+  slot.m_fence = nullptr;
+  slot.m_busy  = false;
+
+  m_oldest = (m_oldest + 1) % GRAB_SLOTS;
+
+  if (state == GL_WAIT_FAILED)
+  {
+    qDebug() << "RmGlGrabber: wait failed, frame" << slot.m_tag << "lost";
+    m_nDropped++;
+    emit FrameDropped(slot.m_tag);
+    return false;
+  }
+
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, slot.m_pbo);
+
+  const uchar* pPixels = (const uchar*) glMapBufferRange(GL_PIXEL_PACK_BUFFER, 0, slot.m_size, GL_MAP_READ_BIT);
+
+  if (pPixels)
+  {
+    QImage image(slot.m_width, slot.m_height, QImage::Format_RGBA8888);
+    int    stride = slot.m_width * 4;
+
+    for (int y = 0; y < slot.m_height; y++)
+      memcpy(image.scanLine(y), &pPixels[(slot.m_height - 1 - y) * stride], stride);
+
+    glUnmapBuffer(GL_PIXEL_PACK_BUFFER);
+    glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+
+    m_nCaptured++;
+
+    emit FrameReady(image, slot.m_tag);
+    return true;
+  }
+
+  glBindBuffer(GL_PIXEL_PACK_BUFFER, 0);
+  m_nDropped++;
+
+  emit FrameDropped(slot.m_tag);
+  return false;
+}
+
+// ----------------------------------------------------------------------------
+// Deliver the finished reads in capture order, returns the number still in flight
+int RmGlGrabber::RmglPoll(bool wait)
+{
+  if (!m_init || !m_async)
+    return 0;
+
+  while (m_slots[m_oldest].m_busy)
+  {
+    if (!Collect(m_slots[m_oldest], wait) && m_slots[m_oldest].m_busy)
+      break;
+  }
+
+  return RmglPending();
+}
@@ -0,0 +1,79 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#pragma once
+
+#include <QObject>
+#include <QImage>
+#include <QOpenGLExtraFunctions>
+
+#define GRAB_SLOTS 3
+
+// ----------------------------------------------------------------------------
+// RmGlGrabSlot - one pixel pack buffer and the fence that marks its read done
+class RmGlGrabSlot
+{
+public:
+  unsigned m_pbo;        // Pixel pack buffer
+  GLsync   m_fence;      // Set when the read has been queued
+  int      m_width;      // Size of the frame in the buffer
+  int      m_height;
+  int      m_size;       // Allocated size of the buffer in bytes
+  quint64  m_tag;        // Caller's frame number
+  bool     m_busy;       // A read is in flight
+};
+
+// ----------------------------------------------------------------------------
+// RmGlGrabber - reads frames back from the current framebuffer without stalling
+// the render. Each capture queues a read into a pixel pack buffer and a fence,
+// the pixels are collected on a later frame once the fence has passed. Contexts
+// without fences / pack buffers fall back to a plain glReadPixels
+
+class RmGlGrabber : public QObject, protected QOpenGLExtraFunctions
+{
+  Q_OBJECT
+
+public:
+  RmGlGrabber();
+  ~RmGlGrabber();
+
+  // Methods (the GL context must be current)
+  void RmglInit();
+  void RmglRelease();
+  bool RmglCapture(quint64 tag, bool mayDrop);
+  int  RmglPoll(bool wait);
+
+  int  RmglPending();
+
+  // Data
+  RmGlGrabSlot m_slots[GRAB_SLOTS];    // Reads in flight
+  int          m_next;                 // Slot for the next capture
+  int          m_oldest;               // Slot that completes first
+  bool         m_init;                 // GL functions are resolved
+  bool         m_async;                // Pack buffers and fences are available
+  quint64      m_nCaptured;            // Frames delivered
+  quint64      m_nDropped;             // Frames skipped because every slot was busy
+
+protected:
+  bool Collect(RmGlGrabSlot& slot, bool wait);
+
+signals:
+  void FrameReady(QImage image, quint64 tag);
+  void FrameDropped(quint64 tag);
+};
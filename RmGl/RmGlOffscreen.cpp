@@ -0,0 +1,201 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "RmGlOffscreen.h"
+
+#include <QDebug>
+
+// ============================================================================
+// RmGlOffscreen - hosts an RmGlSurface in a framebuffer object without a window
+
+RmGlOffscreen::RmGlOffscreen()
+{
+  m_pContext   = nullptr;
+  m_pOffscreen = nullptr;
+  m_pFbo       = nullptr;
+  m_pSurface   = nullptr;
+  m_pPixels    = nullptr;
+  m_width      = 0;
+  m_height     = 0;
+}
+
+RmGlOffscreen::~RmGlOffscreen()
+{
+  RmglDestroy();
+}
+
+// ----------------------------------------------------------------------------
+// Create the context, the offscreen surface and the render target and let the
+// surface initialise its GL resources (as RmGlWidget::initializeGL would).
+// Like RmGlWidget the surface is owned from here on, even on failure
+bool RmGlOffscreen::RmglCreate(RmGlSurface* pSurface, int width, int height)
+{
+  RmglDestroy();
+
+  m_pSurface = pSurface;
+
+  if (!pSurface || width < 1 || height < 1)
+    return CreateFailed("Invalid surface or size");
+
+  m_pContext = new QOpenGLContext;
+  m_pContext->setFormat(QSurfaceFormat::defaultFormat());
+
+  if (!m_pContext->create())
+    return CreateFailed("Cannot create an OpenGL context");
+
+  m_pOffscreen = new QOffscreenSurface;
+  m_pOffscreen->setFormat(m_pContext->format());
+  m_pOffscreen->create();
+
+  if (!m_pOffscreen->isValid())
+    return CreateFailed("Cannot create an offscreen surface");
+
+  if (!m_pContext->makeCurrent(m_pOffscreen))
+    return CreateFailed("Cannot make the OpenGL context current");
+
+  m_pFbo = new QOpenGLFramebufferObject(width, height, QOpenGLFramebufferObject::CombinedDepthStencil);
+
+  if (!m_pFbo->isValid())
+    return CreateFailed("Cannot create a " + QString::number(width) + "x" + QString::number(height) + " framebuffer");
+
+  m_pPixels = (quint8*) malloc (width * height * 4);
+
+  if (!m_pPixels)
+    return CreateFailed("Cannot allocate the read back buffer");
+
+  m_width    = width;
+  m_height   = height;
+
+  m_pFbo->bind();
+
+  m_pSurface->OnCreate();
+  m_pSurface->OnResize(width, height);
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Release the surface and the GL resources (the surface needs the context to be
+// current to free its textures)
+void RmGlOffscreen::RmglDestroy()
+{
+  if (m_pContext && m_pOffscreen && m_pOffscreen->isValid())
+    m_pContext->makeCurrent(m_pOffscreen);
+
+  if (m_pSurface)
+    delete m_pSurface;
+
+  if (m_pFbo)
+    delete m_pFbo;
+
+  if (m_pContext)
+  {
+    m_pContext->doneCurrent();
+    delete m_pContext;
+  }
+
+  if (m_pOffscreen)
+    delete m_pOffscreen;
+
+  if (m_pPixels)
+    free(m_pPixels);
+
+  m_pFbo       = nullptr;
+  m_pContext   = nullptr;
+  m_pOffscreen = nullptr;
+  m_pSurface   = nullptr;
+  m_pPixels    = nullptr;
+}
+
+// ----------------------------------------------------------------------------
+// Clean up and record the reason for a failure
+bool RmGlOffscreen::CreateFailed(QString reason)
+{
+  m_error = reason;
+
+  qDebug() << "RmGlOffscreen:" << reason;
+
+  RmglDestroy();
+
+  return false;
+}
+
+// ----------------------------------------------------------------------------
+// Render the surface into the framebuffer and read it back into m_pPixels
+static bool RenderAndRead(RmGlOffscreen* pOff)
+{
+  if (!pOff->m_pFbo || !pOff->m_pSurface)
+    return false;
+
+  if (!pOff->m_pContext->makeCurrent(pOff->m_pOffscreen))
+    return false;
+
+  QOpenGLFunctions* pGl = pOff->m_pContext->functions();
+
+  pOff->m_pFbo->bind();
+  pGl->glViewport(0, 0, pOff->m_width, pOff->m_height);
+
+  pOff->m_pSurface->Render();
+
+  pGl->glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  pGl->glReadPixels(0, 0, pOff->m_width, pOff->m_height, GL_RGBA, GL_UNSIGNED_BYTE, pOff->m_pPixels);
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Render a frame into an image (top down, RGBA)
+bool RmGlOffscreen::RmglRender(QImage& image)
+{
+  if (!RenderAndRead(this))
+    return false;
+
+  if (image.width() != m_width || image.height() != m_height || image.format() != QImage::Format_RGBA8888)
+    image = QImage(m_width, m_height, QImage::Format_RGBA8888);
+
+  // GL rows are bottom up
+  for (int y = 0; y < m_height; y++)
+    memcpy(image.scanLine(y), &m_pPixels[(m_height - 1 - y) * m_width * 4], m_width * 4);
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Render a frame into a packed top down RGB buffer (width * height * 3 bytes)
+bool RmGlOffscreen::RmglRenderRgb(quint8* pRgb)
+{
+  if (!pRgb || !RenderAndRead(this))
+    return false;
+
+  for (int y = 0; y < m_height; y++)
+  {
+    const quint8* pSrc = &m_pPixels[(m_height - 1 - y) * m_width * 4];
+    quint8*       pDst = &pRgb[y * m_width * 3];
+
+    for (int x = 0; x < m_width; x++)
+    {
+      *pDst++ = pSrc[0];
+      *pDst++ = pSrc[1];
+      *pDst++ = pSrc[2];
+      pSrc += 4;
+    }
+  }
+
+  return true;
+}
@@ -0,0 +1,56 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#pragma once
+
+#include <QOffscreenSurface>
+#include <QOpenGLContext>
+#include <QOpenGLFramebufferObject>
+#include <QImage>
+
+#include "RmGlSurface.h"
+
+// ----------------------------------------------------------------------------
+// RmGlOffscreen - hosts an RmGlSurface in a framebuffer object without a window
+// so the same rendering can be used by headless tools. This is the offscreen
+// equivalent of RmGlWidget
+
+class RmGlOffscreen
+{
+public:
+  RmGlOffscreen();
+  ~RmGlOffscreen();
+
+  // Methods
+  bool RmglCreate(RmGlSurface* pSurface, int width, int height);
+  void RmglDestroy();
+  bool RmglRender(QImage& image);
+  bool RmglRenderRgb(quint8* pRgb);
+  bool CreateFailed(QString reason);
+
+  // Data
+  QOpenGLContext*           m_pContext;     // The GL context used for rendering
+  QOffscreenSurface*        m_pOffscreen;   // The (invisible) surface the context is bound to
+  QOpenGLFramebufferObject* m_pFbo;         // The render target
+  RmGlSurface*              m_pSurface;     // The surface being rendered (owned)
+  quint8*                   m_pPixels;      // Read back buffer (RGBA, bottom up)
+  int                       m_width;        // Width of the render target
+  int                       m_height;       // Height of the render target
+  QString                   m_error;        // Reason for the last failure
+};
@@ -29,27 +29,237 @@
 // RmGlTextBuffer - a buffer to store text information - this can be added to and
 // rendered by the RmGlSurface
 
-RmGlTextBuffer::RmGlTextBuffer()
+RmGlTextBuffer::RmGlTextBuffer(int maxChars, bool isStatic)
 {
-  m_pVbo   = nullptr;
-  m_nChars = 0;
+  m_pVbo     = nullptr;
+  m_nChars   = 0;
+  m_maxChars = 0;
+  m_static   = isStatic;
+  m_dirty    = false;
+  m_vboId    = 0;
+
+  // Preallocate the arena so dynamic text never reallocates in the common case
+  if (maxChars > 0)
+  {
+    Reserve(maxChars);
+    m_nChars = 0;
+  }
 }
 
 RmGlTextBuffer::~RmGlTextBuffer()
 {
-  ClearBuffer();
+  FreeBuffer();
 }
 
 // ----------------------------------------------------------------------------
-// Clear the buffer of any data
+// Clear the buffer of any data, the storage is kept for the next layout
 void RmGlTextBuffer::ClearBuffer()
 {
-  // Delete any text buffer contents
+  m_nChars = 0;
+  m_dirty  = true;
+}
+
+// ----------------------------------------------------------------------------
+// Release the client side storage (the GPU buffer is released by the surface)
+void RmGlTextBuffer::FreeBuffer()
+{
   if (m_pVbo)
-    delete m_pVbo;
+    free(m_pVbo);
 
-  m_pVbo   = nullptr;
-  m_nChars = 0;
+  m_pVbo     = nullptr;
+  m_nChars   = 0;
+  m_maxChars = 0;
+  m_dirty    = true;
+}
+
+// ----------------------------------------------------------------------------
+// Make room for nChars more characters, returns a pointer to the first free
+// character. Storage grows geometrically
+float* RmGlTextBuffer::Reserve(int nChars)
+{
+  if (m_nChars + nChars > m_maxChars)
+  {
+    int maxChars = MAX(m_maxChars * 2, 64);
+
+    while (maxChars < m_nChars + nChars)
+      maxChars *= 2;
+
+    float* pVbo = (float*) realloc (m_pVbo, maxChars * sizeof(float) * 24);
+
+    if (!pVbo)
+      return nullptr;
+
+    m_pVbo     = pVbo;
+    m_maxChars = maxChars;
+  }
+
+  float* pV = &m_pVbo[m_nChars * 24];
+
+  m_nChars += nChars;
+  m_dirty   = true;
+
+  return pV;
+}
+
+
+// ============================================================================
+// RmGlOverlayBuffer - a buffer of line primitives and labels grouped by style
+
+RmGlOverlayBuffer::RmGlOverlayBuffer()
+{
+  m_pStyles = nullptr;
+  m_nStyles = 0;
+}
+
+RmGlOverlayBuffer::~RmGlOverlayBuffer()
+{
+  for (int s = 0; s < m_nStyles; s++)
+    if (m_pStyles[s].m_pVerts)
+      free(m_pStyles[s].m_pVerts);
+
+  if (m_pStyles)
+    free(m_pStyles);
+}
+
+// ----------------------------------------------------------------------------
+// Add a new style to the buffer, returns the style index to be used when adding
+// primitives
+int RmGlOverlayBuffer::AddStyle(QColor colour, float lineWidth)
+{
+  RmGlOverlayStyle* pStyles = (RmGlOverlayStyle*) realloc (m_pStyles, (m_nStyles + 1) * sizeof(RmGlOverlayStyle));
+
+  if (!pStyles)
+    return -1;
+
+  m_pStyles = pStyles;
+
+  RmGlOverlayStyle* pStyle = &m_pStyles[m_nStyles];
+
+  pStyle->m_rgba      = colour.rgba();
+  pStyle->m_lineWidth = lineWidth;
+  pStyle->m_pVerts    = nullptr;
+  pStyle->m_nVerts    = 0;
+  pStyle->m_maxVerts  = 0;
+
+  return m_nStyles++;
+}
+
+// ----------------------------------------------------------------------------
+// Make room for nVerts more vertices in the given style, returns a pointer to
+// the first free vertex. Storage grows geometrically and is kept across clears
+float* RmGlOverlayBuffer::Reserve(int style, int nVerts)
+{
+  if (style < 0 || style >= m_nStyles)
+    return nullptr;
+
+  RmGlOverlayStyle* pStyle = &m_pStyles[style];
+
+  if (pStyle->m_nVerts + nVerts > pStyle->m_maxVerts)
+  {
+    int maxVerts = MAX(pStyle->m_maxVerts * 2, 256);
+
+    while (maxVerts < pStyle->m_nVerts + nVerts)
+      maxVerts *= 2;
+
+    float* pVerts = (float*) realloc (pStyle->m_pVerts, maxVerts * 2 * sizeof(float));
+
+    if (!pVerts)
+      return nullptr;
+
+    pStyle->m_pVerts   = pVerts;
+    pStyle->m_maxVerts = maxVerts;
+  }
+
+  float* pV = &pStyle->m_pVerts[pStyle->m_nVerts * 2];
+  pStyle->m_nVerts += nVerts;
+
+  return pV;
+}
+
+// ----------------------------------------------------------------------------
+// Add a single line segment
+void RmGlOverlayBuffer::AddLine(int style, float x0, float y0, float x1, float y1)
+{
+  float* pV = Reserve(style, 2);
+
+  if (!pV)
+    return;
+
+  *pV++ = x0; *pV++ = y0;
+  *pV++ = x1; *pV++ = y1;
+}
+
+// ----------------------------------------------------------------------------
+// Add an axis aligned box as four line segments
+void RmGlOverlayBuffer::AddBox(int style, float x0, float y0, float x1, float y1)
+{
+  float* pV = Reserve(style, 8);
+
+  if (!pV)
+    return;
+
+  *pV++ = x0; *pV++ = y0; *pV++ = x1; *pV++ = y0;
+  *pV++ = x1; *pV++ = y0; *pV++ = x1; *pV++ = y1;
+  *pV++ = x1; *pV++ = y1; *pV++ = x0; *pV++ = y1;
+  *pV++ = x0; *pV++ = y1; *pV++ = x0; *pV++ = y0;
+}
+
+// ----------------------------------------------------------------------------
+// Add a centre cross of the given half size
+void RmGlOverlayBuffer::AddCross(int style, float x, float y, float size)
+{
+  float* pV = Reserve(style, 4);
+
+  if (!pV)
+    return;
+
+  *pV++ = x - size; *pV++ = y;
+  *pV++ = x + size; *pV++ = y;
+  *pV++ = x;        *pV++ = y - size;
+  *pV++ = x;        *pV++ = y + size;
+}
+
+// ----------------------------------------------------------------------------
+// Add an open polyline (nPts x, y pairs) as a list of line segments
+void RmGlOverlayBuffer::AddPolyline(int style, float* pPts, int nPts)
+{
+  if (!pPts || nPts < 2)
+    return;
+
+  float* pV = Reserve(style, (nPts - 1) * 2);
+
+  if (!pV)
+    return;
+
+  for (int p = 0; p < nPts - 1; p++)
+  {
+    *pV++ = pPts[p * 2];
+    *pV++ = pPts[p * 2 + 1];
+    *pV++ = pPts[p * 2 + 2];
+    *pV++ = pPts[p * 2 + 3];
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Remove all primitives and labels, styles and allocations are kept for reuse
+void RmGlOverlayBuffer::ClearBuffer()
+{
+  for (int s = 0; s < m_nStyles; s++)
+    m_pStyles[s].m_nVerts = 0;
+
+  m_labels.ClearBuffer();
+}
+
+// ----------------------------------------------------------------------------
+// Total number of line vertices across all styles
+int RmGlOverlayBuffer::VertexCount()
+{
+  int nVerts = 0;
+
+  for (int s = 0; s < m_nStyles; s++)
+    nVerts += m_pStyles[s].m_nVerts;
+
+  return nVerts;
 }
 
 
@@ -70,7 +280,11 @@ RmGlSurface::RmGlSurface()
 	m_leftBrandingId = 0;
 	m_rightBrandingId = 0;
   m_overlayId      = 0;
+  m_overlayVboId   = 0;     // Overlay VBO (created on first use)
+  m_overlayVboSize = 0;
   m_showBranding = false;
+  memset(m_fontInfo, 0, sizeof(m_fontInfo));
+  memset(m_kerning, 0, sizeof(m_kerning));
   m_clearColour.setRgb(0, 0, 0);
 
 
@@ -78,6 +292,12 @@ RmGlSurface::RmGlSurface()
 
 RmGlSurface::~RmGlSurface()
 {
+  bool made;
+
+  // Without a context the objects have already gone with it
+  if (!RmglMakeCurrent(made))
+    return;
+
   // Delete the palette texture
   if (m_palTexId)
     glDeleteTextures(1, &m_palTexId);
@@ -100,6 +320,35 @@ RmGlSurface::~RmGlSurface()
 
 	if (m_rightBrandingId)
 		glDeleteTextures(1, &m_rightBrandingId);
+
+  // Delete the overlay vertex buffer
+  if (m_overlayVboId)
+    glDeleteBuffers(1, &m_overlayVboId);
+
+  if (made)
+    m_pContext->doneCurrent();
+}
+
+// ----------------------------------------------------------------------------
+// Make the surface's context current to free GL objects outside a paint (made
+// is set when the caller has to call doneCurrent). Returns false if the context
+// no longer exists
+bool RmGlSurface::RmglMakeCurrent(bool& made)
+{
+  made = false;
+
+  if (!m_pContext)
+    return false;
+
+  if (QOpenGLContext::currentContext() == m_pContext)
+    return true;
+
+  if (!m_pContext->surface() || !m_pContext->makeCurrent(m_pContext->surface()))
+    return false;
+
+  made = true;
+
+  return true;
 }
 
 // ----------------------------------------------------------------------------
@@ -108,6 +357,8 @@ void RmGlSurface::OnCreate()
 {
   initializeOpenGLFunctions();
 
+  m_pContext = QOpenGLContext::currentContext();
+
   RmglInitShaders();
   RmglInitPalette();
   RmglInitFont();
@@ -252,6 +503,27 @@ void RmGlSurface::RmglSetFont(QFont font)
         width += m_fontInfo[c].width + 2;
     }
 
+  // Cache the kerning of every glyph pair as the pair advance less the
+  // individual advances (measured in floating point so rounding does not
+  // show up as kerning)
+#if QT_VERSION >= QT_VERSION_CHECK(5, 11, 0)
+  QFontMetricsF fmf(font);
+
+  for (int a = 0; a < N_GLYPHS; a++)
+  {
+    QChar ca(a + GLYPH_BASE);
+    qreal wa = fmf.horizontalAdvance(ca);
+
+    for (int b = 0; b < N_GLYPHS; b++)
+    {
+      QChar cb(b + GLYPH_BASE);
+      qreal kern = fmf.horizontalAdvance(QString(ca) + cb) - wa - fmf.horizontalAdvance(cb);
+
+      m_kerning[a][b] = (qint8) qBound(-128, qRound(kern), 127);
+    }
+  }
+#endif
+
   // Square off the image
   if (width > 0 && height > 0)
   {
@@ -597,49 +869,70 @@ void RmGlSurface::RmglRenderVbo(float *pVbo, unsigned texId, eProgram pgm)
   glDisable(GL_BLEND);
 }
 
+// ----------------------------------------------------------------------------
+// Width of the string in pixels including kerning
+int RmGlSurface::RmglTextWidth(QString text)
+{
+  int width = 0;
+  int prev  = -1;
+
+  for (int c = 0; c < text.length(); c++)
+  {
+    int index = text.at(c).cell() - GLYPH_BASE;
+
+    if (0 <= index && index < N_GLYPHS)
+    {
+      if (prev >= 0)
+        width += m_kerning[prev][index];
+
+      width += m_fontInfo[index].width;
+      prev   = index;
+    }
+  }
+
+  return width;
+}
+
 // ----------------------------------------------------------------------------
 // Add text to the text buffer
 void RmGlSurface::RmglAddText(RmGlTextBuffer& buffer, float x, float y, float rot, QString text, unsigned ta)
 {
-  int nChars = text.length();
+  int nChars = 0;
   int c;
 
+  // Only characters in the atlas produce quads
+  for (c = 0; c < text.length(); c++)
+  {
+    int index = text.at(c).cell() - GLYPH_BASE;
+
+    if (0 <= index && index < N_GLYPHS)
+      nChars++;
+  }
+
   // Kick out if there is nothing to do
   if (nChars < 1)
     return;
 
-  // Add space into the VBO for the new text
-  buffer.m_pVbo = (float*) realloc (buffer.m_pVbo, (buffer.m_nChars + nChars) * sizeof(float) * 24);
+  // Add space into the VBO for the new text (in place if the arena is big enough)
+  float* pV = buffer.Reserve(nChars);
 
   // In case of daft strings
-  if (!buffer.m_pVbo)
+  if (!pV)
     return;
 
-  // Setup a matrix that defines the position and rotation of the text
-  QMatrix4x4 mat;
-  mat.translate(x, y);
-  mat.rotate(rot, 0.0, 0.0, 1.0);
-
-  int strWidth  = 0;
-  int strHeight = 0;
+  // The rotation is the same for every glyph in the string
+  float cosR = 1.0f;
+  float sinR = 0.0f;
 
-  // Get the size of the string in pixels
-  for (c = 0; c < nChars; c++)
+  if (rot != 0.0f)
   {
-    int index = text.at(c).cell() - GLYPH_BASE;
-
-    if (0 <= index && index < N_GLYPHS)
-    {
-      strWidth += m_fontInfo[index].width;
-      strHeight = (int)MAX(strHeight, m_fontInfo[index].height);
-    }
+    cosR = cos(qDegreesToRadians(rot));
+    sinR = sin(qDegreesToRadians(rot));
   }
 
   // Convert pixel widths into screen coordinates
-  float dx = (float)strWidth  * m_ppu;
-  float dy = (float)strHeight * m_ppuY;
-
-  float* pV = &buffer.m_pVbo[buffer.m_nChars * 24];
+  float dx = (float)RmglTextWidth(text) * m_ppu;
+  float dy = (float)m_fontInfo[0].height * m_ppuY;
 
   float cx = 0;
   float cy = 0;
@@ -656,13 +949,26 @@ void RmGlSurface::RmglAddText(RmGlTextBuffer& buffer, float x, float y, float ro
   if ((ta & taTop) == taTop)
     cy -= dy;
 
+  int prev = -1;
+
   // For each chacter we need to define the quad and the texture coordinates
-  for (c = 0; c < nChars; c++)
+  for (c = 0; c < text.length(); c++)
   {
-    GlyphInfo* pGlyph = &m_fontInfo[text.at(c).cell() - GLYPH_BASE];
+    int index = text.at(c).cell() - GLYPH_BASE;
+
+    if (index < 0 || index >= N_GLYPHS)
+      continue;
+
+    GlyphInfo* pGlyph = &m_fontInfo[index];
 
-    float dx = (float)pGlyph->width  * m_ppu;
-    float dy = (float)pGlyph->height * m_ppuY;
+    // Pull the pair together (or apart) before placing the glyph
+    if (prev >= 0)
+      cx += (float)m_kerning[prev][index] * m_ppu;
+
+    prev = index;
+
+    float gx = (float)pGlyph->width  * m_ppu;
+    float gy = (float)pGlyph->height * m_ppuY;
 
     float s0 = pGlyph->s0;
     float s1 = pGlyph->s1;
@@ -681,51 +987,47 @@ void RmGlSurface::RmglAddText(RmGlTextBuffer& buffer, float x, float y, float ro
       t1 = pGlyph->t0;
     }
 
-    QVector3D v0(cx,       cy, 1);         // BL
-    QVector3D v1(cx + dx,  cy, 1);         // BR
-    QVector3D v2(cx,       cy + dy, 1);    // TL
-    QVector3D v3(cx + dx,  cy + dy, 1);    // TR
+    // Rotate the quad corners about the text origin and translate
+    float x0 = x + cx * cosR - cy * sinR;
+    float y0 = y + cx * sinR + cy * cosR;
 
-    v0 = mat * v0;
-    v1 = mat * v1;
-    v2 = mat * v2;
-    v3 = mat * v3;
+    float ax = gx * cosR;                  // Glyph width vector
+    float ay = gx * sinR;
+    float bx = -gy * sinR;                 // Glyph height vector
+    float by = gy * cosR;
 
-    cx += dx;
+    cx += gx;
 
-    *pV++ = v0.x();         // Bottom Left X
-    *pV++ = v0.y();         // Bottom Left Y
+    *pV++ = x0;             // Bottom Left X
+    *pV++ = y0;             // Bottom Left Y
     *pV++ = s0; // Bottom Left S
     *pV++ = t1; // Bottom Left T
 
-    *pV++ = v2.x();         // Top Left X
-    *pV++ = v2.y();         // Top Left Y
+    *pV++ = x0 + bx;        // Top Left X
+    *pV++ = y0 + by;        // Top Left Y
     *pV++ = s0; // Top Left S
     *pV++ = t0; // Top Left T
 
-    *pV++ = v1.x();         // Bottom Right X
-    *pV++ = v1.y();         // Bottom Right Y
+    *pV++ = x0 + ax;        // Bottom Right X
+    *pV++ = y0 + ay;        // Bottom Right Y
     *pV++ = s1; // Bottom Right S
     *pV++ = t1; // Bottom Right T
 
-    *pV++ = v1.x();         // Bottom Right X
-    *pV++ = v1.y();         // Bottom Right Y
+    *pV++ = x0 + ax;        // Bottom Right X
+    *pV++ = y0 + ay;        // Bottom Right Y
     *pV++ = s1; // Bottom Right S
     *pV++ = t1; // Bottom Right T
 
-    *pV++ = v3.x();         // Top Right X
-    *pV++ = v3.y();         // Top Right Y
+    *pV++ = x0 + ax + bx;   // Top Right X
+    *pV++ = y0 + ay + by;   // Top Right Y
     *pV++ = s1; // Top Right S
     *pV++ = t0; // Top Right T
 
-    *pV++ = v2.x();         // Top Left X
-    *pV++ = v2.y();         // Top Left Y
+    *pV++ = x0 + bx;        // Top Left X
+    *pV++ = y0 + by;        // Top Left Y
     *pV++ = s0; // Top Left S
     *pV++ = t0; // Top Left T
-
   }
-
-  buffer.m_nChars += nChars;
 }
 
 // ----------------------------------------------------------------------------
@@ -739,14 +1041,35 @@ void RmGlSurface::RmglRenderText(RmGlTextBuffer& buffer)
 
     RmglSetPgm(pgmTexture);
 
+    const void* pPos = buffer.m_pVbo;
+    const void* pTex = &buffer.m_pVbo[2];
+
+    // Static text lives in its own GPU buffer and is only uploaded on change
+    if (buffer.m_static)
+    {
+      if (!buffer.m_vboId)
+        glGenBuffers(1, &buffer.m_vboId);
+
+      glBindBuffer(GL_ARRAY_BUFFER, buffer.m_vboId);
+
+      if (buffer.m_dirty)
+      {
+        glBufferData(GL_ARRAY_BUFFER, buffer.m_nChars * 24 * sizeof(float), buffer.m_pVbo, GL_STATIC_DRAW);
+        buffer.m_dirty = false;
+      }
+
+      pPos = nullptr;
+      pTex = (const void*)(2 * sizeof(float));
+    }
+
     // Setup vertex
     int aPosition = glGetAttribLocation(m_pgmId, "aPosition");
-    glVertexAttribPointer(aPosition, 2, GL_FLOAT, false, 4 * sizeof(float), buffer.m_pVbo);
+    glVertexAttribPointer(aPosition, 2, GL_FLOAT, false, 4 * sizeof(float), pPos);
     glEnableVertexAttribArray(aPosition);
 
     // Setup texture
     int aTexCoord = glGetAttribLocation(m_pgmId, "aTexCoords");
-    glVertexAttribPointer(aTexCoord, 2, GL_FLOAT, false, 4 * sizeof(float), &buffer.m_pVbo[2]);
+    glVertexAttribPointer(aTexCoord, 2, GL_FLOAT, false, 4 * sizeof(float), pTex);
     glEnableVertexAttribArray(aTexCoord);
 
     glEnable(GL_BLEND);
@@ -754,9 +1077,30 @@ void RmGlSurface::RmglRenderText(RmGlTextBuffer& buffer)
 
     glDrawArrays(GL_TRIANGLES, 0, 6 * buffer.m_nChars);
     glDisable(GL_BLEND);
+
+    if (buffer.m_static)
+      glBindBuffer(GL_ARRAY_BUFFER, 0);
   }
 }
 
+// ----------------------------------------------------------------------------
+// Release the GPU buffer held by a static text buffer
+void RmGlSurface::RmglReleaseText(RmGlTextBuffer& buffer)
+{
+  bool made;
+
+  if (buffer.m_vboId && RmglMakeCurrent(made))
+  {
+    glDeleteBuffers(1, &buffer.m_vboId);
+
+    if (made)
+      m_pContext->doneCurrent();
+  }
+
+  buffer.m_vboId = 0;
+  buffer.m_dirty = true;
+}
+
 // ----------------------------------------------------------------------------
 // Render a solid rectangle to the given pixel area
 void RmGlSurface::RmglRenderPixelRect(int x0, int y0, int x1, int y1, QColor colour)
@@ -1022,3 +1366,78 @@ void RmGlSurface::RmglRenderPolyline(float* pPts, int nPts, QColor colour)
 
   glDrawArrays(GL_LINES, 0, nPts);
 }
+
+// ----------------------------------------------------------------------------
+// Render an overlay buffer. All styles are streamed into one VBO (orphaned each
+// frame so the driver does not stall on the previous draw) and each style is
+// drawn with a single call, labels follow in one text draw
+void RmGlSurface::RmglRenderOverlayBuffer(RmGlOverlayBuffer& buffer)
+{
+  int nVerts = buffer.VertexCount();
+
+  if (nVerts > 0)
+  {
+    int size = nVerts * 2 * sizeof(float);
+
+    if (!m_overlayVboId)
+      glGenBuffers(1, &m_overlayVboId);
+
+    glBindBuffer(GL_ARRAY_BUFFER, m_overlayVboId);
+
+    // Grow geometrically, otherwise orphan the existing storage
+    if (size > m_overlayVboSize)
+      m_overlayVboSize = MAX(size, m_overlayVboSize * 2);
+
+    glBufferData(GL_ARRAY_BUFFER, m_overlayVboSize, nullptr, GL_STREAM_DRAW);
+
+    int offset = 0;
+
+    for (int s = 0; s < buffer.m_nStyles; s++)
+    {
+      RmGlOverlayStyle* pStyle = &buffer.m_pStyles[s];
+
+      if (pStyle->m_nVerts > 0)
+      {
+        glBufferSubData(GL_ARRAY_BUFFER, offset, pStyle->m_nVerts * 2 * sizeof(float), pStyle->m_pVerts);
+        offset += pStyle->m_nVerts * 2 * sizeof(float);
+      }
+    }
+
+    glDisable(GL_DEPTH_TEST);
+
+    RmglSetPgm(pgmSolid);
+
+    int uColour   = glGetUniformLocation(m_pgmId, "uColour");
+    int aPosition = glGetAttribLocation(m_pgmId, "aPosition");
+
+    glVertexAttribPointer(aPosition, 2, GL_FLOAT, false, 2 * sizeof(float), nullptr);
+    glEnableVertexAttribArray(aPosition);
+
+    int first = 0;
+
+    for (int s = 0; s < buffer.m_nStyles; s++)
+    {
+      RmGlOverlayStyle* pStyle = &buffer.m_pStyles[s];
+
+      if (pStyle->m_nVerts > 0)
+      {
+        QColor colour = QColor::fromRgba(pStyle->m_rgba);
+
+        glUniform4f(uColour, colour.redF(), colour.greenF(), colour.blueF(), colour.alphaF());
+        glLineWidth(pStyle->m_lineWidth);
+        glDrawArrays(GL_LINES, first, pStyle->m_nVerts);
+
+        first += pStyle->m_nVerts;
+      }
+    }
+
+    glLineWidth(1.0f);
+
+    // The rest of the renderer uses client side arrays, don't leave the
+    // attribute pointing into the VBO
+    glDisableVertexAttribArray(aPosition);
+    glBindBuffer(GL_ARRAY_BUFFER, 0);
+  }
+
+  RmglRenderText(buffer.m_labels);
+}
@@ -20,6 +20,8 @@
 #pragma once
 
 #include <QOpenGLFunctions>
+#include <QOpenGLContext>
+#include <QPointer>
 #include <QMatrix4x4>
 #include <QVector2D>
 #include <QOpenGLShaderProgram>
@@ -77,18 +79,70 @@ public:
 // ----------------------------------------------------------------------------
 // RmGlTextBuffer - a buffer to store text information - this can be added to and
 // rendered by the RmGlSurface
+// Static buffers are laid out once and kept in a GPU buffer until the text
+// changes, dynamic buffers are drawn from client memory. Either way clearing the
+// buffer keeps its storage so text can be rewritten in place
 class RmGlTextBuffer
 {
 public:
-  RmGlTextBuffer();
+  RmGlTextBuffer(int maxChars = 0, bool isStatic = false);
   ~RmGlTextBuffer();
 
   // Methods
+  void   ClearBuffer();
+  void   FreeBuffer();
+  float* Reserve(int nChars);
+
+  // Data
+  float*   m_pVbo;       // VBO for text
+  int      m_nChars;     // Number of characters in the buffer
+  int      m_maxChars;   // Number of characters allocated
+  bool     m_static;     // Keep the layout in a GPU buffer
+  bool     m_dirty;      // The GPU buffer needs to be uploaded
+  unsigned m_vboId;      // GPU buffer id (static buffers only)
+};
+
+
+// ----------------------------------------------------------------------------
+// RmGlOverlayStyle - a colour / line width pair and the line segments drawn
+// with it
+class RmGlOverlayStyle
+{
+public:
+  QRgb   m_rgba;        // Line colour
+  float  m_lineWidth;   // Line width in pixels
+  float* m_pVerts;      // Line segment vertices (x, y pairs, two per segment)
+  int    m_nVerts;      // Number of vertices used
+  int    m_maxVerts;    // Number of vertices allocated
+};
+
+
+// ----------------------------------------------------------------------------
+// RmGlOverlayBuffer - a buffer of line primitives and labels grouped by style.
+// The whole buffer is uploaded into a single VBO and rendered with one draw
+// call per style by the RmGlSurface
+class RmGlOverlayBuffer
+{
+public:
+  RmGlOverlayBuffer();
+  ~RmGlOverlayBuffer();
+
+  // Methods
+  int  AddStyle(QColor colour, float lineWidth);
+  void AddLine(int style, float x0, float y0, float x1, float y1);
+  void AddBox(int style, float x0, float y0, float x1, float y1);
+  void AddCross(int style, float x, float y, float size);
+  void AddPolyline(int style, float* pPts, int nPts);
   void ClearBuffer();
+  int  VertexCount();
 
   // Data
-  float* m_pVbo;     // VBO for text
-  int    m_nChars;   // Number of characters in the buffer
+  RmGlOverlayStyle* m_pStyles;   // The styles and their line segments
+  int               m_nStyles;   // Number of styles
+  RmGlTextBuffer    m_labels;    // Text labels rendered after the lines
+
+protected:
+  float* Reserve(int style, int nVerts);
 };
 
 
@@ -132,6 +186,9 @@ public:
   void RmglRenderVbo(float* pVbo, unsigned texId, eProgram pgm);
   void RmglAddText(RmGlTextBuffer& buffer, float x, float y, float rot, QString text, unsigned ta = (taLeft | taBottom));
   void RmglRenderText(RmGlTextBuffer& buffer);
+  void RmglReleaseText(RmGlTextBuffer& buffer);
+  bool RmglMakeCurrent(bool& made);
+  int  RmglTextWidth(QString text);
   void RmglRenderBackground(QRect rect);
   void RmglRenderOverlay();
   bool RmglLoadImageToTexture(QString imgName, unsigned& texId);
@@ -139,6 +196,7 @@ public:
   void RmglRenderLine(float x0, float y0, float x1, float y1, QColor colour);
   void RmglRenderPolyline(float* pPts, int nPts, QColor colour);
   void RmglRenderPixelRect(int x0, int y0, int x1, int y1, QColor colour);
+  void RmglRenderOverlayBuffer(RmGlOverlayBuffer& buffer);
 
 	void RmglRenderLeftBranding();
 	void RmglRenderRightBranding();
@@ -172,6 +230,7 @@ public:
   // Text generation
   unsigned  m_fontTexId;               // Palette texture id
   GlyphInfo m_fontInfo[N_GLYPHS];      // Font atlas information
+  qint8     m_kerning[N_GLYPHS][N_GLYPHS]; // Pair adjustment (pixels) to the advance of the first glyph
 
   // Shaders
   int m_pgmTexture;                    // Basic Texture
@@ -187,6 +246,13 @@ public:
   unsigned m_circleId;                 // Circle marker
   unsigned m_diamondId;                // Diamond marker
 
+  // Overlay
+  unsigned m_overlayVboId;             // Streaming VBO shared by all overlay buffers
+  int      m_overlayVboSize;           // Allocated size of the overlay VBO in bytes
+
+  // Context the GL objects were created in (freed outside a paint)
+  QPointer<QOpenGLContext> m_pContext;
+
 signals:
   void Update();
   void SetCursor(const QCursor& cursor);
@@ -32,6 +32,16 @@ RmGlWidget::RmGlWidget(QWidget* pParent)
 {
     m_pSurface = nullptr;
 
+    m_nCaptures      = 0;
+    m_captureAll     = false;
+    m_captureMayDrop = true;
+    m_frame          = 0;
+    m_lastCapture    = 0;
+
+    m_grabPoll.setSingleShot(true);
+    m_grabPoll.setInterval(5);
+    connect(&m_grabPoll, &QTimer::timeout, this, &RmGlWidget::OnGrabPoll);
+
     m_version.setObjectName("version");
     m_version.setText("Version: " + QApplication::applicationVersion());
 
@@ -43,6 +53,8 @@ RmGlWidget::~RmGlWidget()
 {
     makeCurrent();
 
+    m_grabber.RmglRelease();
+
     if (m_pSurface)
         delete m_pSurface;
 
@@ -79,10 +91,31 @@ void RmGlWidget::paintGL()
         m_pSurface->Render();
 
     }
+
+    // Hand over finished reads and queue this frame if it is being captured
+    m_grabber.RmglPoll(false);
+
+    if (m_nCaptures != 0 || m_captureAll)
+    {
+        bool mayDrop = (m_nCaptures != 0) ? m_captureMayDrop : true;
+
+        if (m_grabber.RmglCapture(m_frame, mayDrop))
+            m_lastCapture = m_frame;
+
+        if (m_nCaptures > 0)
+            m_nCaptures--;
+    }
+
+    m_frame++;
+
+    if (m_grabber.RmglPending() && !m_grabPoll.isActive())
+        m_grabPoll.start();
 }
 
 void RmGlWidget::initializeGL()
 {
+    m_grabber.RmglInit();
+
     if (m_pSurface) {
         m_pSurface->OnCreate();
 
@@ -163,3 +196,37 @@ void RmGlWidget::showBranding(bool show) {
     }
 }
 
+
+// -----------------------------------------------------------------------------
+// Capture the next nFrames drawn (-1 until called again with 0). Frames arrive
+// through m_grabber's FrameReady signal tagged with their frame number, frames
+// that can't be read back through FrameDropped. Returns the tag of the first frame
+quint64 RmGlWidget::RmglCaptureFrames(int nFrames, bool mayDrop)
+{
+    m_nCaptures      = nFrames;
+    m_captureMayDrop = mayDrop;
+
+    return m_frame;
+}
+
+// -----------------------------------------------------------------------------
+// Capture every frame drawn until disabled (used by the screen recorder). Runs
+// alongside RmglCaptureFrames so snapshots can be taken while recording
+void RmGlWidget::RmglCaptureContinuous(bool enable)
+{
+    m_captureAll = enable;
+}
+
+// -----------------------------------------------------------------------------
+// Collect reads that finished after the last frame was drawn
+void RmGlWidget::OnGrabPoll()
+{
+    makeCurrent();
+
+    int pending = m_grabber.RmglPoll(false);
+
+    doneCurrent();
+
+    if (pending)
+        m_grabPoll.start();
+}
@@ -31,6 +31,9 @@
 #include <QWindow>
 #include <QStylePainter>
 #include <QLabel>
+#include <QTimer>
+
+#include "RmGlGrabber.h"
 
 //#include "RmGlOrtho.h"
 
@@ -88,6 +91,9 @@ public:
 
 	void showBranding(bool);
 
+  quint64 RmglCaptureFrames(int nFrames, bool mayDrop);
+  void    RmglCaptureContinuous(bool enable);
+
 
   //virtual int heightForWidth(int width) const;
 
@@ -97,9 +103,19 @@ public:
 
   QLabel m_version;
 
+  // Frame capture
+  RmGlGrabber m_grabber;                // Read back of the rendered frames
+  QTimer      m_grabPoll;               // Collects reads still in flight when no frames are drawn
+  int         m_nCaptures;              // Frames still to capture (-1 = until stopped)
+  bool        m_captureMayDrop;         // Skip frames rather than wait for the read back
+  bool        m_captureAll;             // Capture every frame, dropping any the read back can't keep up with
+  quint64     m_frame;                  // Number of frames drawn (the capture tag)
+  quint64     m_lastCapture;            // Tag of the last frame queued for read back
+
 public slots:
   void OnUpdate();
   void SetCursor(const QCursor& cursor);
+  void OnGrabPoll();
 };
 
 //// ----------------------------------------------------------------------------
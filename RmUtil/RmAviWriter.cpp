@@ -0,0 +1,268 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "RmAviWriter.h"
+
+#include <QtEndian>
+
+// Offsets into the fixed header block that are patched on close
+#define AVI_RIFF_SIZE     4
+#define AVI_MICROSEC      32
+#define AVI_MAX_BYTES     36
+#define AVI_TOTAL_FRAMES  48
+#define AVI_SUGGESTED     60
+#define AVI_STRH_SCALE    128
+#define AVI_STRH_RATE     132
+#define AVI_STRH_LENGTH   140
+#define AVI_STRH_BUFFER   144
+#define AVI_MOVI_SIZE     216
+#define AVI_MOVI          220
+#define AVI_HEADER_SIZE   224
+
+#define AVIF_HASINDEX     0x10
+#define AVIIF_KEYFRAME    0x10
+
+// ----------------------------------------------------------------------------
+// Little endian helpers for building the header block
+static void PutFourCC(QByteArray& buf, const char* fourcc)
+{
+  buf.append(fourcc, 4);
+}
+
+static void Put32(QByteArray& buf, quint32 value)
+{
+  quint32 le = qToLittleEndian(value);
+  buf.append((const char*)&le, 4);
+}
+
+static void Put16(QByteArray& buf, quint16 value)
+{
+  quint16 le = qToLittleEndian(value);
+  buf.append((const char*)&le, 2);
+}
+
+// ============================================================================
+// RmAviWriter - motion JPEG AVI output
+
+RmAviWriter::RmAviWriter()
+{
+  m_width    = 0;
+  m_height   = 0;
+  m_nFrames  = 0;
+  m_maxChunk = 0;
+}
+
+RmAviWriter::~RmAviWriter()
+{
+  if (m_file.isOpen())
+    Close(25.0);
+}
+
+// ----------------------------------------------------------------------------
+// Record the failure and give up on the file
+bool RmAviWriter::WriteFailed(QString reason)
+{
+  m_error = reason + " '" + m_file.fileName() + "': " + m_file.errorString();
+  m_file.close();
+
+  return false;
+}
+
+// ----------------------------------------------------------------------------
+// Create the file and write the headers, the sizes and counts are filled in
+// by Close
+bool RmAviWriter::Open(QString fileName, int width, int height)
+{
+  if (m_file.isOpen())
+    Close(25.0);
+
+  m_width    = width;
+  m_height   = height;
+  m_nFrames  = 0;
+  m_maxChunk = 0;
+  m_index.clear();
+  m_error.clear();
+
+  m_file.setFileName(fileName);
+
+  if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+    return WriteFailed("Unable to create");
+
+  QByteArray hdr;
+  hdr.reserve(AVI_HEADER_SIZE);
+
+  PutFourCC(hdr, "RIFF");
+  Put32(hdr, 0);                        // Patched on close
+  PutFourCC(hdr, "AVI ");
+
+  PutFourCC(hdr, "LIST");
+  Put32(hdr, 192);
+  PutFourCC(hdr, "hdrl");
+
+  // Main header
+  PutFourCC(hdr, "avih");
+  Put32(hdr, 56);
+  Put32(hdr, 40000);                    // Microseconds per frame
+  Put32(hdr, 0);                        // Max bytes per second
+  Put32(hdr, 0);                        // Padding granularity
+  Put32(hdr, AVIF_HASINDEX);
+  Put32(hdr, 0);                        // Total frames
+  Put32(hdr, 0);                        // Initial frames
+  Put32(hdr, 1);                        // Streams
+  Put32(hdr, 0);                        // Suggested buffer size
+  Put32(hdr, width);
+  Put32(hdr, height);
+  for (int i = 0; i < 4; i++)
+    Put32(hdr, 0);
+
+  PutFourCC(hdr, "LIST");
+  Put32(hdr, 116);
+  PutFourCC(hdr, "strl");
+
+  // Video stream header
+  PutFourCC(hdr, "strh");
+  Put32(hdr, 56);
+  PutFourCC(hdr, "vids");
+  PutFourCC(hdr, "MJPG");
+  Put32(hdr, 0);                        // Flags
+  Put16(hdr, 0);                        // Priority
+  Put16(hdr, 0);                        // Language
+  Put32(hdr, 0);                        // Initial frames
+  Put32(hdr, 1000);                     // Scale
+  Put32(hdr, 25000);                    // Rate (rate / scale = fps)
+  Put32(hdr, 0);                        // Start
+  Put32(hdr, 0);                        // Length
+  Put32(hdr, 0);                        // Suggested buffer size
+  Put32(hdr, 0xFFFFFFFF);               // Quality (default)
+  Put32(hdr, 0);                        // Sample size
+  Put16(hdr, 0);                        // Frame rectangle
+  Put16(hdr, 0);
+  Put16(hdr, width);
+  Put16(hdr, height);
+
+  // Stream format
+  PutFourCC(hdr, "strf");
+  Put32(hdr, 40);
+  Put32(hdr, 40);                       // Structure size
+  Put32(hdr, width);
+  Put32(hdr, height);
+  Put16(hdr, 1);                        // Planes
+  Put16(hdr, 24);                       // Bit count
+  PutFourCC(hdr, "MJPG");
+  Put32(hdr, width * height * 3);
+  Put32(hdr, 0);
+  Put32(hdr, 0);
+  Put32(hdr, 0);
+  Put32(hdr, 0);
+
+  PutFourCC(hdr, "LIST");
+  Put32(hdr, 0);                        // Patched on close
+  PutFourCC(hdr, "movi");
+
+  Q_ASSERT(hdr.size() == AVI_HEADER_SIZE);
+
+  if (m_file.write(hdr) != hdr.size())
+    return WriteFailed("Unable to write");
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Append one compressed frame to the movi list
+bool RmAviWriter::AddFrame(const QByteArray& jpeg)
+{
+  if (!m_file.isOpen())
+    return false;
+
+  quint32 offset = (quint32)(m_file.pos() - AVI_MOVI);
+  quint32 size   = (quint32)jpeg.size();
+
+  QByteArray chunk;
+  chunk.reserve(8);
+  PutFourCC(chunk, "00dc");
+  Put32(chunk, size);
+
+  if (m_file.write(chunk) != 8 || m_file.write(jpeg) != jpeg.size())
+    return WriteFailed("Unable to write");
+
+  // Chunks are word aligned
+  if (size & 1)
+  {
+    if (m_file.write("\0", 1) != 1)
+      return WriteFailed("Unable to write");
+  }
+
+  PutFourCC(m_index, "00dc");
+  Put32(m_index, AVIIF_KEYFRAME);
+  Put32(m_index, offset);
+  Put32(m_index, size);
+
+  m_nFrames++;
+  m_maxChunk = qMax(m_maxChunk, size);
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Write the index and fill in the sizes, counts and the frame rate
+bool RmAviWriter::Close(double fps)
+{
+  if (!m_file.isOpen())
+    return false;
+
+  if (fps <= 0.0)
+    fps = 25.0;
+
+  qint64 idxPos = m_file.pos();
+
+  QByteArray idx;
+  PutFourCC(idx, "idx1");
+  Put32(idx, m_index.size());
+
+  if (m_file.write(idx) != idx.size() || m_file.write(m_index) != m_index.size())
+    return WriteFailed("Unable to write the index to");
+
+  qint64 end = m_file.pos();
+
+  struct { qint64 pos; quint32 value; } patches[] = {
+    { AVI_RIFF_SIZE,    (quint32)(end - 8) },
+    { AVI_MICROSEC,     (quint32)(1000000.0 / fps + 0.5) },
+    { AVI_MAX_BYTES,    (quint32)(m_maxChunk * fps) },
+    { AVI_TOTAL_FRAMES, m_nFrames },
+    { AVI_SUGGESTED,    m_maxChunk + 8 },
+    { AVI_STRH_SCALE,   1000 },
+    { AVI_STRH_RATE,    (quint32)(fps * 1000.0 + 0.5) },
+    { AVI_STRH_LENGTH,  m_nFrames },
+    { AVI_STRH_BUFFER,  m_maxChunk + 8 },
+    { AVI_MOVI_SIZE,    (quint32)(idxPos - (AVI_MOVI_SIZE + 4)) }
+  };
+
+  for (auto& patch : patches)
+  {
+    quint32 le = qToLittleEndian(patch.value);
+
+    if (!m_file.seek(patch.pos) || m_file.write((const char*)&le, 4) != 4)
+      return WriteFailed("Unable to update the headers of");
+  }
+
+  m_file.close();
+  m_index.clear();
+
+  return true;
+}
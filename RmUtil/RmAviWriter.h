@@ -0,0 +1,56 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#pragma once
+
+#include <QFile>
+#include <QByteArray>
+
+// ----------------------------------------------------------------------------
+// RmAviWriter - writes a motion JPEG stream into a RIFF AVI 1.0 container. The
+// frames are compressed by the caller, this only lays out the chunks and the
+// idx1 index. The frame rate is patched into the headers when the file is
+// closed so a variable capture rate can be written as its measured average
+
+class RmAviWriter
+{
+public:
+  RmAviWriter();
+  ~RmAviWriter();
+
+  // Methods
+  bool Open(QString fileName, int width, int height);
+  bool AddFrame(const QByteArray& jpeg);
+  bool Close(double fps);
+
+  qint64 Size() { return m_file.size(); }
+  bool   IsOpen() { return m_file.isOpen(); }
+
+  // Data
+  QFile      m_file;          // The AVI being written
+  int        m_width;         // Frame size
+  int        m_height;
+  quint32    m_nFrames;       // Frames in the movi list
+  quint32    m_maxChunk;      // Largest frame (the suggested buffer size)
+  QByteArray m_index;         // idx1 entries, written at the end
+  QString    m_error;         // Reason for the last failure
+
+protected:
+  bool WriteFailed(QString reason);
+};
@@ -0,0 +1,1091 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "RmCodec.h"
+
+#include <string.h>
+#include <stdlib.h>
+#include <math.h>
+#include <queue>
+#include <vector>
+
+#define LZ_HASH_BITS      12
+#define LZ_MIN_MATCH      4
+#define LZ_LAST_LITERALS  5           // The block always ends in literals...
+#define LZ_MF_LIMIT       12          // ...and no match starts this close to the end
+#define LZ_MAX_OFFSET     65535
+
+#define HUFF_MAX_BITS     12          // Longest code (sets the decode table size)
+#define HUFF_TABLE_SIZE   (1 << HUFF_MAX_BITS)
+#define HUFF_HEADER       128         // 256 code lengths, 4 bits each
+
+#define SONAR_VERSION     1
+
+// ----------------------------------------------------------------------------
+// Unaligned little endian access
+static inline quint32 Read32(const quint8* p)
+{
+  quint32 v;
+  memcpy(&v, p, 4);
+  return v;
+}
+
+static inline void Write32(quint8* p, quint32 v)
+{
+  memcpy(p, &v, 4);
+}
+
+// ============================================================================
+// LZ4 block format - greedy single hash compressor, bounds checked decoder
+
+static inline unsigned LzHash(quint32 v)
+{
+  return (v * 2654435761u) >> (32 - LZ_HASH_BITS);
+}
+
+// Lengths of 15 and over continue in 255 steps
+static inline quint8* LzLength(quint8* op, unsigned len)
+{
+  len -= 15;
+
+  while (len >= 255)
+  {
+    *op++ = 255;
+    len  -= 255;
+  }
+
+  *op++ = (quint8) len;
+
+  return op;
+}
+
+// ----------------------------------------------------------------------------
+// Largest possible output for an input of size bytes
+unsigned RmCodec::LzBound(unsigned size)
+{
+  return size + size / 255 + 16;
+}
+
+// ----------------------------------------------------------------------------
+// Compress into pDst (at least LzBound bytes). Returns the compressed size
+unsigned RmCodec::LzCompress(const quint8* pSrc, unsigned size, quint8* pDst, unsigned capacity)
+{
+  if (capacity < LzBound(size))
+    return 0;
+
+  quint32 table[1 << LZ_HASH_BITS];     // Position + 1 of the last sequence with each hash
+  memset(table, 0, sizeof(table));
+
+  const quint8* ip     = pSrc;
+  const quint8* anchor = pSrc;
+  const quint8* end    = pSrc + size;
+  quint8*       op     = pDst;
+
+  if (size > LZ_MF_LIMIT)
+  {
+    const quint8* mfLimit    = end - LZ_MF_LIMIT;
+    const quint8* matchLimit = end - LZ_LAST_LITERALS;
+
+    while (ip < mfLimit)
+    {
+      quint32  seq = Read32(ip);
+      unsigned h   = LzHash(seq);
+      quint32  pos = table[h];
+
+      table[h] = (quint32) (ip - pSrc) + 1;
+
+      const quint8* ref = pSrc + pos - 1;
+
+      if (pos == 0 || ip - ref > LZ_MAX_OFFSET || Read32(ref) != seq)
+      {
+        // Step faster through data that isn't matching
+        ip += 1 + ((ip - anchor) >> 6);
+        continue;
+      }
+
+      // Extend backwards into the pending literals, then forwards
+      while (ip > anchor && ref > pSrc && ip[-1] == ref[-1])
+      {
+        ip--;
+        ref--;
+      }
+
+      const quint8* mp = ip + LZ_MIN_MATCH;
+      const quint8* mr = ref + LZ_MIN_MATCH;
+
+      while (mp < matchLimit && *mp == *mr)
+      {
+        mp++;
+        mr++;
+      }
+
+      unsigned litLen   = (unsigned) (ip - anchor);
+      unsigned matchLen = (unsigned) (mp - ip) - LZ_MIN_MATCH;
+      unsigned offset   = (unsigned) (ip - ref);
+
+      quint8* token = op++;
+      *token = (quint8) ((litLen >= 15 ? 15 : litLen) << 4);
+
+      if (litLen >= 15)
+        op = LzLength(op, litLen);
+
+      memcpy(op, anchor, litLen);
+      op += litLen;
+
+      *op++ = (quint8) offset;
+      *op++ = (quint8) (offset >> 8);
+
+      *token |= (quint8) (matchLen >= 15 ? 15 : matchLen);
+
+      if (matchLen >= 15)
+        op = LzLength(op, matchLen);
+
+      ip     = mp;
+      anchor = ip;
+
+      // Seed the table from inside the match so runs chain together
+      table[LzHash(Read32(ip - 2))] = (quint32) (ip - 2 - pSrc) + 1;
+    }
+  }
+
+  // Final literals
+  unsigned litLen = (unsigned) (end - anchor);
+
+  *op++ = (quint8) ((litLen >= 15 ? 15 : litLen) << 4);
+
+  if (litLen >= 15)
+    op = LzLength(op, litLen);
+
+  if (litLen)
+    memcpy(op, anchor, litLen);
+
+  op += litLen;
+
+  return (unsigned) (op - pDst);
+}
+
+// ----------------------------------------------------------------------------
+// Decode into dstSize bytes. The whole block must decode to exactly that many,
+// unless only a prefix is wanted - then decoding stops once it is filled
+static bool LzDecode(const quint8* pSrc, unsigned size, quint8* pDst, unsigned dstSize, bool prefix)
+{
+  const quint8* ip   = pSrc;
+  const quint8* iend = pSrc + size;
+  quint8*       op   = pDst;
+  quint8*       oend = pDst + dstSize;
+
+  while (ip < iend)
+  {
+    unsigned token  = *ip++;
+    size_t   litLen = token >> 4;
+
+    if (litLen == 15)
+    {
+      quint8 b;
+
+      do
+      {
+        if (ip >= iend)
+          return false;
+
+        b = *ip++;
+        litLen += b;
+      }
+      while (b == 255);
+    }
+
+    if (litLen > (size_t) (iend - ip))
+      return false;
+
+    if (litLen > (size_t) (oend - op))
+    {
+      if (!prefix)
+        return false;
+
+      memcpy(op, ip, oend - op);
+      return true;
+    }
+
+    memcpy(op, ip, litLen);
+    op += litLen;
+    ip += litLen;
+
+    if (prefix && op == oend)
+      return true;
+
+    // The last sequence has no match
+    if (ip >= iend)
+      break;
+
+    if (iend - ip < 2)
+      return false;
+
+    size_t offset = ip[0] | (ip[1] << 8);
+    ip += 2;
+
+    if (offset == 0 || offset > (size_t) (op - pDst))
+      return false;
+
+    size_t matchLen = token & 15;
+
+    if (matchLen == 15)
+    {
+      quint8 b;
+
+      do
+      {
+        if (ip >= iend)
+          return false;
+
+        b = *ip++;
+        matchLen += b;
+      }
+      while (b == 255);
+    }
+
+    matchLen += LZ_MIN_MATCH;
+
+    if (matchLen > (size_t) (oend - op))
+    {
+      if (!prefix)
+        return false;
+
+      matchLen = oend - op;
+    }
+
+    const quint8* match = op - offset;
+
+    if (offset >= matchLen)
+      memcpy(op, match, matchLen);
+    else
+    {
+      // Overlapping copy repeats the pattern
+      for (size_t i = 0; i < matchLen; i++)
+        op[i] = match[i];
+    }
+
+    op += matchLen;
+
+    if (prefix && op == oend)
+      return true;
+  }
+
+  return op == oend;
+}
+
+// ----------------------------------------------------------------------------
+// Decompress exactly dstSize bytes, false on any malformed input
+bool RmCodec::LzDecompress(const quint8* pSrc, unsigned size, quint8* pDst, unsigned dstSize)
+{
+  return LzDecode(pSrc, size, pDst, dstSize, false);
+}
+
+// ----------------------------------------------------------------------------
+// Decompress only the first prefix bytes
+bool RmCodec::LzDecompressPrefix(const quint8* pSrc, unsigned size, quint8* pDst, unsigned prefix)
+{
+  return LzDecode(pSrc, size, pDst, prefix, true);
+}
+
+// ============================================================================
+// Canonical Huffman coding - code lengths limited to HUFF_MAX_BITS so the
+// decoder is a single table lookup per symbol. Bits are packed LSB first
+
+struct HuffNode
+{
+  quint64 freq;
+  int     index;
+
+  bool operator<(const HuffNode& other) const { return freq > other.freq; }
+};
+
+// ----------------------------------------------------------------------------
+// Code lengths from symbol counts
+static void HuffLengths(const quint64* pFreq, quint8* pLengths)
+{
+  quint64 freq[256];
+  memcpy(freq, pFreq, sizeof(freq));
+
+  forever
+  {
+    memset(pLengths, 0, 256);
+
+    std::priority_queue<HuffNode> heap;
+    int parent[512];
+    int nNodes = 256;
+
+    for (int s = 0; s < 256; s++)
+    {
+      parent[s] = -1;
+
+      if (freq[s])
+        heap.push({ freq[s], s });
+    }
+
+    if (heap.size() == 1)
+    {
+      pLengths[heap.top().index] = 1;
+      return;
+    }
+
+    while (heap.size() > 1)
+    {
+      HuffNode a = heap.top(); heap.pop();
+      HuffNode b = heap.top(); heap.pop();
+
+      parent[a.index] = nNodes;
+      parent[b.index] = nNodes;
+      parent[nNodes]  = -1;
+
+      heap.push({ a.freq + b.freq, nNodes++ });
+    }
+
+    int maxLen = 0;
+
+    for (int s = 0; s < 256; s++)
+    {
+      if (!freq[s])
+        continue;
+
+      int len = 0;
+
+      for (int n = s; parent[n] >= 0; n = parent[n])
+        len++;
+
+      pLengths[s] = (quint8) len;
+      maxLen = qMax(maxLen, len);
+    }
+
+    if (maxLen <= HUFF_MAX_BITS)
+      return;
+
+    // Too deep - flatten the distribution and try again
+    for (int s = 0; s < 256; s++)
+      if (freq[s])
+        freq[s] = (freq[s] >> 1) | 1;
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Canonical codes (bit reversed for LSB first packing) from code lengths.
+// Returns false if the lengths do not form a valid prefix code
+static bool HuffCodes(const quint8* pLengths, quint16* pCodes)
+{
+  int count[HUFF_MAX_BITS + 1] = {0};
+  int next[HUFF_MAX_BITS + 2]  = {0};
+
+  for (int s = 0; s < 256; s++)
+  {
+    if (pLengths[s] > HUFF_MAX_BITS)
+      return false;
+
+    count[pLengths[s]]++;
+  }
+
+  count[0] = 0;
+
+  int code  = 0;
+  int kraft = 0;
+
+  for (int len = 1; len <= HUFF_MAX_BITS; len++)
+  {
+    code = (code + count[len - 1]) << 1;
+    next[len] = code;
+    kraft += count[len] << (HUFF_MAX_BITS - len);
+  }
+
+  if (kraft > HUFF_TABLE_SIZE)
+    return false;
+
+  for (int s = 0; s < 256; s++)
+  {
+    int len = pLengths[s];
+
+    if (!len)
+      continue;
+
+    int c   = next[len]++;
+    int rev = 0;
+
+    for (int b = 0; b < len; b++)
+      rev |= ((c >> b) & 1) << (len - 1 - b);
+
+    pCodes[s] = (quint16) rev;
+  }
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Largest possible output for an input of size bytes
+unsigned RmCodec::HuffBound(unsigned size)
+{
+  return HUFF_HEADER + (unsigned) (((quint64) size * HUFF_MAX_BITS + 7) / 8) + 8;
+}
+
+// ----------------------------------------------------------------------------
+// Code the bytes, the output size is needed to decode. Returns the compressed
+// size, 0 if it didn't fit in capacity
+unsigned RmCodec::HuffCompress(const quint8* pSrc, unsigned size, quint8* pDst, unsigned capacity)
+{
+  if (capacity < HUFF_HEADER)
+    return 0;
+
+  quint64 freq[256] = {0};
+
+  for (unsigned i = 0; i < size; i++)
+    freq[pSrc[i]]++;
+
+  quint8  lengths[256];
+  quint16 codes[256] = {0};
+
+  HuffLengths(freq, lengths);
+  HuffCodes(lengths, codes);
+
+  for (int s = 0; s < 256; s += 2)
+    pDst[s >> 1] = (quint8) (lengths[s] | (lengths[s + 1] << 4));
+
+  quint8* op   = pDst + HUFF_HEADER;
+  quint8* oend = pDst + capacity;
+
+  quint64  bits  = 0;
+  unsigned nBits = 0;
+
+  for (unsigned i = 0; i < size; i++)
+  {
+    quint8 s = pSrc[i];
+
+    bits  |= (quint64) codes[s] << nBits;
+    nBits += lengths[s];
+
+    if (nBits >= 32)
+    {
+      if (oend - op < 4)
+        return 0;
+
+      Write32(op, (quint32) bits);
+      op    += 4;
+      bits >>= 32;
+      nBits -= 32;
+    }
+  }
+
+  while (nBits > 0)
+  {
+    if (op >= oend)
+      return 0;
+
+    *op++  = (quint8) bits;
+    bits >>= 8;
+    nBits  = (nBits > 8) ? nBits - 8 : 0;
+  }
+
+  return (unsigned) (op - pDst);
+}
+
+// ----------------------------------------------------------------------------
+// Decode dstSize bytes, false on any malformed input
+bool RmCodec::HuffDecompress(const quint8* pSrc, unsigned size, quint8* pDst, unsigned dstSize)
+{
+  if (size < HUFF_HEADER)
+    return false;
+
+  if (dstSize == 0)
+    return true;
+
+  quint8  lengths[256];
+  quint16 codes[256] = {0};
+
+  for (int s = 0; s < 256; s += 2)
+  {
+    lengths[s]     = pSrc[s >> 1] & 0x0F;
+    lengths[s + 1] = pSrc[s >> 1] >> 4;
+  }
+
+  if (!HuffCodes(lengths, codes))
+    return false;
+
+  // Every HUFF_MAX_BITS wide bit pattern maps to the symbol it starts with
+  quint16 table[HUFF_TABLE_SIZE];
+  memset(table, 0, sizeof(table));
+
+  for (int s = 0; s < 256; s++)
+  {
+    int len = lengths[s];
+
+    if (!len)
+      continue;
+
+    for (int i = codes[s]; i < HUFF_TABLE_SIZE; i += (1 << len))
+      table[i] = (quint16) (s | (len << 8));
+  }
+
+  const quint8* ip   = pSrc + HUFF_HEADER;
+  const quint8* iend = pSrc + size;
+
+  quint64  bits  = 0;
+  unsigned nBits = 0;
+
+  unsigned i = 0;
+
+  // Fast path - refill to at least 56 bits with one load and decode four
+  // symbols (4 x HUFF_MAX_BITS <= 56) between refills
+  while (i + 4 <= dstSize && iend - ip >= 8)
+  {
+    quint64 word;
+    memcpy(&word, ip, 8);
+
+    bits  |= word << nBits;
+    ip    += (63 - nBits) >> 3;
+    nBits |= 56;
+
+    for (int k = 0; k < 4; k++)
+    {
+      unsigned entry = table[bits & (HUFF_TABLE_SIZE - 1)];
+      unsigned len   = entry >> 8;
+
+      if (len == 0)
+        return false;
+
+      pDst[i++] = (quint8) entry;
+      bits  >>= len;
+      nBits  -= len;
+    }
+  }
+
+  for (; i < dstSize; i++)
+  {
+    if (nBits < HUFF_MAX_BITS)
+    {
+      while (nBits <= 56 && ip < iend)
+      {
+        bits  |= (quint64) *ip++ << nBits;
+        nBits += 8;
+      }
+    }
+
+    unsigned entry = table[bits & (HUFF_TABLE_SIZE - 1)];
+    unsigned len   = entry >> 8;
+
+    if (len == 0 || len > nBits)
+      return false;
+
+    pDst[i] = (quint8) entry;
+    bits  >>= len;
+    nBits  -= len;
+  }
+
+  return true;
+}
+
+// ============================================================================
+// Sonar image codec. Each byte is predicted from the range line before it, or
+// from its neighbours on both lines (the LOCO-I median edge predictor), and the
+// residuals are Huffman coded. The predictor is picked per image from a sample
+// of lines - speckle dominated images code best without one. Bytes either side
+// of the image are LZ coded.
+//
+//   u8  version
+//   u8  predictor
+//   u32 offset, lineBytes, lines, sampleBytes
+//   u32 size + LZ block      bytes before the image
+//   u32 size + Huffman block image residuals
+//   u32 size + LZ block      bytes after the image
+
+enum eSonarPredictor
+{
+  predNone,             // Bytes as they are
+  predUp,               // Delta from the previous range line
+  predMed               // Median edge predictor (left, up, up-left)
+};
+
+static inline quint8 MedPredict(int a, int b, int c)
+{
+  int lo = qMin(a, b);
+  int hi = qMax(a, b);
+
+  return (quint8) ((c >= hi) ? lo : (c <= lo) ? hi : a + b - c);
+}
+
+// ----------------------------------------------------------------------------
+// Residuals for one range line (pUp is nullptr for the first line)
+static void ResidualLine(const quint8* pLine, const quint8* pUp, unsigned n, unsigned step, int pred, quint8* pOut)
+{
+  if (pred == predNone)
+  {
+    memcpy(pOut, pLine, n);
+    return;
+  }
+
+  // The first line is coded as a delta along the line
+  if (!pUp)
+  {
+    for (unsigned j = 0; j < n; j++)
+      pOut[j] = (quint8) (pLine[j] - ((j >= step) ? pLine[j - step] : 0));
+    return;
+  }
+
+  if (pred == predUp)
+  {
+    for (unsigned j = 0; j < n; j++)
+      pOut[j] = (quint8) (pLine[j] - pUp[j]);
+    return;
+  }
+
+  unsigned j = 0;
+
+  for (; j < step && j < n; j++)
+    pOut[j] = (quint8) (pLine[j] - pUp[j]);
+
+  for (; j < n; j++)
+    pOut[j] = (quint8) (pLine[j] - MedPredict(pLine[j - step], pUp[j], pUp[j - step]));
+}
+
+// ----------------------------------------------------------------------------
+// Rebuild one range line from its residuals
+static void ReconstructLine(const quint8* pRes, const quint8* pUp, unsigned n, unsigned step, int pred, quint8* pLine)
+{
+  if (pred == predNone)
+  {
+    memcpy(pLine, pRes, n);
+    return;
+  }
+
+  if (!pUp)
+  {
+    for (unsigned j = 0; j < n; j++)
+      pLine[j] = (quint8) (pRes[j] + ((j >= step) ? pLine[j - step] : 0));
+    return;
+  }
+
+  if (pred == predUp)
+  {
+    for (unsigned j = 0; j < n; j++)
+      pLine[j] = (quint8) (pRes[j] + pUp[j]);
+    return;
+  }
+
+  unsigned j = 0;
+
+  for (; j < step && j < n; j++)
+    pLine[j] = (quint8) (pRes[j] + pUp[j]);
+
+  for (; j < n; j++)
+    pLine[j] = (quint8) (pRes[j] + MedPredict(pLine[j - step], pUp[j], pUp[j - step]));
+}
+
+// ----------------------------------------------------------------------------
+// Order 0 entropy estimate (bits) of a histogram
+static double Entropy(const quint32* pHist, quint64 total)
+{
+  double bits = 0.0;
+
+  for (int s = 0; s < 256; s++)
+  {
+    if (pHist[s])
+      bits -= pHist[s] * log2((double) pHist[s] / total);
+  }
+
+  return bits;
+}
+
+// ----------------------------------------------------------------------------
+// Pick the predictor that gives the lowest entropy over a sample of lines
+static int ChoosePredictor(const quint8* pImg, unsigned lineBytes, unsigned lines, unsigned step, quint8* pScratch)
+{
+  quint32 hist[3][256];
+  memset(hist, 0, sizeof(hist));
+
+  quint64  total = 0;
+  unsigned every = qMax(1u, lines / 32);
+
+  for (unsigned r = 1; r < lines; r += every)
+  {
+    const quint8* pLine = pImg + (size_t) r * lineBytes;
+
+    for (int pred = predNone; pred <= predMed; pred++)
+    {
+      ResidualLine(pLine, pLine - lineBytes, lineBytes, step, pred, pScratch);
+
+      for (unsigned j = 0; j < lineBytes; j++)
+        hist[pred][pScratch[j]]++;
+    }
+
+    total += lineBytes;
+  }
+
+  if (total == 0)
+    return predUp;
+
+  int    best     = predNone;
+  double bestBits = Entropy(hist[predNone], total);
+
+  for (int pred = predUp; pred <= predMed; pred++)
+  {
+    double bits = Entropy(hist[pred], total);
+
+    if (bits < bestBits)
+    {
+      best     = pred;
+      bestBits = bits;
+    }
+  }
+
+  return best;
+}
+
+// ----------------------------------------------------------------------------
+// Append a length prefixed LZ block
+static void AppendLz(QByteArray& out, const quint8* pSrc, unsigned size)
+{
+  int at = out.size();
+
+  out.resize(at + 4 + RmCodec::LzBound(size));
+
+  unsigned n = RmCodec::LzCompress(pSrc, size, (quint8*) out.data() + at + 4, RmCodec::LzBound(size));
+
+  Write32((quint8*) out.data() + at, n);
+  out.resize(at + 4 + n);
+}
+
+// ----------------------------------------------------------------------------
+// Check and step over a length prefixed block
+static const quint8* NextBlock(const quint8*& ip, const quint8* iend, unsigned& size)
+{
+  if (iend - ip < 4)
+    return nullptr;
+
+  size = Read32(ip);
+  ip  += 4;
+
+  if (size > (unsigned) (iend - ip))
+    return nullptr;
+
+  const quint8* pBlock = ip;
+  ip += size;
+
+  return pBlock;
+}
+
+static bool LzFn(const quint8* pSrc, unsigned size, const RmCodecLayout*, QByteArray& out)
+{
+  out.resize(RmCodec::LzBound(size));
+  out.resize(RmCodec::LzCompress(pSrc, size, (quint8*) out.data(), out.size()));
+
+  return out.size() > 0;
+}
+
+static bool SonarFn(const quint8* pSrc, unsigned size, const RmCodecLayout* pLayout, QByteArray& out)
+{
+  // Without an image to predict the sonar codec is plain LZ
+  if (!pLayout || pLayout->lineBytes == 0 || pLayout->lines == 0 ||
+      (quint64) pLayout->offset + (quint64) pLayout->lineBytes * pLayout->lines > size)
+    return LzFn(pSrc, size, pLayout, out);
+
+  unsigned step     = qBound(1u, pLayout->sampleBytes, 4u);
+  unsigned imgBytes = pLayout->lineBytes * pLayout->lines;
+  unsigned tail     = pLayout->offset + imgBytes;
+
+  quint8* pRes = (quint8*) malloc(imgBytes);
+
+  if (!pRes)
+    return false;
+
+  const quint8* pImg = pSrc + pLayout->offset;
+  unsigned      n    = pLayout->lineBytes;
+
+  int pred = ChoosePredictor(pImg, n, pLayout->lines, step, pRes);
+
+  for (unsigned r = 0; r < pLayout->lines; r++)
+    ResidualLine(pImg + (size_t) r * n, r ? pImg + (size_t) (r - 1) * n : nullptr, n, step, pred, pRes + (size_t) r * n);
+
+  out.clear();
+  out.reserve(64 + imgBytes);
+  out.append((char) SONAR_VERSION);
+  out.append((char) pred);
+
+  quint8 hdr[16];
+  Write32(hdr,      pLayout->offset);
+  Write32(hdr + 4,  pLayout->lineBytes);
+  Write32(hdr + 8,  pLayout->lines);
+  Write32(hdr + 12, step);
+  out.append((const char*) hdr, 16);
+
+  AppendLz(out, pSrc, pLayout->offset);
+
+  int at = out.size();
+  unsigned bound = RmCodec::HuffBound(imgBytes);
+
+  out.resize(at + 4 + bound);
+
+  n = RmCodec::HuffCompress(pRes, imgBytes, (quint8*) out.data() + at + 4, bound);
+
+  free(pRes);
+
+  if (n == 0)
+    return false;
+
+  Write32((quint8*) out.data() + at, n);
+  out.resize(at + 4 + n);
+
+  AppendLz(out, pSrc + tail, size - tail);
+
+  return true;
+}
+
+static bool ZlibFn(const quint8* pSrc, unsigned size, const RmCodecLayout*, QByteArray& out)
+{
+  out = qCompress(pSrc, size, 1);
+
+  return !out.isEmpty();
+}
+
+static bool LzDecodeFn(const quint8* pSrc, unsigned size, quint8* pDst, unsigned dstSize)
+{
+  return RmCodec::LzDecompress(pSrc, size, pDst, dstSize);
+}
+
+static bool SonarDecodeFn(const quint8* pSrc, unsigned size, quint8* pDst, unsigned dstSize)
+{
+  // Plain LZ when there was no image. Telling the two apart by the first byte
+  // is only safe because an LZ block never starts with SONAR_VERSION (0x01):
+  // its first token is 0x00 for an empty block, otherwise it carries at least
+  // one literal (a match can't reach back to the first byte) so it is >= 0x10
+  if (size == 0 || pSrc[0] != SONAR_VERSION)
+    return RmCodec::LzDecompress(pSrc, size, pDst, dstSize);
+
+  if (size < 18)
+    return false;
+
+  int      pred      = pSrc[1];
+  unsigned offset    = Read32(pSrc + 2);
+  unsigned lineBytes = Read32(pSrc + 6);
+  unsigned lines     = Read32(pSrc + 10);
+  unsigned step      = Read32(pSrc + 14);
+
+  if (pred > predMed || step < 1 || step > 4 || (quint64) offset + (quint64) lineBytes * lines > dstSize)
+    return false;
+
+  unsigned imgBytes = lineBytes * lines;
+  unsigned tail     = offset + imgBytes;
+
+  const quint8* ip   = pSrc + 18;
+  const quint8* iend = pSrc + size;
+  unsigned n;
+
+  const quint8* pHead = NextBlock(ip, iend, n);
+
+  if (!pHead || !RmCodec::LzDecompress(pHead, n, pDst, offset))
+    return false;
+
+  const quint8* pCoded = NextBlock(ip, iend, n);
+
+  if (!pCoded)
+    return false;
+
+  quint8* pImg = pDst + offset;
+
+  if (pred == predNone)
+  {
+    // The residuals are the image
+    if (!RmCodec::HuffDecompress(pCoded, n, pImg, imgBytes))
+      return false;
+  }
+  else
+  {
+    quint8* pRes = (quint8*) malloc(imgBytes ? imgBytes : 1);
+
+    if (!pRes)
+      return false;
+
+    bool ok = RmCodec::HuffDecompress(pCoded, n, pRes, imgBytes);
+
+    if (ok)
+    {
+      for (unsigned r = 0; r < lines; r++)
+        ReconstructLine(pRes + (size_t) r * lineBytes, r ? pImg + (size_t) (r - 1) * lineBytes : nullptr,
+                        lineBytes, step, pred, pImg + (size_t) r * lineBytes);
+    }
+
+    free(pRes);
+
+    if (!ok)
+      return false;
+  }
+
+  const quint8* pTail = NextBlock(ip, iend, n);
+
+  return pTail && RmCodec::LzDecompress(pTail, n, pDst + tail, dstSize - tail);
+}
+
+static bool ZlibDecodeFn(const quint8* pSrc, unsigned size, quint8* pDst, unsigned dstSize)
+{
+  QByteArray data = qUncompress(pSrc, size);
+
+  if ((unsigned) data.size() != dstSize)
+    return false;
+
+  memcpy(pDst, data.constData(), dstSize);
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// The first prefix bytes of a sonar coded payload. The bytes before the image
+// (the ping header) are an LZ block of their own, nothing else is decoded
+static bool SonarPrefix(const quint8* pSrc, unsigned size, quint8* pDst, unsigned prefix, unsigned dstSize)
+{
+  // Plain LZ never starts with SONAR_VERSION, see SonarDecodeFn
+  if (size == 0 || pSrc[0] != SONAR_VERSION)
+    return RmCodec::LzDecompressPrefix(pSrc, size, pDst, prefix);
+
+  if (size < 18)
+    return false;
+
+  unsigned offset = Read32(pSrc + 2);
+
+  const quint8* ip   = pSrc + 18;
+  const quint8* iend = pSrc + size;
+  unsigned n;
+
+  const quint8* pHead = NextBlock(ip, iend, n);
+
+  if (!pHead)
+    return false;
+
+  if (prefix <= offset)
+    return RmCodec::LzDecompressPrefix(pHead, n, pDst, prefix);
+
+  // The prefix runs into the image
+  QByteArray whole(dstSize, 0);
+
+  if (!SonarDecodeFn(pSrc, size, (quint8*) whole.data(), dstSize))
+    return false;
+
+  memcpy(pDst, whole.constData(), prefix);
+
+  return true;
+}
+
+// ============================================================================
+// RmCodec - the codec table
+
+static const RmCodecInfo s_codecs[] = {
+  { codecZlib,  "zlib",  ZlibFn,  ZlibDecodeFn  },
+  { codecLz,    "lz",    LzFn,    LzDecodeFn    },
+  { codecSonar, "sonar", SonarFn, SonarDecodeFn }
+};
+
+// ----------------------------------------------------------------------------
+// All the codecs
+const RmCodecInfo* RmCodec::Codecs(int* pCount)
+{
+  *pCount = (int) (sizeof(s_codecs) / sizeof(s_codecs[0]));
+
+  return s_codecs;
+}
+
+// ----------------------------------------------------------------------------
+// Look up a codec by id, nullptr if it is unknown
+const RmCodecInfo* RmCodec::Find(quint16 id)
+{
+  for (const RmCodecInfo& codec : s_codecs)
+    if (codec.id == id)
+      return &codec;
+
+  return nullptr;
+}
+
+// ----------------------------------------------------------------------------
+// Look up a codec by name
+const RmCodecInfo* RmCodec::Find(QString name)
+{
+  for (const RmCodecInfo& codec : s_codecs)
+    if (name.compare(codec.name, Qt::CaseInsensitive) == 0)
+      return &codec;
+
+  return nullptr;
+}
+
+// ----------------------------------------------------------------------------
+// Compress a payload. Returns false if the codec is unknown or the result is
+// no smaller than the input - the caller should then store the payload as is
+bool RmCodec::Compress(quint16 codec, const quint8* pSrc, unsigned size, const RmCodecLayout* pLayout, QByteArray& out)
+{
+  const RmCodecInfo* pCodec = Find(codec);
+
+  if (!pCodec || !pCodec->compress(pSrc, size, pLayout, out))
+    return false;
+
+  return (unsigned) out.size() < size;
+}
+
+// ----------------------------------------------------------------------------
+// Decompress a payload into exactly dstSize bytes
+bool RmCodec::Decompress(quint16 codec, const quint8* pSrc, unsigned size, quint8* pDst, unsigned dstSize)
+{
+  if (codec == codecNone)
+  {
+    if (size != dstSize)
+      return false;
+
+    memcpy(pDst, pSrc, size);
+    return true;
+  }
+
+  const RmCodecInfo* pCodec = Find(codec);
+
+  return pCodec && pCodec->decompress(pSrc, size, pDst, dstSize);
+}
+
+// ----------------------------------------------------------------------------
+// Decompress just the first prefix bytes of a payload that unpacks to dstSize,
+// e.g. to read a header without the image behind it. LZ and sonar coded
+// payloads stop once the prefix is filled; zlib has no way to stop early from
+// qUncompress, so those are unpacked whole and the prefix copied
+bool RmCodec::DecompressPrefix(quint16 codec, const quint8* pSrc, unsigned size, unsigned dstSize, quint8* pDst, unsigned prefix)
+{
+  if (prefix > dstSize)
+    return false;
+
+  switch (codec)
+  {
+  case codecNone:
+    if (size != dstSize)
+      return false;
+
+    memcpy(pDst, pSrc, prefix);
+    return true;
+
+  case codecLz:
+    return LzDecompressPrefix(pSrc, size, pDst, prefix);
+
+  case codecSonar:
+    return SonarPrefix(pSrc, size, pDst, prefix, dstSize);
+  }
+
+  QByteArray whole(dstSize, 0);
+
+  if (!Decompress(codec, pSrc, size, (quint8*) whole.data(), dstSize))
+    return false;
+
+  memcpy(pDst, whole.constData(), prefix);
+
+  return true;
+}
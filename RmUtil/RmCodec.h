@@ -0,0 +1,85 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#pragma once
+
+#include <QByteArray>
+#include <QString>
+
+// ----------------------------------------------------------------------------
+// Codec identifiers, stored in RmLogItem::compression
+enum eLogCodec
+{
+  codecNone  = 0,       // Stored as is
+  codecZlib  = 1,       // qCompress (zlib level 1)
+  codecLz    = 2,       // LZ4 block format, fast and general purpose
+  codecSonar = 3        // Sonar image: range line prediction and Huffman coding
+};
+
+// ----------------------------------------------------------------------------
+// Where the image sits in a payload - lets the sonar codec predict each range
+// line from the one before. Bytes outside the image are LZ coded
+struct RmCodecLayout
+{
+  unsigned offset;      // Start of the image in the payload
+  unsigned lineBytes;   // Bytes per range line (including any gain prefix)
+  unsigned lines;       // Number of range lines
+  unsigned sampleBytes; // Bytes per sample (1, 2 or 4)
+};
+
+typedef bool (*RmCompressFn)(const quint8* pSrc, unsigned size, const RmCodecLayout* pLayout, QByteArray& out);
+typedef bool (*RmDecompressFn)(const quint8* pSrc, unsigned size, quint8* pDst, unsigned dstSize);
+
+// ----------------------------------------------------------------------------
+// One entry in the codec table
+struct RmCodecInfo
+{
+  quint16        id;
+  const char*    name;
+  RmCompressFn   compress;
+  RmDecompressFn decompress;
+};
+
+// ----------------------------------------------------------------------------
+// RmCodec - the log payload codecs. Every payload is compressed on its own so
+// any record can be decoded without its neighbours (seeking, trimming and
+// parallel work all depend on that). All functions are thread safe
+
+class RmCodec
+{
+public:
+  static const RmCodecInfo* Find(quint16 id);
+  static const RmCodecInfo* Find(QString name);
+  static const RmCodecInfo* Codecs(int* pCount);
+
+  static bool Compress(quint16 codec, const quint8* pSrc, unsigned size, const RmCodecLayout* pLayout, QByteArray& out);
+  static bool Decompress(quint16 codec, const quint8* pSrc, unsigned size, quint8* pDst, unsigned dstSize);
+  static bool DecompressPrefix(quint16 codec, const quint8* pSrc, unsigned size, unsigned dstSize, quint8* pDst, unsigned prefix);
+
+  // LZ4 block format
+  static unsigned LzBound(unsigned size);
+  static unsigned LzCompress(const quint8* pSrc, unsigned size, quint8* pDst, unsigned capacity);
+  static bool     LzDecompress(const quint8* pSrc, unsigned size, quint8* pDst, unsigned dstSize);
+  static bool     LzDecompressPrefix(const quint8* pSrc, unsigned size, quint8* pDst, unsigned prefix);
+
+  // Canonical Huffman coding of a byte stream
+  static unsigned HuffBound(unsigned size);
+  static unsigned HuffCompress(const quint8* pSrc, unsigned size, quint8* pDst, unsigned capacity);
+  static bool     HuffDecompress(const quint8* pSrc, unsigned size, quint8* pDst, unsigned dstSize);
+};
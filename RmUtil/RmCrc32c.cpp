@@ -0,0 +1,278 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+#include <cstring>
+
+#include "RmCrc32c.h"
+#include "RmLogger.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define CRC_X86
+#define CRC_SSE42 __attribute__((target("sse4.2")))
+#include <nmmintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define CRC_X86
+#define CRC_SSE42
+#include <nmmintrin.h>
+#include <intrin.h>
+#elif (defined(__GNUC__) || defined(__clang__)) && defined(__aarch64__)
+#define CRC_ARM
+#if defined(__clang__)
+#define CRC_ARMV8 __attribute__((target("crc")))
+#else
+#define CRC_ARMV8 __attribute__((target("+crc")))
+#endif
+#include <arm_acle.h>
+#if defined(__linux__)
+#include <sys/auxv.h>
+#include <asm/hwcap.h>
+#endif
+#endif
+
+// CRC-32C polynomial, bit reversed
+static const quint32 s_poly = 0x82f63b78;
+
+typedef quint32 (*RmCrcFn)(const quint8* pData, size_t size, quint32 crc);
+
+// ----------------------------------------------------------------------------
+// The slicing-by-8 tables, built on first use
+struct RmCrcTables
+{
+  quint32 t[8][256];
+
+  RmCrcTables()
+  {
+    for (unsigned i = 0; i < 256; i++)
+    {
+      quint32 crc = i;
+
+      for (int b = 0; b < 8; b++)
+        crc = (crc & 1) ? (crc >> 1) ^ s_poly : crc >> 1;
+
+      t[0][i] = crc;
+    }
+
+    for (unsigned i = 0; i < 256; i++)
+      for (int k = 1; k < 8; k++)
+        t[k][i] = (t[k - 1][i] >> 8) ^ t[0][t[k - 1][i] & 0xff];
+  }
+};
+
+static const RmCrcTables& Tables()
+{
+  static const RmCrcTables tables;
+
+  return tables;
+}
+
+// ============================================================================
+// Kernels - the running CRC (not inverted) over n bytes
+
+// ----------------------------------------------------------------------------
+// Eight bytes a step through the tables (the logs are little endian)
+static quint32 CrcTable(const quint8* pData, size_t size, quint32 crc)
+{
+  const RmCrcTables& tables = Tables();
+
+  while (size >= 8)
+  {
+    quint64 word;
+    memcpy(&word, pData, 8);
+
+    word ^= crc;
+
+    crc = tables.t[7][word & 0xff]         ^ tables.t[6][(word >> 8) & 0xff] ^
+          tables.t[5][(word >> 16) & 0xff] ^ tables.t[4][(word >> 24) & 0xff] ^
+          tables.t[3][(word >> 32) & 0xff] ^ tables.t[2][(word >> 40) & 0xff] ^
+          tables.t[1][(word >> 48) & 0xff] ^ tables.t[0][word >> 56];
+
+    pData += 8;
+    size  -= 8;
+  }
+
+  while (size--)
+    crc = tables.t[0][(crc ^ *pData++) & 0xff] ^ (crc >> 8);
+
+  return crc;
+}
+
+#if defined(CRC_X86)
+// ----------------------------------------------------------------------------
+// SSE 4.2 crc32 instruction
+CRC_SSE42 static quint32 CrcSse42(const quint8* pData, size_t size, quint32 crc)
+{
+#if defined(__x86_64__) || defined(_M_X64)
+  quint64 crc64 = crc;
+
+  for (; size >= 8; pData += 8, size -= 8)
+  {
+    quint64 word;
+    memcpy(&word, pData, 8);
+    crc64 = _mm_crc32_u64(crc64, word);
+  }
+
+  crc = (quint32) crc64;
+#endif
+
+  for (; size >= 4; pData += 4, size -= 4)
+  {
+    quint32 word;
+    memcpy(&word, pData, 4);
+    crc = _mm_crc32_u32(crc, word);
+  }
+
+  while (size--)
+    crc = _mm_crc32_u8(crc, *pData++);
+
+  return crc;
+}
+#endif
+
+#if defined(CRC_ARM)
+// ----------------------------------------------------------------------------
+// ARMv8 crc32c instructions
+CRC_ARMV8 static quint32 CrcArmv8(const quint8* pData, size_t size, quint32 crc)
+{
+  for (; size >= 8; pData += 8, size -= 8)
+  {
+    quint64 word;
+    memcpy(&word, pData, 8);
+    crc = __crc32cd(crc, word);
+  }
+
+  while (size--)
+    crc = __crc32cb(crc, *pData++);
+
+  return crc;
+}
+#endif
+
+// ----------------------------------------------------------------------------
+// The fastest kernel the processor runs
+static RmCrcFn Kernel()
+{
+#if defined(CRC_X86)
+  if (RmCrc32c::HasHardware())
+    return CrcSse42;
+#elif defined(CRC_ARM)
+  if (RmCrc32c::HasHardware())
+    return CrcArmv8;
+#endif
+
+  return CrcTable;
+}
+
+// ============================================================================
+// RmCrc32c - CRC-32C checksums
+
+// ----------------------------------------------------------------------------
+// Does the processor have CRC-32C instructions - checked once
+bool RmCrc32c::HasHardware()
+{
+#if defined(CRC_X86) && defined(_MSC_VER)
+  static int sse42 = -1;
+
+  if (sse42 < 0)
+  {
+    int info[4];
+
+    __cpuid(info, 1);
+    sse42 = (info[2] & (1 << 20)) ? 1 : 0;
+  }
+
+  return sse42 == 1;
+#elif defined(CRC_X86)
+  static const bool sse42 = __builtin_cpu_supports("sse4.2");
+
+  return sse42;
+#elif defined(CRC_ARM) && defined(__ARM_FEATURE_CRC32)
+  return true;
+#elif defined(CRC_ARM) && defined(__APPLE__)
+  return true;
+#elif defined(CRC_ARM) && defined(__linux__)
+  static const bool crc = (getauxval(AT_HWCAP) & HWCAP_CRC32) != 0;
+
+  return crc;
+#else
+  return false;
+#endif
+}
+
+// ----------------------------------------------------------------------------
+// Which kernel Calc uses, for reports
+const char* RmCrc32c::Engine()
+{
+#if defined(CRC_X86)
+  return HasHardware() ? "SSE 4.2" : "software";
+#elif defined(CRC_ARM)
+  return HasHardware() ? "ARMv8 CRC" : "software";
+#else
+  return "software";
+#endif
+}
+
+// ----------------------------------------------------------------------------
+// The CRC of the data, continuing from the CRC of what went before it
+quint32 RmCrc32c::Calc(const void* pData, size_t size, quint32 crc)
+{
+  static const RmCrcFn kernel = Kernel();
+
+  return ~kernel((const quint8*) pData, size, ~crc);
+}
+
+// ----------------------------------------------------------------------------
+// As Calc, always through the tables
+quint32 RmCrc32c::Software(const void* pData, size_t size, quint32 crc)
+{
+  return ~CrcTable((const quint8*) pData, size, ~crc);
+}
+
+// ----------------------------------------------------------------------------
+// The checksum of a record: its item header, with the crc field taken as 0,
+// then its payload as stored
+quint32 RmCrc32c::Item(const quint8* pItem)
+{
+  quint8 head[sizeof(RmLogItem)];
+
+  memcpy(head, pItem, sizeof(RmLogItem));
+  memset(head + offsetof(RmLogItem, crc), 0, sizeof(quint32));
+
+  RmLogItem item;
+  memcpy(&item, head, sizeof(RmLogItem));
+
+  return Calc(pItem + sizeof(RmLogItem), item.payloadSize, Calc(head, sizeof(RmLogItem)));
+}
+
+// ----------------------------------------------------------------------------
+// Store a finished record's checksum in its header
+void RmCrc32c::Seal(quint8* pItem)
+{
+  quint32 crc = Item(pItem);
+
+  memcpy(pItem + offsetof(RmLogItem, crc), &crc, sizeof(quint32));
+}
+
+// ----------------------------------------------------------------------------
+// Does the record match its checksum
+bool RmCrc32c::Check(const quint8* pItem)
+{
+  quint32 stored;
+  memcpy(&stored, pItem + offsetof(RmLogItem, crc), sizeof(quint32));
+
+  return stored == Item(pItem);
+}
@@ -0,0 +1,43 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+#pragma once
+
+#include <QtGlobal>
+
+#include <cstddef>
+
+// ----------------------------------------------------------------------------
+// RmCrc32c - CRC-32C (Castagnoli) checksums, as used for the log records. The
+// processor's CRC instructions are used where it has them (SSE 4.2 on x86,
+// the ARMv8 CRC extension on ARM), found once at run time, otherwise a
+// slicing-by-8 table version. All give the same result and are thread safe
+
+class RmCrc32c
+{
+public:
+  static quint32     Calc(const void* pData, size_t size, quint32 crc = 0);
+  static quint32     Software(const void* pData, size_t size, quint32 crc = 0);
+  static bool        HasHardware();
+  static const char* Engine();
+
+  // Log records (RmLogItem and payload)
+  static quint32     Item(const quint8* pItem);
+  static void        Seal(quint8* pItem);
+  static bool        Check(const quint8* pItem);
+};
@@ -0,0 +1,265 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include <QFile>
+#include <QFileInfo>
+
+#include "RmLogCut.h"
+#include "RmLogRepair.h"
+#include "RmLogger.h"
+
+#if defined(Q_OS_LINUX)
+#include <unistd.h>
+#include <sys/sendfile.h>
+#endif
+
+// Largest single copy
+static const quint64 s_copyBlock = 64 * 1024 * 1024;
+
+// ============================================================================
+// RmLogCut - new logs from stretches of others
+
+// ----------------------------------------------------------------------------
+// Write the records of the ranges, in the order given, to a new log. The
+// records of each range are found through its log's index and copied in runs
+bool RmLogCut::Write(const QVector<RmCutRange>& ranges, QString outFile, RmCutReport& report)
+{
+  report.nRecords    = 0;
+  report.outputSize  = 0;
+  report.kernelBytes = 0;
+
+  // The output is truncated before anything is read, it can't be a source
+  if (ranges.isEmpty() || Overwrites(ranges, outFile))
+    return false;
+
+  // Unbuffered, so the kernel copies and the writes here see the same file
+  QFile out(outFile);
+
+  if (!out.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered))
+    return false;
+
+  RmLogIndex  index;            // Records of the new log
+  RmLogHeader header;           // ...and its header
+  quint64     written = 0;
+  bool        ok      = true;
+  bool        older   = false;
+
+  for (int r = 0; ok && r < ranges.size(); r++)
+  {
+    const RmCutRange& range = ranges.at(r);
+
+    RmLogIndex source;
+    QFile      log(range.file);
+
+    if (!source.Load(range.file) || !log.open(QIODevice::ReadOnly))
+    {
+      ok = false;
+      break;
+    }
+
+    const quint8* pData = log.map(0, source.m_fileSize);
+
+    if (!pData)
+    {
+      ok = false;
+      break;
+    }
+
+    // The new log takes the first log's header, and the oldest version of
+    // the logs so records without checksums aren't taken for corrupt ones
+    if (written == 0)
+    {
+      memcpy(&header, pData, sizeof(RmLogHeader));
+
+      ok      = (out.write((const char*) &header, sizeof(RmLogHeader)) == sizeof(RmLogHeader));
+      written = sizeof(RmLogHeader);
+    }
+    else
+    {
+      RmLogHeader other;
+      memcpy(&other, pData, sizeof(RmLogHeader));
+
+      if (other.version < header.version)
+      {
+        header.version = other.version;
+        older          = true;
+      }
+    }
+
+    int e = 0;
+
+    while (e < source.m_nEntries && source.m_pEntries[e].offset < range.from)
+      e++;
+
+    while (ok && e < source.m_nEntries && source.m_pEntries[e].offset < range.to)
+    {
+      // Gather the run of records that follow on from each other
+      quint64 runStart = source.m_pEntries[e].offset;
+      quint64 runEnd   = runStart;
+
+      for (; e < source.m_nEntries && source.m_pEntries[e].offset == runEnd && runEnd < range.to; e++)
+      {
+        const RmIndexEntry& entry = source.m_pEntries[e];
+        RmLogItem item;
+
+        if (runEnd + sizeof(RmLogItem) > source.m_fileSize)
+        {
+          ok = false;
+          break;
+        }
+
+        memcpy(&item, pData + runEnd, sizeof(RmLogItem));
+
+        if (runEnd + sizeof(RmLogItem) + item.payloadSize > source.m_fileSize ||
+            !index.Add(written + (runEnd - runStart), entry.type, entry.time, entry.id, entry.ping))
+        {
+          ok = false;
+          break;
+        }
+
+        runEnd += sizeof(RmLogItem) + item.payloadSize;
+      }
+
+      ok       = ok && CopyRun(log, pData, out, runStart, runEnd, written, report);
+      written += runEnd - runStart;
+    }
+
+    log.unmap((uchar*) pData);
+  }
+
+  if (ok && older)
+    ok = out.seek(0) && out.write((const char*) &header, sizeof(RmLogHeader)) == sizeof(RmLogHeader);
+
+  // The footer follows the last record
+  ok = ok && index.m_nEntries > 0 && out.seek(written) && RmLogRepair::WriteFooter(out, index);
+
+  report.nRecords   = index.m_nEntries;
+  report.outputSize = out.size();
+
+  out.close();
+
+  if (!ok)
+    QFile::remove(outFile);
+
+  // A sidecar left from an earlier log of the same name no longer matches
+  QFile::remove(RmLogIndex::SidecarName(outFile));
+
+  return ok;
+}
+
+// ----------------------------------------------------------------------------
+// Would writing the file replace one of the logs the ranges come from
+bool RmLogCut::Overwrites(const QVector<RmCutRange>& ranges, QString outFile)
+{
+  QString target = QFileInfo(outFile).absoluteFilePath();
+  QString real   = QFileInfo(outFile).canonicalFilePath();   // Empty if it doesn't exist yet
+
+  for (const RmCutRange& range : ranges)
+  {
+    QFileInfo source(range.file);
+
+    if (source.absoluteFilePath() == target || (!real.isEmpty() && source.canonicalFilePath() == real))
+      return true;
+  }
+
+  return false;
+}
+
+// ----------------------------------------------------------------------------
+// The range of a log holding the records timed from start up to end. False if
+// there are none
+bool RmLogCut::TimeRange(const RmLogIndex& index, double start, double end, RmCutRange& range)
+{
+  int first = 0;
+
+  while (first < index.m_nEntries && index.m_pEntries[first].time < start)
+    first++;
+
+  int last = first;
+
+  while (last < index.m_nEntries && index.m_pEntries[last].time < end)
+    last++;
+
+  if (last == first)
+    return false;
+
+  range.file = index.m_fileName;
+  range.from = index.m_pEntries[first].offset;
+  range.to   = last < index.m_nEntries ? index.m_pEntries[last].offset : index.m_fileSize;
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Copy [from, to) of the source to the output at the position given. On Linux
+// the data goes file to file in the kernel (a reflink on file systems that
+// share extents); what that can't do is written from the mapping
+bool RmLogCut::CopyRun(QFile& src, const quint8* pSrc, QFile& dst, quint64 from, quint64 to, quint64 at, RmCutReport& report)
+{
+#if defined(Q_OS_LINUX)
+  loff_t in  = from;
+  loff_t out = at;
+
+  while ((quint64) in < to)
+  {
+    ssize_t n = copy_file_range(src.handle(), &in, dst.handle(), &out, qMin(s_copyBlock, to - in), 0);
+
+    if (n <= 0)
+      break;
+
+    report.kernelBytes += n;
+  }
+
+  // Across file systems on older kernels, or no copy_file_range at all
+  if ((quint64) in < to && dst.seek(out))
+  {
+    off_t offset = in;
+
+    while ((quint64) offset < to)
+    {
+      ssize_t n = sendfile(dst.handle(), src.handle(), &offset, qMin(s_copyBlock, to - offset));
+
+      if (n <= 0)
+        break;
+
+      report.kernelBytes += n;
+    }
+
+    in = offset;
+  }
+
+  at  += in - from;
+  from = in;
+#else
+  Q_UNUSED(src)
+#endif
+
+  if (from < to && !dst.seek(at))
+    return false;
+
+  for (quint64 pos = from; pos < to; pos += s_copyBlock)
+  {
+    qint64 size = qMin(s_copyBlock, to - pos);
+
+    if (dst.write((const char*) pSrc + pos, size) != size)
+      return false;
+  }
+
+  return true;
+}
@@ -0,0 +1,61 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#pragma once
+
+#include <QString>
+#include <QVector>
+
+#include "RmLogIndex.h"
+
+// ----------------------------------------------------------------------------
+// A stretch of a log to copy: the records that start in [from, to)
+struct RmCutRange
+{
+  QString file;         // Log to copy from
+  quint64 from;         // First byte
+  quint64 to;           // End (exclusive)
+};
+
+// ----------------------------------------------------------------------------
+// What a cut wrote
+struct RmCutReport
+{
+  int     nRecords;     // Records copied
+  quint64 outputSize;   // Size of the new log
+  quint64 kernelBytes;  // Bytes copied without passing through the process
+};
+
+// ----------------------------------------------------------------------------
+// RmLogCut - writes a new log from stretches of others: a trimmed clip, one
+// piece of a split or several logs merged. The records are copied as they are,
+// never decoded, runs of them in one kernel copy where the platform has one
+// (copy_file_range, else sendfile). The header comes from the first log and a
+// fresh index footer is written for the new positions
+
+class RmLogCut
+{
+public:
+  static bool Write(const QVector<RmCutRange>& ranges, QString outFile, RmCutReport& report);
+  static bool TimeRange(const RmLogIndex& index, double start, double end, RmCutRange& range);
+  static bool Overwrites(const QVector<RmCutRange>& ranges, QString outFile);
+
+protected:
+  static bool CopyRun(QFile& src, const quint8* pSrc, QFile& dst, quint64 from, quint64 to, quint64 at, RmCutReport& report);
+};
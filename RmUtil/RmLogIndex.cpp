@@ -0,0 +1,955 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDateTime>
+#include <QDebug>
+#include <QThreadPool>
+#include <QThread>
+
+#include <stddef.h>
+#include <limits>
+
+#include "RmLogIndex.h"
+#include "RmLogger.h"
+#include "RmCrc32c.h"
+#include "RmCodec.h"
+#include "../Oculus/Oculus.h"
+
+const quint32 RmLogIndex::s_chunkMagic   = 0x58444e49;      // "INDX"
+const quint32 RmLogIndex::s_tailMagic    = 0x4c494154;      // "TAIL"
+const quint32 RmLogIndex::s_sidecarMagic = 0x58444943;      // "CIDX"
+
+// Bytes read past an item header to find the ping header
+static const unsigned s_peekSize = 256;
+
+// A walk that ran into bad data and found nothing valid after it
+static const quint64 s_lost = ~0ULL;
+
+// Records in a row needed to trust a record found by its magic
+static const int s_syncChain = 3;
+
+// ----------------------------------------------------------------------------
+// What one thread found in its piece of the file
+struct RmIndexPiece
+{
+  quint64 start;                    // The piece
+  quint64 end;
+  quint64 first;                    // First record found in the piece (end if none)
+  quint64 exit;                     // First record at or past the end, or s_lost
+  quint64 lostAt;                   // Where the data went bad if exit is s_lost
+  QVector<RmIndexEntry> entries;    // Records starting in the piece
+  QVector<RmIndexGap>   corrupt;    // Bad regions inside the piece
+};
+
+Q_STATIC_ASSERT(sizeof(RmIndexEntry) == 32);
+Q_STATIC_ASSERT(sizeof(OculusSimplePingResult2) <= s_peekSize);
+
+// ----------------------------------------------------------------------------
+// Ping id and start time of a record for its index entry, both 0 if it isn't
+// a ping (or its header can't be read from the size bytes given)
+static bool EntryPing(const RmLogItem& item, const quint8* pPayload, unsigned size, quint32* pId, double* pTime)
+{
+  RmPingHeader ping;
+
+  *pId   = 0;
+  *pTime = 0.0;
+
+  if (!RmLogIndex::ReadPing(item.type, item.compression, pPayload, size, item.originalSize, ping))
+    return false;
+
+  *pId   = ping.id;
+  *pTime = ping.clock;
+
+  return true;
+}
+
+RmLogIndex::RmLogIndex()
+{
+  m_pEntries = nullptr;
+  m_nEntries = 0;
+  m_capacity = 0;
+  m_fileSize = 0;
+  m_indexed  = 0;
+  m_source   = indexNone;
+}
+
+RmLogIndex::~RmLogIndex()
+{
+  if (m_pEntries)
+    free(m_pEntries);
+}
+
+// ----------------------------------------------------------------------------
+// Forget the entries (the allocation is kept)
+void RmLogIndex::Clear()
+{
+  m_nEntries = 0;
+  m_fileSize = 0;
+  m_indexed  = 0;
+  m_source   = indexNone;
+  m_fileName.clear();
+  m_corrupt.clear();
+}
+
+// ----------------------------------------------------------------------------
+// Add a record, the entries grow by doubling
+bool RmLogIndex::Add(quint64 offset, quint16 type, double time, quint32 id, double ping)
+{
+  if (m_nEntries == m_capacity)
+  {
+    int capacity = qMax(1024, m_capacity * 2);
+    RmIndexEntry* pEntries = (RmIndexEntry*) realloc(m_pEntries, capacity * sizeof(RmIndexEntry));
+
+    if (!pEntries)
+      return false;
+
+    m_pEntries = pEntries;
+    m_capacity = capacity;
+  }
+
+  RmIndexEntry& entry = m_pEntries[m_nEntries++];
+
+  entry.offset = offset;
+  entry.time   = time;
+  entry.ping   = ping;
+  entry.id     = id;
+  entry.type   = type;
+  entry.flags  = 0;
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Add a record from its item header
+bool RmLogIndex::AddItem(quint64 offset, const quint8* pItem, quint32 id, double ping)
+{
+  RmLogItem item;
+  memcpy(&item, pItem, sizeof(RmLogItem));
+
+  return Add(offset, item.type, item.time, id, ping);
+}
+
+// ----------------------------------------------------------------------------
+// Fill in the file positions of the records of one type, ppEntries is
+// reallocated to fit (as CreateTypeIndex always did)
+int RmLogIndex::TypeIndex(int type, quint64** ppEntries)
+{
+  int nEntries = CountOfType(type);
+
+  if (nEntries == 0)
+    return 0;
+
+  quint64* pEntries = (quint64*) realloc(*ppEntries, nEntries * sizeof(quint64));
+
+  if (!pEntries)
+    return 0;
+
+  *ppEntries = pEntries;
+
+  int n = 0;
+
+  for (int e = 0; e < m_nEntries; e++)
+    if (m_pEntries[e].type == type)
+      pEntries[n++] = m_pEntries[e].offset;
+
+  return nEntries;
+}
+
+// ----------------------------------------------------------------------------
+// Number of records of one type
+int RmLogIndex::CountOfType(int type)
+{
+  int n = 0;
+
+  for (int e = 0; e < m_nEntries; e++)
+    if (m_pEntries[e].type == type)
+      n++;
+
+  return n;
+}
+
+// ----------------------------------------------------------------------------
+// Is this the index of the file as it is now
+bool RmLogIndex::IsCurrent(QString file)
+{
+  return m_source != indexNone && m_fileName == file && (quint64) QFileInfo(file).size() == m_fileSize;
+}
+
+// ----------------------------------------------------------------------------
+// Drop whatever was partly read
+bool RmLogIndex::LoadFailed()
+{
+  m_nEntries = 0;
+  m_indexed  = 0;
+  m_corrupt.clear();
+
+  return false;
+}
+
+// ----------------------------------------------------------------------------
+// Load the index of a log: the footer of a closed log, a sidecar built
+// earlier, the chunks of a log that was never closed, or as a last resort a
+// walk through every record - saved as a sidecar so it only happens once
+bool RmLogIndex::Load(QString file, bool writeSidecar)
+{
+  Clear();
+
+  QFile log(file);
+
+  if (!log.open(QIODevice::ReadOnly))
+    return false;
+
+  RmLogHeader header;
+
+  if (log.read((char*) &header, sizeof(RmLogHeader)) != sizeof(RmLogHeader) ||
+      header.fileHeader != RmLogger::s_fileHeader || header.sizeHeader != sizeof(RmLogHeader))
+    return false;
+
+  m_fileName = file;
+  m_fileSize = log.size();
+
+  if (ReadFooter(log))
+    m_source = indexFooter;
+  else if (ReadSidecar(file))
+    m_source = indexSidecar;
+  else if (ReadChunks(log))
+    m_source = indexChunks;
+  else
+  {
+    if (!ScanParallel(log, sizeof(RmLogHeader)))
+      Scan(log, sizeof(RmLogHeader));
+
+    m_source = indexScan;
+
+    if (writeSidecar && !WriteSidecar(file))
+      qDebug() << "Unable to write the log index" << SidecarName(file);
+  }
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Read the chunk item at offset and check it, optionally appending its entries
+bool RmLogIndex::ReadChunk(QFile& file, quint64 offset, RmIndexChunk& chunk, bool entries)
+{
+  RmLogItem item;
+
+  if (!file.seek(offset) || file.read((char*) &item, sizeof(RmLogItem)) != sizeof(RmLogItem))
+    return false;
+
+  if (item.itemHeader != RmLogger::s_itemHeader || item.sizeHeader != sizeof(RmLogItem) ||
+      item.type != rt_logIndex || item.compression != 0 || item.payloadSize < sizeof(RmIndexChunk))
+    return false;
+
+  if (file.read((char*) &chunk, sizeof(RmIndexChunk)) != sizeof(RmIndexChunk))
+    return false;
+
+  if (chunk.magic != s_chunkMagic ||
+      item.payloadSize != sizeof(RmIndexChunk) + (quint64) chunk.nEntries * sizeof(RmIndexEntry) ||
+      offset + sizeof(RmLogItem) + item.payloadSize > m_fileSize)
+    return false;
+
+  if (!entries)
+    return true;
+
+  for (quint32 e = 0; e < chunk.nEntries; e++)
+  {
+    RmIndexEntry entry;
+
+    if (file.read((char*) &entry, sizeof(RmIndexEntry)) != sizeof(RmIndexEntry))
+      return false;
+
+    if (!Add(entry.offset, entry.type, entry.time, entry.id, entry.ping))
+      return false;
+  }
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// The tail item is the last thing in a closed log and points at the footer
+bool RmLogIndex::ReadFooter(QFile& file)
+{
+  quint64 tailSize = TailSize();
+
+  if (m_fileSize < sizeof(RmLogHeader) + tailSize)
+    return false;
+
+  quint64     tailPos = m_fileSize - tailSize;
+  RmLogItem   item;
+  RmIndexTail tail;
+
+  if (!file.seek(tailPos) ||
+      file.read((char*) &item, sizeof(RmLogItem)) != sizeof(RmLogItem) ||
+      file.read((char*) &tail, sizeof(RmIndexTail)) != sizeof(RmIndexTail))
+    return false;
+
+  if (item.itemHeader != RmLogger::s_itemHeader || item.sizeHeader != sizeof(RmLogItem) ||
+      item.type != rt_logIndexTail || item.payloadSize != sizeof(RmIndexTail) ||
+      tail.magic != s_tailMagic || tail.footer >= tailPos)
+    return false;
+
+  RmIndexChunk chunk;
+
+  if (!ReadChunk(file, tail.footer, chunk, true) || !chunk.footer || chunk.nEntries != tail.nEntries)
+    return LoadFailed();
+
+  m_indexed = tailPos;
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// A log that was not closed (power loss, crash) has no footer but still has
+// the chunks written while it was logged. Find the last one near the end of
+// the file, follow the chain back and then walk the few records after it
+bool RmLogIndex::ReadChunks(QFile& file)
+{
+  const quint64 window  = 4 * 1024 * 1024;
+  const quint64 overlap = sizeof(RmLogItem) + sizeof(RmIndexChunk);
+  const quint64 first   = sizeof(RmLogHeader);
+  const quint64 limit   = (m_fileSize > first + LOG_INDEX_SEARCH) ? m_fileSize - LOG_INDEX_SEARCH : first;
+
+  QByteArray buffer;
+  quint64    last = 0;
+  RmIndexChunk chunk;
+
+  // Search backwards a window at a time for the last chunk item
+  for (quint64 end = m_fileSize; end > limit && !last; end = (end > limit + window) ? end - window : limit)
+  {
+    quint64 start = (end > limit + window) ? end - window : limit;
+    quint64 size  = qMin(end + overlap, m_fileSize) - start;
+
+    if (!file.seek(start))
+      return false;
+
+    buffer = file.read(size);
+
+    if ((quint64) buffer.size() != size)
+      return false;
+
+    const quint8* pData = (const quint8*) buffer.constData();
+
+    for (qint64 p = (qint64) (end - start) - 1; p >= 0 && !last; p--)
+    {
+      if (p + overlap > size)
+        continue;
+
+      quint32 magic;
+      memcpy(&magic, pData + p, sizeof(quint32));
+
+      if (magic != RmLogger::s_itemHeader)
+        continue;
+
+      // Confirm it from the file
+      if (ReadChunk(file, start + p, chunk, false))
+        last = start + p;
+    }
+  }
+
+  if (!last)
+    return false;
+
+  // Follow the chain back to the first chunk (a footer already holds the lot)
+  QList<quint64> chunks;
+  quint64 offset = last;
+
+  forever
+  {
+    if (!ReadChunk(file, offset, chunk, false))
+      return false;
+
+    chunks.prepend(offset);
+
+    if (chunk.footer || chunk.previous == 0)
+      break;
+
+    if (chunk.previous >= offset)
+      return false;
+
+    offset = chunk.previous;
+  }
+
+  for (quint64 chunkPos : chunks)
+    if (!ReadChunk(file, chunkPos, chunk, true))
+      return LoadFailed();
+
+  // The chain must start at the first record or a chunk has been lost
+  if (m_nEntries && m_pEntries[0].offset != first)
+    return LoadFailed();
+
+  // Pick up the records written after the last chunk
+  ReadChunk(file, last, chunk, false);
+
+  Scan(file, last + sizeof(RmLogItem) + sizeof(RmIndexChunk) + (quint64) chunk.nEntries * sizeof(RmIndexEntry));
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Read the sidecar if it was built from the log as it is now
+bool RmLogIndex::ReadSidecar(QString file)
+{
+  QFile sidecar(SidecarName(file));
+
+  if (!sidecar.open(QIODevice::ReadOnly))
+    return false;
+
+  RmIndexSidecar header;
+
+  if (sidecar.read((char*) &header, sizeof(RmIndexSidecar)) != sizeof(RmIndexSidecar))
+    return false;
+
+  QFileInfo info(file);
+
+  if (header.magic != s_sidecarMagic || header.version != LOG_INDEX_VERSION ||
+      header.logSize != m_fileSize || header.logModified != info.lastModified().toMSecsSinceEpoch() ||
+      (quint64) sidecar.size() != sizeof(RmIndexSidecar) + (quint64) header.nEntries * sizeof(RmIndexEntry) +
+                                  (quint64) header.nCorrupt * sizeof(RmIndexGap))
+    return false;
+
+  if (header.nEntries > (quint32) m_capacity)
+  {
+    RmIndexEntry* pEntries = (RmIndexEntry*) realloc(m_pEntries, header.nEntries * sizeof(RmIndexEntry));
+
+    if (!pEntries)
+      return false;
+
+    m_pEntries = pEntries;
+    m_capacity = header.nEntries;
+  }
+
+  qint64 bytes = (qint64) header.nEntries * sizeof(RmIndexEntry);
+
+  if (sidecar.read((char*) m_pEntries, bytes) != bytes)
+    return LoadFailed();
+
+  m_corrupt.resize(header.nCorrupt);
+
+  bytes = (qint64) header.nCorrupt * sizeof(RmIndexGap);
+
+  if (sidecar.read((char*) m_corrupt.data(), bytes) != bytes)
+    return LoadFailed();
+
+  m_nEntries = header.nEntries;
+  m_indexed  = m_fileSize;
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Save the index next to the log
+bool RmLogIndex::WriteSidecar(QString file)
+{
+  QSaveFile sidecar(SidecarName(file));
+
+  if (!sidecar.open(QIODevice::WriteOnly))
+    return false;
+
+  RmIndexSidecar header;
+  memset(&header, 0, sizeof(RmIndexSidecar));
+
+  header.magic       = s_sidecarMagic;
+  header.version     = LOG_INDEX_VERSION;
+  header.logSize     = m_fileSize;
+  header.logModified = QFileInfo(file).lastModified().toMSecsSinceEpoch();
+  header.nEntries    = m_nEntries;
+  header.nCorrupt    = m_corrupt.size();
+
+  qint64 bytes   = (qint64) m_nEntries * sizeof(RmIndexEntry);
+  qint64 corrupt = (qint64) m_corrupt.size() * sizeof(RmIndexGap);
+
+  if (sidecar.write((const char*) &header, sizeof(RmIndexSidecar)) != sizeof(RmIndexSidecar) ||
+      sidecar.write((const char*) m_pEntries, bytes) != bytes ||
+      sidecar.write((const char*) m_corrupt.constData(), corrupt) != corrupt)
+  {
+    sidecar.cancelWriting();
+    return false;
+  }
+
+  return sidecar.commit();
+}
+
+// ----------------------------------------------------------------------------
+// Walk the records from the given position to the end of the file or the first
+// bad item. Index items are skipped, a record cut short by the end of the file
+// is left out
+bool RmLogIndex::Scan(QFile& file, quint64 from)
+{
+  quint8  buffer[sizeof(RmLogItem) + s_peekSize];
+  quint64 pos = from;
+
+  m_indexed = pos;
+
+  while (m_fileSize - pos >= sizeof(RmLogItem))
+  {
+    if (!file.seek(pos))
+      return false;
+
+    qint64 readBytes = file.read((char*) buffer, sizeof(buffer));
+
+    if (readBytes < (qint64) sizeof(RmLogItem))
+      return false;
+
+    RmLogItem item;
+    memcpy(&item, buffer, sizeof(RmLogItem));
+
+    if (item.itemHeader != RmLogger::s_itemHeader || item.sizeHeader != sizeof(RmLogItem))
+      return false;
+
+    quint64 end = pos + sizeof(RmLogItem) + item.payloadSize;
+
+    if (end > m_fileSize)
+      return false;
+
+    if (item.type != rt_logIndex && item.type != rt_logIndexTail)
+    {
+      unsigned peek = qMin((unsigned) (readBytes - sizeof(RmLogItem)), item.payloadSize);
+      quint32  id;
+      double   ping;
+
+      // A compressed ping header can take more than the peek to unpack
+      if (!EntryPing(item, buffer + sizeof(RmLogItem), peek, &id, &ping) &&
+          item.type == rt_oculusSonar && item.compression != 0 && peek < item.payloadSize)
+      {
+        QByteArray payload;
+
+        if (file.seek(pos + sizeof(RmLogItem)))
+          payload = file.read(item.payloadSize);
+
+        if ((unsigned) payload.size() == item.payloadSize)
+          EntryPing(item, (const quint8*) payload.constData(), item.payloadSize, &id, &ping);
+      }
+
+      if (!Add(pos, item.type, item.time, id, ping))
+        return false;
+    }
+
+    pos       = end;
+    m_indexed = pos;
+  }
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Is there a whole record at pos, if so where does the next one start
+static bool ItemOk(const quint8* pData, quint64 size, quint64 pos, quint64* pNext)
+{
+  if (pos > size || size - pos < sizeof(RmLogItem))
+    return false;
+
+  RmLogItem item;
+  memcpy(&item, pData + pos, sizeof(RmLogItem));
+
+  if (item.itemHeader != RmLogger::s_itemHeader || item.sizeHeader != sizeof(RmLogItem))
+    return false;
+
+  quint64 next = pos + sizeof(RmLogItem) + item.payloadSize;
+
+  if (next > size)
+    return false;
+
+  *pNext = next;
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Find the first record in [from, end). The magic can turn up inside a
+// payload, so a record only counts if it starts a chain of s_syncChain
+// records or one that runs to the end of the file
+static quint64 SyncItem(const quint8* pData, quint64 size, quint64 from, quint64 end)
+{
+  const quint8 lead = RmLogger::s_itemHeader & 0xFF;
+
+  for (quint64 p = from; p < end; p++)
+  {
+    const quint8* pHit = (const quint8*) memchr(pData + p, lead, end - p);
+
+    if (!pHit)
+      break;
+
+    p = pHit - pData;
+
+    quint64 q = p;
+    int     n = 0;
+
+    while (n < s_syncChain && q < size && ItemOk(pData, size, q, &q))
+      n++;
+
+    if (n == s_syncChain || (n > 0 && q == size))
+      return p;
+  }
+
+  return end;
+}
+
+// ----------------------------------------------------------------------------
+// Walk the records from start until one starts at or past end. Bad data is
+// skipped up to the next record, if there isn't one in the piece the walk is
+// lost and the stitching picks it up from the next piece
+static void WalkPiece(const quint8* pData, quint64 size, quint64 start, RmIndexPiece& piece)
+{
+  quint64 p = start;
+
+  while (p < piece.end)
+  {
+    quint64 next;
+
+    // ItemOk has checked the payload is all inside the file
+    if (ItemOk(pData, size, p, &next))
+    {
+      RmLogItem item;
+      memcpy(&item, pData + p, sizeof(RmLogItem));
+
+      if (item.type != rt_logIndex && item.type != rt_logIndexTail)
+      {
+        RmIndexEntry entry;
+
+        entry.offset = p;
+        entry.time   = item.time;
+        entry.type   = item.type;
+        entry.flags  = 0;
+
+        EntryPing(item, pData + p + sizeof(RmLogItem), item.payloadSize, &entry.id, &entry.ping);
+
+        piece.entries.append(entry);
+      }
+
+      p = next;
+      continue;
+    }
+
+    quint64 q = SyncItem(pData, size, p + 1, piece.end);
+
+    if (q == piece.end)
+    {
+      piece.exit   = s_lost;
+      piece.lostAt = p;
+      return;
+    }
+
+    piece.corrupt.append({ p, q - p });
+    p = q;
+  }
+
+  piece.exit = p;
+}
+
+// ----------------------------------------------------------------------------
+// Index a log without a footer on all cores. The mapped file is cut into
+// pieces, each thread finds the first record in its piece and walks from
+// there. The pieces are then joined in order: where the record a walk ran on
+// to isn't the one the next piece started from, that piece is walked again
+// from the right place. Bad data is skipped and reported in m_corrupt rather
+// than ending the index
+bool RmLogIndex::ScanParallel(QFile& file, quint64 from, int nThreads)
+{
+  if (m_fileSize <= from)
+  {
+    m_indexed = from;
+    return true;
+  }
+
+  const quint8* pData = file.map(0, m_fileSize);
+
+  if (!pData)
+    return false;
+
+  if (nThreads <= 0)
+    nThreads = QThread::idealThreadCount();
+
+  quint64 span      = m_fileSize - from;
+  quint64 pieceSize = qMax((quint64) LOG_INDEX_PIECE, span / (nThreads * 4) + 1);
+  int     nPieces   = (int) ((span + pieceSize - 1) / pieceSize);
+
+  QVector<RmIndexPiece> pieces(nPieces);
+
+  QThreadPool pool;
+  pool.setMaxThreadCount(nThreads);
+
+  for (int i = 0; i < nPieces; i++)
+  {
+    RmIndexPiece* pPiece = &pieces[i];
+
+    pPiece->start = from + i * pieceSize;
+    pPiece->end   = qMin(pPiece->start + pieceSize, m_fileSize);
+
+    pool.start([this, pData, pPiece]() {
+      pPiece->first = SyncItem(pData, m_fileSize, pPiece->start, pPiece->end);
+
+      if (pPiece->first < pPiece->end)
+        WalkPiece(pData, m_fileSize, pPiece->first, *pPiece);
+      else
+        pPiece->exit = pPiece->end;
+    });
+  }
+
+  pool.waitForDone();
+
+  // Join the pieces
+  quint64 pos    = from;
+  quint64 lostAt = s_lost;
+
+  for (RmIndexPiece& piece : pieces)
+  {
+    // After bad data carry on from the first record the piece found
+    if (lostAt != s_lost)
+    {
+      if (piece.first == piece.end)
+        continue;
+
+      m_corrupt.append({ lostAt, piece.first - lostAt });
+      pos    = piece.first;
+      lostAt = s_lost;
+    }
+
+    // Inside a payload that runs over the whole piece
+    if (pos >= piece.end)
+      continue;
+
+    // The piece started somewhere else (on a magic in a payload, or past a
+    // record the walk before it found) - walk it again from the right place
+    if (piece.first != pos)
+    {
+      piece.entries.clear();
+      piece.corrupt.clear();
+      piece.first = pos;
+
+      WalkPiece(pData, m_fileSize, pos, piece);
+    }
+
+    for (const RmIndexEntry& entry : piece.entries)
+      if (!Add(entry.offset, entry.type, entry.time, entry.id, entry.ping))
+      {
+        file.unmap((uchar*) pData);
+        return false;
+      }
+
+    m_corrupt += piece.corrupt;
+
+    if (piece.exit == s_lost)
+      lostAt = piece.lostAt;
+    else
+      pos = piece.exit;
+  }
+
+  if (lostAt != s_lost)
+  {
+    m_corrupt.append({ lostAt, m_fileSize - lostAt });
+    pos = lostAt;
+  }
+
+  m_indexed = pos;
+
+  file.unmap((uchar*) pData);
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Build the index of a log by scanning it, whatever index it already has
+bool RmLogIndex::Rebuild(QString file, int nThreads)
+{
+  Clear();
+
+  QFile log(file);
+
+  if (!log.open(QIODevice::ReadOnly))
+    return false;
+
+  RmLogHeader header;
+
+  if (log.read((char*) &header, sizeof(RmLogHeader)) != sizeof(RmLogHeader) ||
+      header.fileHeader != RmLogger::s_fileHeader || header.sizeHeader != sizeof(RmLogHeader))
+    return false;
+
+  m_fileName = file;
+  m_fileSize = log.size();
+  m_source   = indexScan;
+
+  if (!ScanParallel(log, sizeof(RmLogHeader), nThreads))
+    Scan(log, sizeof(RmLogHeader));
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Size of an rt_logIndex item holding count entries
+unsigned RmLogIndex::ItemSize(int count)
+{
+  return sizeof(RmLogItem) + sizeof(RmIndexChunk) + count * sizeof(RmIndexEntry);
+}
+
+// ----------------------------------------------------------------------------
+// Write the item (header, chunk and entries) for the entries from first
+void RmLogIndex::BuildItem(quint8* pDst, int first, int count, bool footer, quint64 previous)
+{
+  RmLogItem item;
+  memset(&item, 0, sizeof(RmLogItem));
+
+  item.itemHeader   = RmLogger::s_itemHeader;
+  item.sizeHeader   = sizeof(RmLogItem);
+  item.type         = rt_logIndex;
+  item.version      = LOG_INDEX_VERSION;
+  item.time         = (double) QDateTime::currentMSecsSinceEpoch() / 1000.0;
+  item.compression  = 0;
+  item.payloadSize  = sizeof(RmIndexChunk) + count * sizeof(RmIndexEntry);
+  item.originalSize = item.payloadSize;
+
+  RmIndexChunk chunk;
+  memset(&chunk, 0, sizeof(RmIndexChunk));
+
+  chunk.magic    = s_chunkMagic;
+  chunk.version  = LOG_INDEX_VERSION;
+  chunk.footer   = footer ? 1 : 0;
+  chunk.previous = previous;
+  chunk.nEntries = count;
+
+  memcpy(pDst, &item, sizeof(RmLogItem));
+  memcpy(pDst + sizeof(RmLogItem), &chunk, sizeof(RmIndexChunk));
+  memcpy(pDst + sizeof(RmLogItem) + sizeof(RmIndexChunk), m_pEntries + first, count * sizeof(RmIndexEntry));
+
+  RmCrc32c::Seal(pDst);
+}
+
+// ----------------------------------------------------------------------------
+// Size of the tail item
+unsigned RmLogIndex::TailSize()
+{
+  return sizeof(RmLogItem) + sizeof(RmIndexTail);
+}
+
+// ----------------------------------------------------------------------------
+// Write the tail item pointing at the footer
+void RmLogIndex::BuildTail(quint8* pDst, quint64 footer, quint32 nEntries)
+{
+  RmLogItem item;
+  memset(&item, 0, sizeof(RmLogItem));
+
+  item.itemHeader   = RmLogger::s_itemHeader;
+  item.sizeHeader   = sizeof(RmLogItem);
+  item.type         = rt_logIndexTail;
+  item.version      = LOG_INDEX_VERSION;
+  item.time         = (double) QDateTime::currentMSecsSinceEpoch() / 1000.0;
+  item.payloadSize  = sizeof(RmIndexTail);
+  item.originalSize = item.payloadSize;
+
+  RmIndexTail tail;
+  tail.magic    = s_tailMagic;
+  tail.nEntries = nEntries;
+  tail.footer   = footer;
+
+  memcpy(pDst, &item, sizeof(RmLogItem));
+  memcpy(pDst + sizeof(RmLogItem), &tail, sizeof(RmIndexTail));
+
+  RmCrc32c::Seal(pDst);
+}
+
+// ----------------------------------------------------------------------------
+// Read the header of a simple ping result. Of a compressed payload only the
+// header is unpacked (see RmCodec::DecompressPrefix), never the image
+bool RmLogIndex::ReadPing(quint16 type, quint16 compression, const quint8* pPayload, unsigned size, unsigned originalSize, RmPingHeader& ping)
+{
+  if (type != rt_oculusSonar)
+    return false;
+
+  quint8 head[sizeof(OculusSimplePingResult2)];
+
+  if (compression != 0)
+  {
+    unsigned prefix = qMin(originalSize, (unsigned) sizeof(head));
+
+    if (!RmCodec::DecompressPrefix(compression, pPayload, size, originalSize, head, prefix))
+      return false;
+
+    pPayload = head;
+    size     = originalSize;
+  }
+
+  if (size < sizeof(OculusMessageHeader))
+    return false;
+
+  OculusMessageHeader message;
+  memcpy(&message, pPayload, sizeof(OculusMessageHeader));
+
+  if (message.msgId != messageSimplePingResult)
+    return false;
+
+  if (message.msgVersion == 2)
+  {
+    OculusSimplePingResult2 result;
+
+    if (size < sizeof(result))
+      return false;
+
+    memcpy(&result, pPayload, sizeof(result));
+
+    ping.id           = result.pingId;
+    ping.clock        = result.pingStartTime;
+    ping.nRanges      = result.nRanges;
+    ping.nBeams       = result.nBeams;
+    ping.rangeRes     = result.rangeResolution;
+    ping.range        = result.fireMessage.range;
+    ping.gain         = result.fireMessage.gainPercent;
+    ping.frequency    = result.frequency;
+    ping.temperature  = result.temperature;
+    ping.pressure     = result.pressure;
+    ping.heading      = result.heading;
+    ping.pitch        = result.pitch;
+    ping.roll         = result.roll;
+    ping.speedOfSound = result.speedOfSoundUsed;
+  }
+  else
+  {
+    OculusSimplePingResult result;
+
+    if (size < sizeof(result))
+      return false;
+
+    memcpy(&result, pPayload, sizeof(result));
+
+    ping.id           = result.pingId;
+    ping.clock        = 0.0;
+    ping.nRanges      = result.nRanges;
+    ping.nBeams       = result.nBeams;
+    ping.rangeRes     = result.rangeResolution;
+    ping.range        = result.fireMessage.range;
+    ping.gain         = result.fireMessage.gainPercent;
+    ping.frequency    = result.frequency;
+    ping.temperature  = result.temperature;
+    ping.pressure     = result.pressure;
+    ping.heading      = std::numeric_limits<double>::quiet_NaN();
+    ping.pitch        = std::numeric_limits<double>::quiet_NaN();
+    ping.roll         = std::numeric_limits<double>::quiet_NaN();
+    ping.speedOfSound = result.speedOfSoundUsed;
+  }
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// The sidecar lives next to the log
+QString RmLogIndex::SidecarName(QString file)
+{
+  return file + ".idx";
+}
@@ -0,0 +1,179 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#pragma once
+
+#include <QString>
+#include <QFile>
+#include <QtGlobal>
+#include <QVector>
+
+#define LOG_INDEX_VERSION   1
+#define LOG_INDEX_INTERVAL  4096                // Records between index chunks...
+#define LOG_INDEX_GAP       (16 * 1024 * 1024)  // ...or bytes, whichever comes first
+#define LOG_INDEX_SEARCH    (64 * 1024 * 1024)  // How far back to look for the last chunk
+#define LOG_INDEX_PIECE     (32 * 1024 * 1024)  // Smallest piece a thread indexes
+
+// ----------------------------------------------------------------------------
+// One record in the log
+struct RmIndexEntry
+{
+  quint64 offset;       // File position of the record's RmLogItem
+  double  time;         // Item time
+  double  ping;         // Ping start time of sonar records (0 if none)
+  quint32 id;           // Ping id for sonar records (0 otherwise)
+  quint16 type;         // Record type (eRecordTypes)
+  quint16 flags;        // Reserved
+};
+
+// ----------------------------------------------------------------------------
+// Payload of an rt_logIndex item, followed by nEntries RmIndexEntry. The
+// logger writes one every LOG_INDEX_INTERVAL records covering the records since
+// the last one, and a footer covering the whole file when it is closed
+struct RmIndexChunk
+{
+  quint32 magic;        // RmLogIndex::s_chunkMagic
+  quint16 version;      // LOG_INDEX_VERSION
+  quint16 footer;       // 1 if this holds every record in the file
+  quint64 previous;     // Offset of the chunk before this one (0 = none)
+  quint32 nEntries;     // Entries following
+  quint32 reserved;
+};
+
+// ----------------------------------------------------------------------------
+// Payload of the rt_logIndexTail item, always the last item of a closed log so
+// the footer can be found without reading anything else
+struct RmIndexTail
+{
+  quint32 magic;        // RmLogIndex::s_tailMagic
+  quint32 nEntries;     // Entries in the footer
+  quint64 footer;       // Offset of the footer's rt_logIndex item
+};
+
+// ----------------------------------------------------------------------------
+// Header of a .idx sidecar, built once for logs written without an index
+struct RmIndexSidecar
+{
+  quint32 magic;        // RmLogIndex::s_sidecarMagic
+  quint16 version;      // LOG_INDEX_VERSION
+  quint16 reserved;
+  quint64 logSize;      // Size of the log the index was built from...
+  qint64  logModified;  // ...and its modification time (ms since epoch)
+  quint32 nEntries;     // Entries following
+  quint32 nCorrupt;     // RmIndexGap corrupt regions after the entries
+};
+
+// ----------------------------------------------------------------------------
+// A stretch of a log that doesn't hold valid records
+struct RmIndexGap
+{
+  quint64 offset;       // Start of the region
+  quint64 size;         // Bytes skipped
+};
+
+// ----------------------------------------------------------------------------
+// The header of an Oculus simple ping result, either version
+struct RmPingHeader
+{
+  quint32 id;           // Ping id
+  double  clock;        // Ping start time (s from power up), 0 for version 1
+  quint16 nRanges;      // Range lines
+  quint16 nBeams;       // Beams
+  double  rangeRes;     // Metres per range line
+  double  range;        // Range (m)
+  double  gain;         // Gain (%)
+  double  frequency;    // Acoustic frequency (Hz)
+  double  temperature;  // External temperature (deg C)
+  double  pressure;     // External pressure (bar)
+  double  heading;      // Attitude (degrees, NaN for version 1)
+  double  pitch;
+  double  roll;
+  double  speedOfSound; // Speed of sound used (m/s)
+};
+
+// ----------------------------------------------------------------------------
+// Where the index was loaded from
+enum eIndexSource
+{
+  indexNone,            // Nothing loaded
+  indexFooter,          // The footer of a closed log
+  indexChunks,          // The periodic chunks of a log that was not closed
+  indexSidecar,         // A sidecar built earlier
+  indexScan             // Walking the records (a sidecar is then written)
+};
+
+// ----------------------------------------------------------------------------
+// RmLogIndex - the offset, type, time, ping id and ping time of every record
+// in a log. Loading is independent of the file size for logs with a footer or
+// sidecar; the logger's writer uses the same class to build the index as it
+// writes
+
+class RmLogIndex
+{
+  Q_DISABLE_COPY(RmLogIndex)
+
+public:
+  RmLogIndex();
+  ~RmLogIndex();
+
+  // Methods
+  void    Clear();
+  bool    Add(quint64 offset, quint16 type, double time, quint32 id, double ping = 0.0);
+  bool    AddItem(quint64 offset, const quint8* pItem, quint32 id, double ping = 0.0);
+  int     TypeIndex(int type, quint64** ppEntries);
+  int     CountOfType(int type);
+  bool    IsCurrent(QString file);
+
+  // Reading
+  bool    Load(QString file, bool writeSidecar = true);
+  bool    ReadFooter(QFile& file);
+  bool    ReadChunks(QFile& file);
+  bool    ReadSidecar(QString file);
+  bool    WriteSidecar(QString file);
+  bool    Scan(QFile& file, quint64 from);
+  bool    ScanParallel(QFile& file, quint64 from, int nThreads = 0);
+  bool    Rebuild(QString file, int nThreads = 0);
+
+  // Writing (the logger)
+  unsigned ItemSize(int count);
+  void     BuildItem(quint8* pDst, int first, int count, bool footer, quint64 previous);
+  static void BuildTail(quint8* pDst, quint64 footer, quint32 nEntries);
+  static unsigned TailSize();
+
+  static QString SidecarName(QString file);
+  static bool    ReadPing(quint16 type, quint16 compression, const quint8* pPayload, unsigned size, unsigned originalSize, RmPingHeader& ping);
+
+  // Data
+  RmIndexEntry* m_pEntries;   // The records in file order
+  int           m_nEntries;   // Number of records
+  int           m_capacity;   // Entries allocated
+  QString       m_fileName;   // Log the index was loaded for
+  quint64       m_fileSize;   // Its size when loaded
+  quint64       m_indexed;    // End of the last record indexed
+  eIndexSource  m_source;     // Where the index came from
+  QVector<RmIndexGap> m_corrupt; // Regions skipped by the scan
+
+  static const quint32 s_chunkMagic;
+  static const quint32 s_tailMagic;
+  static const quint32 s_sidecarMagic;
+
+protected:
+  bool    ReadChunk(QFile& file, quint64 offset, RmIndexChunk& chunk, bool entries);
+  bool    LoadFailed();
+};
@@ -0,0 +1,111 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include <algorithm>
+#include <queue>
+
+#include "RmLogMerge.h"
+
+// ============================================================================
+// RmLogMerge - one timeline over several logs
+
+// ----------------------------------------------------------------------------
+// Merge the sources' entries. Each source is already in time order, so a heap
+// holding the next record of each is all that's needed: O(n log k)
+void RmLogMerge::Build(const QVector<QVector<RmSessionEntry>>& sources)
+{
+  typedef std::pair<double, int> Head;    // Time of the source's next record, source
+
+  std::priority_queue<Head, std::vector<Head>, std::greater<Head>> heap;
+  QVector<int> next(sources.size(), 0);
+  int          total = 0;
+
+  for (int s = 0; s < sources.size(); s++)
+  {
+    total += sources[s].size();
+
+    if (!sources[s].isEmpty())
+      heap.push(Head(sources[s].at(0).sync, s));
+  }
+
+  m_entries.clear();
+  m_entries.reserve(total);
+
+  while (!heap.empty())
+  {
+    int s = heap.top().second;
+    heap.pop();
+
+    int e = next[s]++;
+
+    m_entries.append({ sources[s].at(e).sync, s, e });
+
+    if (next[s] < sources[s].size())
+      heap.push(Head(sources[s].at(next[s]).sync, s));
+  }
+}
+
+// ----------------------------------------------------------------------------
+void RmLogMerge::Clear()
+{
+  m_entries.clear();
+}
+
+// ----------------------------------------------------------------------------
+int RmLogMerge::Count()
+{
+  return m_entries.size();
+}
+
+// ----------------------------------------------------------------------------
+// The last record at or before the time, -1 if there is none
+int RmLogMerge::FindTime(double time)
+{
+  auto after = std::upper_bound(m_entries.constBegin(), m_entries.constEnd(), time,
+                                [](double t, const RmMergeEntry& e) { return t < e.time; });
+
+  return int(after - m_entries.constBegin()) - 1;
+}
+
+// ----------------------------------------------------------------------------
+// Time of the first record after the time going forward (direction 1), or the
+// last one before it going back (-1). False when there isn't one
+bool RmLogMerge::NextTime(double time, int direction, double* pNext)
+{
+  int n;
+
+  if (direction > 0)
+  {
+    n = FindTime(time) + 1;
+  }
+  else
+  {
+    auto at = std::lower_bound(m_entries.constBegin(), m_entries.constEnd(), time,
+                               [](const RmMergeEntry& e, double t) { return e.time < t; });
+
+    n = int(at - m_entries.constBegin()) - 1;
+  }
+
+  if (n < 0 || n >= m_entries.size())
+    return false;
+
+  *pNext = m_entries[n].time;
+
+  return true;
+}
@@ -0,0 +1,52 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#pragma once
+
+#include <QVector>
+
+#include "RmLogSession.h"
+
+// ----------------------------------------------------------------------------
+// A record in the merged timeline
+struct RmMergeEntry
+{
+  double time;          // Synchronised time
+  int    source;        // Log it comes from
+  int    entry;         // Its entry in that log's session
+};
+
+// ----------------------------------------------------------------------------
+// RmLogMerge - the records of several logs (e.g. one per sonar head) merged
+// into one timeline by a k-way merge of their session indexes, so a single
+// clock can drive all of them
+
+class RmLogMerge
+{
+public:
+  // Methods
+  void Build(const QVector<QVector<RmSessionEntry>>& sources);
+  void Clear();
+  int  Count();
+  int  FindTime(double time);
+  bool NextTime(double time, int direction, double* pNext);
+
+  // Data
+  QVector<RmMergeEntry> m_entries;    // Every record in time order
+};
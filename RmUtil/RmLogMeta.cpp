@@ -0,0 +1,485 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QDateTime>
+#include <QThreadPool>
+#include <QThread>
+#include <QAtomicInt>
+
+#include <cmath>
+#include <limits>
+
+#include "RmLogMeta.h"
+#include "RmLogIndex.h"
+#include "RmLogger.h"
+
+const quint32 RmLogMeta::s_magic = 0x4154454d;      // "META"
+
+// How the values of a column are stored
+enum eMetaType
+{
+  metaU64,
+  metaF64,
+  metaU32,
+  metaU16,
+  metaF32
+};
+
+// ----------------------------------------------------------------------------
+// Name (for queries) and storage of each column
+struct RmMetaColumnInfo
+{
+  const char* name;
+  eMetaType   type;
+  unsigned    size;
+};
+
+static const RmMetaColumnInfo s_columns[metaColumns] =
+{
+  { "offset",      metaU64, 8 },
+  { "time",        metaF64, 8 },
+  { "id",          metaU32, 4 },
+  { "ranges",      metaU16, 2 },
+  { "beams",       metaU16, 2 },
+  { "resolution",  metaF32, 4 },
+  { "range",       metaF32, 4 },
+  { "gain",        metaF32, 4 },
+  { "frequency",   metaF32, 4 },
+  { "temperature", metaF32, 4 },
+  { "pressure",    metaF32, 4 },
+  { "heading",     metaF32, 4 },
+  { "pitch",       metaF32, 4 },
+  { "roll",        metaF32, 4 },
+  { "sos",         metaF32, 4 }
+};
+
+// ----------------------------------------------------------------------------
+// One ping's row, as it is read from the log
+struct RmMetaRow
+{
+  quint64 offset;
+  double  time;
+  quint32 id;
+  quint16 nRanges;
+  quint16 nBeams;
+  float   value[metaColumns];   // The float columns (metaRangeRes on)
+  bool    ok;
+};
+
+// ============================================================================
+// RmLogMeta - columnar ping metadata
+
+RmLogMeta::RmLogMeta()
+{
+  m_pMap   = nullptr;
+  m_nPings = 0;
+
+  for (int c = 0; c < metaColumns; c++)
+    m_pColumns[c] = nullptr;
+}
+
+RmLogMeta::~RmLogMeta()
+{
+  Close();
+}
+
+// ----------------------------------------------------------------------------
+// The sidecar lives next to the log
+QString RmLogMeta::SidecarName(QString file)
+{
+  return file + ".meta";
+}
+
+// ----------------------------------------------------------------------------
+QString RmLogMeta::ColumnName(eMetaColumn column)
+{
+  return s_columns[column].name;
+}
+
+// ----------------------------------------------------------------------------
+// The column with a name, -1 if there isn't one
+int RmLogMeta::FindColumn(QString name)
+{
+  for (int c = 0; c < metaColumns; c++)
+    if (name.compare(s_columns[c].name, Qt::CaseInsensitive) == 0)
+      return c;
+
+  return -1;
+}
+
+// ----------------------------------------------------------------------------
+// Map the log's sidecar. If it is missing or was built from an older version
+// of the log it is built first (unless build is false)
+bool RmLogMeta::Load(QString file, bool build, int nThreads)
+{
+  if (Map(file))
+    return true;
+
+  return build && Build(file, nThreads) && Map(file);
+}
+
+// ----------------------------------------------------------------------------
+// Unmap the sidecar
+void RmLogMeta::Close()
+{
+  if (m_pMap)
+    m_sidecar.unmap(m_pMap);
+
+  m_sidecar.close();
+
+  m_pMap   = nullptr;
+  m_nPings = 0;
+
+  for (int c = 0; c < metaColumns; c++)
+    m_pColumns[c] = nullptr;
+}
+
+// ----------------------------------------------------------------------------
+int RmLogMeta::Count()
+{
+  return m_nPings;
+}
+
+// ----------------------------------------------------------------------------
+// A column's values (quint64, double, quint32, quint16 or float, see
+// eMetaColumn), nullptr when nothing is loaded
+const void* RmLogMeta::Column(eMetaColumn column)
+{
+  return m_pColumns[column];
+}
+
+// ----------------------------------------------------------------------------
+// One value, whatever its column's type
+double RmLogMeta::Value(eMetaColumn column, int row)
+{
+  const uchar* pColumn = m_pColumns[column];
+
+  if (!pColumn || row < 0 || row >= m_nPings)
+    return 0.0;
+
+  switch (s_columns[column].type)
+  {
+  case metaU64: return ((const quint64*) pColumn)[row];
+  case metaF64: return ((const double*) pColumn)[row];
+  case metaU32: return ((const quint32*) pColumn)[row];
+  case metaU16: return ((const quint16*) pColumn)[row];
+  case metaF32: return ((const float*) pColumn)[row];
+  }
+
+  return 0.0;
+}
+
+// ----------------------------------------------------------------------------
+// Clear the mask of the values outside [min, max]. Branch free, so the
+// compiler vectorises it
+template <typename T>
+static void MatchRange(const T* pValues, int count, T min, T max, quint8* pMask)
+{
+  for (int i = 0; i < count; i++)
+    pMask[i] &= (quint8) ((pValues[i] >= min) & (pValues[i] <= max));
+}
+
+// ----------------------------------------------------------------------------
+// As above for an integer column. The limits are brought inside the type; a
+// 64 bit maximum rounds up to 2^64 as a double, which doesn't convert back
+template <typename T>
+static void MatchInteger(const T* pValues, int count, double min, double max, quint8* pMask)
+{
+  double top = (double) std::numeric_limits<T>::max();
+
+  if (std::numeric_limits<T>::digits > std::numeric_limits<double>::digits)
+    top = std::nextafter(top, 0.0);
+
+  min = std::ceil(qMax(min, 0.0));
+  max = std::floor(qMin(max, top));
+
+  if (min > max)
+  {
+    memset(pMask, 0, count);
+    return;
+  }
+
+  MatchRange<T>(pValues, count, (T) min, (T) max, pMask);
+}
+
+// ----------------------------------------------------------------------------
+// The rows that pass every filter, in log order. Each filter is one pass over
+// its column
+QVector<int> RmLogMeta::Select(const QVector<RmMetaFilter>& filters)
+{
+  QVector<int> rows;
+
+  if (m_nPings == 0)
+    return rows;
+
+  QVector<quint8> mask(m_nPings, 1);
+  quint8*         pMask = mask.data();
+
+  for (const RmMetaFilter& filter : filters)
+  {
+    const uchar* pColumn = m_pColumns[filter.column];
+
+    switch (s_columns[filter.column].type)
+    {
+    case metaU64: MatchInteger<quint64>((const quint64*) pColumn, m_nPings, filter.min, filter.max, pMask); break;
+    case metaU32: MatchInteger<quint32>((const quint32*) pColumn, m_nPings, filter.min, filter.max, pMask); break;
+    case metaU16: MatchInteger<quint16>((const quint16*) pColumn, m_nPings, filter.min, filter.max, pMask); break;
+    case metaF64: MatchRange<double>((const double*) pColumn, m_nPings, filter.min, filter.max, pMask);    break;
+    case metaF32: MatchRange<float>((const float*) pColumn, m_nPings, (float) filter.min, (float) filter.max, pMask); break;
+    }
+  }
+
+  for (int i = 0; i < m_nPings; i++)
+    if (pMask[i])
+      rows.append(i);
+
+  return rows;
+}
+
+// ----------------------------------------------------------------------------
+// Read the metadata of one sonar record into a row
+static void ReadRow(const quint8* pLog, quint64 size, const RmIndexEntry& entry, RmMetaRow& row)
+{
+  row.ok     = false;
+  row.offset = entry.offset;
+  row.time   = entry.time;
+
+  // An index entry past the end of the log (a stale footer) has no row
+  if (entry.offset > size || size - entry.offset < sizeof(RmLogItem))
+    return;
+
+  RmLogItem item;
+  memcpy(&item, pLog + entry.offset, sizeof(RmLogItem));
+
+  if (item.payloadSize > size - entry.offset - sizeof(RmLogItem))
+    return;
+
+  RmPingHeader ping;
+
+  if (!RmLogIndex::ReadPing(item.type, item.compression, pLog + entry.offset + sizeof(RmLogItem), item.payloadSize, item.originalSize, ping))
+    return;
+
+  row.id      = ping.id;
+  row.nRanges = ping.nRanges;
+  row.nBeams  = ping.nBeams;
+
+  row.value[metaRangeRes]     = ping.rangeRes;
+  row.value[metaRange]        = ping.range;
+  row.value[metaGain]         = ping.gain;
+  row.value[metaFrequency]    = ping.frequency;
+  row.value[metaTemperature]  = ping.temperature;
+  row.value[metaPressure]     = ping.pressure;
+  row.value[metaHeading]      = ping.heading;
+  row.value[metaPitch]        = ping.pitch;
+  row.value[metaRoll]         = ping.roll;
+  row.value[metaSpeedOfSound] = ping.speedOfSound;
+
+  row.ok = true;
+}
+
+// ----------------------------------------------------------------------------
+// Lay out one column of the rows that were read
+static void FillColumn(int column, const QVector<RmMetaRow>& rows, uchar* pData)
+{
+  int n = 0;
+
+  for (const RmMetaRow& row : rows)
+  {
+    if (!row.ok)
+      continue;
+
+    switch (column)
+    {
+    case metaOffset: ((quint64*) pData)[n] = row.offset;       break;
+    case metaTime:   ((double*)  pData)[n] = row.time;         break;
+    case metaPingId: ((quint32*) pData)[n] = row.id;           break;
+    case metaRanges: ((quint16*) pData)[n] = row.nRanges;      break;
+    case metaBeams:  ((quint16*) pData)[n] = row.nBeams;       break;
+    default:         ((float*)   pData)[n] = row.value[column]; break;
+    }
+
+    n++;
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Read every simple ping in the log, on all threads, and write the columns
+// out as the sidecar
+bool RmLogMeta::Build(QString file, int nThreads)
+{
+  RmLogIndex index;
+
+  if (!index.Load(file))
+    return false;
+
+  QFile log(file);
+
+  if (!log.open(QIODevice::ReadOnly))
+    return false;
+
+  const quint8* pLog = log.map(0, index.m_fileSize);
+
+  if (!pLog)
+    return false;
+
+  // The sonar records, the rows are read for these in parallel
+  QVector<int> sonar;
+
+  for (int e = 0; e < index.m_nEntries; e++)
+    if (index.m_pEntries[e].type == rt_oculusSonar)
+      sonar.append(e);
+
+  QVector<RmMetaRow> rows(sonar.size());
+  QAtomicInt         next(0);
+  QThreadPool        pool;
+
+  if (nThreads <= 0)
+    nThreads = QThread::idealThreadCount();
+
+  pool.setMaxThreadCount(nThreads);
+
+  for (int t = 0; t < nThreads; t++)
+  {
+    pool.start([&]() {
+      // Blocks of 1024 rows at a time
+      for (int b = next.fetchAndAddRelaxed(1024); b < sonar.size(); b = next.fetchAndAddRelaxed(1024))
+        for (int r = b; r < qMin(b + 1024, sonar.size()); r++)
+          ReadRow(pLog, index.m_fileSize, index.m_pEntries[sonar.at(r)], rows[r]);
+    });
+  }
+
+  pool.waitForDone();
+
+  log.unmap((uchar*) pLog);
+
+  // Lay the sidecar out
+  RmMetaHeader header;
+  memset(&header, 0, sizeof(RmMetaHeader));
+
+  quint32 nPings = 0;
+
+  for (const RmMetaRow& row : rows)
+    if (row.ok)
+      nPings++;
+
+  header.magic       = s_magic;
+  header.version     = LOG_META_VERSION;
+  header.nColumns    = metaColumns;
+  header.logSize     = index.m_fileSize;
+  header.logModified = QFileInfo(file).lastModified().toMSecsSinceEpoch();
+  header.nPings      = nPings;
+
+  quint64 pos = sizeof(RmMetaHeader);
+
+  for (int c = 0; c < metaColumns; c++)
+  {
+    pos = (pos + LOG_META_ALIGN - 1) & ~(quint64) (LOG_META_ALIGN - 1);
+    header.column[c] = pos;
+    pos += (quint64) nPings * s_columns[c].size;
+  }
+
+  // Written a column at a time, a large log's sidecar is more than one
+  // QByteArray can hold
+  QSaveFile sidecar(SidecarName(file));
+
+  if (!sidecar.open(QIODevice::WriteOnly))
+    return false;
+
+  quint64 written = sizeof(RmMetaHeader);
+  bool    ok      = (sidecar.write((const char*) &header, sizeof(RmMetaHeader)) == sizeof(RmMetaHeader));
+
+  for (int c = 0; ok && c < metaColumns; c++)
+  {
+    quint64 bytes = (quint64) nPings * s_columns[c].size;
+
+    if (bytes > (quint64) std::numeric_limits<int>::max())
+    {
+      ok = false;
+      break;
+    }
+
+    QByteArray padding((int) (header.column[c] - written), 0);
+    QByteArray column((int) bytes, 0);
+
+    FillColumn(c, rows, (uchar*) column.data());
+
+    ok = (sidecar.write(padding) == padding.size() && sidecar.write(column) == column.size());
+
+    written = header.column[c] + bytes;
+  }
+
+  if (!ok)
+  {
+    sidecar.cancelWriting();
+    return false;
+  }
+
+  return sidecar.commit();
+}
+
+// ----------------------------------------------------------------------------
+// Map the sidecar if it matches the log
+bool RmLogMeta::Map(QString file)
+{
+  Close();
+
+  m_sidecar.setFileName(SidecarName(file));
+
+  if (!m_sidecar.open(QIODevice::ReadOnly))
+    return false;
+
+  RmMetaHeader header;
+  QFileInfo    info(file);
+  quint64      size = m_sidecar.size();
+
+  if (m_sidecar.read((char*) &header, sizeof(RmMetaHeader)) != sizeof(RmMetaHeader) ||
+      header.magic != s_magic || header.version != LOG_META_VERSION || header.nColumns != metaColumns ||
+      header.logSize != (quint64) info.size() || header.logModified != info.lastModified().toMSecsSinceEpoch())
+  {
+    Close();
+    return false;
+  }
+
+  for (int c = 0; c < metaColumns; c++)
+  {
+    if (header.column[c] % LOG_META_ALIGN != 0 || header.column[c] > size ||
+        (size - header.column[c]) / s_columns[c].size < header.nPings)
+    {
+      Close();
+      return false;
+    }
+  }
+
+  m_pMap = m_sidecar.map(0, size);
+
+  if (!m_pMap)
+  {
+    Close();
+    return false;
+  }
+
+  for (int c = 0; c < metaColumns; c++)
+    m_pColumns[c] = m_pMap + header.column[c];
+
+  m_nPings = header.nPings;
+
+  return true;
+}
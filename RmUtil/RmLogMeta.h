@@ -0,0 +1,112 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#pragma once
+
+#include <QString>
+#include <QFile>
+#include <QVector>
+
+#define LOG_META_VERSION  1
+#define LOG_META_ALIGN    64        // Column alignment in the sidecar
+
+// ----------------------------------------------------------------------------
+// The columns of the metadata sidecar, one value per sonar ping
+enum eMetaColumn
+{
+  metaOffset,           // File position of the record (quint64)
+  metaTime,             // Record time (double)
+  metaPingId,           // Ping id (quint32)
+  metaRanges,           // Range lines (quint16)
+  metaBeams,            // Beams (quint16)
+  metaRangeRes,         // Metres per range line (float from here on)
+  metaRange,            // Range (m)
+  metaGain,             // Gain (%)
+  metaFrequency,        // Acoustic frequency (Hz)
+  metaTemperature,      // External temperature (deg C)
+  metaPressure,         // External pressure (bar)
+  metaHeading,          // Attitude (degrees, NaN for version 1 pings)
+  metaPitch,
+  metaRoll,
+  metaSpeedOfSound,     // Speed of sound used (m/s)
+  metaColumns
+};
+
+// ----------------------------------------------------------------------------
+// Header of a .meta sidecar. Each column follows as a plain array, aligned to
+// LOG_META_ALIGN so it can be scanned straight from the mapping
+struct RmMetaHeader
+{
+  quint32 magic;        // RmLogMeta::s_magic
+  quint16 version;      // LOG_META_VERSION
+  quint16 nColumns;     // metaColumns
+  quint64 logSize;      // Size of the log the sidecar was built from...
+  qint64  logModified;  // ...and its modification time (ms since epoch)
+  quint32 nPings;       // Values in each column
+  quint32 reserved;
+  quint64 column[metaColumns];  // Offset of each column in the sidecar
+};
+
+// ----------------------------------------------------------------------------
+// A condition on a column: min <= value <= max
+struct RmMetaFilter
+{
+  eMetaColumn column;
+  double      min;
+  double      max;
+};
+
+// ----------------------------------------------------------------------------
+// RmLogMeta - the settings and sensor readings of every simple ping in a log,
+// kept column by column in a sidecar so that finding pings by range, gain,
+// frequency, temperature or attitude is a scan of a few mapped arrays rather
+// than a decode of the whole log. The sidecar is built offline (or on first
+// use) from the log's index and rebuilt when the log changes
+
+class RmLogMeta
+{
+  Q_DISABLE_COPY(RmLogMeta)
+
+public:
+  RmLogMeta();
+  ~RmLogMeta();
+
+  // Methods
+  bool         Load(QString file, bool build = true, int nThreads = 0);
+  bool         Build(QString file, int nThreads = 0);
+  void         Close();
+  int          Count();
+  const void*  Column(eMetaColumn column);
+  double       Value(eMetaColumn column, int row);
+  QVector<int> Select(const QVector<RmMetaFilter>& filters);
+
+  static QString SidecarName(QString file);
+  static QString ColumnName(eMetaColumn column);
+  static int     FindColumn(QString name);
+
+  static const quint32 s_magic;
+
+protected:
+  bool Map(QString file);
+
+  QFile        m_sidecar;                 // The mapped sidecar
+  uchar*       m_pMap;                    // Its mapping
+  int          m_nPings;                  // Rows
+  const uchar* m_pColumns[metaColumns];   // Start of each column in the mapping
+};
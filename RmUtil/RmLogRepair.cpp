@@ -0,0 +1,228 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include <QFile>
+#include <QSaveFile>
+#include <QFileInfo>
+#include <QDebug>
+
+#include "RmLogRepair.h"
+#include "RmLogger.h"
+
+// Largest single write when copying records
+static const quint64 s_copyBlock = 64 * 1024 * 1024;
+
+// ============================================================================
+// RmLogRepair - log recovery
+
+// ----------------------------------------------------------------------------
+// Repair a log. With no output file the log is repaired in place: cut back and
+// given a footer if only its tail is damaged, otherwise rewritten through a
+// temporary file. The report says what was kept and what was lost
+bool RmLogRepair::Repair(QString file, QString outFile, RmRepairReport& report, int nThreads)
+{
+  report.fileSize   = QFileInfo(file).size();
+  report.outputSize = 0;
+  report.nRecords   = 0;
+  report.lostBytes  = 0;
+  report.closed     = false;
+  report.truncated  = false;
+  report.lost.clear();
+
+  RmLogIndex index;
+
+  // A closed log is taken as it is, its footer means it isn't scanned for
+  // damage in the middle (RmLogVerify checks the records)
+  if (index.Load(file, false) && index.m_source == indexFooter)
+  {
+    report.closed     = true;
+    report.outputSize = report.fileSize;
+    report.nRecords   = index.m_nEntries;
+
+    if (outFile.isEmpty() || QFileInfo(outFile).canonicalFilePath() == QFileInfo(file).canonicalFilePath())
+      return true;
+
+    // QFile::copy won't replace an existing file
+    if (QFile::exists(outFile) && !QFile::remove(outFile))
+      return false;
+
+    return QFile::copy(file, outFile);
+  }
+
+  // Find every intact record whatever the log's chunks say
+  if (!index.Rebuild(file, nThreads))
+    return false;
+
+  report.nRecords = index.m_nEntries;
+
+  bool tailOnly = true;
+
+  for (const RmIndexGap& gap : index.m_corrupt)
+  {
+    RmRepairGap lost;
+
+    lost.offset     = gap.offset;
+    lost.size       = gap.size;
+    lost.timeBefore = 0.0;
+    lost.timeAfter  = 0.0;
+
+    // First record after the gap
+    int lo = 0, hi = index.m_nEntries;
+
+    while (lo < hi)
+    {
+      int mid = (lo + hi) / 2;
+
+      if (index.m_pEntries[mid].offset < gap.offset)
+        lo = mid + 1;
+      else
+        hi = mid;
+    }
+
+    if (lo > 0)
+      lost.timeBefore = index.m_pEntries[lo - 1].time;
+
+    if (lo < index.m_nEntries)
+      lost.timeAfter = index.m_pEntries[lo].time;
+
+    if (gap.offset + gap.size < index.m_fileSize)
+      tailOnly = false;
+
+    report.lostBytes += gap.size;
+    report.lost.append(lost);
+  }
+
+  // Nothing after the last record but the damage, cut it off and close the log
+  if (outFile.isEmpty() && tailOnly)
+    return TruncateInPlace(file, index, report);
+
+  return WriteCopy(file, outFile, index, report);
+}
+
+// ----------------------------------------------------------------------------
+// Cut the log back to its last whole record and add the footer
+bool RmLogRepair::TruncateInPlace(QString file, RmLogIndex& index, RmRepairReport& report)
+{
+  QFile log(file);
+
+  if (!log.open(QIODevice::ReadWrite))
+    return false;
+
+  if (!log.resize(index.m_indexed) || !log.seek(index.m_indexed))
+    return false;
+
+  if (!WriteFooter(log, index))
+    return false;
+
+  report.truncated  = true;
+  report.outputSize = log.size();
+
+  log.close();
+
+  // The old sidecar no longer matches
+  QFile::remove(RmLogIndex::SidecarName(file));
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Copy the header and every intact record, runs of records that sit together
+// in the damaged log go across in one write. The old index items are left
+// behind, the footer is rebuilt for the new positions
+bool RmLogRepair::WriteCopy(QString file, QString outFile, RmLogIndex& index, RmRepairReport& report)
+{
+  QFile log(file);
+
+  if (!log.open(QIODevice::ReadOnly))
+    return false;
+
+  const quint8* pData = log.map(0, index.m_fileSize);
+
+  if (!pData)
+    return false;
+
+  // In place goes through a temporary file that replaces the log on commit
+  QSaveFile out(outFile.isEmpty() ? file : outFile);
+
+  if (!out.open(QIODevice::WriteOnly))
+    return false;
+
+  bool ok = (out.write((const char*) pData, sizeof(RmLogHeader)) == sizeof(RmLogHeader));
+
+  quint64 written = sizeof(RmLogHeader);
+  int     e       = 0;
+
+  while (ok && e < index.m_nEntries)
+  {
+    // Gather the run of records that follow on from each other
+    quint64 runStart = index.m_pEntries[e].offset;
+    quint64 runEnd   = runStart;
+
+    for (; e < index.m_nEntries && index.m_pEntries[e].offset == runEnd; e++)
+    {
+      RmLogItem item;
+      memcpy(&item, pData + runEnd, sizeof(RmLogItem));
+
+      index.m_pEntries[e].offset = written + (runEnd - runStart);
+      runEnd += sizeof(RmLogItem) + item.payloadSize;
+    }
+
+    for (quint64 pos = runStart; ok && pos < runEnd; pos += s_copyBlock)
+    {
+      qint64 size = qMin(s_copyBlock, runEnd - pos);
+      ok = (out.write((const char*) pData + pos, size) == size);
+    }
+
+    written += runEnd - runStart;
+  }
+
+  log.unmap((uchar*) pData);
+
+  // The commit can replace the log, which mustn't still be open
+  log.close();
+
+  if (!ok || !WriteFooter(out, index))
+  {
+    out.cancelWriting();
+    return false;
+  }
+
+  report.outputSize = out.size();
+
+  if (!out.commit())
+    return false;
+
+  QFile::remove(RmLogIndex::SidecarName(outFile.isEmpty() ? file : outFile));
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Append the footer and tail for the index at the current position
+bool RmLogRepair::WriteFooter(QFileDevice& out, RmLogIndex& index)
+{
+  quint64    footer = out.pos();
+  unsigned   size   = index.ItemSize(index.m_nEntries);
+  QByteArray buffer(size + RmLogIndex::TailSize(), 0);
+
+  index.BuildItem((quint8*) buffer.data(), 0, index.m_nEntries, true, 0);
+  RmLogIndex::BuildTail((quint8*) buffer.data() + size, footer, index.m_nEntries);
+
+  return out.write(buffer) == buffer.size();
+}
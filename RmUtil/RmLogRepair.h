@@ -0,0 +1,65 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#pragma once
+
+#include <QString>
+#include <QVector>
+
+#include "RmLogIndex.h"
+
+// ----------------------------------------------------------------------------
+// A region of a log the repair could not recover
+struct RmRepairGap
+{
+  quint64 offset;       // Start of the region in the damaged log
+  quint64 size;         // Bytes lost
+  double  timeBefore;   // Time of the last record before it (0 = none)
+  double  timeAfter;    // Time of the first record after it (0 = none)
+};
+
+// ----------------------------------------------------------------------------
+// What a repair found and did
+struct RmRepairReport
+{
+  quint64 fileSize;     // Size of the damaged log
+  quint64 outputSize;   // Size of the repaired log
+  int     nRecords;     // Records recovered
+  quint64 lostBytes;    // Bytes in the regions lost
+  bool    closed;       // The log already had a footer, nothing was done
+  bool    truncated;    // Repaired in place by cutting the tail and adding the footer
+  QVector<RmRepairGap> lost;
+};
+
+// ----------------------------------------------------------------------------
+// RmLogRepair - recovers a log left damaged by a crash or a bad disk. Every
+// intact record is kept, the index is rebuilt and the footer written. A log
+// that only lost its tail is fixed where it is; one damaged in the middle is
+// copied without the bad data
+
+class RmLogRepair
+{
+public:
+  static bool Repair(QString file, QString outFile, RmRepairReport& report, int nThreads = 0);
+  static bool WriteFooter(QFileDevice& out, RmLogIndex& index);
+
+protected:
+  static bool TruncateInPlace(QString file, RmLogIndex& index, RmRepairReport& report);
+  static bool WriteCopy(QString file, QString outFile, RmLogIndex& index, RmRepairReport& report);
+};
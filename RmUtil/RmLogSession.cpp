@@ -0,0 +1,430 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include <QFileInfo>
+#include <QDir>
+#include <QRegularExpression>
+#include <QList>
+
+#include <algorithm>
+
+#include "RmLogSession.h"
+#include "RmLogger.h"
+
+// ----------------------------------------------------------------------------
+// A segment found while discovering the session
+struct RmFoundSegment
+{
+  QString                 file;
+  double                  start;
+  double                  end;
+  int                     corrupt;
+  QVector<RmSessionEntry> entries;
+};
+
+// ----------------------------------------------------------------------------
+// Index a file and pick out the records of the type. False if the file can't
+// be indexed or has no records at all
+static bool LoadSegment(QString file, int type, RmFoundSegment& found)
+{
+  RmLogIndex index;
+
+  if (!index.Load(file) || index.m_nEntries == 0)
+    return false;
+
+  found.file  = file;
+  found.start = index.m_pEntries[0].time;
+  found.end   = index.m_pEntries[index.m_nEntries - 1].time;
+  found.corrupt = index.m_corrupt.size();
+
+  // The ping times come with the index, the records themselves aren't read
+  for (int e = 0; e < index.m_nEntries; e++)
+    if (index.m_pEntries[e].type == type)
+      found.entries.append({ index.m_pEntries[e].offset, index.m_pEntries[e].time, index.m_pEntries[e].ping, 0.0, 0 });
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Does the later segment carry on from the earlier one
+static bool FollowsOn(const RmFoundSegment& earlier, const RmFoundSegment& later)
+{
+  double gap = later.start - earlier.end;
+
+  return gap > -1.0 && gap < SESSION_MAX_GAP;
+}
+
+// ============================================================================
+// RmLogSession - rotated log files played as one
+
+RmLogSession::RmLogSession()
+{
+  m_maxOpen  = SESSION_MAX_OPEN;
+  m_current  = -1;
+  m_nCorrupt = 0;
+  m_useCount = 0;
+}
+
+RmLogSession::~RmLogSession()
+{
+  Close();
+}
+
+// ----------------------------------------------------------------------------
+// Open the session the file belongs to and index the records of the type
+// across it. With join false only the file itself is opened
+bool RmLogSession::Open(QString file, int type, bool join)
+{
+  Close();
+
+  QString path = QFileInfo(file).absoluteFilePath();
+
+  QList<RmFoundSegment> found;
+  RmFoundSegment        segment;
+
+  if (!LoadSegment(path, type, segment))
+    return false;
+
+  found.append(segment);
+
+  if (join)
+  {
+    QStringList names = FindSegments(path);
+    int         at    = names.indexOf(path);
+
+    // Earlier segments while they lead into the first one found
+    for (int n = at - 1; n >= 0; n--)
+    {
+      RmFoundSegment earlier;
+
+      if (!LoadSegment(names[n], type, earlier) || !FollowsOn(earlier, found.first()))
+        break;
+
+      found.prepend(earlier);
+    }
+
+    // Later segments while they follow on from the last
+    for (int n = at + 1; at >= 0 && n < names.size(); n++)
+    {
+      RmFoundSegment later;
+
+      if (!LoadSegment(names[n], type, later) || !FollowsOn(found.last(), later))
+        break;
+
+      found.append(later);
+    }
+  }
+
+  // Merge the segment indexes
+  for (const RmFoundSegment& part : found)
+  {
+    RmSessionSegment segment;
+
+    segment.file     = part.file;
+    segment.start    = part.start;
+    segment.end      = part.end;
+    segment.first    = m_entries.size();
+    segment.count    = part.entries.size();
+    segment.pPlayer  = nullptr;
+    segment.lastUsed = 0;
+
+    m_nCorrupt += part.corrupt;
+
+    for (RmSessionEntry entry : part.entries)
+    {
+      entry.segment = m_segments.size();
+      m_entries.append(entry);
+    }
+
+    m_segments.append(segment);
+  }
+
+  SyncTimes();
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Put the ping clock onto the record clock. Over a run of pings from one sonar
+// power up the offset between the clocks is the smallest one seen, i.e. that
+// of the record delayed least on its way to the logger. A run ends where the
+// ping clock steps back (a restart) or wanders SESSION_MAX_DRIFT from the
+// record times. The times are kept in order for the search
+void RmLogSession::SyncTimes()
+{
+  RmSessionEntry* pEntries = m_entries.data();
+  int             n        = m_entries.size();
+
+  for (int run = 0; run < n; )
+  {
+    if (pEntries[run].ping <= 0.0)
+    {
+      pEntries[run].sync = pEntries[run].time;
+      run++;
+      continue;
+    }
+
+    double offset = pEntries[run].time - pEntries[run].ping;
+    int    end    = run + 1;
+
+    for (; end < n; end++)
+    {
+      if (pEntries[end].ping <= pEntries[end - 1].ping)
+        break;
+
+      double diff = pEntries[end].time - pEntries[end].ping;
+
+      if (qAbs(diff - offset) > SESSION_MAX_DRIFT)
+        break;
+
+      offset = qMin(offset, diff);
+    }
+
+    for (int e = run; e < end; e++)
+      pEntries[e].sync = pEntries[e].ping + offset;
+
+    run = end;
+  }
+
+  for (int e = 1; e < n; e++)
+    pEntries[e].sync = qMax(pEntries[e].sync, pEntries[e - 1].sync);
+}
+
+// ----------------------------------------------------------------------------
+// Close every segment
+void RmLogSession::Close()
+{
+  for (RmSessionSegment& segment : m_segments)
+    delete segment.pPlayer;
+
+  m_segments.clear();
+  m_entries.clear();
+  m_current  = -1;
+  m_nCorrupt = 0;
+}
+
+// ----------------------------------------------------------------------------
+bool RmLogSession::IsOpen()
+{
+  return !m_segments.isEmpty();
+}
+
+// ----------------------------------------------------------------------------
+// Records of the session's type
+int RmLogSession::Count()
+{
+  return m_entries.size();
+}
+
+// ----------------------------------------------------------------------------
+// Files in the session
+int RmLogSession::Segments()
+{
+  return m_segments.size();
+}
+
+// ----------------------------------------------------------------------------
+// Time of a record
+double RmLogSession::EntryTime(int entry)
+{
+  if (entry < 0 || entry >= m_entries.size())
+    return 0.0;
+
+  return m_entries[entry].time;
+}
+
+// ----------------------------------------------------------------------------
+// Sonar-synchronised time of a record
+double RmLogSession::SyncTime(int entry)
+{
+  if (entry < 0 || entry >= m_entries.size())
+    return 0.0;
+
+  return m_entries[entry].sync;
+}
+
+// ----------------------------------------------------------------------------
+// Seconds from a record to the next one, 0 for the last
+double RmLogSession::FrameDelta(int entry)
+{
+  if (entry < 0 || entry >= m_entries.size() - 1)
+    return 0.0;
+
+  return m_entries[entry + 1].sync - m_entries[entry].sync;
+}
+
+// ----------------------------------------------------------------------------
+// The record showing at a time - the last one at or before it, the first if
+// the time is before the session starts
+int RmLogSession::FindTime(double time)
+{
+  if (m_entries.isEmpty())
+    return -1;
+
+  auto after = std::upper_bound(m_entries.constBegin(), m_entries.constEnd(), time,
+                                [](double t, const RmSessionEntry& e) { return t < e.sync; });
+
+  return qMax(int(after - m_entries.constBegin()) - 1, 0);
+}
+
+// ----------------------------------------------------------------------------
+// The file last read from (the first file before anything is read)
+QString RmLogSession::CurrentFile()
+{
+  if (m_segments.isEmpty())
+    return QString();
+
+  return m_segments[qMax(m_current, 0)].file;
+}
+
+// ----------------------------------------------------------------------------
+// Damaged regions the segments were indexed around
+int RmLogSession::CorruptRegions()
+{
+  return m_nCorrupt;
+}
+
+// ----------------------------------------------------------------------------
+// The merged index, shared rather than copied, for readers on other threads
+QVector<RmSessionEntry> RmLogSession::Entries()
+{
+  return m_entries;
+}
+
+// ----------------------------------------------------------------------------
+// The session's files in segment order
+QStringList RmLogSession::Files()
+{
+  QStringList files;
+
+  for (const RmSessionSegment& segment : m_segments)
+    files.append(segment.file);
+
+  return files;
+}
+
+// ----------------------------------------------------------------------------
+// The player for a segment, mapping the file if it isn't open. Once too many
+// are open the one used longest ago is closed
+RmPlayer* RmLogSession::Player(int segment)
+{
+  RmSessionSegment& seg = m_segments[segment];
+
+  seg.lastUsed = ++m_useCount;
+
+  if (seg.pPlayer)
+    return seg.pPlayer;
+
+  int nOpen  = 0;
+  int oldest = -1;
+
+  for (int s = 0; s < m_segments.size(); s++)
+  {
+    if (!m_segments[s].pPlayer)
+      continue;
+
+    nOpen++;
+
+    if (oldest < 0 || m_segments[s].lastUsed < m_segments[oldest].lastUsed)
+      oldest = s;
+  }
+
+  if (nOpen >= m_maxOpen && oldest >= 0)
+  {
+    delete m_segments[oldest].pPlayer;
+    m_segments[oldest].pPlayer = nullptr;
+  }
+
+  RmPlayer* pPlayer = new RmPlayer;
+
+  if (!pPlayer->OpenFile(seg.file))
+  {
+    delete pPlayer;
+    return nullptr;
+  }
+
+  connect(pPlayer, &RmPlayer::NewPayload, this, &RmLogSession::NewPayload);
+
+  seg.pPlayer = pPlayer;
+
+  return pPlayer;
+}
+
+// ----------------------------------------------------------------------------
+// Read the record at entry, whichever file it is in
+bool RmLogSession::ReadEntry(int entry, ePlayAccess access)
+{
+  if (entry < 0 || entry >= m_entries.size())
+    return false;
+
+  const RmSessionEntry& e = m_entries[entry];
+  RmPlayer* pPlayer = Player(e.segment);
+
+  if (!pPlayer)
+    return false;
+
+  if (pPlayer->m_access != access)
+    pPlayer->SetAccess(access);
+
+  pPlayer->Seek(e.offset);
+  m_current = e.segment;
+
+  return pPlayer->ReadNextItem();
+}
+
+// ----------------------------------------------------------------------------
+// (SLOT) Read the item after the last one read, in the same file
+bool RmLogSession::ReadNextItem()
+{
+  if (m_current < 0)
+    return false;
+
+  RmPlayer* pPlayer = Player(m_current);
+
+  return pPlayer && pPlayer->ReadNextItem();
+}
+
+// ----------------------------------------------------------------------------
+// The logs in the same directory named like this one by the logger
+// (<source>_yyyyMMdd_hhmmss.<ext>), in time order. Just the file if it isn't
+// named that way
+QStringList RmLogSession::FindSegments(QString file)
+{
+  QFileInfo info(file);
+  QRegularExpression pattern("^(.*)_\\d{8}_\\d{6}$");
+  QRegularExpressionMatch match = pattern.match(info.completeBaseName());
+
+  if (!match.hasMatch())
+    return QStringList(info.absoluteFilePath());
+
+  QString     prefix = match.captured(1);
+  QDir        dir    = info.absoluteDir();
+  QStringList names  = dir.entryList(QStringList(prefix + "_*." + info.suffix()), QDir::Files, QDir::Name);
+  QStringList segments;
+
+  for (const QString& name : names)
+  {
+    QRegularExpressionMatch other = pattern.match(QFileInfo(name).completeBaseName());
+
+    if (other.hasMatch() && other.captured(1) == prefix)
+      segments.append(dir.absoluteFilePath(name));
+  }
+
+  return segments;
+}
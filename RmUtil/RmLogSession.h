@@ -0,0 +1,111 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#pragma once
+
+#include <QObject>
+#include <QString>
+#include <QVector>
+#include <QStringList>
+
+#include "RmPlayer.h"
+
+#define SESSION_MAX_GAP   10.0      // Seconds between segments of the same session
+#define SESSION_MAX_OPEN  4         // Segments kept mapped at once
+#define SESSION_MAX_DRIFT 1.0       // Seconds the ping clock may wander from the record clock
+
+// ----------------------------------------------------------------------------
+// One file of a session
+struct RmSessionSegment
+{
+  QString   file;       // The log file
+  double    start;      // Time of its first record
+  double    end;        // Time of its last record
+  int       first;      // First session entry in this file
+  int       count;      // Entries in this file
+  RmPlayer* pPlayer;    // Open player (nullptr when not mapped)
+  quint64   lastUsed;   // For the LRU eviction
+};
+
+// ----------------------------------------------------------------------------
+// A record of the session's type somewhere in the session
+struct RmSessionEntry
+{
+  quint64 offset;       // Position in its file
+  double  time;         // Record time
+  double  ping;         // Sonar ping start time (0 if the record has none)
+  double  sync;         // Ping time on the record clock, the record time without one
+  int     segment;      // File it is in
+};
+
+// ----------------------------------------------------------------------------
+// RmLogSession - the files a logging session was split into by the logger's
+// size limit, played as one. The segments either side of the file opened are
+// joined while their times follow on; the merged index numbers the records of
+// the whole session. Segments are mapped when first read and the least
+// recently used one is closed once more than m_maxOpen are open.
+// Each record also gets a sonar-synchronised time, taken from the ping clock
+// where the sonar stamps its pings, which is what playback is paced by and
+// what a time is looked up against
+
+class RmLogSession : public QObject
+{
+  Q_OBJECT
+
+public:
+  RmLogSession();
+  ~RmLogSession();
+
+  // Methods
+  bool    Open(QString file, int type, bool join = true);
+  void    Close();
+  bool    IsOpen();
+  int     Count();
+  int     Segments();
+  double  EntryTime(int entry);
+  double  SyncTime(int entry);
+  double  FrameDelta(int entry);
+  int     FindTime(double time);
+  QString CurrentFile();
+  int     CorruptRegions();
+  QVector<RmSessionEntry> Entries();
+  QStringList Files();
+  bool    ReadEntry(int entry, ePlayAccess access);
+
+  static QStringList FindSegments(QString file);
+
+  // Data
+  int     m_maxOpen;          // Segments kept mapped
+
+signals:
+  void NewPayload(unsigned short type, unsigned short version, double time, unsigned payloadSize, quint8* pPayload);
+
+public slots:
+  bool ReadNextItem();
+
+protected:
+  RmPlayer* Player(int segment);
+  void      SyncTimes();
+
+  QVector<RmSessionSegment> m_segments;   // The files in time order
+  QVector<RmSessionEntry>   m_entries;    // Records of the session's type
+  int                       m_current;    // Segment last read from
+  int                       m_nCorrupt;   // Corrupt regions skipped by the indexing
+  quint64                   m_useCount;   // LRU clock
+};
@@ -0,0 +1,381 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+#include <QFile>
+#include <QSaveFile>
+#include <QTextStream>
+#include <QJsonArray>
+#include <QJsonObject>
+#include <QJsonDocument>
+#include <QThreadPool>
+#include <QThread>
+#include <QAtomicInt>
+#include <QElapsedTimer>
+
+#include <algorithm>
+#include <cmath>
+
+#include "RmLogStats.h"
+#include "RmLogIndex.h"
+#include "RmLogSession.h"
+#include "RmLogger.h"
+
+#if defined(Q_OS_UNIX)
+#include <sys/mman.h>
+#endif
+
+// ============================================================================
+// RmLogStats - per log health figures
+
+// ----------------------------------------------------------------------------
+// Start a log's figures from nothing
+static void ClearHealth(QString file, RmLogHealth& health)
+{
+  health.file           = file;
+  health.ok             = false;
+  health.size           = 0;
+  health.nRecords       = 0;
+  health.nPings         = 0;
+  health.start          = 0.0;
+  health.end            = 0.0;
+  health.pingRate       = 0.0;
+  health.medianInterval = 0.0;
+  health.nGaps          = 0;
+  health.longestGap     = 0.0;
+  health.nOutOfOrder    = 0;
+  health.nMissing       = 0;
+  health.nResyncs       = 0;
+  health.nCorrupt       = 0;
+  health.corruptBytes   = 0;
+  health.minTemperature = 0.0;
+  health.maxTemperature = 0.0;
+  health.minPressure    = 0.0;
+  health.maxPressure    = 0.0;
+  health.payloadBytes   = 0;
+  health.originalBytes  = 0;
+  health.seconds        = 0.0;
+
+  health.ranges.clear();
+  health.gains.clear();
+}
+
+// ----------------------------------------------------------------------------
+// Walk the log once in index order and work out its figures
+bool RmLogStats::Scan(QString file, RmLogHealth& health)
+{
+  QElapsedTimer timer;
+  timer.start();
+
+  ClearHealth(file, health);
+
+  RmLogIndex index;
+
+  if (!index.Load(file))
+    return false;
+
+  QFile log(file);
+
+  if (!log.open(QIODevice::ReadOnly))
+    return false;
+
+  const quint8* pLog = index.m_fileSize ? log.map(0, index.m_fileSize) : nullptr;
+
+  if (!pLog)
+    return false;
+
+#if defined(Q_OS_UNIX)
+  // One pass front to back, let the kernel read well ahead
+  madvise((void*) pLog, index.m_fileSize, MADV_SEQUENTIAL);
+#endif
+
+  health.size     = index.m_fileSize;
+  health.nRecords = index.m_nEntries;
+  health.nCorrupt = index.m_corrupt.size();
+
+  for (const RmIndexGap& gap : index.m_corrupt)
+    health.corruptBytes += gap.size;
+
+  if (index.m_nEntries > 0)
+  {
+    health.start = index.m_pEntries[0].time;
+    health.end   = index.m_pEntries[index.m_nEntries - 1].time;
+  }
+
+  QVector<double> intervals;
+  double          firstTime = 0.0;
+  double          lastTime  = 0.0;
+  double          lastClock = 0.0;
+  double          offset    = 0.0;
+  quint32         lastId    = 0;
+
+  for (int e = 0; e < index.m_nEntries; e++)
+  {
+    const RmIndexEntry& entry = index.m_pEntries[e];
+
+    RmLogItem item;
+
+    if (entry.offset + sizeof(RmLogItem) > index.m_fileSize)
+      continue;
+
+    memcpy(&item, pLog + entry.offset, sizeof(RmLogItem));
+
+    if (entry.offset + sizeof(RmLogItem) + item.payloadSize > index.m_fileSize)
+      continue;
+
+    health.payloadBytes  += item.payloadSize;
+    health.originalBytes += item.compression ? item.originalSize : item.payloadSize;
+
+    RmPingHeader ping;
+
+    if (!RmLogIndex::ReadPing(entry.type, item.compression, pLog + entry.offset + sizeof(RmLogItem), item.payloadSize, item.originalSize, ping))
+      continue;
+
+    // Timing and ping id continuity
+    if (health.nPings == 0)
+    {
+      firstTime = entry.time;
+
+      // The ranges start from the first ping, a log without any keeps zeros
+      health.minTemperature = health.maxTemperature = ping.temperature;
+      health.minPressure    = health.maxPressure    = ping.pressure;
+    }
+    else
+    {
+      intervals.append(entry.time - lastTime);
+
+      if (ping.id <= lastId)
+        health.nOutOfOrder++;
+      else
+        health.nMissing += ping.id - lastId - 1;
+    }
+
+    // A run of the ping clock ends as in RmLogSession::SyncTimes
+    if (ping.clock > 0.0)
+    {
+      double diff = entry.time - ping.clock;
+
+      if (lastClock <= 0.0)
+        offset = diff;
+      else if (ping.clock <= lastClock || qAbs(diff - offset) > SESSION_MAX_DRIFT)
+      {
+        health.nResyncs++;
+        offset = diff;
+      }
+      else
+        offset = qMin(offset, diff);
+    }
+
+    lastTime  = entry.time;
+    lastClock = ping.clock;
+    lastId    = ping.id;
+
+    health.nPings++;
+
+    // Environment and settings
+    health.minTemperature = qMin(health.minTemperature, ping.temperature);
+    health.maxTemperature = qMax(health.maxTemperature, ping.temperature);
+    health.minPressure    = qMin(health.minPressure, ping.pressure);
+    health.maxPressure    = qMax(health.maxPressure, ping.pressure);
+
+    health.ranges[std::floor(ping.range / LOG_STATS_RANGE) * LOG_STATS_RANGE]++;
+    health.gains[std::floor(ping.gain / LOG_STATS_GAIN) * LOG_STATS_GAIN]++;
+  }
+
+  log.unmap((uchar*) pLog);
+
+  if (health.nPings > 1 && lastTime > firstTime)
+    health.pingRate = (health.nPings - 1) / (lastTime - firstTime);
+
+  // Gaps are judged against the median interval, so they hold at any ping rate
+  if (!intervals.isEmpty())
+  {
+    QVector<double> sorted = intervals;
+    auto            middle = sorted.begin() + sorted.size() / 2;
+
+    std::nth_element(sorted.begin(), middle, sorted.end());
+
+    health.medianInterval = *middle;
+
+    for (double interval : intervals)
+    {
+      if (interval > LOG_STATS_GAP * health.medianInterval)
+        health.nGaps++;
+
+      health.longestGap = qMax(health.longestGap, interval);
+    }
+  }
+
+  health.ok      = true;
+  health.seconds = timer.nsecsElapsed() / 1e9;
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Scan the logs, several at a time. The results are in the order of the files
+QVector<RmLogHealth> RmLogStats::ScanAll(QStringList files, int nThreads)
+{
+  QVector<RmLogHealth> logs(files.size());
+  QAtomicInt           next(0);
+  QThreadPool          pool;
+
+  if (nThreads <= 0)
+    nThreads = QThread::idealThreadCount();
+
+  pool.setMaxThreadCount(nThreads);
+
+  for (int t = 0; t < qMin(nThreads, files.size()); t++)
+  {
+    pool.start([&]() {
+      for (int f = next.fetchAndAddRelaxed(1); f < files.size(); f = next.fetchAndAddRelaxed(1))
+        Scan(files.at(f), logs[f]);
+    });
+  }
+
+  pool.waitForDone();
+
+  return logs;
+}
+
+// ----------------------------------------------------------------------------
+// A distribution as a JSON object, bucket edge to count
+static QJsonObject Distribution(const QMap<double, int>& buckets)
+{
+  QJsonObject object;
+
+  for (auto b = buckets.constBegin(); b != buckets.constEnd(); ++b)
+    object.insert(QString::number(b.key()), b.value());
+
+  return object;
+}
+
+// ----------------------------------------------------------------------------
+// The bucket holding the most pings
+static double Mode(const QMap<double, int>& buckets)
+{
+  double mode  = 0.0;
+  int    count = 0;
+
+  for (auto b = buckets.constBegin(); b != buckets.constEnd(); ++b)
+  {
+    if (b.value() > count)
+    {
+      mode  = b.key();
+      count = b.value();
+    }
+  }
+
+  return mode;
+}
+
+// ----------------------------------------------------------------------------
+// Stored size against the original, 1 for an empty log
+static double Ratio(const RmLogHealth& health)
+{
+  return health.payloadBytes ? (double) health.originalBytes / health.payloadBytes : 1.0;
+}
+
+// ----------------------------------------------------------------------------
+// Write the figures of every log as a JSON document
+bool RmLogStats::WriteJson(const QVector<RmLogHealth>& logs, QString file)
+{
+  QJsonArray array;
+
+  for (const RmLogHealth& health : logs)
+  {
+    QJsonObject object;
+
+    object.insert("file",             health.file);
+    object.insert("ok",               health.ok);
+    object.insert("size",             (double) health.size);
+    object.insert("records",          health.nRecords);
+    object.insert("pings",            health.nPings);
+    object.insert("start",            health.start);
+    object.insert("end",              health.end);
+    object.insert("pingRate",         health.pingRate);
+    object.insert("medianInterval",   health.medianInterval);
+    object.insert("gaps",             health.nGaps);
+    object.insert("longestGap",       health.longestGap);
+    object.insert("outOfOrder",       health.nOutOfOrder);
+    object.insert("missingIds",       (double) health.nMissing);
+    object.insert("resyncs",          health.nResyncs);
+    object.insert("corruptRegions",   health.nCorrupt);
+    object.insert("corruptBytes",     (double) health.corruptBytes);
+    object.insert("temperature",      QJsonArray({ health.minTemperature, health.maxTemperature }));
+    object.insert("pressure",         QJsonArray({ health.minPressure, health.maxPressure }));
+    object.insert("ranges",           Distribution(health.ranges));
+    object.insert("gains",            Distribution(health.gains));
+    object.insert("compressionRatio", Ratio(health));
+
+    array.append(object);
+  }
+
+  QJsonObject document;
+  document.insert("logs", array);
+
+  QSaveFile out(file);
+
+  if (!out.open(QIODevice::WriteOnly) || out.write(QJsonDocument(document).toJson()) < 0)
+  {
+    out.cancelWriting();
+    return false;
+  }
+
+  return out.commit();
+}
+
+// ----------------------------------------------------------------------------
+// Write the figures of every log as CSV, one row per log. The distributions
+// are summed up by their most common bucket
+bool RmLogStats::WriteCsv(const QVector<RmLogHealth>& logs, QString file)
+{
+  QSaveFile out(file);
+
+  if (!out.open(QIODevice::WriteOnly | QIODevice::Text))
+    return false;
+
+  QTextStream csv(&out);
+
+  csv << "file,ok,size,records,pings,duration,ping_rate,median_interval,gaps,longest_gap,out_of_order,missing_ids,"
+         "resyncs,corrupt_regions,corrupt_bytes,min_temperature,max_temperature,min_pressure,max_pressure,"
+         "main_range,main_gain,compression_ratio\n";
+
+  for (const RmLogHealth& health : logs)
+  {
+    QString name = health.file;
+
+    csv << "\"" << name.replace("\"", "\"\"") << "\"," << (health.ok ? 1 : 0) << "," << health.size << ","
+        << health.nRecords << "," << health.nPings << "," << health.end - health.start << ","
+        << health.pingRate << "," << health.medianInterval << "," << health.nGaps << "," << health.longestGap << ","
+        << health.nOutOfOrder << "," << health.nMissing << "," << health.nResyncs << ","
+        << health.nCorrupt << "," << health.corruptBytes << ","
+        << health.minTemperature << "," << health.maxTemperature << ","
+        << health.minPressure << "," << health.maxPressure << ","
+        << Mode(health.ranges) << "," << Mode(health.gains) << "," << Ratio(health) << "\n";
+  }
+
+  csv.flush();
+
+  if (csv.status() != QTextStream::Ok)
+  {
+    out.cancelWriting();
+    return false;
+  }
+
+  return out.commit();
+}
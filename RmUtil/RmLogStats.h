@@ -0,0 +1,76 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QMap>
+
+#define LOG_STATS_GAP    3.0      // A ping interval this many times the median is a gap
+#define LOG_STATS_RANGE  1.0      // Bucket width of the range distribution (m)
+#define LOG_STATS_GAIN   10.0     // Bucket width of the gain distribution (%)
+
+// ----------------------------------------------------------------------------
+// The health of one log
+struct RmLogHealth
+{
+  QString file;             // Log scanned
+  bool    ok;               // False if it could not be read
+  quint64 size;             // Bytes
+  int     nRecords;         // Records of every type
+  int     nPings;           // Simple ping results
+  double  start;            // Time of the first record
+  double  end;              // ...and of the last
+  double  pingRate;         // Pings per second
+  double  medianInterval;   // Median time between pings (s)
+  int     nGaps;            // Ping intervals over LOG_STATS_GAP times the median
+  double  longestGap;       // Longest time between pings (s)
+  int     nOutOfOrder;      // Ping ids not above the one before
+  quint64 nMissing;         // Ping ids skipped over
+  int     nResyncs;         // Ping clock restarts or drifts from the record clock
+  int     nCorrupt;         // Regions the index scan skipped...
+  quint64 corruptBytes;     // ...and their size
+  double  minTemperature;   // External temperature (deg C)
+  double  maxTemperature;
+  double  minPressure;      // External pressure (bar)
+  double  maxPressure;
+  QMap<double, int> ranges; // Pings in each LOG_STATS_RANGE bucket, by its lower edge
+  QMap<double, int> gains;  // Pings in each LOG_STATS_GAIN bucket
+  quint64 payloadBytes;     // Payload stored...
+  quint64 originalBytes;    // ...and before compression
+  double  seconds;          // Time taken to scan
+};
+
+// ----------------------------------------------------------------------------
+// RmLogStats - per log health figures for a whole campaign. Each log is mapped
+// and walked once in its index order; the figures come from the record
+// headers, the index and the ping headers. Of a compressed ping only the
+// header is unpacked (zlib payloads excepted, they can only be unpacked
+// whole). The logs are scanned concurrently, one per thread
+
+class RmLogStats
+{
+public:
+  static bool Scan(QString file, RmLogHealth& health);
+  static QVector<RmLogHealth> ScanAll(QStringList files, int nThreads = 0);
+
+  static bool WriteJson(const QVector<RmLogHealth>& logs, QString file);
+  static bool WriteCsv(const QVector<RmLogHealth>& logs, QString file);
+};
@@ -0,0 +1,148 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+#include <QFile>
+#include <QThreadPool>
+#include <QThread>
+#include <QAtomicInt>
+#include <QAtomicInteger>
+#include <QMutex>
+#include <QElapsedTimer>
+
+#include <algorithm>
+
+#include "RmLogVerify.h"
+#include "RmLogger.h"
+#include "RmCrc32c.h"
+
+// ============================================================================
+// RmLogVerify - record checksum verification
+
+// ----------------------------------------------------------------------------
+// Check every record of the log. False only if the log can't be read; the
+// records that fail are listed in the report
+bool RmLogVerify::Verify(QString file, RmVerifyReport& report, int nThreads)
+{
+  QElapsedTimer timer;
+  timer.start();
+
+  report.version   = 0;
+  report.checksums = false;
+  report.nRecords  = 0;
+  report.bytes     = 0;
+  report.seconds   = 0.0;
+  report.bad.clear();
+  report.corrupt.clear();
+
+  // Verifying leaves no sidecar behind
+  RmLogIndex index;
+
+  if (!index.Load(file, false))
+    return false;
+
+  QFile log(file);
+
+  if (!log.open(QIODevice::ReadOnly))
+    return false;
+
+  const quint8* pLog = log.map(0, index.m_fileSize);
+
+  if (!pLog)
+    return false;
+
+  RmLogHeader header;
+  memcpy(&header, pLog, sizeof(RmLogHeader));
+
+  report.version   = header.version;
+  report.checksums = header.version >= LOG_CRC_VERSION;
+  report.nRecords  = index.m_nEntries;
+  report.corrupt   = index.m_corrupt;
+
+  QAtomicInt              next(0);
+  QAtomicInteger<quint64> bytes(0);
+  QMutex                  lock;
+  QThreadPool             pool;
+  bool                    checksums = report.checksums;
+
+  if (nThreads <= 0)
+    nThreads = QThread::idealThreadCount();
+
+  pool.setMaxThreadCount(nThreads);
+
+  for (int t = 0; t < nThreads; t++)
+  {
+    pool.start([&]() {
+      QVector<RmVerifyError> bad;
+      quint64                checked = 0;
+
+      for (int b = next.fetchAndAddRelaxed(LOG_VERIFY_BLOCK); b < index.m_nEntries; b = next.fetchAndAddRelaxed(LOG_VERIFY_BLOCK))
+      {
+        for (int e = b; e < qMin(b + LOG_VERIFY_BLOCK, index.m_nEntries); e++)
+        {
+          const RmIndexEntry& entry = index.m_pEntries[e];
+          RmVerifyError       error = { entry.offset, entry.time, entry.type, 0, 0 };
+          RmLogItem           item;
+
+          // A record the index points past the end of the file is bad whatever its version
+          if (entry.offset + sizeof(RmLogItem) > index.m_fileSize)
+          {
+            bad.append(error);
+            continue;
+          }
+
+          memcpy(&item, pLog + entry.offset, sizeof(RmLogItem));
+
+          if (item.itemHeader != RmLogger::s_itemHeader || item.sizeHeader != sizeof(RmLogItem) ||
+              entry.offset + sizeof(RmLogItem) + item.payloadSize > index.m_fileSize)
+          {
+            bad.append(error);
+            continue;
+          }
+
+          if (!checksums)
+            continue;
+
+          error.stored   = item.crc;
+          error.computed = RmCrc32c::Item(pLog + entry.offset);
+          checked       += sizeof(RmLogItem) + item.payloadSize;
+
+          if (error.computed != error.stored)
+            bad.append(error);
+        }
+      }
+
+      bytes.fetchAndAddRelaxed(checked);
+
+      QMutexLocker locker(&lock);
+      report.bad += bad;
+    });
+  }
+
+  pool.waitForDone();
+
+  log.unmap((uchar*) pLog);
+
+  std::sort(report.bad.begin(), report.bad.end(), [](const RmVerifyError& a, const RmVerifyError& b) {
+    return a.offset < b.offset;
+  });
+
+  report.bytes   = bytes.loadAcquire();
+  report.seconds = timer.nsecsElapsed() / 1e9;
+
+  return true;
+}
@@ -0,0 +1,62 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+#pragma once
+
+#include <QString>
+#include <QVector>
+
+#include "RmLogIndex.h"
+
+#define LOG_VERIFY_BLOCK  1024      // Records a thread checks at a time
+
+// ----------------------------------------------------------------------------
+// A record that failed its check
+struct RmVerifyError
+{
+  quint64 offset;       // File position of the record
+  double  time;         // Its time
+  quint16 type;         // Record type (eRecordTypes)
+  quint32 stored;       // Checksum in the record
+  quint32 computed;     // Checksum of what is there now
+};
+
+// ----------------------------------------------------------------------------
+// What a verify found
+struct RmVerifyReport
+{
+  int     version;      // File version
+  bool    checksums;    // The records carry checksums (LOG_CRC_VERSION on)
+  int     nRecords;     // Records checked
+  quint64 bytes;        // Bytes checksummed
+  double  seconds;      // Time taken
+  QVector<RmVerifyError> bad;       // Records that don't match their checksum, in file order
+  QVector<RmIndexGap>    corrupt;   // Regions the index scan could not read as records
+};
+
+// ----------------------------------------------------------------------------
+// RmLogVerify - checks every record of a log against its CRC-32C. The log is
+// mapped and its records, found through the index, are shared out over the
+// threads in blocks. Logs older than LOG_CRC_VERSION have no checksums, only
+// their structure is checked
+
+class RmLogVerify
+{
+public:
+  static bool Verify(QString file, RmVerifyReport& report, int nThreads = 0);
+};
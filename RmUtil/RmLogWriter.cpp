@@ -0,0 +1,561 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "RmLogWriter.h"
+#include "RmLogger.h"
+
+#include <QDebug>
+
+#if defined(Q_OS_LINUX)
+#include <fcntl.h>
+#include <unistd.h>
+#elif defined(Q_OS_UNIX)
+#include <unistd.h>
+#elif defined(Q_OS_WIN)
+#include <io.h>
+#endif
+
+// ============================================================================
+// RmLogBlock - a pooled record buffer
+
+RmLogBlock::RmLogBlock()
+{
+  m_cmd        = logRecord;
+  m_pData      = nullptr;
+  m_size       = 0;
+  m_capacity   = 0;
+  m_queuedSize = 0;
+  m_id         = 0;
+  m_ping       = 0.0;
+  m_pending    = false;
+}
+
+RmLogBlock::~RmLogBlock()
+{
+  if (m_pData)
+    free(m_pData);
+}
+
+// ----------------------------------------------------------------------------
+// Make sure the block can hold size bytes (grown in 64kB steps)
+bool RmLogBlock::Reserve(unsigned size)
+{
+  if (size > m_capacity)
+  {
+    unsigned capacity = (size + 0xFFFF) & ~0xFFFF;
+    quint8*  pData    = (quint8*) realloc(m_pData, capacity);
+
+    if (!pData)
+      return false;
+
+    m_pData    = pData;
+    m_capacity = capacity;
+  }
+
+  m_size = size;
+
+  return true;
+}
+
+// ============================================================================
+// RmLogQueue - lock free single producer / single consumer ring
+
+RmLogQueue::RmLogQueue()
+{
+  memset(m_ring, 0, sizeof(m_ring));
+  m_head.storeRelaxed(0);
+  m_tail.storeRelaxed(0);
+}
+
+// ----------------------------------------------------------------------------
+// Add a block, returns false if the ring is full
+bool RmLogQueue::Push(RmLogBlock* pBlock)
+{
+  unsigned head = m_head.loadRelaxed();
+
+  if (head - m_tail.loadAcquire() >= LOG_QUEUE_SIZE)
+    return false;
+
+  m_ring[head & (LOG_QUEUE_SIZE - 1)] = pBlock;
+  m_head.storeRelease(head + 1);
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Take the oldest block, nullptr if the ring is empty
+RmLogBlock* RmLogQueue::Pop()
+{
+  unsigned tail = m_tail.loadRelaxed();
+
+  if (tail == m_head.loadAcquire())
+    return nullptr;
+
+  RmLogBlock* pBlock = m_ring[tail & (LOG_QUEUE_SIZE - 1)];
+  m_tail.storeRelease(tail + 1);
+
+  return pBlock;
+}
+
+// ----------------------------------------------------------------------------
+// Number of blocks in the ring (approximate when called from a third thread)
+unsigned RmLogQueue::Count()
+{
+  return m_head.loadAcquire() - m_tail.loadAcquire();
+}
+
+// ============================================================================
+// RmLogWriter - the log file writer thread
+
+RmLogWriter::RmLogWriter()
+{
+  m_preallocate = 64 * 1024 * 1024;
+  m_syncBytes   = 16 * 1024 * 1024;
+  m_syncMs      = 1000;
+  m_flushMs     = 100;
+
+  m_queued.storeRelaxed(0);
+  m_written.storeRelaxed(0);
+  m_nDropped.storeRelaxed(0);
+  m_active.storeRelaxed(0);
+  m_inFlight.storeRelaxed(0);
+
+  m_nBlocks        = 0;
+  m_pSpare         = nullptr;
+  m_pBatch         = (quint8*) qMallocAligned(LOG_BATCH_SIZE, LOG_ALIGN);
+  m_nBatch         = 0;
+  m_fileSize       = 0;
+  m_allocated      = 0;
+  m_unsynced       = 0;
+  m_canPreallocate = true;
+  m_failed         = false;
+  m_chunkStart     = 0;
+  m_lastChunk      = 0;
+  m_pIndexItem     = nullptr;
+  m_indexSize      = 0;
+}
+
+RmLogWriter::~RmLogWriter()
+{
+  Shutdown();
+
+  // Everything is back in the free ring once the thread has drained
+  while (RmLogBlock* pBlock = m_free.Pop())
+    delete pBlock;
+
+  delete m_pSpare;
+
+  qFreeAligned(m_pBatch);
+
+  if (m_pIndexItem)
+    free(m_pIndexItem);
+}
+
+// ----------------------------------------------------------------------------
+// Start the writer thread
+void RmLogWriter::Startup()
+{
+  if (isRunning())
+    return;
+
+  m_active.storeRelease(1);
+  start();
+}
+
+// ----------------------------------------------------------------------------
+// Write everything queued, close the file and stop the thread
+void RmLogWriter::Shutdown()
+{
+  if (!isRunning())
+    return;
+
+  m_active.storeRelease(0);
+  m_ready.release();
+
+  wait();
+}
+
+// ----------------------------------------------------------------------------
+// Get a free block able to hold size bytes. Returns nullptr when every block
+// is waiting to be written - the only time a record is dropped. Records leave
+// LOG_CMD_BLOCKS for the commands, so an open or close never has to wait
+RmLogBlock* RmLogWriter::Acquire(unsigned size, bool command)
+{
+  int limit = command ? LOG_QUEUE_SIZE : LOG_QUEUE_SIZE - LOG_CMD_BLOCKS;
+
+  if (m_inFlight.loadAcquire() >= limit)
+    return nullptr;
+
+  RmLogBlock* pBlock = m_pSpare;
+  m_pSpare = nullptr;
+
+  if (!pBlock)
+    pBlock = m_free.Pop();
+
+  if (!pBlock && m_nBlocks < LOG_QUEUE_SIZE)
+  {
+    pBlock = new RmLogBlock;
+    m_nBlocks++;
+  }
+
+  if (!pBlock)
+    return nullptr;
+
+  if (!pBlock->Reserve(size))
+  {
+    m_pSpare = pBlock;
+    return nullptr;
+  }
+
+  pBlock->m_cmd     = logRecord;
+  pBlock->m_id      = 0;
+  pBlock->m_ping    = 0.0;
+  pBlock->m_pending = false;
+  pBlock->m_fileName.clear();
+
+  m_inFlight.fetchAndAddRelaxed(1);
+
+  return pBlock;
+}
+
+// ----------------------------------------------------------------------------
+// Hand a filled block to the writer. The queue can't be full as there are
+// never more blocks than slots. A block marked pending may still be changing
+// size, the writer waits for it when it reaches the head of the queue
+void RmLogWriter::Submit(RmLogBlock* pBlock)
+{
+  pBlock->m_queuedSize = pBlock->m_size;
+  m_queued.fetchAndAddRelaxed(pBlock->m_queuedSize);
+
+  m_full.Push(pBlock);
+  m_ready.release();
+}
+
+// ----------------------------------------------------------------------------
+// Queue an open or close. These use the blocks records leave free, so the
+// logger's thread is never held up waiting for the disk
+bool RmLogWriter::Command(eLogCommand cmd, QString fileName, const void* pData, unsigned size)
+{
+  RmLogBlock* pBlock = Acquire(size, true);
+
+  if (!pBlock)
+    return false;
+
+  pBlock->m_cmd      = cmd;
+  pBlock->m_fileName = fileName;
+
+  if (size)
+    memcpy(pBlock->m_pData, pData, size);
+
+  Submit(pBlock);
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Bytes queued but not yet taken by the writer thread
+quint64 RmLogWriter::BytesBehind()
+{
+  return m_queued.loadAcquire() - m_written.loadAcquire();
+}
+
+// ----------------------------------------------------------------------------
+// The writer loop - drain the queue, write partial batches once they are old
+// and sync on time as well as on size
+void RmLogWriter::run()
+{
+  m_lastSync.start();
+
+  forever
+  {
+    RmLogBlock* pBlock = nullptr;
+
+    if (m_ready.tryAcquire(1, 20))
+      pBlock = m_full.Pop();
+
+    if (pBlock)
+    {
+      // Records are written in the order they were queued, even if a later
+      // one finished compressing first
+      if (pBlock->m_pending)
+      {
+        pBlock->m_encoded.acquire();
+        pBlock->m_pending = false;
+      }
+
+      switch (pBlock->m_cmd)
+      {
+      case logOpen:
+        Open(pBlock);
+        break;
+
+      case logClose:
+        Close();
+        break;
+
+      case logRecord:
+        if (m_file.isOpen() && !m_failed)
+        {
+          quint64 offset = m_fileSize + m_nBatch;
+
+          if (Append(pBlock->m_pData, pBlock->m_size))
+          {
+            m_index.AddItem(offset, pBlock->m_pData, pBlock->m_id, pBlock->m_ping);
+
+            quint64 sinceChunk = offset - (m_lastChunk ? m_lastChunk : sizeof(RmLogHeader));
+
+            if (m_index.m_nEntries - m_chunkStart >= LOG_INDEX_INTERVAL || sinceChunk >= LOG_INDEX_GAP)
+              WriteIndex(false);
+
+            if (m_lastSync.elapsed() >= m_syncMs)
+              Checkpoint();
+          }
+        }
+        break;
+      }
+
+      m_written.fetchAndAddRelaxed(pBlock->m_queuedSize);
+
+      m_free.Push(pBlock);
+      m_inFlight.fetchAndAddRelease(-1);
+      continue;
+    }
+
+    // Idle
+    if (m_nBatch && m_batchAge.elapsed() >= m_flushMs)
+      Flush();
+
+    if (m_unsynced && m_lastSync.elapsed() >= m_syncMs)
+      Checkpoint();
+
+    if (!m_active.loadAcquire() && !m_full.Count())
+      break;
+  }
+
+  Close();
+}
+
+// ----------------------------------------------------------------------------
+// Record the failure once, everything after it is discarded until the next open
+bool RmLogWriter::WriteFailed(QString reason)
+{
+  if (!m_failed)
+  {
+    m_failed = true;
+    emit LogFailed(reason + " '" + m_file.fileName() + "': " + m_file.errorString());
+  }
+
+  return false;
+}
+
+// ----------------------------------------------------------------------------
+// Close the current file and start the next with the header in the block
+void RmLogWriter::Open(RmLogBlock* pBlock)
+{
+  Close();
+
+  m_failed         = false;
+  m_fileSize       = 0;
+  m_allocated      = 0;
+  m_unsynced       = 0;
+  m_canPreallocate = (m_preallocate > 0);
+  m_chunkStart     = 0;
+  m_lastChunk      = 0;
+
+  m_index.Clear();
+
+  m_file.setFileName(pBlock->m_fileName);
+
+  // Unbuffered - the batch is the buffer
+  if (!m_file.open(QIODevice::WriteOnly | QIODevice::Truncate | QIODevice::Unbuffered))
+  {
+    WriteFailed("Unable to create the log file");
+    return;
+  }
+
+  Append(pBlock->m_pData, pBlock->m_size);
+}
+
+// ----------------------------------------------------------------------------
+// Write what is left, sync and release any preallocation past the end
+void RmLogWriter::Close()
+{
+  if (!m_file.isOpen())
+    return;
+
+  // The footer lets the player open the log without reading it through
+  if (!m_failed)
+    WriteIndex(true);
+
+  Flush();
+  Sync();
+
+#if defined(Q_OS_LINUX)
+  if (m_allocated > m_fileSize)
+  {
+    if (ftruncate(m_file.handle(), m_fileSize) != 0)
+      qDebug() << "Unable to release the log preallocation" << m_file.fileName();
+  }
+#endif
+
+  m_file.close();
+}
+
+// ----------------------------------------------------------------------------
+// Index the records since the last chunk and get everything to the disk. A
+// log cut off after this opens (and repairs) from here without a full scan
+void RmLogWriter::Checkpoint()
+{
+  if (!m_file.isOpen() || m_failed)
+    return;
+
+  if (m_index.m_nEntries > m_chunkStart)
+    WriteIndex(false);
+
+  Flush();
+  Sync();
+}
+
+// ----------------------------------------------------------------------------
+// Write the records since the last chunk as an index item, or for the footer
+// every record followed by the tail that points at it
+void RmLogWriter::WriteIndex(bool footer)
+{
+  int first = footer ? 0 : m_chunkStart;
+  int count = m_index.m_nEntries - first;
+
+  unsigned size = m_index.ItemSize(count) + (footer ? RmLogIndex::TailSize() : 0);
+
+  if (size > m_indexSize)
+  {
+    quint8* pItem = (quint8*) realloc(m_pIndexItem, size);
+
+    if (!pItem)
+      return;
+
+    m_pIndexItem = pItem;
+    m_indexSize  = size;
+  }
+
+  quint64 offset = m_fileSize + m_nBatch;
+
+  m_index.BuildItem(m_pIndexItem, first, count, footer, m_lastChunk);
+
+  if (footer)
+    RmLogIndex::BuildTail(m_pIndexItem + m_index.ItemSize(count), offset, count);
+
+  if (Append(m_pIndexItem, size))
+  {
+    m_lastChunk  = offset;
+    m_chunkStart = m_index.m_nEntries;
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Add data to the batch, writing the batch out when it is full. Anything as
+// big as a batch goes straight to the file
+bool RmLogWriter::Append(const quint8* pData, unsigned size)
+{
+  if (m_nBatch + size > LOG_BATCH_SIZE && !Flush())
+    return false;
+
+  if (size >= LOG_BATCH_SIZE)
+    return Write(pData, size);
+
+  if (m_nBatch == 0)
+    m_batchAge.start();
+
+  memcpy(m_pBatch + m_nBatch, pData, size);
+  m_nBatch += size;
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Write out the batch
+bool RmLogWriter::Flush()
+{
+  if (m_nBatch == 0)
+    return true;
+
+  unsigned n = m_nBatch;
+  m_nBatch = 0;
+
+  return Write(m_pBatch, n);
+}
+
+// ----------------------------------------------------------------------------
+// Write to the file, syncing once enough has gone out
+bool RmLogWriter::Write(const quint8* pData, unsigned size)
+{
+  if (m_failed)
+    return false;
+
+  Preallocate(m_fileSize + size);
+
+  if (m_file.write((const char*) pData, size) != (qint64) size)
+    return WriteFailed("Unable to write to the log file");
+
+  m_fileSize += size;
+  m_unsynced += size;
+
+  if (m_unsynced >= m_syncBytes)
+    Sync();
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Reserve disk space ahead of the data so the file system isn't allocating on
+// every write. The file size is left alone, a crash leaves no padding behind
+void RmLogWriter::Preallocate(quint64 end)
+{
+#if defined(Q_OS_LINUX)
+  if (!m_canPreallocate || end <= m_allocated)
+    return;
+
+  quint64 newEnd = end + m_preallocate;
+
+  if (fallocate(m_file.handle(), FALLOC_FL_KEEP_SIZE, m_allocated, newEnd - m_allocated) == 0)
+    m_allocated = newEnd;
+  else
+    m_canPreallocate = false;
+#else
+  Q_UNUSED(end)
+#endif
+}
+
+// ----------------------------------------------------------------------------
+// Push the written data to the storage
+void RmLogWriter::Sync()
+{
+  if (!m_file.isOpen() || m_unsynced == 0)
+    return;
+
+#if defined(Q_OS_LINUX)
+  fdatasync(m_file.handle());
+#elif defined(Q_OS_UNIX)
+  fsync(m_file.handle());
+#elif defined(Q_OS_WIN)
+  _commit(m_file.handle());
+#endif
+
+  m_unsynced = 0;
+  m_lastSync.restart();
+}
@@ -0,0 +1,164 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#pragma once
+
+#include <QThread>
+#include <QString>
+#include <QFile>
+#include <QSemaphore>
+#include <QAtomicInteger>
+#include <QElapsedTimer>
+
+#include "RmLogIndex.h"
+
+#define LOG_QUEUE_SIZE  256                 // Blocks in flight (power of two)
+#define LOG_CMD_BLOCKS  2                   // Of those kept back for an open and a close
+#define LOG_BATCH_SIZE  (1024 * 1024)       // Bytes gathered before a write
+#define LOG_ALIGN       4096                // Batch buffer alignment
+
+// ----------------------------------------------------------------------------
+// What the writer thread should do with a block
+enum eLogCommand
+{
+  logRecord,            // Append the block to the open file
+  logOpen,              // Open m_fileName and write the block as its header
+  logClose              // Flush, sync and close the file
+};
+
+// ----------------------------------------------------------------------------
+// RmLogBlock - a record (item header and payload) on its way to the disk. The
+// blocks are pooled and handed between the threads, never copied
+class RmLogBlock
+{
+public:
+  RmLogBlock();
+  ~RmLogBlock();
+
+  bool Reserve(unsigned size);
+
+  eLogCommand m_cmd;        // What to do with the block
+  QString     m_fileName;   // File to open (logOpen)
+  quint8*     m_pData;      // The bytes to write
+  unsigned    m_size;       // Bytes used
+  unsigned    m_capacity;   // Bytes allocated
+  unsigned    m_queuedSize; // Size when it was queued (for the bytes behind count)
+  quint32     m_id;         // Ping id for the index
+  double      m_ping;       // Ping start time for the index (0 = none)
+  bool        m_pending;    // Still being compressed, wait on m_encoded before writing
+  QSemaphore  m_encoded;    // Released once the compression has finished
+};
+
+// ----------------------------------------------------------------------------
+// RmLogQueue - single producer / single consumer ring of block pointers. Push
+// is only called from one thread and Pop from one other, so no locks are needed
+class RmLogQueue
+{
+public:
+  RmLogQueue();
+
+  bool        Push(RmLogBlock* pBlock);
+  RmLogBlock* Pop();
+  unsigned    Count();
+
+  RmLogBlock*              m_ring[LOG_QUEUE_SIZE];
+  QAtomicInteger<unsigned> m_head;    // Next slot to fill (producer)
+  QAtomicInteger<unsigned> m_tail;    // Next slot to empty (consumer)
+};
+
+// ----------------------------------------------------------------------------
+// RmLogWriter - owns the log file on a thread of its own. The logger fills
+// pooled blocks and queues them; the writer gathers them into large aligned
+// writes, preallocates ahead of the data where the file system allows it and
+// syncs periodically. A record is only lost when every block is in flight.
+// The writer also indexes the records: a chunk of the index goes into the file
+// every LOG_INDEX_INTERVAL records and with every timed sync (a checkpoint, so
+// a crash loses at most the last m_syncMs), and the whole index on close
+
+class RmLogWriter : public QThread
+{
+  Q_OBJECT
+
+public:
+  RmLogWriter();
+  ~RmLogWriter();
+
+  void run() Q_DECL_OVERRIDE;
+
+  void Startup();
+  void Shutdown();
+
+  // Producer side (the logger's thread)
+  RmLogBlock* Acquire(unsigned size, bool command = false);
+  void        Submit(RmLogBlock* pBlock);
+  bool        Command(eLogCommand cmd, QString fileName, const void* pData, unsigned size);
+  quint64     BytesBehind();
+
+  // Settings (set before logging starts)
+  quint64 m_preallocate;    // Bytes to reserve ahead of the data (0 = off)
+  quint64 m_syncBytes;      // Sync after this many bytes...
+  int     m_syncMs;         // ...or this long, whichever comes first
+  int     m_flushMs;        // Longest a partial batch waits before it is written
+
+  // Counters
+  QAtomicInteger<quint64> m_queued;     // Bytes handed to the writer
+  QAtomicInteger<quint64> m_written;    // Bytes taken off the queue by the writer
+  QAtomicInteger<quint32> m_nDropped;   // Records lost because the queue was full
+
+signals:
+  void LogFailed(QString reason);
+
+protected:
+  void Open(RmLogBlock* pBlock);
+  void Close();
+  bool Append(const quint8* pData, unsigned size);
+  bool Flush();
+  bool Write(const quint8* pData, unsigned size);
+  void Preallocate(quint64 end);
+  void Sync();
+  void Checkpoint();
+  void WriteIndex(bool footer);
+  bool WriteFailed(QString reason);
+
+  // Shared
+  RmLogQueue      m_full;       // Blocks waiting to be written
+  RmLogQueue      m_free;       // Blocks returned to the pool
+  QSemaphore      m_ready;      // One per queued block
+  QAtomicInt      m_active;     // Cleared to stop the thread
+  QAtomicInt      m_inFlight;   // Blocks handed out and not yet back in m_free
+  int             m_nBlocks;    // Blocks allocated (producer side)
+  RmLogBlock*     m_pSpare;     // Block that could not be grown (producer side)
+
+  // Writer thread
+  QFile           m_file;       // The log being written
+  quint8*         m_pBatch;     // Aligned gather buffer
+  unsigned        m_nBatch;     // Bytes in the gather buffer
+  quint64         m_fileSize;   // Bytes written to the file
+  quint64         m_allocated;  // Bytes reserved on disk
+  quint64         m_unsynced;   // Bytes written since the last sync
+  bool            m_canPreallocate; // The file system supports preallocation
+  bool            m_failed;     // The file is unusable, records are discarded
+  QElapsedTimer   m_batchAge;   // Time since the batch was started
+  QElapsedTimer   m_lastSync;   // Time since the last sync
+  RmLogIndex      m_index;      // Records written to the current file
+  int             m_chunkStart; // First record not yet in a chunk
+  quint64         m_lastChunk;  // Offset of the last chunk (0 = none yet)
+  quint8*         m_pIndexItem; // Buffer the index items are built in
+  unsigned        m_indexSize;  // Bytes allocated for it
+};
@@ -24,8 +24,7 @@
 #include <QFile>
 
 #include "RmLogger.h"
-
-#include <QMessageBox>
+#include "RmCrc32c.h"
 
 const unsigned RmLogger::s_fileHeader = 0x11223344;               // Something endian
 const unsigned RmLogger::s_itemHeader = 0xaabbccdd;
@@ -38,16 +37,29 @@ RmLogger::RmLogger(QObject *parent) : QObject(parent)
   m_key        = 0;
   m_nRecords   = 0;
   m_loggedSize = 0;
+  m_fileNumber = 0;
+  m_codec      = codecNone;
 	m_ext        = ".oculus";
 
+  // Compression shares the machine with the display
+  m_pool.setMaxThreadCount(qMax(1, QThread::idealThreadCount() / 2));
+
   // Initialise the log directory documents location
   m_logDir = QStandardPaths::writableLocation(QStandardPaths::DocumentsLocation);
+
+  // The file is written on the writer thread, failures come back as a signal
+  connect(&m_writer, &RmLogWriter::LogFailed, this, &RmLogger::WriterFailed);
+  m_writer.Startup();
 }
 
 RmLogger::~RmLogger()
 {
   if (m_state == logging)
     CloseLog();
+
+  // The writer waits on records still being compressed
+  m_pool.waitForDone();
+  m_writer.Shutdown();
 }
 
 // ----------------------------------------------------------------------------
@@ -67,27 +79,32 @@ void RmLogger::OpenFile(QString filename)
   header.fileHeader = s_fileHeader;
   header.sizeHeader = sizeof(RmLogHeader);
   memcpy(header.source, s_source, 16);
-  header.version    = 1;
+  header.version    = LOG_FILE_VERSION;
   header.encryption = 0;
   header.time       = (double) dt.toMSecsSinceEpoch() / 1000.0;
 
-  // Reset the log counters
-  m_nRecords   = 0;
-  m_loggedSize = 0;
+  // Reset the log counters. Records still being compressed count against the
+  // file they were queued for, not this one
+  m_nRecords = 0;
 
-  m_file.setFileName(m_fileName);
+  m_sizeLock.lock();
+  m_fileNumber++;
+  m_loggedSize = 0;
+  m_sizeLock.unlock();
 
-  if (m_file.open(QIODevice::WriteOnly))
+  // The writer opens the file and writes the header; a failure to create the
+  // file is reported through LogFailed
+  if (m_writer.Command(logOpen, m_fileName, &header, sizeof(RmLogHeader)))
   {
-    // Write the file header
-    m_file.write((char*)&header, sizeof(RmLogHeader));
     m_loggedSize += sizeof(RmLogHeader);
 
     m_state = logging;
   }
   else
   {
+    // Only while earlier opens and closes are still waiting for the writer
     m_state = notLogging;
+    emit LogFailed("Unable to open the log file, the log writer is too far behind");
   }
 }
 
@@ -113,6 +130,20 @@ bool RmLogger::LogIsActive()
   return (m_state == logging);
 }
 
+// ----------------------------------------------------------------------------
+// Bytes logged but not yet written to the file
+quint64 RmLogger::BytesBehind()
+{
+  return m_writer.BytesBehind();
+}
+
+// ----------------------------------------------------------------------------
+// Records lost because the writer was too far behind
+quint32 RmLogger::DroppedRecords()
+{
+  return m_writer.m_nDropped.loadRelaxed();
+}
+
 // ----------------------------------------------------------------------------
 // Browse for the directory to log to
 void RmLogger::SetLogDirectory(QString logDir)
@@ -144,19 +175,10 @@ void RmLogger::OpenLog()
   QDir ld(m_logDir);
 
   // If the log directory doesn't exist, create it
-  if (!ld.exists(m_logDir)) {
-	  QMessageBox msg;
-	  msg.setIcon(QMessageBox::Critical);
-	  msg.setStandardButtons(QMessageBox::Ok);
-
-	  QString str = "Unable to start logging.\r\n\r\nThe log directory does not exist:\r\n\r\n";
-	  str += m_logDir;
-
-	  msg.setText(str);
-	  msg.setWindowTitle("Logging Error");
-	  msg.exec();
-
-	  return;
+  if (!ld.exists(m_logDir) && !ld.mkpath(m_logDir)) {
+    m_state = notLogging;
+    emit LogFailed("Unable to start logging, the log directory '" + m_logDir + "' does not exist");
+    return;
   }
 
   OpenFile(filename);
@@ -171,20 +193,36 @@ void RmLogger::CloseLog()
   {
     m_state = closing;
 
-    m_file.close();
+    // If the writer is too far behind to take it, the file is still closed by
+    // the writer's next open or when it shuts down
+    if (!m_writer.Command(logClose, QString(), nullptr, 0))
+      qWarning() << "The log writer is behind, the log is closed later";
   }
 
   m_state = notLogging;
 }
 
+// ----------------------------------------------------------------------------
+// (SLOT) The writer could not create or write the file - stop logging
+void RmLogger::WriterFailed(QString reason)
+{
+  if (m_state == logging)
+    CloseLog();
+
+  emit LogFailed(reason);
+}
+
 
 // ----------------------------------------------------------------------------
-// (SLOT) Principal logging command
-void RmLogger::LogData(unsigned short type, unsigned short version, bool compress, unsigned size, unsigned char* pData)
+// (SLOT) Principal logging command. The record is copied into a pooled block
+// and queued for the writer thread, nothing here waits on the disk. Records to
+// be compressed are queued straight away (keeping their place in the file) and
+// compressed on the pool; the layout lets the sonar codec find the image
+void RmLogger::LogData(unsigned short type, unsigned short version, bool compress, unsigned size, unsigned char* pData, const RmCodecLayout* pLayout)
 {
   // Check whether we've exceeded the maximum log size
   if (m_state == logging) {
-	  if ((m_logCurrMaxSize > 0) && ((uint32_t)m_file.size() > m_logCurrMaxSize)) {
+	  if ((m_logCurrMaxSize > 0) && (m_loggedSize > m_logCurrMaxSize)) {
          // Close the existing log file
          CloseLog();
          // Open a new log file
@@ -193,7 +231,7 @@ void RmLogger::LogData(unsigned short type, unsigned short version, bool compres
   }
 
   // If we are logging then add the new data into the stream
-  if (m_state == logging && m_file.isOpen())
+  if (m_state == logging)
   {
     // Prepare the header
     RmLogItem logItem;
@@ -205,43 +243,84 @@ void RmLogger::LogData(unsigned short type, unsigned short version, bool compres
     logItem.version      = version;
     logItem.time         = (double) QDateTime::currentDateTime().toMSecsSinceEpoch() / 1000.0;
     logItem.originalSize = size;
+    logItem.compression  = codecNone;
+    logItem.payloadSize  = size;
+
+    RmLogBlock* pBlock = m_writer.Acquire(sizeof(RmLogItem) + size);
 
-    if (compress == false)
+    if (!pBlock)
     {
-      logItem.compression = false;
-      logItem.payloadSize = size;
+      // Every block is still waiting for the disk
+      m_writer.m_nDropped.fetchAndAddRelaxed(1);
+      return;
+    }
 
-      // Log the item header
-      m_file.write((char*)&logItem, sizeof(RmLogItem));
-      m_loggedSize += sizeof(RmLogItem);
+    memcpy(pBlock->m_pData, &logItem, sizeof(RmLogItem));
+    memcpy(pBlock->m_pData + sizeof(RmLogItem), pData, size);
 
-      // Write the payload
-      m_file.write((char*)pData, size);
-      m_loggedSize += size;
+    // The writer indexes the record, the ping id and time have to come from it
+    // uncompressed
+    RmPingHeader ping;
 
-      m_nRecords++;
+    if (RmLogIndex::ReadPing(type, codecNone, pData, size, size, ping))
+    {
+      pBlock->m_id   = ping.id;
+      pBlock->m_ping = ping.clock;
     }
-    else
-    // Class 1 compression - use the Qt compression alg
+
+    m_nRecords++;
+
+    if (!compress)
     {
-      // Compress the image (Qt default compression)
-      QByteArray compressed = qCompress(pData, size, 1);
+      RmCrc32c::Seal(pBlock->m_pData);
 
-      logItem.compression  = 1;  // 1 = qt compression
-      logItem.payloadSize  = compressed.size();
+      m_writer.Submit(pBlock);
+      m_loggedSize.fetchAndAddRelaxed(pBlock->m_size);
+      return;
+    }
 
-      // Log the item header
-      m_file.write((char*)&logItem, sizeof(RmLogItem));
-      m_loggedSize += sizeof(RmLogItem);
+    // Class 1 compression (qCompress) unless a faster codec has been chosen
+    quint16 codec = (m_codec == codecNone) ? (quint16) codecZlib : m_codec;
 
-      // Write the payload
-      m_file.write((char*)compressed.data(), compressed.size());
-      m_loggedSize += compressed.size();
+    RmCodecLayout layout = {0, 0, 0, 0};
 
-      m_nRecords++;
+    if (pLayout)
+      layout = *pLayout;
 
-      //qDebug() << "Compressed data  Original: " + QString::number((double)logItem.originalSize / 1024.0) + "kb Compressed: " + QString::number((double)logItem.payloadSize / 1024.0) + " " + QString::number(100.0 * (double)logItem.payloadSize / (double) logItem.originalSize) + "%";
-    }
+    pBlock->m_pending = true;
+    m_writer.Submit(pBlock);
+
+    unsigned fileNumber = m_fileNumber;
+
+    m_pool.start([this, pBlock, codec, layout, fileNumber]() {
+      QByteArray compressed;
+      const quint8* pPayload = pBlock->m_pData + sizeof(RmLogItem);
+      unsigned      original = pBlock->m_size - sizeof(RmLogItem);
+
+      // Keep the record as it is if the codec doesn't make it smaller
+      if (RmCodec::Compress(codec, pPayload, original, layout.lineBytes ? &layout : nullptr, compressed))
+      {
+        RmLogItem* pItem = (RmLogItem*) pBlock->m_pData;
+
+        pItem->compression = codec;
+        pItem->payloadSize = compressed.size();
+
+        memcpy(pBlock->m_pData + sizeof(RmLogItem), compressed.constData(), compressed.size());
+        pBlock->m_size = sizeof(RmLogItem) + compressed.size();
+      }
+
+      // Checksum the record as it will be stored
+      RmCrc32c::Seal(pBlock->m_pData);
+
+      m_sizeLock.lock();
+
+      if (fileNumber == m_fileNumber)
+        m_loggedSize.fetchAndAddRelaxed(pBlock->m_size);
+
+      m_sizeLock.unlock();
+
+      pBlock->m_encoded.release();
+    });
   }
 }
 
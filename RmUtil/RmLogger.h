@@ -22,6 +22,15 @@
 #include <QObject>
 #include <QFile>
 
+#include <QThreadPool>
+#include <QMutex>
+
+#include "RmLogWriter.h"
+#include "RmCodec.h"
+
+#define LOG_FILE_VERSION  2         // RmLogHeader::version written
+#define LOG_CRC_VERSION   2         // First version whose records carry a checksum
+
 // ----------------------------------------------------------------------------
 // The post-ping fire message received back from the sonar
 struct RmLogHeader
@@ -46,11 +55,16 @@ public:
   unsigned short type;         // Identifer for the contained data type
   unsigned short version;      // Version for the data type
   double         time;         // Time item creation
-  unsigned short compression;  // Compression type 0 = none, 1 = qCompress
+  unsigned short compression;  // Compression type (eLogCodec) 0 = none, 1 = qCompress
   unsigned       originalSize; // Size of the payload prior to any compression
   unsigned       payloadSize;  // Size of the following payload
+  unsigned       crc;          // CRC-32C of this item (crc as 0) and payload, LOG_CRC_VERSION files on
 };
 
+// The checksum sits in what was the structure's tail padding, so the item is
+// the same size in every file version
+static_assert(sizeof(RmLogItem) == 40, "RmLogItem layout changed");
+
 // ----------------------------------------------------------------------------
 // The current state of the logger
 enum elogState
@@ -86,7 +100,9 @@ enum eRecordTypes
 	rt_apGeoImageHeader  = 25,            // ApGeoImageHeader
 	rt_apGeoImageData    = 26,            // ApGeoImage data of image
 	rt_sbgData           = 30,            // SBG compass data message
-	rt_ocViewInfo		 = 500			  // Oculus view information
+	rt_ocViewInfo		 = 500,			  // Oculus view information
+	rt_logIndex          = 501,           // RmIndexChunk of record positions (see RmLogIndex)
+	rt_logIndexTail      = 502            // RmIndexTail, last item of a closed log
 };
 
 
@@ -124,6 +140,8 @@ public:
   void      SetupEncryption(quint16 encryption, quint64 key);
   elogState GetLogState();
   bool      LogIsActive();
+  quint64   BytesBehind();
+  quint32   DroppedRecords();
 
   // Data
   QString   m_logDir;        // The directory to log files to
@@ -131,12 +149,16 @@ public:
   uint32_t	m_logCurrMaxSize;
   QString   m_ext;           // Extension to use for the log file
   QString   m_fileName;      // Name of the file currently being logged
-  QFile     m_file;          // The file
+  RmLogWriter m_writer;      // Writes the file on its own thread
+  QThreadPool m_pool;        // Compresses records before the writer takes them
+  quint16   m_codec;         // Codec for compressed records (codecNone = qCompress)
   elogState m_state;         // The state of the logger
   quint16   m_encryption;    // The encryption level to use
   quint64   m_key;           // The encryption key to use
   unsigned  m_nRecords;      // Number of records logged in the current file
-  quint64   m_loggedSize;    // Number of bytes logged to the current record
+  QAtomicInteger<quint64> m_loggedSize; // Number of bytes queued for the current file
+  QMutex    m_sizeLock;      // Keeps a late compressed record off the next file's size...
+  unsigned  m_fileNumber;    // ...by the files opened so far
 
   quint64   m_maxRecords;    // Maximum number of records to log before opening a new file
   quint64   m_maxSize;       // Maximum number of bytes to log before opening a new file
@@ -146,11 +168,13 @@ public:
   static const char     s_source[16];
 
 signals:
+  void LogFailed(QString reason);
 
 public slots:
   void OpenLog();
   void CloseLog();
   void SetLogDirectory(QString dir);
   void SetMaxLogSize(uint32_t size);
-  void LogData(unsigned short type, unsigned short version, bool compress, unsigned size, unsigned char* pData);
+  void LogData(unsigned short type, unsigned short version, bool compress, unsigned size, unsigned char* pData, const RmCodecLayout* pLayout = nullptr);
+  void WriterFailed(QString reason);
 };
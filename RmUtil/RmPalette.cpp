@@ -0,0 +1,390 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "RmPalette.h"
+
+#include <QDebug>
+
+#if (defined(__GNUC__) || defined(__clang__)) && (defined(__x86_64__) || defined(__i386__))
+#define PAL_X86
+#define PAL_AVX2 __attribute__((target("avx2")))
+#include <immintrin.h>
+#elif defined(_MSC_VER) && (defined(_M_X64) || defined(_M_IX86))
+#define PAL_X86
+#define PAL_AVX2
+#include <immintrin.h>
+#include <intrin.h>
+#endif
+
+// ============================================================================
+// Kernels - n pixels from pSrc through the table into pDst
+
+// ----------------------------------------------------------------------------
+// Scalar versions
+static void LutRgba8(const quint32* pLut, const uchar* pSrc, int i, int n, uchar* pDst)
+{
+  for (; i < n; i++)
+    memcpy(&pDst[i * 4], &pLut[pSrc[i]], 4);
+}
+
+static void LutRgb8(const quint32* pLut, const uchar* pSrc, int i, int n, uchar* pDst)
+{
+  for (; i < n; i++)
+    memcpy(&pDst[i * 3], &pLut[pSrc[i]], 3);
+}
+
+static void LutRgba16(const quint32* pLut, const quint16* pSrc, int i, int n, uchar* pDst)
+{
+  for (; i < n; i++)
+    memcpy(&pDst[i * 4], &pLut[pSrc[i]], 4);
+}
+
+static void LutRgb16(const quint32* pLut, const quint16* pSrc, int i, int n, uchar* pDst)
+{
+  for (; i < n; i++)
+    memcpy(&pDst[i * 3], &pLut[pSrc[i]], 3);
+}
+
+#ifdef PAL_X86
+// ----------------------------------------------------------------------------
+// AVX2 versions - gather eight table entries at a time. For RGB the alpha bytes
+// are squeezed out in each lane and the lanes are joined, giving 24 bytes in a
+// 32 byte store that the next store overwrites (so the loop stops while there
+// are at least 32 bytes of output left)
+PAL_AVX2 static inline __m256i PackRgb(__m256i v)
+{
+  const __m256i squeeze = _mm256_setr_epi8(0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1,
+                                           0, 1, 2, 4, 5, 6, 8, 9, 10, 12, 13, 14, -1, -1, -1, -1);
+  const __m256i join    = _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 3, 7);
+
+  return _mm256_permutevar8x32_epi32(_mm256_shuffle_epi8(v, squeeze), join);
+}
+
+PAL_AVX2 static void LutRgba8Avx2(const quint32* pLut, const uchar* pSrc, int n, uchar* pDst)
+{
+  int i = 0;
+
+  for (; i + 8 <= n; i += 8)
+  {
+    __m256i idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)&pSrc[i]));
+    _mm256_storeu_si256((__m256i*)&pDst[i * 4], _mm256_i32gather_epi32((const int*)pLut, idx, 4));
+  }
+
+  LutRgba8(pLut, pSrc, i, n, pDst);
+}
+
+PAL_AVX2 static void LutRgb8Avx2(const quint32* pLut, const uchar* pSrc, int n, uchar* pDst)
+{
+  int i = 0;
+
+  for (; i + 11 <= n; i += 8)
+  {
+    __m256i idx = _mm256_cvtepu8_epi32(_mm_loadl_epi64((const __m128i*)&pSrc[i]));
+    _mm256_storeu_si256((__m256i*)&pDst[i * 3], PackRgb(_mm256_i32gather_epi32((const int*)pLut, idx, 4)));
+  }
+
+  LutRgb8(pLut, pSrc, i, n, pDst);
+}
+
+PAL_AVX2 static void LutRgba16Avx2(const quint32* pLut, const quint16* pSrc, int n, uchar* pDst)
+{
+  int i = 0;
+
+  for (; i + 8 <= n; i += 8)
+  {
+    __m256i idx = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)&pSrc[i]));
+    _mm256_storeu_si256((__m256i*)&pDst[i * 4], _mm256_i32gather_epi32((const int*)pLut, idx, 4));
+  }
+
+  LutRgba16(pLut, pSrc, i, n, pDst);
+}
+
+PAL_AVX2 static void LutRgb16Avx2(const quint32* pLut, const quint16* pSrc, int n, uchar* pDst)
+{
+  int i = 0;
+
+  for (; i + 11 <= n; i += 8)
+  {
+    __m256i idx = _mm256_cvtepu16_epi32(_mm_loadu_si128((const __m128i*)&pSrc[i]));
+    _mm256_storeu_si256((__m256i*)&pDst[i * 3], PackRgb(_mm256_i32gather_epi32((const int*)pLut, idx, 4)));
+  }
+
+  LutRgb16(pLut, pSrc, i, n, pDst);
+}
+#endif
+
+
+// ============================================================================
+// RmPalette - CPU palette lookup
+
+RmPalette::RmPalette()
+{
+  m_pLut16 = nullptr;
+  m_fn     = nullptr;
+
+  LoadGreyscale();
+}
+
+RmPalette::~RmPalette()
+{
+  if (m_pLut16)
+    free(m_pLut16);
+}
+
+// ----------------------------------------------------------------------------
+// Does the processor (and OS) support AVX2 - checked once
+bool RmPalette::HasAvx2()
+{
+#if defined(PAL_X86) && defined(_MSC_VER)
+  static int avx2 = -1;
+
+  if (avx2 < 0)
+  {
+    int info[4];
+
+    __cpuid(info, 1);
+    bool osSaves = (info[2] & (1 << 27)) && (info[2] & (1 << 28));
+
+    __cpuidex(info, 7, 0);
+
+    avx2 = osSaves && (info[1] & (1 << 5)) && ((_xgetbv(0) & 6) == 6) ? 1 : 0;
+  }
+
+  return avx2 == 1;
+#elif defined(PAL_X86)
+  static const bool avx2 = __builtin_cpu_supports("avx2");
+
+  return avx2;
+#else
+  return false;
+#endif
+}
+
+// ----------------------------------------------------------------------------
+// Store a colour in the 8 bit table in R G B A byte order
+void RmPalette::SetEntry(int i, QRgb colour)
+{
+  uchar* pE = (uchar*)&m_lut8[i];
+
+  pE[0] = (uchar)qRed(colour);
+  pE[1] = (uchar)qGreen(colour);
+  pE[2] = (uchar)qBlue(colour);
+  pE[3] = (uchar)qAlpha(colour);
+}
+
+// ----------------------------------------------------------------------------
+// Plain black to white ramp
+void RmPalette::LoadGreyscale()
+{
+  m_fn = nullptr;
+
+  for (int i = 0; i < 256; i++)
+    SetEntry(i, qRgb(i, i, i));
+
+  if (m_pLut16)
+    BuildLut16();
+}
+
+// ----------------------------------------------------------------------------
+// Take palette "index" from a palettes image (10 pixel rows per palette, as
+// used by the GPU palette texture and the PalWidget)
+bool RmPalette::LoadFromImage(const QImage& image, int index)
+{
+  int nPalettes = image.height() / 10;
+
+  if (image.isNull() || image.width() < 2 || index < 0 || index >= nPalettes)
+    return false;
+
+  m_fn = nullptr;
+
+  int y = index * 10 + 5;
+
+  for (int i = 0; i < 256; i++)
+    SetEntry(i, image.pixel(i * (image.width() - 1) / 255, y) | 0xff000000);
+
+  if (m_pLut16)
+    BuildLut16();
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Take a palette from the built in palettes bitmap
+bool RmPalette::LoadFromResource(int index)
+{
+  QImage image;
+
+  if (!image.load(":/RmGl/Media/palettes.bmp"))
+  {
+    qDebug() << "RmPalette::LoadFromResource, Cannot load palettes bitmap from resource";
+    return false;
+  }
+
+  return LoadFromImage(image, index);
+}
+
+// ----------------------------------------------------------------------------
+// Bake a colour curve, the 16 bit table is sampled from the curve directly
+void RmPalette::LoadFromFunction(RmPaletteFn fn)
+{
+  if (!fn)
+    return;
+
+  m_fn = fn;
+
+  for (int i = 0; i < 256; i++)
+    SetEntry(i, fn((float)i / 255.0f));
+
+  if (m_pLut16)
+    BuildLut16();
+}
+
+// ----------------------------------------------------------------------------
+// Build the 65536 entry table, from the curve or by interpolating the 8 bit table
+void RmPalette::BuildLut16()
+{
+  if (!m_pLut16)
+    m_pLut16 = (quint32*) malloc (65536 * sizeof(quint32));
+
+  if (!m_pLut16)
+    return;
+
+  for (int i = 0; i < 65536; i++)
+  {
+    uchar* pE = (uchar*)&m_pLut16[i];
+
+    if (m_fn)
+    {
+      QRgb c = m_fn((float)i / 65535.0f);
+
+      pE[0] = (uchar)qRed(c);
+      pE[1] = (uchar)qGreen(c);
+      pE[2] = (uchar)qBlue(c);
+      pE[3] = (uchar)qAlpha(c);
+    }
+    else
+    {
+      int    pos = i * 255;
+      int    e0  = pos / 65535;
+      int    e1  = qMin(e0 + 1, 255);
+      int    w   = (pos % 65535) >> 8;          // 0 - 255
+      uchar* p0  = (uchar*)&m_lut8[e0];
+      uchar* p1  = (uchar*)&m_lut8[e1];
+
+      for (int c = 0; c < 4; c++)
+        pE[c] = (uchar)((p0[c] * (256 - w) + p1[c] * w) >> 8);
+    }
+  }
+}
+
+// ----------------------------------------------------------------------------
+// Colour n 8 bit pixels into pDst (n * 3 or n * 4 bytes)
+void RmPalette::Colourise8(const uchar* pSrc, int n, uchar* pDst, ePixelFormat format) const
+{
+  if (!pSrc || !pDst || n < 1)
+    return;
+
+#ifdef PAL_X86
+  if (HasAvx2())
+  {
+    if (format == pixRgba)
+      LutRgba8Avx2(m_lut8, pSrc, n, pDst);
+    else
+      LutRgb8Avx2(m_lut8, pSrc, n, pDst);
+
+    return;
+  }
+#endif
+
+  if (format == pixRgba)
+    LutRgba8(m_lut8, pSrc, 0, n, pDst);
+  else
+    LutRgb8(m_lut8, pSrc, 0, n, pDst);
+}
+
+// ----------------------------------------------------------------------------
+// Colour n 16 bit pixels into pDst (n * 3 or n * 4 bytes)
+void RmPalette::Colourise16(const quint16* pSrc, int n, uchar* pDst, ePixelFormat format)
+{
+  if (!pSrc || !pDst || n < 1)
+    return;
+
+  if (!m_pLut16)
+    BuildLut16();
+
+  if (!m_pLut16)
+    return;
+
+#ifdef PAL_X86
+  if (HasAvx2())
+  {
+    if (format == pixRgba)
+      LutRgba16Avx2(m_pLut16, pSrc, n, pDst);
+    else
+      LutRgb16Avx2(m_pLut16, pSrc, n, pDst);
+
+    return;
+  }
+#endif
+
+  if (format == pixRgba)
+    LutRgba16(m_pLut16, pSrc, 0, n, pDst);
+  else
+    LutRgb16(m_pLut16, pSrc, 0, n, pDst);
+}
+
+// ----------------------------------------------------------------------------
+// The blue - cyan - yellow sonar colour curve (intensity 0.0 - 1.0)
+QRgb RmPalette::SonarColourMap(float intensity)
+{
+  // Clamp intensity to 0-1 range
+  intensity = qBound(0.0f, intensity, 1.0f);
+
+  int red, green, blue;
+
+  if (intensity < 0.15f) {
+    // Reduced blue range - darker blue for low intensity (deep water/no return)
+    red = 0;
+    green = static_cast<int>(intensity * 6.67f * 80); // 0 to 80 (reduced green component)
+    blue = static_cast<int>(150 + intensity * 6.67f * 105); // 150 to 255 (less intense blue)
+  }
+  else if (intensity < 0.35f) {
+    // Shorter blue to cyan transition
+    float t = (intensity - 0.15f) * 5; // 0 to 1
+    red = static_cast<int>(t * 100); // Start adding red earlier
+    green = static_cast<int>(80 + t * 175); // 80 to 255
+    blue = static_cast<int>(255 * (1 - t * 0.6f)); // 255 to ~100 (reduce blue faster)
+  }
+  else if (intensity < 0.65f) {
+    // Extended yellow range - cyan to yellow transition
+    float t = (intensity - 0.35f) * 3.33f; // 0 to 1
+    red = static_cast<int>(100 + t * 155); // 100 to 255
+    green = 255;
+    blue = static_cast<int>(100 * (1 - t)); // 100 to 0 (remove remaining blue)
+  }
+  else {
+    // Extended yellow to bright yellow/white for high intensity
+    float t = (intensity - 0.65f) * 2.86f; // 0 to 1
+    red = 255;
+    green = 255;
+    blue = static_cast<int>(t * 150); // 0 to 150 (more yellow, less white)
+  }
+
+  return qRgb(qBound(0, red, 255), qBound(0, green, 255), qBound(0, blue, 255));
+}
@@ -0,0 +1,66 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#pragma once
+
+#include <QImage>
+#include <QRgb>
+
+// Pixel layouts the palette can write
+enum ePixelFormat : int
+{
+  pixRgb,         // 3 bytes per pixel, R G B
+  pixRgba         // 4 bytes per pixel, R G B A
+};
+
+// A palette defined by a curve over intensity 0.0 - 1.0
+typedef QRgb (*RmPaletteFn)(float intensity);
+
+// ----------------------------------------------------------------------------
+// RmPalette - colours intensity images on the CPU through lookup tables baked
+// from a row of palettes.bmp or from a colour curve. The tables are applied
+// with AVX2 gathers when the processor has them and a scalar loop otherwise
+
+class RmPalette
+{
+public:
+  RmPalette();
+  ~RmPalette();
+
+  // Methods
+  bool LoadFromImage(const QImage& image, int index);
+  bool LoadFromResource(int index);
+  void LoadFromFunction(RmPaletteFn fn);
+  void LoadGreyscale();
+
+  void Colourise8(const uchar* pSrc, int n, uchar* pDst, ePixelFormat format) const;
+  void Colourise16(const quint16* pSrc, int n, uchar* pDst, ePixelFormat format);
+
+  static QRgb SonarColourMap(float intensity);
+  static bool HasAvx2();
+
+  // Data
+  quint32     m_lut8[256];   // 8 bit table, R G B A in memory order
+  quint32*    m_pLut16;      // 16 bit table, built on first use
+  RmPaletteFn m_fn;          // Source curve (nullptr for image / greyscale palettes)
+
+protected:
+  void SetEntry(int i, QRgb colour);
+  void BuildLut16();
+};
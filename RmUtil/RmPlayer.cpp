@@ -18,33 +18,57 @@
  *****************************************************************************/
 
 #include <QDebug>
+#include <QFileInfo>
+
+#if defined(Q_OS_UNIX)
+#include <sys/mman.h>
+#endif
 
 #include "RmPlayer.h"
 #include "RmLogger.h"
+#include "RmCodec.h"
 
 RmPlayer::RmPlayer()
 {
   m_pPayloadBuffer = nullptr;
+  m_pDecodeBuffer  = nullptr;
+  m_decodeSize     = 0;
   m_fileSize       = 0;
+  m_totalBytes     = 0;
+  m_pMap           = nullptr;
+  m_access         = playSequential;
 
   m_repeat = false;
 }
 
 RmPlayer::~RmPlayer()
 {
+  CloseFile();
+
   if (m_pPayloadBuffer)
     delete m_pPayloadBuffer;
 
   m_pPayloadBuffer = nullptr;
+
+  if (m_pDecodeBuffer)
+    free(m_pDecodeBuffer);
 }
 
 //   void NewPayload(unsigned short type, unsigned short version, double time, unsigned payloadSize, quint8* pPayload);
 
 // ----------------------------------------------------------------------------
 // Read through a file, perform any needed uncompression or decryption and emit the
-// payloads as a signal
+// payloads as a signal. Opening the file that is already mapped just rewinds it
 bool RmPlayer::OpenFile(QString file)
 {
+  if (m_pMap && file == m_fileName && (quint64) QFileInfo(file).size() == m_fileSize)
+  {
+    m_totalBytes = sizeof(RmLogHeader);
+    return true;
+  }
+
+  CloseFile();
+
   // Keep the last file name
   m_fileName = file;
 
@@ -71,6 +95,13 @@ bool RmPlayer::OpenFile(QString file)
     if (header.sizeHeader != sizeof(RmLogHeader))
       return ReadFailed("File header version mismatch");
 
+    // Map the whole file, private so nothing handed a payload can write to
+    // the file. If the map fails (address space) the file is read as before
+    m_pMap = m_file.map(0, m_fileSize, QFileDevice::MapPrivateOption);
+
+    if (m_pMap)
+      SetAccess(m_access);
+
     return true;
   }
   else
@@ -81,6 +112,12 @@ bool RmPlayer::OpenFile(QString file)
 // Close the file
 void RmPlayer::CloseFile()
 {
+  if (m_pMap)
+  {
+    m_file.unmap(m_pMap);
+    m_pMap = nullptr;
+  }
+
   m_file.close();
 }
 
@@ -89,7 +126,9 @@ void RmPlayer::Seek(quint64 pos)
 {
   if (m_file.isOpen())
   {
-    m_file.seek(pos);
+    if (!m_pMap)
+      m_file.seek(pos);
+
     m_totalBytes = pos;
   }
 }
@@ -100,7 +139,7 @@ bool RmPlayer::ReadFailed(QString reason)
 {
   //qDebug() << reason;
 
-  m_file.close();
+  CloseFile();
 
   if (m_pPayloadBuffer)
     delete m_pPayloadBuffer;
@@ -111,67 +150,146 @@ bool RmPlayer::ReadFailed(QString reason)
 }
 
 // ----------------------------------------------------------------------------
-// Open a file and seek to the given file position - push out one record
+// Open a file and seek to the given file position - push out one record. On
+// the mapped file this is only a seek
 bool RmPlayer::OpenFileAt(QString file, quint64 pos)
 {
-  if (OpenFile(file))
-    return m_file.seek(pos);
-  else
+  if (!OpenFile(file) || pos > m_fileSize)
     return false;
+
+  Seek(pos);
+
+  return true;
 }
 
 // ----------------------------------------------------------------------------
-// Create an index list of all the entries of a given type
-int RmPlayer::CreateTypeIndex(QString file, int type, quint64** ppEntries)
+// Tell the OS how the mapping is about to be read. Replay reads ahead, while
+// scrubbing only the pages of the records shown are wanted
+void RmPlayer::SetAccess(ePlayAccess access)
 {
-  int nEntries = 0;
+  m_access = access;
 
-  if (OpenFile(file))
-  {
-    quint64 bytesLeft = m_fileSize - m_totalBytes;
+#if defined(Q_OS_UNIX)
+  if (m_pMap)
+    madvise(m_pMap, m_fileSize, (access == playSequential) ? MADV_SEQUENTIAL : MADV_RANDOM);
+#endif
+}
 
-    while (bytesLeft > sizeof(RmLogItem))
-    {
-      m_file.seek(m_totalBytes);
+// ----------------------------------------------------------------------------
+// Is the file being read through a mapping
+bool RmPlayer::IsMapped()
+{
+  return m_pMap != nullptr;
+}
+
+// ----------------------------------------------------------------------------
+// Read the item header at pos without moving
+bool RmPlayer::ItemAt(quint64 pos, RmLogItem& item)
+{
+  if (pos > m_fileSize || m_fileSize - pos < sizeof(RmLogItem))
+    return false;
 
-      RmLogItem item;
-      quint64 readBytes = m_file.read((char*)&item, sizeof(RmLogItem));
+  if (m_pMap)
+  {
+    memcpy(&item, m_pMap + pos, sizeof(RmLogItem));
+    return true;
+  }
 
-      if (readBytes != sizeof(RmLogItem))
-        break;
+  return m_file.seek(pos) && m_file.read((char*)&item, sizeof(RmLogItem)) == sizeof(RmLogItem);
+}
 
-      // Record the position of the data record
-      quint64 filePos = m_totalBytes;
+// ----------------------------------------------------------------------------
+// Read the item at the current position. ppRaw points into the mapping, or
+// the payload buffer when the file is read through QFile
+bool RmPlayer::ReadItem(RmLogItem& item, quint8** ppRaw, QString& error)
+{
+  if (!ItemAt(m_totalBytes, item))
+  {
+    error = "Cannot read the item header";
+    return false;
+  }
 
-      // Update total bytes read
-      m_totalBytes += readBytes;
+  // Update total bytes read
+  m_totalBytes += sizeof(RmLogItem);
 
-      if (item.itemHeader != RmLogger::s_itemHeader)
-        break;
+  if (item.itemHeader != RmLogger::s_itemHeader)
+  {
+    error = "Not a valid item header";
+    return false;
+  }
 
-      if (item.sizeHeader != sizeof(RmLogItem))
-        break;
+  if (item.sizeHeader != sizeof(RmLogItem))
+  {
+    error = "Item header version mismatch";
+    return false;
+  }
 
-      // If we are the type then add to the index list
-      if (item.type == type)
-      {
-        nEntries++;
-        *ppEntries = (quint64*) realloc(*ppEntries, nEntries * sizeof(quint64));
-        (*ppEntries)[nEntries - 1] = filePos;
-      }
+  if (item.payloadSize > m_fileSize - m_totalBytes)
+  {
+    error = "Unable to read item payload";
+    return false;
+  }
 
-      // Seek past in the payload
-      m_totalBytes += item.payloadSize;
+  if (m_pMap)
+    *ppRaw = m_pMap + m_totalBytes;
+  else
+  {
+    // Make sure there is enough room in the buffer
+    m_pPayloadBuffer = (quint8*) realloc (m_pPayloadBuffer, qMax(item.payloadSize, 1u));
 
-      bytesLeft = m_fileSize - m_totalBytes;
+    // Try to read in the payload
+    if (m_file.read((char*)m_pPayloadBuffer, item.payloadSize) != item.payloadSize)
+    {
+      error = "Unable to read item payload";
+      return false;
     }
 
-    CloseFile();
+    *ppRaw = m_pPayloadBuffer;
+  }
+
+  // Update total bytes read
+  m_totalBytes += item.payloadSize;
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Decompress the payload just read if it was logged compressed. On return
+// ppPayload points at the payload as read, on return at the data to hand out
+bool RmPlayer::DecodePayload(unsigned short compression, unsigned payloadSize, unsigned originalSize, quint8** ppPayload)
+{
+  if (compression == codecNone)
+    return true;
+
+  if (originalSize > m_decodeSize)
+  {
+    quint8* pBuffer = (quint8*) realloc(m_pDecodeBuffer, originalSize);
+
+    if (!pBuffer)
+      return false;
 
-    return nEntries;
+    m_pDecodeBuffer = pBuffer;
+    m_decodeSize    = originalSize;
   }
-  else
+
+  if (!RmCodec::Decompress(compression, *ppPayload, payloadSize, m_pDecodeBuffer, originalSize))
+    return false;
+
+  *ppPayload = m_pDecodeBuffer;
+
+  return true;
+}
+
+// ----------------------------------------------------------------------------
+// Create an index list of all the entries of a given type. The index of the
+// whole file is loaded once (from the footer or sidecar where there is one) and
+// kept, so asking for another type doesn't go back to the file
+int RmPlayer::CreateTypeIndex(QString file, int type, quint64** ppEntries)
+{
+  if (!m_index.IsCurrent(file) && !m_index.Load(file))
     return 0;
+
+  return m_index.TypeIndex(type, ppEntries);
 }
 
 // ----------------------------------------------------------------------------
@@ -192,42 +310,26 @@ bool RmPlayer::ReadNextItem()
   if (bytesLeft < sizeof(RmLogItem))
     return ReadFailed("Incomplete item header found. FS:" + QString::number(m_fileSize) + " BR:" + QString::number(m_totalBytes));
 
-  RmLogItem item;
-
-  quint64 readBytes = m_file.read((char*)&item, sizeof(RmLogItem));
-
-  if (readBytes != sizeof(RmLogItem))
-    return ReadFailed("Cannot read the item header");
-
   // Record the position of the data record
   quint64 filePos = m_totalBytes;
 
-  // Update total bytes read
-  m_totalBytes += readBytes;
-
-  if (item.itemHeader != RmLogger::s_itemHeader)
-    return ReadFailed("Not a valid item header");
-
-  if (item.sizeHeader != sizeof(RmLogItem))
-    return ReadFailed("Item header version mismatch");
+  RmLogItem item;
+  quint8*   pPayload = nullptr;
+  QString   error;
 
-  // Make sure there is enough room in the buffer
-  m_pPayloadBuffer = (quint8*) realloc (m_pPayloadBuffer, item.payloadSize);
+  if (!ReadItem(item, &pPayload, error))
+    return ReadFailed(error);
 
-  // Try to read in the payload
-  readBytes = m_file.read((char*)m_pPayloadBuffer, item.payloadSize);
+  unsigned payloadSize = item.compression ? item.originalSize : item.payloadSize;
 
-  if (readBytes != item.payloadSize)
-    return ReadFailed("Unable to read item payload");
-
-  // Update total bytes read
-  m_totalBytes += item.payloadSize;
+  if (!DecodePayload(item.compression, item.payloadSize, item.originalSize, &pPayload))
+    return ReadFailed("Unable to decompress item payload");
 
   // Emit the new data packet for processing
-  emit NewPayload(item.type, item.version, item.time, item.payloadSize, m_pPayloadBuffer);
+  emit NewPayload(item.type, item.version, item.time, payloadSize, pPayload);
 
   // Emit 2nd signal with file posthe new data packet for processing
-  emit NewPayloadPos(item.type, item.version, item.time, item.payloadSize, m_pPayloadBuffer, filePos);
+  emit NewPayloadPos(item.type, item.version, item.time, payloadSize, pPayload, filePos);
 
 
   return true;
@@ -265,12 +367,10 @@ bool RmPlayer::PeekNextItem(double *time) {
 	// hunt for the next sonar record
 	while (bytesLeft > sizeof(RmLogItem))
 	{
-	  m_file.seek(totalBytes);
-
 	  RmLogItem item;
-	  quint64 readBytes = m_file.read((char*)&item, sizeof(RmLogItem));
+	  quint64 readBytes = sizeof(RmLogItem);
 
-	  if (readBytes != sizeof(RmLogItem))
+	  if (!ItemAt(totalBytes, item))
 		break;
 
 	  // Record the position of the data record
@@ -335,44 +435,28 @@ bool RmPlayer::ReadNextItemOfType(quint16 type)
     if (bytesLeft < sizeof(RmLogItem))
       return ReadFailed("Incomplete item header found");
 
-    RmLogItem item;
-
-    quint64 readBytes = m_file.read((char*)&item, sizeof(RmLogItem));
-
-    if (readBytes != sizeof(RmLogItem))
-      return ReadFailed("Cannot read the item header");
-
     // Record the position of the data record
     quint64 filePos = m_totalBytes;
 
-    // Update total bytes read
-    m_totalBytes += readBytes;
-
-    if (item.itemHeader != RmLogger::s_itemHeader)
-      return ReadFailed("Not a valid item header");
-
-    if (item.sizeHeader != sizeof(RmLogItem))
-      return ReadFailed("Item header version mismatch");
-
-    // Make sure there is enough room in the buffer
-    m_pPayloadBuffer = (quint8*) realloc (m_pPayloadBuffer, item.payloadSize);
-
-    // Try to read in the payload
-    readBytes = m_file.read((char*)m_pPayloadBuffer, item.payloadSize);
-
-    if (readBytes != item.payloadSize)
-      return ReadFailed("Unable to read item payload");
+    RmLogItem item;
+    quint8*   pPayload = nullptr;
+    QString   error;
 
-    // Update total bytes read
-    m_totalBytes += item.payloadSize;
+    if (!ReadItem(item, &pPayload, error))
+      return ReadFailed(error);
 
     if (item.type == type)
     {
+      unsigned payloadSize = item.compression ? item.originalSize : item.payloadSize;
+
+      if (!DecodePayload(item.compression, item.payloadSize, item.originalSize, &pPayload))
+        return ReadFailed("Unable to decompress item payload");
+
       // Emit the new data packet for processing
-      emit NewPayload(item.type, item.version, item.time, item.payloadSize, m_pPayloadBuffer);
+      emit NewPayload(item.type, item.version, item.time, payloadSize, pPayload);
 
       // Emit 2nd signal with file pos of the new data packet for processing
-      emit NewPayloadPos(item.type, item.version, item.time, item.payloadSize, m_pPayloadBuffer, filePos);
+      emit NewPayloadPos(item.type, item.version, item.time, payloadSize, pPayload, filePos);
 
       return true;
     }
@@ -22,8 +22,22 @@
 #include <QObject>
 #include <QFile>
 
+#include "RmLogIndex.h"
+
+struct RmLogItem;
+
 // ----------------------------------------------------------------------------
-// A tool for playing files in the .log format as logged by RmLogger
+// How the file is about to be read, passed on to the OS as a paging hint
+enum ePlayAccess
+{
+  playSequential,       // Replay - read ahead aggressively
+  playRandom            // Scrubbing - only fault in what is touched
+};
+
+// ----------------------------------------------------------------------------
+// A tool for playing files in the .log format as logged by RmLogger. The file
+// is memory mapped where possible and stays mapped until it is closed or
+// another file is opened; payloads are handed out straight from the mapping
 
 class RmPlayer : public QObject
 {
@@ -40,6 +54,9 @@ public:
   bool ReadFailed(QString reason);
   bool OpenFileAt(QString file, quint64 pos);
   int  CreateTypeIndex(QString file, int type, quint64** nEntries);
+  bool DecodePayload(unsigned short compression, unsigned payloadSize, unsigned originalSize, quint8** ppPayload);
+  void SetAccess(ePlayAccess access);
+  bool IsMapped();
 
   // Data
   QFile   m_file;            // The file
@@ -47,6 +64,11 @@ public:
   quint64 m_fileSize;        // The size of the file being read
   quint64 m_totalBytes;      // The amount of data read so far from the file
   quint8* m_pPayloadBuffer;  // Byte buffer to store the payload in
+  quint8* m_pDecodeBuffer;   // Decompressed payload
+  unsigned m_decodeSize;     // Allocated size of the decode buffer
+  RmLogIndex m_index;        // Record index of the last file indexed
+  uchar*  m_pMap;            // The file mapping (nullptr when reading through m_file)
+  ePlayAccess m_access;      // The current paging hint
 
 
   bool    m_repeat;
@@ -60,5 +82,9 @@ public slots:
   bool ReadNextItem();
   bool PeekNextItem(double *time);
   bool ReadNextItemOfType(quint16 type);
+
+protected:
+  bool ItemAt(quint64 pos, RmLogItem& item);
+  bool ReadItem(RmLogItem& item, quint8** ppRaw, QString& error);
 };
 
@@ -0,0 +1,107 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#include "SonarYolo.h"
+
+#include <algorithm>
+#include <cmath>
+
+// ----------------------------------------------------------------------------
+void SonarYoloDetect(YOLO_V8* pDetector, int width, int height, uchar* pImage,
+                     short* pBrgs, double range,
+                     QList<SonarSurface::DetectedObject>& detections,
+                     int maxDetections)
+{
+    detections.clear();
+
+    if (!pDetector || !pImage || width <= 0 || height <= 0)
+        return;
+
+    // 1. Ham sonar görüntüsünü oluştur
+    cv::Mat sonarImage(height, width, CV_8UC1, pImage);
+
+    // 2. Transpose + Flip
+    cv::Mat transformedImg;
+    cv::transpose(sonarImage, transformedImg);
+    cv::flip(transformedImg, transformedImg, 1);
+
+    // 3. 640x640 resize
+    cv::Mat resizedImg;
+    cv::resize(transformedImg, resizedImg, cv::Size(640, 640), 0, 0, cv::INTER_LINEAR);
+
+    cv::Mat rgbImg;
+    cv::cvtColor(resizedImg, rgbImg, cv::COLOR_GRAY2RGB);
+
+    cv::Mat rotatedImg;
+    cv::rotate(rgbImg, rotatedImg, cv::ROTATE_90_CLOCKWISE);
+
+    // 4. YOLO inference
+    std::vector<DL_RESULT> results;
+    pDetector->RunSession(rotatedImg, results);
+
+    if (results.empty())
+        return;
+
+    std::sort(results.begin(), results.end(),
+              [](const DL_RESULT& a, const DL_RESULT& b) {
+                  return a.confidence > b.confidence;
+              });
+
+    int numToShow = std::min((int)results.size(), maxDetections);
+
+    for (int i = 0; i < numToShow; i++) {
+        const auto& det = results[i];
+
+        // YOLO rotated image'de detection yaptı (640x640)
+        // X ekseni = bearing (soldan sağa)
+        // Y ekseni = range (yukarıdan aşağı, 0=yakın, 640=uzak)
+
+        float yolo_centerX = det.box.x + det.box.width / 2.0f;
+        float yolo_centerY = det.box.y + det.box.height / 2.0f;
+
+        // X → Bearing index
+        float normalized_x = (640.0f - yolo_centerX) / 640.0f;
+        int bearingIndex = (int)(normalized_x * width);
+        bearingIndex = std::max(0, std::min(bearingIndex, width - 1));
+
+        float bearingRad = 0.0f;
+        if (pBrgs) {
+            bearingRad = pBrgs[bearingIndex] * 0.01f * M_PI / 180.0f;
+        }
+
+        // Y → Distance (mesafe)
+        float distance = ((640.0f - yolo_centerY) / 640.0f) * range;
+
+        // Polar to Cartesian
+        float x = distance * sin(bearingRad);
+        float y = distance * cos(bearingRad);
+
+        float objectWidthMeters = (det.box.width / 640.0f) * range * 0.2f;
+        float objectHeightMeters = (det.box.height / 640.0f) * range * 0.15f;
+
+
+        SonarSurface::DetectedObject obj;
+        obj.meterPos = QPointF(x, y);
+        obj.meterWidth = objectWidthMeters;
+        obj.meterHeight = objectHeightMeters;
+        obj.confidence = det.confidence;
+
+        detections.append(obj);
+    }
+}
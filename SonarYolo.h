@@ -0,0 +1,35 @@
+/******************************************************************************
+ * (c) Copyright 2017 Blueprint Subsea.
+ * This file is part of Oculus Viewer
+ *
+ * Oculus Viewer is free software: you can redistribute it and/or modify
+ * it under the terms of the GNU General Public License as published by
+ * the Free Software Foundation, either version 3 of the License, or
+ * (at your option) any later version.
+ *
+ * Oculus Viewer is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ * GNU General Public License for more details.
+ *
+ * You should have received a copy of the GNU General Public License
+ * along with this program.  If not, see <http://www.gnu.org/licenses/>.
+ *
+ *****************************************************************************/
+
+#pragma once
+
+#include <QList>
+
+#include "inference.h"
+#include "Displays/SonarSurface.h"
+
+// ----------------------------------------------------------------------------
+// Run the YOLO detector over a polar sonar image (nRanges x nBeams, 8 bit) and
+// map the strongest results back onto the fan in metres. Shared by the live view
+// and the headless exporter so both draw the same overlay. Throws on inference
+// errors (as YOLO_V8::RunSession does)
+void SonarYoloDetect(YOLO_V8* pDetector, int width, int height, uchar* pImage,
+                     short* pBrgs, double range,
+                     QList<SonarSurface::DetectedObject>& detections,
+                     int maxDetections = 10);
@@ -18,6 +18,8 @@
  *****************************************************************************/
 
 #include "OculusSonar/MainView.h"
+#include "OculusSonar/LogExporter.h"
+#include "OculusSonar/LogTools.h"
 #include <QApplication>
 #include <QPalette>
 #include <QSettings>
@@ -30,6 +32,14 @@
 
 int main(int argc, char *argv[])
 {
+  // Headless export of a log file, runs without the main window (or a display)
+  if (LogExporter::IsExportCommand(argc, argv))
+    return LogExporter::Main(argc, argv);
+
+  // Log utilities (benchmarks, checks, repairs)
+  if (LogTools::IsToolCommand(argc, argv))
+    return LogTools::Main(argc, argv);
+
   QApplication a(argc, argv);
 
   QString version = QString::number(MAJOR_VERSION) + "." + QString::number(MINOR_VERSION) + "." + QString::number(BUILD_VERSION);